@@ -7,9 +7,11 @@
 #pragma comment(lib, "DbgHelp.lib")
 #endif
 
+#include <algorithm>
 #include "utility.h"
 #include "c_api.h"
 #include "editor_core.h"
+#include "logging.h"
 
 template<typename T>
 class CPtrHolder {
@@ -148,6 +150,14 @@ const U16Char* get_document_line_text(intptr_t document_handle, size_t line) {
   return StrUtil::allocU16Chars(u16_text);
 }
 
+size_t copy_document_line_text(intptr_t document_handle, size_t line, U16Char* buffer, size_t capacity) {
+  Ptr<Document> document = getCPtrHolderValue<Document>(document_handle);
+  if (document == nullptr || line >= document->getLineCount()) {
+    return 0;
+  }
+  return StrUtil::copyU16Chars(document->getLineU16View(line), buffer, capacity);
+}
+
 intptr_t create_editor(float touch_slop, int64_t double_tap_timeout, MeasureTextWidth measurer_func, GetFontMetrics metrics_func) {
   Ptr<CTextMeasurer> c_measurer = makePtr<CTextMeasurer>(measurer_func, metrics_func);
   TouchConfig touch_config = {touch_slop, double_tap_timeout};
@@ -221,13 +231,313 @@ const U16Char* build_editor_render_model(intptr_t editor_handle) {
   return result;
 }
 
+const U16Char* build_editor_render_delta(intptr_t editor_handle, uint64_t base_sequence) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return CHAR16_NONE;
+  }
+  EditorRenderDelta delta;
+  editor_core->buildRenderDelta(base_sequence, delta);
+  U8String u8_text = delta.toJson();
+  U16Char* result;
+  StrUtil::convertUTF8ToUTF16(u8_text, &result);
+  return result;
+}
+
+size_t build_editor_render_model_binary(intptr_t editor_handle, uint8_t* buffer, size_t capacity) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  EditorRenderModel model;
+  editor_core->buildRenderModel(model);
+  return editor_core->encodeRenderModel(model, buffer, capacity);
+}
+
+size_t build_editor_render_delta_binary(intptr_t editor_handle, uint64_t base_sequence, uint8_t* buffer, size_t capacity) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  EditorRenderDelta delta;
+  editor_core->buildRenderDelta(base_sequence, delta);
+  return editor_core->encodeRenderDelta(delta, buffer, capacity);
+}
+
 const U16Char* get_editor_visual_run_text(intptr_t editor_handle, int64_t run_text_id) {
   Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
   if (editor_core == nullptr) {
     return CHAR16_NONE;
   }
-  U16String u16_text = editor_core->getVisualRunText(run_text_id);
-  return StrUtil::allocU16Chars(u16_text);
+  return StrUtil::allocU16Chars(editor_core->getVisualRunText(run_text_id));
+}
+
+size_t copy_editor_visual_run_text(intptr_t editor_handle, int64_t run_text_id, U16Char* buffer, size_t capacity) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  return StrUtil::copyU16Chars(editor_core->getVisualRunText(run_text_id), buffer, capacity);
+}
+
+void set_editor_frame_buffers(intptr_t editor_handle, uint8_t** buffers, const size_t* capacities, uint32_t count) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->setFrameBuffers(buffers, capacities, count);
+}
+
+int32_t build_editor_frame(intptr_t editor_handle, uint64_t base_sequence) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return -1;
+  }
+  return editor_core->buildFrame(base_sequence);
+}
+
+void release_editor_frame(intptr_t editor_handle, int32_t index) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->releaseFrame(index);
+}
+
+size_t prefetch_editor_layout(intptr_t editor_handle, size_t max_lines) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  return editor_core->prefetchLayout(max_lines);
+}
+
+void get_editor_prefetch_stats(intptr_t editor_handle, uint64_t* stats, size_t length) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || stats == nullptr) {
+    return;
+  }
+  const PrefetchStats prefetch_stats = editor_core->getPrefetchStats();
+  const uint64_t values[] = {prefetch_stats.hit_count, prefetch_stats.miss_count, prefetch_stats.prefetched_lines};
+  for (size_t i = 0; i < length && i < 3; ++i) {
+    stats[i] = values[i];
+  }
+}
+
+void set_editor_styles(intptr_t editor_handle, const uint32_t* styles, size_t count) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (styles == nullptr && count > 0)) {
+    return;
+  }
+  Vector<Style> style_list(count);
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t* fields = styles + i * 3;
+    style_list[i] = {fields[0], static_cast<int32_t>(fields[1]), (fields[2] & 1) != 0, (fields[2] & 2) != 0};
+  }
+  editor_core->setStyles(std::move(style_list));
+}
+
+void set_editor_style_spans(intptr_t editor_handle, size_t start_line, const uint32_t* packed, size_t count) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (packed == nullptr && count > 0)) {
+    return;
+  }
+  editor_core->setPackedSpans(start_line, packed, count);
+}
+
+int32_t apply_editor_style_span_edits(intptr_t editor_handle, const uint32_t* edits, size_t length) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (edits == nullptr && length > 0)) {
+    return 0;
+  }
+  return editor_core->applyPackedSpanEdits(edits, length) ? 1 : 0;
+}
+
+void set_editor_inlay_hints(intptr_t editor_handle, size_t start_line, size_t line_count,
+  const uint32_t* packed, size_t count, const char* texts, size_t texts_length) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (packed == nullptr && count > 0)) {
+    return;
+  }
+  Vector<Vector<InlayHint>> hints(line_count);
+  size_t text_offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t* fields = packed + i * 5;
+    const size_t text_length = texts == nullptr ? 0 : fields[4];
+    if (text_length > texts_length - text_offset) {
+      return;
+    }
+    if (fields[0] >= start_line && fields[0] - start_line < line_count) {
+      InlayHint hint;
+      hint.column = fields[1];
+      hint.type = fields[2] == 1 ? InlayType::ICON : InlayType::TEXT;
+      hint.icon_id = static_cast<int32_t>(fields[3]);
+      hint.text.assign(texts == nullptr ? "" : texts + text_offset, text_length);
+      hints[fields[0] - start_line].push_back(std::move(hint));
+    }
+    text_offset += text_length;
+  }
+  editor_core->setInlayHints(start_line, std::move(hints));
+}
+
+void set_editor_phantom_texts(intptr_t editor_handle, size_t start_line, size_t line_count,
+  const uint32_t* packed, size_t count, const char* texts, size_t texts_length) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (packed == nullptr && count > 0)) {
+    return;
+  }
+  Vector<Vector<PhantomText>> phantom_texts(line_count);
+  size_t text_offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t* fields = packed + i * 3;
+    const size_t text_length = texts == nullptr ? 0 : fields[2];
+    if (text_length > texts_length - text_offset) {
+      return;
+    }
+    if (fields[0] >= start_line && fields[0] - start_line < line_count) {
+      PhantomText phantom_text;
+      phantom_text.column = fields[1];
+      phantom_text.text.assign(texts == nullptr ? "" : texts + text_offset, text_length);
+      phantom_texts[fields[0] - start_line].push_back(std::move(phantom_text));
+    }
+    text_offset += text_length;
+  }
+  editor_core->setPhantomTexts(start_line, std::move(phantom_texts));
+}
+
+void set_editor_diagnostics(intptr_t editor_handle, const uint32_t* packed, size_t count) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (packed == nullptr && count > 0)) {
+    return;
+  }
+  Vector<Diagnostic> diagnostics(count);
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t* fields = packed + i * 6;
+    Diagnostic& diagnostic = diagnostics[i];
+    diagnostic.range = {{fields[0], fields[1]}, {fields[2], fields[3]}};
+    diagnostic.severity = static_cast<DiagnosticSeverity>(std::clamp<uint32_t>(fields[4], 1, 4));
+    diagnostic.style = static_cast<DiagnosticStyle>(std::min<uint32_t>(fields[5], 2));
+  }
+  editor_core->setDiagnostics(std::move(diagnostics));
+}
+
+void set_editor_selections(intptr_t editor_handle, const uint32_t* packed, size_t count, size_t primary_index) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (packed == nullptr && count > 0)) {
+    return;
+  }
+  Vector<Selection> selections(count);
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t* fields = packed + i * 4;
+    selections[i] = {{fields[0], fields[1]}, {fields[2], fields[3]}};
+  }
+  editor_core->setSelections(std::move(selections), primary_index);
+}
+
+void editor_insert_text(intptr_t editor_handle, const char* text) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || text == nullptr) {
+    return;
+  }
+  editor_core->insertText(text);
+}
+
+void editor_delete_backward(intptr_t editor_handle) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->deleteBackward();
+}
+
+void editor_select_all(intptr_t editor_handle) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->selectAll();
+}
+
+void copy_editor_selected_text(intptr_t editor_handle, TextChunkReceiver receiver) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || receiver == nullptr) {
+    return;
+  }
+  editor_core->copySelectedText([receiver, editor_handle](const char* data, size_t length) {
+    receiver(editor_handle, data, length);
+  });
+}
+
+void editor_scroll_to_line(intptr_t editor_handle, size_t line, uint8_t behavior) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->scrollToLine(line, static_cast<ScrollBehavior>(std::min<uint8_t>(behavior, 2)));
+}
+
+void editor_smooth_scroll_to_line(intptr_t editor_handle, size_t line, uint8_t behavior, int64_t duration_ms) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  editor_core->smoothScrollToLine(line, static_cast<ScrollBehavior>(std::min<uint8_t>(behavior, 2)), duration_ms);
+}
+
+int32_t update_editor_scroll_animation(intptr_t editor_handle) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  return editor_core->updateScrollAnimation() ? 1 : 0;
+}
+
+int32_t set_editor_grammar(intptr_t editor_handle, const char* grammar_json) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || grammar_json == nullptr) {
+    return 0;
+  }
+  try {
+    editor_core->setGrammar(nlohmann::json::parse(grammar_json).get<Grammar>());
+  } catch (const std::exception& e) {
+    LOGE("set_editor_grammar failed: %s", e.what());
+    return 0;
+  }
+  return 1;
+}
+
+void set_editor_highlight_callback(intptr_t editor_handle, HighlightReady callback) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return;
+  }
+  if (callback == nullptr) {
+    editor_core->setHighlightReadyCallback(nullptr);
+    return;
+  }
+  editor_core->setHighlightReadyCallback([callback, editor_handle] {
+    callback(editor_handle);
+  });
+}
+
+void set_editor_fold_ranges(intptr_t editor_handle, const uint32_t* ranges, size_t count) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr || (ranges == nullptr && count > 0)) {
+    return;
+  }
+  Vector<FoldRange> fold_ranges(count);
+  for (size_t i = 0; i < count; ++i) {
+    fold_ranges[i] = {ranges[i * 3], ranges[i * 3 + 1], ranges[i * 3 + 2] != 0};
+  }
+  editor_core->setFoldRanges(fold_ranges);
+}
+
+int32_t set_editor_fold_collapsed(intptr_t editor_handle, size_t line, int32_t collapsed) {
+  Ptr<EditorCore> editor_core = getCPtrHolderValue<EditorCore>(editor_handle);
+  if (editor_core == nullptr) {
+    return 0;
+  }
+  return editor_core->setFoldCollapsed(line, collapsed != 0) ? 1 : 0;
 }
 
 const U16Char* get_editor_params(intptr_t editor_handle) {
@@ -0,0 +1,271 @@
+//
+// Created by Scave on 2025/12/16.
+//
+#include <cstring>
+#include "codec.h"
+
+namespace NS_SWEETEDITOR {
+  // ======================================== BinaryWriter =================================================
+  BinaryWriter::BinaryWriter(uint8_t* buffer, size_t capacity): m_buffer_(buffer), m_capacity_(buffer == nullptr ? 0 : capacity) {
+  }
+
+  void BinaryWriter::writeU8(uint8_t value) {
+    writeBytes(&value, 1);
+  }
+
+  void BinaryWriter::writeU16(uint16_t value) {
+    uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    writeBytes(bytes, 2);
+  }
+
+  void BinaryWriter::writeU32(uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; ++i) {
+      bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+    writeBytes(bytes, 4);
+  }
+
+  void BinaryWriter::writeU64(uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) {
+      bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+    writeBytes(bytes, 8);
+  }
+
+  void BinaryWriter::writeF32(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32(bits);
+  }
+
+  void BinaryWriter::writePoint(const PointF& point) {
+    writeF32(point.x);
+    writeF32(point.y);
+  }
+
+  void BinaryWriter::writeU16Text(U16StringView text) {
+    writeU32(static_cast<uint32_t>(text.length()));
+    for (U16Char ch : text) {
+      writeU16(static_cast<uint16_t>(ch));
+    }
+  }
+
+  void BinaryWriter::patchU32(size_t offset, uint32_t value) {
+    if (offset + 4 > m_capacity_) {
+      return;
+    }
+    for (int i = 0; i < 4; ++i) {
+      m_buffer_[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+  }
+
+  size_t BinaryWriter::size() const {
+    return m_size_;
+  }
+
+  bool BinaryWriter::isOverflow() const {
+    return m_size_ > m_capacity_;
+  }
+
+  void BinaryWriter::writeBytes(const uint8_t* bytes, size_t length) {
+    if (m_size_ + length <= m_capacity_) {
+      std::memcpy(m_buffer_ + m_size_, bytes, length);
+    }
+    m_size_ += length;
+  }
+
+  // ======================================== RenderModelEncoder =================================================
+  RenderModelEncoder::RenderModelEncoder(const TextLayout& text_layout): m_text_layout_(text_layout) {
+  }
+
+  size_t RenderModelEncoder::encode(const EditorRenderModel& model, uint8_t* buffer, size_t capacity) const {
+    BinaryWriter writer(buffer, capacity);
+    writeHeader(writer, RenderBinaryKind::MODEL);
+    writer.writeU64(model.sequence);
+    writer.writeF32(model.split_x);
+    writer.writePoint(model.current_line);
+    writeCursor(writer, model.cursor);
+    writer.writeU32(static_cast<uint32_t>(model.extra_cursors.size()));
+    for (const Cursor& cursor : model.extra_cursors) {
+      writeCursor(writer, cursor);
+    }
+    writeLines(writer, model.lines);
+    writeGuideLines(writer, model.guide_lines);
+    writeDiagnostics(writer, model.diagnostics);
+    writeSelectionRects(writer, model.selection_rects);
+    finishHeader(writer);
+    return writer.size();
+  }
+
+  size_t RenderModelEncoder::encode(const EditorRenderDelta& delta, uint8_t* buffer, size_t capacity) const {
+    BinaryWriter writer(buffer, capacity);
+    writeHeader(writer, RenderBinaryKind::DELTA);
+    writer.writeU64(delta.sequence);
+    writer.writeU64(delta.base_sequence);
+    writer.writeF32(delta.split_x);
+    writer.writePoint(delta.current_line);
+    writeCursor(writer, delta.cursor);
+    writer.writeU32(static_cast<uint32_t>(delta.extra_cursors.size()));
+    for (const Cursor& cursor : delta.extra_cursors) {
+      writeCursor(writer, cursor);
+    }
+    writeLines(writer, delta.added_lines);
+    writeLines(writer, delta.changed_lines);
+    writer.writeU32(static_cast<uint32_t>(delta.shifted_lines.size()));
+    for (const VisualLineShift& shift : delta.shifted_lines) {
+      writer.writeU32(static_cast<uint32_t>(shift.key.logical_line));
+      writer.writeU32(static_cast<uint32_t>(shift.key.wrap_index));
+      writer.writeF32(shift.offset_x);
+      writer.writeF32(shift.offset_y);
+    }
+    writer.writeU32(static_cast<uint32_t>(delta.removed_lines.size()));
+    for (const VisualLineKey& key : delta.removed_lines) {
+      writer.writeU32(static_cast<uint32_t>(key.logical_line));
+      writer.writeU32(static_cast<uint32_t>(key.wrap_index));
+    }
+    writer.writeU32(static_cast<uint32_t>(delta.line_shift_start));
+    writer.writeU32(static_cast<uint32_t>(static_cast<int32_t>(delta.line_shift)));
+    writeGuideLines(writer, delta.guide_lines);
+    writeDiagnostics(writer, delta.diagnostics);
+    writeSelectionRects(writer, delta.selection_rects);
+    finishHeader(writer);
+    return writer.size();
+  }
+
+  void RenderModelEncoder::writeHeader(BinaryWriter& writer, RenderBinaryKind kind) const {
+    writer.writeU32(kRenderBinaryMagic);
+    writer.writeU16(kRenderBinaryVersion);
+    writer.writeU16(static_cast<uint16_t>(kind));
+    // total_size 在编码结束后回填
+    writer.writeU32(0);
+    writer.writeU32(0);
+  }
+
+  void RenderModelEncoder::finishHeader(BinaryWriter& writer) const {
+    writer.patchU32(8, static_cast<uint32_t>(writer.size()));
+  }
+
+  void RenderModelEncoder::writeLine(BinaryWriter& writer, const VisualLine& line) const {
+    writer.writeU32(static_cast<uint32_t>(line.logical_line));
+    writer.writeU32(static_cast<uint32_t>(line.wrap_index));
+    writer.writePoint(line.line_number_position);
+    writer.writeU8(line.is_folded ? 1 : 0);
+    writer.writeU32(static_cast<uint32_t>(line.runs.size()));
+    for (const VisualRun& run : line.runs) {
+      writer.writeU8(static_cast<uint8_t>(run.type));
+      writer.writeU32(static_cast<uint32_t>(run.column));
+      writer.writeU32(static_cast<uint32_t>(run.length));
+      writer.writeF32(run.x);
+      writer.writeF32(run.y);
+      writer.writeU32(run.style_id);
+      writer.writeU16Text(m_text_layout_.getTextById(run.text_id));
+    }
+  }
+
+  void RenderModelEncoder::writeLines(BinaryWriter& writer, const Vector<VisualLine>& lines) const {
+    writer.writeU32(static_cast<uint32_t>(lines.size()));
+    for (const VisualLine& line : lines) {
+      writeLine(writer, line);
+    }
+  }
+
+  void RenderModelEncoder::writeCursor(BinaryWriter& writer, const Cursor& cursor) const {
+    writer.writePoint(cursor.position);
+    writer.writeU8(cursor.show_dragger ? 1 : 0);
+  }
+
+  void RenderModelEncoder::writeGuideLines(BinaryWriter& writer, const Vector<GuideLine>& guide_lines) const {
+    writer.writeU32(static_cast<uint32_t>(guide_lines.size()));
+    for (const GuideLine& guide_line : guide_lines) {
+      writer.writeU8(static_cast<uint8_t>(guide_line.direction));
+      writer.writePoint(guide_line.start);
+      writer.writePoint(guide_line.end);
+    }
+  }
+
+  void RenderModelEncoder::writeDiagnostics(BinaryWriter& writer, const Vector<DiagnosticSegment>& diagnostics) const {
+    writer.writeU32(static_cast<uint32_t>(diagnostics.size()));
+    for (const DiagnosticSegment& segment : diagnostics) {
+      writer.writeU8(static_cast<uint8_t>(segment.severity));
+      writer.writeU8(static_cast<uint8_t>(segment.style));
+      writer.writePoint(segment.start);
+      writer.writePoint(segment.end);
+    }
+  }
+
+  void RenderModelEncoder::writeSelectionRects(BinaryWriter& writer, const Vector<SelectionRect>& rects) const {
+    writer.writeU32(static_cast<uint32_t>(rects.size()));
+    for (const SelectionRect& rect : rects) {
+      writer.writePoint(rect.origin);
+      writer.writeF32(rect.width);
+      writer.writeF32(rect.height);
+    }
+  }
+
+  // ======================================== FrameBufferRing =================================================
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+    "frame slot state must be a plain lock-free u32 shared with the platform");
+
+  void FrameBufferRing::setBuffers(uint8_t* const* buffers, const size_t* capacities, uint32_t count) {
+    m_slots_.clear();
+    m_next_slot_ = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      // 状态字直接作为原子变量访问，未对齐的内存（例如托管堆中任意偏移的数组）无法保证原子性，与容量不足的一样忽略
+      if (buffers[i] == nullptr || capacities[i] < kFrameSlotHeaderSize
+        || reinterpret_cast<uintptr_t>(buffers[i]) % alignof(std::atomic<uint32_t>) != 0) {
+        continue;
+      }
+      FrameSlot slot = {buffers[i], capacities[i]};
+      std::memset(slot.memory, 0, kFrameSlotHeaderSize);
+      m_slots_.push_back(slot);
+    }
+  }
+
+  int32_t FrameBufferRing::acquire() {
+    const uint32_t count = static_cast<uint32_t>(m_slots_.size());
+    for (uint32_t i = 0; i < count; ++i) {
+      const uint32_t index = (m_next_slot_ + i) % count;
+      uint32_t expected = static_cast<uint32_t>(FrameSlotState::FREE);
+      if (stateOf(m_slots_[index]).compare_exchange_strong(expected, static_cast<uint32_t>(FrameSlotState::WRITING),
+        std::memory_order_acquire)) {
+        m_next_slot_ = (index + 1) % count;
+        return static_cast<int32_t>(index);
+      }
+    }
+    return -1;
+  }
+
+  uint8_t* FrameBufferRing::payload(int32_t index) const {
+    return m_slots_[index].memory + kFrameSlotHeaderSize;
+  }
+
+  size_t FrameBufferRing::payloadCapacity(int32_t index) const {
+    return m_slots_[index].capacity - kFrameSlotHeaderSize;
+  }
+
+  void FrameBufferRing::publish(int32_t index, size_t data_size, uint64_t sequence) {
+    const FrameSlot& slot = m_slots_[index];
+    const FrameSlotState state = data_size > payloadCapacity(index) ? FrameSlotState::TOO_LARGE : FrameSlotState::READY;
+    BinaryWriter writer(slot.memory + 4, kFrameSlotHeaderSize - 4);
+    writer.writeU32(static_cast<uint32_t>(data_size));
+    writer.writeU64(sequence);
+    stateOf(slot).store(static_cast<uint32_t>(state), std::memory_order_release);
+  }
+
+  void FrameBufferRing::release(int32_t index) {
+    if (index < 0 || static_cast<size_t>(index) >= m_slots_.size()) {
+      return;
+    }
+    stateOf(m_slots_[index]).store(static_cast<uint32_t>(FrameSlotState::FREE), std::memory_order_release);
+  }
+
+  uint32_t FrameBufferRing::size() const {
+    return static_cast<uint32_t>(m_slots_.size());
+  }
+
+  std::atomic<uint32_t>& FrameBufferRing::stateOf(const FrameSlot& slot) {
+    return *reinterpret_cast<std::atomic<uint32_t>*>(slot.memory);
+  }
+}
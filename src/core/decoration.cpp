@@ -1,9 +1,379 @@
 //
 // Created by Scave on 2025/12/10.
 //
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include "decoration.h"
 
 namespace NS_SWEETEDITOR {
+  /// 每个编码Span占用的uint32个数
+  static constexpr size_t kPackedSpanFields = 5;
+
+  static bool isSameInlay(const InlayHint& a, const InlayHint& b) {
+    return a.column == b.column && a.type == b.type && a.icon_id == b.icon_id && a.text == b.text;
+  }
+
+  static bool isSameInlay(const PhantomText& a, const PhantomText& b) {
+    return a.column == b.column && a.text == b.text;
+  }
+
+  /// 逐行替换按列定位的嵌入内容，只有内容变化的行被记录
+  template<typename T>
+  static void replaceLineInlays(LineArray<T>& lines, size_t start_line, Vector<Vector<T>>&& items, Vector<size_t>& changed_lines) {
+    size_t end_line = start_line + items.size();
+    while (end_line > start_line && end_line > lines.size() && items[end_line - start_line - 1].empty()) {
+      --end_line;
+    }
+    if (end_line > lines.size()) {
+      lines.resize(end_line);
+    }
+    for (size_t line = start_line; line < end_line; ++line) {
+      Vector<T>& line_items = items[line - start_line];
+      std::stable_sort(line_items.begin(), line_items.end(), [](const T& a, const T& b) {
+        return a.column < b.column;
+      });
+      Vector<T>& old_items = lines[line];
+      const bool is_same = line_items.size() == old_items.size()
+        && std::equal(line_items.begin(), line_items.end(), old_items.begin(), [](const T& a, const T& b) {
+          return isSameInlay(a, b);
+        });
+      if (!is_same) {
+        old_items = std::move(line_items);
+        changed_lines.push_back(line);
+      }
+    }
+  }
+
+  /// 按一批变更依次调整按行存储的数据：变更增删的行在所在的块内原地拼接，变更之后的行随之整体移动，不重建整个行数组
+  /// @param edit_line 处理一个变更的首行和末行（末行超出已有数据时为nullptr，与首行相同时指向首行），
+  ///                  裁剪首行并返回末行中需要移到新文本结束位置的内容
+  template<typename T, typename EditLine>
+  static void shiftLines(LineArray<T>& lines, const Vector<TextChange>& changes, EditLine&& edit_line) {
+    // 变更的坐标基于之前的变更已经生效的文本，与逐个拼接后的行号一致
+    for (const TextChange& change : changes) {
+      const size_t start_line = change.range.start.line;
+      if (start_line >= lines.size()) {
+        break;
+      }
+      const size_t end_line = change.range.end.line;
+      Vector<T>* end_items = end_line < lines.size() ? &lines[end_line] : nullptr;
+      Vector<T> tail = edit_line(lines[start_line], end_items, change);
+      // 删除首行之后直到末行的行，新插入的行没有内容
+      const size_t inserted = change.new_end.line - start_line;
+      lines.spliceLines(start_line + 1, end_line - start_line, inserted);
+      Vector<T>& new_end_items = lines[start_line + inserted];
+      new_end_items.insert(new_end_items.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+    }
+  }
+
+  /// 平移一个变更涉及的按列定位的嵌入内容：变更起点及之前的保留在首行（插入时起点处的内容移到新文本之后），
+  /// 变更终点及之后的平移后返回，被删除范围内的丢弃
+  template<typename T>
+  static Vector<T> shiftInlayLine(Vector<T>& head_items, Vector<T>* end_items, const TextChange& change) {
+    const uint32_t start_column = static_cast<uint32_t>(change.range.start.column);
+    const uint32_t end_column = static_cast<uint32_t>(change.range.end.column);
+    const uint32_t new_end_column = static_cast<uint32_t>(change.new_end.column);
+    const bool is_insertion = change.range.start == change.range.end;
+    const size_t kept = std::find_if(head_items.begin(), head_items.end(), [&](const T& item) {
+      return item.column > start_column || (item.column == start_column && is_insertion);
+    }) - head_items.begin();
+    // 起止在同一行时，留在首行的内容不能再被移到结束位置
+    Vector<T> tail_items;
+    if (end_items != nullptr) {
+      for (size_t i = end_items == &head_items ? kept : 0; i < end_items->size(); ++i) {
+        T& item = (*end_items)[i];
+        if (item.column >= end_column) {
+          item.column = item.column - end_column + new_end_column;
+          tail_items.push_back(std::move(item));
+        }
+      }
+    }
+    head_items.resize(kept);
+    return tail_items;
+  }
+
+  /// 平移一个变更涉及的Span：首行保留变更起点之前的部分，末行保留变更终点之后的部分并平移后返回；
+  /// 在Span内部插入文本（不含换行）时Span随之变长
+  static Vector<StyleSpan> shiftSpanLine(Vector<StyleSpan>& head_spans, Vector<StyleSpan>* end_spans, const TextChange& change) {
+    const uint32_t start_column = static_cast<uint32_t>(change.range.start.column);
+    const uint32_t end_column = static_cast<uint32_t>(change.range.end.column);
+    const uint32_t new_end_column = static_cast<uint32_t>(change.new_end.column);
+    if (change.range.start.line == change.new_end.line && change.range.start == change.range.end) {
+      for (StyleSpan& span : head_spans) {
+        if (span.column >= start_column) {
+          span.column += new_end_column - start_column;
+        } else if (span.column + span.length > start_column) {
+          span.length += new_end_column - start_column;
+        }
+      }
+      return {};
+    }
+    Vector<StyleSpan> tail_spans;
+    if (end_spans != nullptr) {
+      for (const StyleSpan& span : *end_spans) {
+        const uint32_t span_end = span.column + span.length;
+        if (span_end <= end_column) {
+          continue;
+        }
+        const uint32_t column = std::max(span.column, end_column);
+        tail_spans.push_back({column - end_column + new_end_column, span_end - column, span.style_id});
+      }
+    }
+    size_t kept = 0;
+    for (const StyleSpan& span : head_spans) {
+      if (span.column >= start_column) {
+        break;
+      }
+      head_spans[kept] = span;
+      head_spans[kept].length = std::min(span.column + span.length, start_column) - span.column;
+      ++kept;
+    }
+    head_spans.resize(kept);
+    return tail_spans;
+  }
+
+  void DiagnosticIndex::setDiagnostics(Vector<Diagnostic>&& diagnostics) {
+    m_diagnostics_ = std::move(diagnostics);
+    for (Diagnostic& diagnostic : m_diagnostics_) {
+      if (diagnostic.range.end < diagnostic.range.start) {
+        std::swap(diagnostic.range.start, diagnostic.range.end);
+      }
+    }
+    std::stable_sort(m_diagnostics_.begin(), m_diagnostics_.end(), [](const Diagnostic& a, const Diagnostic& b) {
+      return a.range.start < b.range.start;
+    });
+    const size_t count = m_diagnostics_.size();
+    const size_t node_count = count == 0 ? 0 : count * 2 - 1;
+    m_min_start_.assign(node_count, 0);
+    m_max_start_.assign(node_count, 0);
+    m_max_end_.assign(node_count, 0);
+    m_shift_.assign(node_count, 0);
+    if (count > 0) {
+      build(0, 0, count);
+    }
+  }
+
+  size_t DiagnosticIndex::size() const {
+    return m_diagnostics_.size();
+  }
+
+  void DiagnosticIndex::query(size_t first_line, size_t last_line, Vector<Diagnostic>& result) {
+    result.clear();
+    if (m_diagnostics_.empty()) {
+      return;
+    }
+    Vector<size_t> indices;
+    collect(0, 0, m_diagnostics_.size(), first_line, last_line, indices);
+    result.reserve(indices.size());
+    for (size_t index : indices) {
+      result.push_back(m_diagnostics_[index]);
+    }
+  }
+
+  void DiagnosticIndex::onTextChanged(const TextChange& change) {
+    const size_t count = m_diagnostics_.size();
+    if (count == 0) {
+      return;
+    }
+    const TextPosition& start = change.range.start;
+    const TextPosition& end = change.range.end;
+    const TextPosition& new_end = change.new_end;
+    const bool is_insertion = start == end;
+    // 在诊断末尾插入的文本不属于该诊断，被删除范围内的端点收缩到变更起点
+    auto map_position = [&](const TextPosition& pos, bool is_range_end) -> TextPosition {
+      if (pos < start || (is_insertion && is_range_end && pos == start)) {
+        return pos;
+      }
+      if (pos < end) {
+        return start;
+      }
+      if (pos.line == end.line) {
+        return {new_end.line, pos.column - end.column + new_end.column};
+      }
+      return {pos.line - end.line + new_end.line, pos.column};
+    };
+    // 先按变更前的行号找出与变更行相交的诊断，再整体平移变更之后开始的诊断，最后逐个调整相交的诊断
+    Vector<size_t> touched;
+    collect(0, 0, count, start.line, end.line, touched);
+    const int64_t line_shift = static_cast<int64_t>(new_end.line) - static_cast<int64_t>(end.line);
+    if (line_shift != 0) {
+      shiftAfter(0, 0, count, end.line, line_shift);
+    }
+    for (size_t index : touched) {
+      const TextRange& old_range = m_diagnostics_[index].range;
+      TextRange range = {map_position(old_range.start, false), map_position(old_range.end, true)};
+      if (range.end < range.start) {
+        range.end = range.start;
+      }
+      if (!(range == old_range)) {
+        updateLeaf(0, 0, count, index, range);
+      }
+    }
+  }
+
+  void DiagnosticIndex::build(size_t node, size_t lo, size_t hi) {
+    if (hi - lo > 1) {
+      const size_t mid = (lo + hi) / 2;
+      build(node + 1, lo, mid);
+      build(node + 2 * (mid - lo), mid, hi);
+    }
+    pull(node, lo, hi);
+  }
+
+  void DiagnosticIndex::pull(size_t node, size_t lo, size_t hi) {
+    if (hi - lo == 1) {
+      const TextRange& range = m_diagnostics_[lo].range;
+      m_min_start_[node] = range.start.line;
+      m_max_start_[node] = range.start.line;
+      m_max_end_[node] = range.end.line;
+      return;
+    }
+    const size_t mid = (lo + hi) / 2;
+    const size_t left = node + 1;
+    const size_t right = node + 2 * (mid - lo);
+    m_min_start_[node] = std::min(m_min_start_[left], m_min_start_[right]);
+    m_max_start_[node] = std::max(m_max_start_[left], m_max_start_[right]);
+    m_max_end_[node] = std::max(m_max_end_[left], m_max_end_[right]);
+  }
+
+  void DiagnosticIndex::applyShift(size_t node, size_t lo, size_t hi, int64_t shift) {
+    auto shift_line = [shift](size_t line) {
+      return static_cast<size_t>(static_cast<int64_t>(line) + shift);
+    };
+    m_min_start_[node] = shift_line(m_min_start_[node]);
+    m_max_start_[node] = shift_line(m_max_start_[node]);
+    m_max_end_[node] = shift_line(m_max_end_[node]);
+    if (hi - lo == 1) {
+      TextRange& range = m_diagnostics_[lo].range;
+      range.start.line = shift_line(range.start.line);
+      range.end.line = shift_line(range.end.line);
+    } else {
+      m_shift_[node] += shift;
+    }
+  }
+
+  void DiagnosticIndex::pushDown(size_t node, size_t lo, size_t hi) {
+    if (m_shift_[node] == 0 || hi - lo == 1) {
+      return;
+    }
+    const size_t mid = (lo + hi) / 2;
+    applyShift(node + 1, lo, mid, m_shift_[node]);
+    applyShift(node + 2 * (mid - lo), mid, hi, m_shift_[node]);
+    m_shift_[node] = 0;
+  }
+
+  void DiagnosticIndex::collect(size_t node, size_t lo, size_t hi, size_t first_line, size_t last_line, Vector<size_t>& indices) {
+    // 起始行都在范围之后，或结束行都在范围之前的区间直接跳过
+    if (m_min_start_[node] > last_line || m_max_end_[node] < first_line) {
+      return;
+    }
+    if (hi - lo == 1) {
+      indices.push_back(lo);
+      return;
+    }
+    pushDown(node, lo, hi);
+    const size_t mid = (lo + hi) / 2;
+    collect(node + 1, lo, mid, first_line, last_line, indices);
+    collect(node + 2 * (mid - lo), mid, hi, first_line, last_line, indices);
+  }
+
+  void DiagnosticIndex::shiftAfter(size_t node, size_t lo, size_t hi, size_t line, int64_t shift) {
+    if (m_max_start_[node] <= line) {
+      return;
+    }
+    // 起始行都在line之后的区间只记录平移量，不再下传
+    if (m_min_start_[node] > line) {
+      applyShift(node, lo, hi, shift);
+      return;
+    }
+    pushDown(node, lo, hi);
+    const size_t mid = (lo + hi) / 2;
+    shiftAfter(node + 1, lo, mid, line, shift);
+    shiftAfter(node + 2 * (mid - lo), mid, hi, line, shift);
+    pull(node, lo, hi);
+  }
+
+  void DiagnosticIndex::updateLeaf(size_t node, size_t lo, size_t hi, size_t index, const TextRange& range) {
+    if (hi - lo == 1) {
+      m_diagnostics_[lo].range = range;
+    } else {
+      pushDown(node, lo, hi);
+      const size_t mid = (lo + hi) / 2;
+      if (index < mid) {
+        updateLeaf(node + 1, lo, mid, index, range);
+      } else {
+        updateLeaf(node + 2 * (mid - lo), mid, hi, index, range);
+      }
+    }
+    pull(node, lo, hi);
+  }
+
+  StyleSnapshot::StyleSnapshot(Vector<ResolvedStyle>&& styles, uint64_t layout_version)
+    : m_styles_(std::move(styles)), m_layout_version_(layout_version) {
+  }
+
+  const ResolvedStyle& StyleSnapshot::get(uint32_t style_id) const {
+    static const ResolvedStyle kDefaultStyle;
+    return style_id < m_styles_.size() ? m_styles_[style_id] : kDefaultStyle;
+  }
+
+  size_t StyleSnapshot::size() const {
+    return m_styles_.size();
+  }
+
+  uint64_t StyleSnapshot::getLayoutVersion() const {
+    return m_layout_version_;
+  }
+
+  void StyleRegistry::registerStyle(Style&& style) {
+    const uint32_t style_id = style.style_id;
+    if (style_id >= kMaxStyleCount) {
+      return;
+    }
+    if (style_id >= m_styles_.size()) {
+      m_styles_.resize(style_id + 1);
+    }
+    m_styles_[style_id] = std::move(style);
+    m_snapshot_ = nullptr;
+  }
+
+  void StyleRegistry::setStyles(Vector<Style>&& styles) {
+    m_styles_.clear();
+    for (Style& style : styles) {
+      registerStyle(std::move(style));
+    }
+    m_snapshot_ = nullptr;
+  }
+
+  const Style& StyleRegistry::getStyle(uint32_t style_id) const {
+    static const Style kDefaultStyle;
+    return style_id < m_styles_.size() ? m_styles_[style_id] : kDefaultStyle;
+  }
+
+  Ptr<const StyleSnapshot> StyleRegistry::getSnapshot() {
+    if (m_snapshot_ != nullptr) {
+      return m_snapshot_;
+    }
+    Vector<ResolvedStyle> resolved(m_styles_.size());
+    Vector<uint8_t> width_cache_ids(m_styles_.size());
+    for (size_t i = 0; i < m_styles_.size(); ++i) {
+      const Style& style = m_styles_[i];
+      const uint8_t width_cache_id = (style.is_bold ? 1 : 0) | (style.is_italic ? 2 : 0);
+      resolved[i] = {style.color, style.is_bold, style.is_italic, width_cache_id};
+      width_cache_ids[i] = width_cache_id;
+    }
+    // 只有字体变体变化时文本宽度才会变化，需要重新布局
+    width_cache_ids.resize(std::max(width_cache_ids.size(), m_width_cache_ids_.size()), 0);
+    m_width_cache_ids_.resize(width_cache_ids.size(), 0);
+    if (width_cache_ids != m_width_cache_ids_) {
+      ++m_layout_version_;
+      m_width_cache_ids_ = std::move(width_cache_ids);
+    }
+    m_snapshot_ = makePtr<const StyleSnapshot>(std::move(resolved), m_layout_version_);
+    return m_snapshot_;
+  }
+
   DecorationManager::DecorationManager() {
     m_style_reg_ = makePtr<StyleRegistry>();
   }
@@ -11,4 +381,259 @@ namespace NS_SWEETEDITOR {
   Ptr<StyleRegistry> DecorationManager::getStyleRegistry() {
     return m_style_reg_;
   }
+
+  void DecorationManager::setLineSpans(size_t line, Vector<StyleSpan>&& spans) {
+    if (line >= m_spans_.size()) {
+      if (spans.empty()) {
+        return;
+      }
+      m_spans_.resize(line + 1);
+    }
+    std::sort(spans.begin(), spans.end(), [](const StyleSpan& a, const StyleSpan& b) {
+      return a.column < b.column;
+    });
+    m_spans_[line] = std::move(spans);
+  }
+
+  bool DecorationManager::replaceLineSpans(size_t line, Vector<StyleSpan>&& spans) {
+    const Vector<StyleSpan>& old_spans = getLineSpans(line);
+    const bool is_same = spans.size() == old_spans.size() && std::equal(spans.begin(), spans.end(), old_spans.begin(),
+      [](const StyleSpan& a, const StyleSpan& b) {
+        return a.column == b.column && a.length == b.length && a.style_id == b.style_id;
+      });
+    if (is_same) {
+      return false;
+    }
+    if (line >= m_spans_.size()) {
+      m_spans_.resize(line + 1);
+    }
+    m_spans_[line] = std::move(spans);
+    return true;
+  }
+
+  const Vector<StyleSpan>& DecorationManager::getLineSpans(size_t line) const {
+    static const Vector<StyleSpan> kEmptySpans;
+    return line < m_spans_.size() ? m_spans_[line] : kEmptySpans;
+  }
+
+  std::pair<size_t, size_t> DecorationManager::findLineSpans(size_t line, size_t start_column, size_t end_column) const {
+    const Vector<StyleSpan>& spans = getLineSpans(line);
+    // Span互不重叠且按起始列有序，因此结束列同样有序
+    auto first = std::upper_bound(spans.begin(), spans.end(), start_column, [](size_t column, const StyleSpan& span) {
+      return column < static_cast<size_t>(span.column) + span.length;
+    });
+    auto last = std::lower_bound(first, spans.end(), end_column, [](const StyleSpan& span, size_t column) {
+      return span.column < column;
+    });
+    return {first - spans.begin(), last - spans.begin()};
+  }
+
+  void DecorationManager::setPackedSpans(size_t start_line, const uint32_t* packed, size_t count, size_t line_count,
+                                         Vector<size_t>& changed_lines) {
+    m_packed_start_line_ = start_line;
+    m_packed_spans_.resize(packed == nullptr ? 0 : count * kPackedSpanFields);
+    if (!m_packed_spans_.empty()) {
+      std::memcpy(m_packed_spans_.data(), packed, m_packed_spans_.size() * sizeof(uint32_t));
+    }
+    const size_t token_line = m_packed_spans_.empty() ? start_line : start_line + m_packed_spans_[0];
+    decodePackedSpans(start_line, 0, token_line, line_count, changed_lines);
+  }
+
+  bool DecorationManager::applyPackedSpanEdits(const uint32_t* edits, size_t length, size_t line_count,
+                                               Vector<size_t>& changed_lines) {
+    if (edits == nullptr || length == 0) {
+      return true;
+    }
+    // 先校验并拼接出编辑后的数据，格式无效时不修改任何状态
+    const size_t old_size = m_packed_spans_.size();
+    Vector<uint32_t> result;
+    result.reserve(old_size);
+    size_t copied = 0;
+    size_t pos = 0;
+    while (pos < length) {
+      if (length - pos < 3) {
+        return false;
+      }
+      const size_t start = edits[pos];
+      const size_t delete_count = edits[pos + 1];
+      const size_t data_count = edits[pos + 2];
+      pos += 3;
+      if (start < copied || delete_count > old_size - std::min(start, old_size) || start > old_size || data_count > length - pos) {
+        return false;
+      }
+      result.insert(result.end(), m_packed_spans_.begin() + copied, m_packed_spans_.begin() + start);
+      result.insert(result.end(), edits + pos, edits + pos + data_count);
+      copied = start + delete_count;
+      pos += data_count;
+    }
+    result.insert(result.end(), m_packed_spans_.begin() + copied, m_packed_spans_.end());
+    if (result.size() % kPackedSpanFields != 0) {
+      return false;
+    }
+    const size_t first_edit = edits[0] / kPackedSpanFields;
+    m_packed_spans_ = std::move(result);
+
+    // 第一个编辑之前的数据不变，从它所在行的第一个Span开始重新解码；
+    // 被删除的Span可能位于前一个未变化的行与该行之间，这些行从前一行的下一行开始清除
+    const size_t token_count = m_packed_spans_.size() / kPackedSpanFields;
+    if (token_count == 0) {
+      decodePackedSpans(m_packed_start_line_, 0, m_packed_start_line_, line_count, changed_lines);
+      return true;
+    }
+    const size_t last_token = std::min(first_edit, token_count - 1);
+    size_t line_first_token = 0;
+    size_t token_line = m_packed_start_line_;
+    size_t clear_line = m_packed_start_line_;
+    for (size_t i = 0; i <= last_token; ++i) {
+      const uint32_t delta_line = m_packed_spans_[i * kPackedSpanFields];
+      if (i == 0 || delta_line != 0) {
+        if (i > 0) {
+          clear_line = token_line + 1;
+        }
+        token_line += delta_line;
+        line_first_token = i;
+      }
+    }
+    decodePackedSpans(clear_line, line_first_token, token_line, line_count, changed_lines);
+    return true;
+  }
+
+  void DecorationManager::replaceInlayHints(size_t start_line, Vector<Vector<InlayHint>>&& hints, Vector<size_t>& changed_lines) {
+    replaceLineInlays(m_inlay_hints_, start_line, std::move(hints), changed_lines);
+  }
+
+  const Vector<InlayHint>& DecorationManager::getLineInlayHints(size_t line) const {
+    static const Vector<InlayHint> kEmptyHints;
+    return line < m_inlay_hints_.size() ? m_inlay_hints_[line] : kEmptyHints;
+  }
+
+  void DecorationManager::replacePhantomTexts(size_t start_line, Vector<Vector<PhantomText>>&& texts, Vector<size_t>& changed_lines) {
+    replaceLineInlays(m_phantom_texts_, start_line, std::move(texts), changed_lines);
+  }
+
+  const Vector<PhantomText>& DecorationManager::getLinePhantomTexts(size_t line) const {
+    static const Vector<PhantomText> kEmptyTexts;
+    return line < m_phantom_texts_.size() ? m_phantom_texts_[line] : kEmptyTexts;
+  }
+
+  void DecorationManager::clearInlays() {
+    m_inlay_hints_.clear();
+    m_phantom_texts_.clear();
+  }
+
+  void DecorationManager::clearSpans() {
+    m_spans_.clear();
+    m_packed_spans_.clear();
+    m_packed_start_line_ = 0;
+  }
+
+  void DecorationManager::setDiagnostics(Vector<Diagnostic>&& diagnostics) {
+    m_diagnostics_.setDiagnostics(std::move(diagnostics));
+  }
+
+  void DecorationManager::queryDiagnostics(size_t first_line, size_t last_line, Vector<Diagnostic>& result) {
+    m_diagnostics_.query(first_line, last_line, result);
+  }
+
+  size_t DecorationManager::getDiagnosticCount() const {
+    return m_diagnostics_.size();
+  }
+
+  void DecorationManager::onTextChanged(const TextChange& change) {
+    onTextChangedBatch({change});
+  }
+
+  void DecorationManager::onTextChangedBatch(const Vector<TextChange>& changes) {
+    for (const TextChange& change : changes) {
+      m_diagnostics_.onTextChanged(change);
+    }
+    shiftLines(m_inlay_hints_, changes, shiftInlayLine<InlayHint>);
+    shiftLines(m_phantom_texts_, changes, shiftInlayLine<PhantomText>);
+    shiftLines(m_spans_, changes, shiftSpanLine);
+  }
+
+  void DecorationManager::decodePackedSpans(size_t clear_line, size_t first_token, size_t token_line, size_t line_count,
+                                            Vector<size_t>& changed_lines) {
+    const uint32_t* data = m_packed_spans_.data();
+    const size_t token_count = m_packed_spans_.size() / kPackedSpanFields;
+    auto clear_line_spans = [&](size_t line) {
+      if (line < m_spans_.size() && !m_spans_[line].empty()) {
+        m_spans_[line].clear();
+        changed_lines.push_back(line);
+      }
+    };
+    // 先累加行差得到最后一行，一次性分配行数组
+    size_t token = first_token;
+    size_t last_line = token_line;
+    for (size_t i = first_token + 1; i < token_count && last_line < line_count; ++i) {
+      last_line += data[i * kPackedSpanFields];
+    }
+    if (token < token_count && line_count > 0) {
+      m_spans_.resize(std::max(m_spans_.size(), std::min(last_line, line_count - 1) + 1));
+    }
+    size_t next_line = clear_line;
+    while (token < token_count) {
+      if (token != first_token) {
+        token_line += data[token * kPackedSpanFields];
+      }
+      if (token_line >= line_count) {
+        break;
+      }
+      for (; next_line < token_line; ++next_line) {
+        clear_line_spans(next_line);
+      }
+      // 逐个覆写该行原有的Span，只在内容不同时标记变化，不产生临时数组
+      Vector<StyleSpan>& spans = m_spans_[token_line];
+      size_t line_end_token = token + 1;
+      while (line_end_token < token_count && data[line_end_token * kPackedSpanFields] == 0) {
+        ++line_end_token;
+      }
+      spans.reserve(line_end_token - token);
+      bool is_changed = false;
+      size_t written = 0;
+      uint32_t column = 0;
+      uint32_t prev_end = 0;
+      do {
+        // 每行第一个Span的列差即绝对列，列差为相对同一行上一个Span起始列的偏移
+        const uint32_t* fields = data + token * kPackedSpanFields;
+        column += fields[1];
+        // 与前一个Span重叠的部分被裁掉，保证Span互不重叠
+        const uint32_t span_start = std::max(column, prev_end);
+        const uint32_t span_end = column + fields[2];
+        if (span_end > span_start) {
+          const StyleSpan span {span_start, span_end - span_start, fields[3]};
+          if (written < spans.size()) {
+            StyleSpan& old_span = spans[written];
+            if (old_span.column != span.column || old_span.length != span.length || old_span.style_id != span.style_id) {
+              old_span = span;
+              is_changed = true;
+            }
+          } else {
+            spans.push_back(span);
+            is_changed = true;
+          }
+          ++written;
+          prev_end = span_end;
+        }
+        ++token;
+      } while (token < line_end_token);
+      if (written != spans.size()) {
+        spans.resize(written);
+        is_changed = true;
+      }
+      if (is_changed) {
+        changed_lines.push_back(token_line);
+      }
+      next_line = token_line + 1;
+    }
+    // 最后一个Span之后的行不再有Span
+    for (; next_line < m_spans_.size(); ++next_line) {
+      clear_line_spans(next_line);
+    }
+    size_t line_end = m_spans_.size();
+    while (line_end > 0 && m_spans_[line_end - 1].empty()) {
+      --line_end;
+    }
+    m_spans_.resize(line_end);
+  }
 }
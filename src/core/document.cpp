@@ -8,6 +8,16 @@
 #include "utility.h"
 
 namespace NS_SWEETEDITOR {
+  /// 片段数少于该值时不压缩编辑片段
+  static constexpr size_t kMinCompactSegments = 4096;
+
+  // ============================================== DocumentListener ===============================================
+  void DocumentListener::onTextChangedBatch(const Vector<TextChange>& changes) {
+    for (const TextChange& change : changes) {
+      onTextChanged(change);
+    }
+  }
+
   // ================================================== Document ===================================================
   Document::Document(U8String&& original_string): m_original_buffer_(makeUPtr<U8StringBuffer>(std::move(original_string))) {
     rebuildBufferSegments();
@@ -52,13 +62,42 @@ namespace NS_SWEETEDITOR {
     if (!m_logical_lines_[line].is_char_dirty) {
       return m_logical_lines_[line].cached_text;
     }
-    const size_t byte_length = getByteLengthOfLine(line);
-    U8String utf8_text = getU8Text(m_logical_lines_[line].start_byte, byte_length);
+    U8String utf8_text = getLineU8Content(line);
     U16String result;
     StrUtil::convertUTF8ToUTF16(utf8_text, result);
     return result;
   }
 
+  U16StringView Document::getLineU16View(size_t line) {
+    if (line >= m_logical_lines_.size()) {
+      throw std::out_of_range("Document::getLineU16View line index out of range");
+    }
+    updateDirtyLine(line, m_logical_lines_[line]);
+    return m_logical_lines_[line].cached_text;
+  }
+
+  size_t Document::getLineByteLength(size_t line) const {
+    const size_t byte_length = getByteLengthOfLine(line);
+    const size_t start_byte = m_logical_lines_[line].start_byte;
+    // 只读取行尾的两个字节判断换行符，不拷贝整行
+    const size_t tail_length = std::min<size_t>(2, byte_length);
+    U8String tail = getU8Text(start_byte + byte_length - tail_length, tail_length);
+    size_t length = byte_length;
+    while (!tail.empty() && (tail.back() == '\n' || tail.back() == '\r')) {
+      tail.pop_back();
+      --length;
+    }
+    return length;
+  }
+
+  U8String Document::getLineU8Text(size_t line, size_t byte_offset, size_t byte_length) const {
+    const size_t line_length = getLineByteLength(line);
+    if (byte_offset >= line_length) {
+      return "";
+    }
+    return getU8Text(m_logical_lines_[line].start_byte + byte_offset, std::min(byte_length, line_length - byte_offset));
+  }
+
   uint32_t Document::getLineColumns(size_t line) {
     if (line >= m_logical_lines_.size()) {
       throw std::out_of_range("Document::getLineColumns line index out of range");
@@ -100,14 +139,27 @@ namespace NS_SWEETEDITOR {
     if (text.empty()) {
       return;
     }
-    const size_t byte_offset = getByteOffsetFromPosition(position);
+    TextChange change;
+    change.range.start = {position.line, std::min<size_t>(position.column, getLineColumns(position.line))};
+    change.range.end = change.range.start;
+    const size_t byte_offset = getByteOffsetFromPosition(change.range.start);
     insertU8Text(byte_offset, text);
+    change.new_end = computeInsertEnd(change.range.start, text);
+    dispatchTextChanged(change);
   }
 
   void Document::deleteU8Text(const TextRange& range) {
-    size_t start_byte = getByteOffsetFromPosition(range.start);
-    size_t byte_length = getByteOffsetFromPosition(range.end) - start_byte;
+    TextChange change;
+    change.range.start = {range.start.line, std::min<size_t>(range.start.column, getLineColumns(range.start.line))};
+    change.range.end = {range.end.line, std::min<size_t>(range.end.column, getLineColumns(range.end.line))};
+    change.new_end = change.range.start;
+    size_t start_byte = getByteOffsetFromPosition(change.range.start);
+    size_t byte_length = getByteOffsetFromPosition(change.range.end) - start_byte;
+    if (byte_length == 0) {
+      return;
+    }
     deleteU8Text(start_byte, byte_length);
+    dispatchTextChanged(change);
   }
 
   void Document::replaceU8Text(const TextRange& range, const U8String& text) {
@@ -115,23 +167,380 @@ namespace NS_SWEETEDITOR {
     insertU8Text(range.start, text);
   }
 
+  TextPosition Document::clampPosition(const TextPosition& position) const {
+    if (m_logical_lines_.empty()) {
+      return {};
+    }
+    Vector<TextPosition> positions = {position};
+    if (position.line >= m_logical_lines_.size()) {
+      positions[0] = {m_logical_lines_.size() - 1, SIZE_MAX};
+    }
+    Vector<size_t> byte_offsets;
+    Vector<size_t> char_offsets;
+    resolveOffsets(positions, byte_offsets, char_offsets);
+    return positions[0];
+  }
+
+  void Document::streamU8Text(const TextRange& range, const std::function<void(const char*, size_t)>& consumer,
+                              size_t max_chunk_bytes) const {
+    const size_t line_count = m_logical_lines_.size();
+    if (line_count == 0) {
+      return;
+    }
+    Vector<TextPosition> positions = {range.start, range.end};
+    for (TextPosition& position : positions) {
+      if (position.line >= line_count) {
+        position = {line_count - 1, SIZE_MAX};
+      }
+    }
+    if (positions[1] < positions[0]) {
+      std::swap(positions[0], positions[1]);
+    }
+    Vector<size_t> byte_offsets;
+    Vector<size_t> char_offsets;
+    resolveOffsets(positions, byte_offsets, char_offsets);
+    max_chunk_bytes = std::max<size_t>(max_chunk_bytes, 4);
+    const size_t end_byte = byte_offsets[1];
+    // 按片段直接输出buffer中的数据，片段边界总在字符边界上，只有片段内部分块时需要对齐
+    for (size_t byte = byte_offsets[0]; byte < end_byte;) {
+      const size_t segment_index = findSegment(byte);
+      const size_t segment_start = segment_index == 0 ? 0 : m_segment_ends_[segment_index - 1];
+      const char* data = getSegmentData(m_buffer_segments_[segment_index]) + (byte - segment_start);
+      size_t length = std::min(m_segment_ends_[segment_index], end_byte) - byte;
+      if (length > max_chunk_bytes) {
+        length = max_chunk_bytes;
+        while (length > 0 && (static_cast<unsigned char>(data[length]) & 0xC0) == 0x80) {
+          --length;
+        }
+        if (length == 0) {
+          length = max_chunk_bytes;
+        }
+      }
+      consumer(data, length);
+      byte += length;
+    }
+  }
+
+  Vector<TextChange> Document::applyEdits(Vector<TextEdit>&& edits) {
+    Vector<TextChange> changes;
+    if (edits.empty()) {
+      return changes;
+    }
+    // 行号限制在文档内后按起点排序，列在求偏移时限制到行尾
+    const size_t line_count = m_logical_lines_.size();
+    auto clamp_line = [&](TextPosition& position) {
+      if (position.line >= line_count) {
+        position = {line_count - 1, SIZE_MAX};
+      }
+    };
+    for (TextEdit& edit : edits) {
+      clamp_line(edit.range.start);
+      clamp_line(edit.range.end);
+      if (edit.range.end < edit.range.start) {
+        std::swap(edit.range.start, edit.range.end);
+      }
+    }
+    std::stable_sort(edits.begin(), edits.end(), [](const TextEdit& a, const TextEdit& b) {
+      return a.range.start < b.range.start;
+    });
+
+    // 所有端点按顺序排列，一次扫描求出字节偏移和字符偏移
+    Vector<TextPosition> positions;
+    positions.reserve(edits.size() * 2);
+    for (const TextEdit& edit : edits) {
+      positions.push_back(edit.range.start);
+      positions.push_back(edit.range.end);
+    }
+    Vector<size_t> byte_offsets;
+    Vector<size_t> char_offsets;
+    resolveOffsets(positions, byte_offsets, char_offsets);
+    // 裁掉与前一处修改重叠的部分
+    for (size_t i = 1; i < positions.size(); ++i) {
+      if (byte_offsets[i] < byte_offsets[i - 1]) {
+        positions[i] = positions[i - 1];
+        byte_offsets[i] = byte_offsets[i - 1];
+        char_offsets[i] = char_offsets[i - 1];
+      }
+    }
+    for (size_t i = 0; i < edits.size(); ++i) {
+      edits[i].range = {positions[i * 2], positions[i * 2 + 1]};
+    }
+
+    // 一次遍历重建文本片段：保留修改之间的原有片段，跳过被删除的字节，插入新文本的片段
+    Vector<BufferSegment> segments;
+    segments.reserve(m_buffer_segments_.size() + edits.size() * 2);
+    size_t segment_index = 0;
+    size_t segment_start = 0;
+    size_t copied = 0;
+    // 在同一buffer中首尾相接的片段直接合并（例如单光标连续输入）
+    auto push_segment = [&](const BufferSegment& segment) {
+      if (!segments.empty()) {
+        BufferSegment& last = segments.back();
+        if (last.type == segment.type && last.start_byte + last.byte_length == segment.start_byte) {
+          last.byte_length += segment.byte_length;
+          return;
+        }
+      }
+      segments.push_back(segment);
+    };
+    auto copy_until = [&](size_t end_byte) {
+      while (copied < end_byte) {
+        while (segment_start + m_buffer_segments_[segment_index].byte_length <= copied) {
+          segment_start += m_buffer_segments_[segment_index].byte_length;
+          ++segment_index;
+        }
+        const BufferSegment& segment = m_buffer_segments_[segment_index];
+        const size_t piece_start = copied - segment_start;
+        const size_t piece_end = std::min(segment.byte_length, end_byte - segment_start);
+        push_segment({segment.type, segment.start_byte + piece_start, piece_end - piece_start});
+        copied = segment_start + piece_end;
+      }
+    };
+    for (size_t i = 0; i < edits.size(); ++i) {
+      copy_until(byte_offsets[i * 2]);
+      copied = byte_offsets[i * 2 + 1];
+      const U8String& text = edits[i].text;
+      if (!text.empty()) {
+        push_segment({SegmentType::EDITED, m_edit_buffer_->currentEnd(), text.size()});
+        m_edit_buffer_->append(text);
+      }
+    }
+    copy_until(m_total_bytes_);
+
+    // 一次遍历重建逻辑行：修改之间的行只平移偏移量，修改起点所在行标记为dirty，被删除的行移除，插入的换行产生新行
+    size_t inserted_lines = 0;
+    for (const TextEdit& edit : edits) {
+      inserted_lines += static_cast<size_t>(std::count(edit.text.begin(), edit.text.end(), '\n'));
+    }
+    Vector<LogicalLine> lines;
+    lines.reserve(m_logical_lines_.size() + inserted_lines);
+    int64_t byte_shift = 0;
+    int64_t char_shift = 0;
+    size_t next_line = 0;
+    auto move_line = [&](size_t line) {
+      LogicalLine& logical_line = m_logical_lines_[line];
+      logical_line.start_byte = static_cast<size_t>(static_cast<int64_t>(logical_line.start_byte) + byte_shift);
+      logical_line.start_char = static_cast<size_t>(static_cast<int64_t>(logical_line.start_char) + char_shift);
+      lines.push_back(std::move(logical_line));
+    };
+    // 之前的修改已经生效的坐标：与上一处修改的结束位置在同一行时相对它的新结束位置平移，否则只平移行号
+    TextPosition prev_end = {SIZE_MAX, 0};
+    TextPosition prev_new_end;
+    auto map_position = [&](const TextPosition& position) -> TextPosition {
+      if (position.line == prev_end.line) {
+        return {prev_new_end.line, prev_new_end.column + position.column - prev_end.column};
+      }
+      return {static_cast<size_t>(static_cast<int64_t>(position.line) + static_cast<int64_t>(lines.size()) - static_cast<int64_t>(next_line)), position.column};
+    };
+    changes.reserve(edits.size());
+    for (size_t i = 0; i < edits.size(); ++i) {
+      const TextRange& range = edits[i].range;
+      const U8String& text = edits[i].text;
+      TextChange change;
+      change.range = {map_position(range.start), map_position(range.end)};
+      change.new_end = computeInsertEnd(change.range.start, text);
+      changes.push_back(change);
+
+      for (; next_line <= range.start.line; ++next_line) {
+        move_line(next_line);
+      }
+      const size_t start_byte = static_cast<size_t>(static_cast<int64_t>(byte_offsets[i * 2]) + byte_shift);
+      const size_t start_char = static_cast<size_t>(static_cast<int64_t>(char_offsets[i * 2]) + char_shift);
+      if (!text.empty() || byte_offsets[i * 2] != byte_offsets[i * 2 + 1]) {
+        LogicalLine& edited_line = lines.back();
+        edited_line.is_char_dirty = true;
+        ++edited_line.version;
+      }
+      next_line = std::max(next_line, range.end.line + 1);
+      size_t inserted_chars = 0;
+      for (size_t j = 0; j < text.size(); ++j) {
+        if ((text[j] & 0xC0) != 0x80) {
+          ++inserted_chars;
+        }
+        if (text[j] == '\n') {
+          LogicalLine logical_line;
+          logical_line.start_byte = start_byte + j + 1;
+          logical_line.start_char = start_char + inserted_chars;
+          logical_line.is_char_dirty = true;
+          lines.push_back(std::move(logical_line));
+        }
+      }
+      byte_shift += static_cast<int64_t>(text.size()) - static_cast<int64_t>(byte_offsets[i * 2 + 1] - byte_offsets[i * 2]);
+      char_shift += static_cast<int64_t>(inserted_chars) - static_cast<int64_t>(char_offsets[i * 2 + 1] - char_offsets[i * 2]);
+      prev_end = range.end;
+      prev_new_end = change.new_end;
+    }
+    for (; next_line < line_count; ++next_line) {
+      move_line(next_line);
+    }
+    m_buffer_segments_.swap(segments);
+    compactSegments();
+    rebuildSegmentEnds();
+    m_logical_lines_.swap(lines);
+    m_total_bytes_ = static_cast<size_t>(static_cast<int64_t>(m_total_bytes_) + byte_shift);
+    ++m_version_;
+    // 没有实际修改的变更不通知，其余的一次性通知
+    Vector<TextChange> effective_changes;
+    effective_changes.reserve(changes.size());
+    for (const TextChange& change : changes) {
+      if (!(change.range.start == change.range.end && change.range.start == change.new_end)) {
+        effective_changes.push_back(change);
+      }
+    }
+    if (!effective_changes.empty()) {
+      dispatchTextChangedBatch(effective_changes);
+    }
+    return changes;
+  }
+
   void Document::rebuildBufferSegments() {
     m_edit_buffer_ = makeUPtr<U8StringBuffer>();
     m_buffer_segments_.clear();
     m_buffer_segments_.push_back({SegmentType::ORIGINAL, 0, m_original_buffer_->size()});
     m_total_bytes_ = m_original_buffer_->size();
+    m_compacted_segment_count_ = 0;
+    rebuildSegmentEnds();
     rebuildLogicalLines();
   }
 
+  void Document::compactSegments() {
+    // 多光标输入时编辑片段和原文片段交替出现，每次输入都会增加片段；片段数翻倍时把相邻的编辑片段复制为连续的一段
+    if (m_buffer_segments_.size() < std::max(kMinCompactSegments, m_compacted_segment_count_ * 2)) {
+      return;
+    }
+    U8String edit_text;
+    Vector<BufferSegment> segments;
+    segments.reserve(m_buffer_segments_.size());
+    for (const BufferSegment& segment : m_buffer_segments_) {
+      if (segment.type == SegmentType::ORIGINAL) {
+        segments.push_back(segment);
+        continue;
+      }
+      if (!segments.empty() && segments.back().type == SegmentType::EDITED) {
+        segments.back().byte_length += segment.byte_length;
+      } else {
+        segments.push_back({SegmentType::EDITED, edit_text.size(), segment.byte_length});
+      }
+      edit_text.append(m_edit_buffer_->data() + segment.start_byte, segment.byte_length);
+    }
+    m_edit_buffer_ = makeUPtr<U8StringBuffer>(std::move(edit_text));
+    m_buffer_segments_.swap(segments);
+    m_compacted_segment_count_ = m_buffer_segments_.size();
+  }
+
+  void Document::rebuildSegmentEnds() {
+    m_segment_ends_.resize(m_buffer_segments_.size());
+    size_t end = 0;
+    for (size_t i = 0; i < m_buffer_segments_.size(); ++i) {
+      end += m_buffer_segments_[i].byte_length;
+      m_segment_ends_[i] = end;
+    }
+  }
+
+  void Document::updateSegmentEnds(size_t first_segment, size_t touched_end, size_t old_count, int64_t byte_delta) {
+    // [first_segment, touched_end)范围内的片段被修改，重新累加结束偏移；之后的片段没有变化，只按字节差平移
+    const size_t new_count = m_buffer_segments_.size();
+    const size_t old_touched_end = old_count - (new_count - touched_end);
+    if (old_touched_end > touched_end) {
+      m_segment_ends_.erase(m_segment_ends_.begin() + touched_end, m_segment_ends_.begin() + old_touched_end);
+    } else {
+      m_segment_ends_.insert(m_segment_ends_.begin() + old_touched_end, touched_end - old_touched_end, 0);
+    }
+    size_t end = first_segment == 0 ? 0 : m_segment_ends_[first_segment - 1];
+    for (size_t i = first_segment; i < touched_end; ++i) {
+      end += m_buffer_segments_[i].byte_length;
+      m_segment_ends_[i] = end;
+    }
+    for (size_t i = touched_end; i < new_count; ++i) {
+      m_segment_ends_[i] = static_cast<size_t>(static_cast<int64_t>(m_segment_ends_[i]) + byte_delta);
+    }
+  }
+
+  size_t Document::findSegment(size_t byte_offset) const {
+    return std::upper_bound(m_segment_ends_.begin(), m_segment_ends_.end(), byte_offset) - m_segment_ends_.begin();
+  }
+
+  void Document::resolveOffsets(Vector<TextPosition>& positions, Vector<size_t>& byte_offsets, Vector<size_t>& char_offsets) const {
+    byte_offsets.resize(positions.size());
+    char_offsets.resize(positions.size());
+    size_t line = SIZE_MAX;
+    size_t line_end = 0;
+    size_t byte = 0;
+    size_t chars = 0;
+    size_t column = 0;
+    size_t segment_index = m_buffer_segments_.size();
+    size_t segment_start = 0;
+    size_t segment_end = 0;
+    auto byte_at = [&](size_t offset) -> unsigned char {
+      if (offset < segment_start || offset >= segment_end) {
+        segment_index = findSegment(offset);
+        segment_start = segment_index == 0 ? 0 : m_segment_ends_[segment_index - 1];
+        segment_end = m_segment_ends_[segment_index];
+      }
+      return static_cast<unsigned char>(getSegmentData(m_buffer_segments_[segment_index])[offset - segment_start]);
+    };
+    for (size_t i = 0; i < positions.size(); ++i) {
+      TextPosition& position = positions[i];
+      // 同一行的位置从上一个位置继续扫描，否则从行首开始，列超出行尾时限制到行尾（不含换行符）
+      if (position.line != line || position.column < column) {
+        line = position.line;
+        byte = m_logical_lines_[line].start_byte;
+        chars = m_logical_lines_[line].start_char;
+        column = 0;
+        line_end = line + 1 < m_logical_lines_.size() ? m_logical_lines_[line + 1].start_byte : m_total_bytes_;
+        while (line_end > byte && (byte_at(line_end - 1) == '\n' || byte_at(line_end - 1) == '\r')) {
+          --line_end;
+        }
+      }
+      while (column < position.column && byte < line_end) {
+        const unsigned char c = byte_at(byte);
+        if (c < 0x80) {
+          byte += 1;
+          column += 1;
+        } else if ((c & 0xE0) == 0xC0) {
+          byte += 2;
+          column += 1;
+        } else if ((c & 0xF0) == 0xE0) {
+          byte += 3;
+          column += 1;
+        } else if ((c & 0xF8) == 0xF0) {
+          byte += 4;
+          column += 2;
+        } else {
+          byte += 1;
+          column += 1;
+        }
+        ++chars;
+      }
+      position.column = column;
+      byte_offsets[i] = byte;
+      char_offsets[i] = chars;
+    }
+  }
+
+  TextPosition Document::computeInsertEnd(const TextPosition& start, const U8String& text) {
+    const size_t last_break = text.rfind('\n');
+    if (last_break == U8String::npos) {
+      return {start.line, start.column + simdutf::utf16_length_from_utf8(text.data(), text.size())};
+    }
+    return {start.line + std::count(text.begin(), text.end(), '\n'),
+      simdutf::utf16_length_from_utf8(text.data() + last_break + 1, text.size() - last_break - 1)};
+  }
+
   void Document::rebuildLogicalLines() {
     m_logical_lines_.clear();
     m_logical_lines_.push_back({0, 0, {}, true});
     const char* data = m_original_buffer_->data();
     const size_t size = m_original_buffer_->size();
+    size_t chars = 0;
     size_t i = 0;
     for (i = 0; i < size; ++i) {
+      // 顺便统计字符数（非UTF8后续字节），每行的起始字符偏移此后随编辑增量维护
+      if ((data[i] & 0xC0) != 0x80) {
+        ++chars;
+      }
       if (data[i] == '\n') {
-        m_logical_lines_.push_back({i + 1, 0, {}, true});
+        m_logical_lines_.push_back({i + 1, chars, {}, true});
       }
     }
   }
@@ -145,9 +554,12 @@ namespace NS_SWEETEDITOR {
     }
     U8String result;
     result.reserve(byte_length);
-    size_t current_byte = 0;
+    // 二分定位起始片段
+    const size_t first_segment = findSegment(start_byte);
+    size_t current_byte = first_segment == 0 ? 0 : m_segment_ends_[first_segment - 1];
     size_t req_end_byte = start_byte + byte_length;
-    for (const BufferSegment& segment : m_buffer_segments_) {
+    for (size_t i = first_segment; i < m_buffer_segments_.size(); ++i) {
+      const BufferSegment& segment = m_buffer_segments_[i];
       size_t seg_start = current_byte;
       size_t seg_end = current_byte + segment.byte_length;
 
@@ -181,18 +593,19 @@ namespace NS_SWEETEDITOR {
     size_t edit_buffer_start = m_edit_buffer_->currentEnd();
     m_edit_buffer_->append(text);
     BufferSegment new_seg = {SegmentType::EDITED, edit_buffer_start, text.size()};
-    bool is_inserted = false;
-    size_t current_byte = 0;
-    for (auto it = m_buffer_segments_.begin(); it != m_buffer_segments_.end(); ++it) {
-      // 检查插入点是否在当前 Segment 内部（包含头部，不包含尾部，除非是最后一个）
-      if (current_byte + it->byte_length > start_byte) {
-        size_t offset_in_seg = start_byte - current_byte;
-        // 插入点在 Segment 头部 (offset == 0)
-        if (offset_in_seg == 0) {
-          m_buffer_segments_.insert(it, new_seg);
-          is_inserted = true;
-          break;
-        }
+    const size_t old_count = m_buffer_segments_.size();
+    // 插入点所在的 Segment（包含头部，不包含尾部），没有则追加到末尾
+    const size_t first_segment = findSegment(start_byte);
+    size_t touched_end = first_segment + 1;
+    if (first_segment == old_count) {
+      m_buffer_segments_.push_back(new_seg);
+    } else {
+      auto it = m_buffer_segments_.begin() + first_segment;
+      const size_t offset_in_seg = start_byte - (first_segment == 0 ? 0 : m_segment_ends_[first_segment - 1]);
+      if (offset_in_seg == 0) {
+        // 插入点在 Segment 头部
+        m_buffer_segments_.insert(it, new_seg);
+      } else {
         // 插入点在 Segment 中间，进行拆分 (左 + 新 + 右)
         BufferSegment right = *it;
         right.start_byte += offset_in_seg;
@@ -202,15 +615,10 @@ namespace NS_SWEETEDITOR {
         // 插入新 Segment 和 右半部分
         it = m_buffer_segments_.insert(it + 1, new_seg);
         m_buffer_segments_.insert(it + 1, right);
-        is_inserted = true;
-        break;
+        touched_end = first_segment + 3;
       }
-      current_byte += it->byte_length;
-    }
-    // 中间没有插入则追加到末尾
-    if (!is_inserted) {
-      m_buffer_segments_.push_back(new_seg);
     }
+    updateSegmentEnds(first_segment, touched_end, old_count, static_cast<int64_t>(text.size()));
     m_total_bytes_ += text.size();
     updateLogicalLinesByInsertText(start_byte, text);
   }
@@ -222,9 +630,12 @@ namespace NS_SWEETEDITOR {
     if (start_byte + byte_length > m_total_bytes_) {
       byte_length = m_total_bytes_ - start_byte;
     }
+    const size_t char_length = countChars(start_byte, byte_length);
     size_t delete_end = start_byte + byte_length;
-    size_t current_byte = 0;
-    auto it = m_buffer_segments_.begin();
+    const size_t old_count = m_buffer_segments_.size();
+    const size_t first_segment = findSegment(start_byte);
+    size_t current_byte = first_segment == 0 ? 0 : m_segment_ends_[first_segment - 1];
+    auto it = m_buffer_segments_.begin() + first_segment;
     while (it != m_buffer_segments_.end()) {
       size_t seg_len_original = it->byte_length;
       size_t seg_start = current_byte;
@@ -268,8 +679,9 @@ namespace NS_SWEETEDITOR {
         break;
       }
     }
+    updateSegmentEnds(first_segment, it - m_buffer_segments_.begin(), old_count, -static_cast<int64_t>(byte_length));
     m_total_bytes_ -= byte_length;
-    updateLogicalLinesByDeleteText(start_byte, byte_length);
+    updateLogicalLinesByDeleteText(start_byte, byte_length, char_length);
   }
 
   size_t Document::countChars(size_t start_byte, size_t byte_length) const {
@@ -281,35 +693,46 @@ namespace NS_SWEETEDITOR {
     return m_logical_lines_;
   }
 
+  uint64_t Document::getVersion() const {
+    return m_version_;
+  }
+
+  void Document::addListener(const Ptr<DocumentListener>& listener) {
+    m_listeners_.push_back(listener);
+  }
+
+  void Document::removeListener(const Ptr<DocumentListener>& listener) {
+    m_listeners_.erase(std::remove_if(m_listeners_.begin(), m_listeners_.end(), [&listener](const WPtr<DocumentListener>& item) {
+      Ptr<DocumentListener> locked = item.lock();
+      return locked == nullptr || locked == listener;
+    }), m_listeners_.end());
+  }
+
   void Document::updateDirtyLine(size_t line, LogicalLine& logical_line) {
     if (logical_line.is_char_dirty) {
-      const size_t byte_length = getByteLengthOfLine(line);
-      U8String u8_text = getU8Text(logical_line.start_byte, byte_length);
+      U8String u8_text = getLineU8Content(line);
       StrUtil::convertUTF8ToUTF16(u8_text, logical_line.cached_text);
-      if (line > 0) {
-        LogicalLine& prev_line = m_logical_lines_[line - 1];
-        if (prev_line.is_char_dirty) {
-          U8String prev_texts = getU8Text(0, prev_line.start_byte);
-          const size_t prev_chars_count = simdutf::count_utf8(prev_texts.data(), prev_texts.length());
-          prev_line.start_char = prev_chars_count;
-        }
-        const size_t prev_byte_length = getByteLengthOfLine(line - 1);
-        U8String prev_line_text = getU8Text(prev_line.start_byte, prev_byte_length);
-        logical_line.start_char = prev_line.start_char + simdutf::count_utf8(prev_line_text.data(), prev_line_text.length());
-      } else {
-        logical_line.start_char = 0;
-      }
       logical_line.is_char_dirty = false;
     }
   }
 
   void Document::updateLogicalLinesByInsertText(size_t start_byte, const U8String& text) {
     const size_t line = getLineFromByteOffset(start_byte);
+    LogicalLine& edited_line = m_logical_lines_[line];
+    const size_t chars_before = edited_line.start_char + countChars(edited_line.start_byte, start_byte - edited_line.start_byte);
+    // 插入点所在行内容发生变化
+    edited_line.is_char_dirty = true;
+    ++edited_line.version;
     Vector<LogicalLine> new_lines;
+    size_t inserted_chars = 0;
     for (size_t i = 0; i < text.size(); ++i) {
+      if ((text[i] & 0xC0) != 0x80) {
+        ++inserted_chars;
+      }
       if (text[i] == '\n') {
         LogicalLine logical_line;
         logical_line.start_byte = start_byte + i + 1;
+        logical_line.start_char = chars_before + inserted_chars;
         logical_line.is_char_dirty = true;
         new_lines.push_back(logical_line);
       }
@@ -318,17 +741,17 @@ namespace NS_SWEETEDITOR {
       // 插入新行数据
       m_logical_lines_.insert(m_logical_lines_.begin() + line + 1, new_lines.begin(), new_lines.end());
     }
-    // 更新受影响的后续行字节偏移，m_logical_lines[line + 1] 开始的所有项都要 start_byte 都要 + shift_amount
+    // 后续行内容不变，只平移字节和字符偏移
     size_t shift_amount = text.size();
     size_t start_shift_line = line + 1 + new_lines.size();
     for (size_t i = start_shift_line; i < m_logical_lines_.size(); ++i) {
       m_logical_lines_[i].start_byte += shift_amount;
-      m_logical_lines_[i].is_char_dirty = true;
-      m_logical_lines_[i].height = -1;
+      m_logical_lines_[i].start_char += inserted_chars;
     }
+    ++m_version_;
   }
 
-  void Document::updateLogicalLinesByDeleteText(size_t start_byte, size_t byte_length) {
+  void Document::updateLogicalLinesByDeleteText(size_t start_byte, size_t byte_length, size_t char_length) {
     size_t end_byte = start_byte + byte_length;
     // 第一个line.start_byte > start_byte 的行
     size_t low = 0;
@@ -357,11 +780,40 @@ namespace NS_SWEETEDITOR {
     if (line_to_remove < line_to_keep) {
       m_logical_lines_.erase(m_logical_lines_.begin() + line_to_remove, m_logical_lines_.begin() + line_to_keep);
     }
+    // 删除起点所在行内容发生变化
+    LogicalLine& edited_line = m_logical_lines_[line_to_remove - 1];
+    edited_line.is_char_dirty = true;
+    ++edited_line.version;
     // 位移后续行，被删除区间后面的所有行，偏移量都要减去 length
     for (size_t i = line_to_remove; i < m_logical_lines_.size(); ++i) {
       m_logical_lines_[i].start_byte -= byte_length;
-      m_logical_lines_[i].is_char_dirty = true;
-      m_logical_lines_[i].height = -1;
+      m_logical_lines_[i].start_char -= char_length;
+    }
+    ++m_version_;
+  }
+
+  void Document::dispatchTextChanged(const TextChange& change) {
+    forEachListener([&change](DocumentListener& listener) { listener.onTextChanged(change); });
+  }
+
+  void Document::dispatchTextChangedBatch(const Vector<TextChange>& changes) {
+    forEachListener([&changes](DocumentListener& listener) { listener.onTextChangedBatch(changes); });
+  }
+
+  void Document::forEachListener(const std::function<void(DocumentListener&)>& callback) {
+    bool has_expired = false;
+    for (const WPtr<DocumentListener>& item : m_listeners_) {
+      Ptr<DocumentListener> listener = item.lock();
+      if (listener == nullptr) {
+        has_expired = true;
+        continue;
+      }
+      callback(*listener);
+    }
+    if (has_expired) {
+      m_listeners_.erase(std::remove_if(m_listeners_.begin(), m_listeners_.end(), [](const WPtr<DocumentListener>& item) {
+        return item.expired();
+      }), m_listeners_.end());
     }
   }
 
@@ -373,11 +825,12 @@ namespace NS_SWEETEDITOR {
     size_t line_end_byte = (position.line + 1 < m_logical_lines_.size())
                      ? m_logical_lines_[position.line + 1].start_byte
                      : m_total_bytes_;
-    size_t current_byte = 0;
+    const size_t first_segment = findSegment(line_start_byte);
+    size_t current_byte = first_segment == 0 ? 0 : m_segment_ends_[first_segment - 1];
     size_t scanned_u16_count = 0;
     size_t result = line_start_byte;
 
-    auto it = m_buffer_segments_.begin();
+    auto it = m_buffer_segments_.begin() + first_segment;
     while (it != m_buffer_segments_.end()) {
         size_t seg_end = current_byte + it->byte_length;
         // segment 在这一行的范围内 (有交集)
@@ -490,6 +943,15 @@ namespace NS_SWEETEDITOR {
     }
   }
 
+  U8String Document::getLineU8Content(size_t line) const {
+    U8String u8_text = getU8Text(m_logical_lines_[line].start_byte, getByteLengthOfLine(line));
+    // 行缓存不包括换行符
+    while (!u8_text.empty() && (u8_text.back() == '\n' || u8_text.back() == '\r')) {
+      u8_text.pop_back();
+    }
+    return u8_text;
+  }
+
   inline const char* Document::getSegmentData(const BufferSegment& segment) const {
     return (segment.type == SegmentType::ORIGINAL)
              ? m_original_buffer_->data() + segment.start_byte
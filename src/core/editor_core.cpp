@@ -1,54 +1,272 @@
 //
 // Created by Scave on 2025/12/1.
 //
+#include <algorithm>
+#include <cmath>
 #include "editor_core.h"
+#include "utility.h"
 #include "logging.h"
 
 namespace NS_SWEETEDITOR {
+  /// 两次滚动间隔超过该时长时视为新的滚动，速度重新估计
+  static constexpr int64_t kScrollVelocityWindowMs = 100;
+  /// 估计速度时假设的帧间隔
+  static constexpr float kFrameIntervalMs = 16;
+  /// 预布局覆盖按当前速度滚动这段时长的距离
+  static constexpr float kPrefetchLookaheadMs = 500;
+
   U8String EditorConfig::dump() const {
-    return "EditorConfig {touch_config = " + touch_config.dump() + "}";
+    return "EditorConfig {touch_config = " + touch_config.dump() + ", prefetch_screens = " + std::to_string(prefetch_screens)
+      + ", async_highlight = " + std::to_string(async_highlight) + "}";
+  }
+
+  EditorDocumentListener::EditorDocumentListener(EditorCore* editor): m_editor_(editor) {
+  }
+
+  /// 双击选词时视为单词组成部分的字符：字母、数字、下划线以及除空白和标点以外的非ASCII字符
+  static bool isWordChar(U16Char ch) {
+    if (ch < 0x80) {
+      return ch == u'_' || (ch >= u'0' && ch <= u'9') || (ch >= u'a' && ch <= u'z') || (ch >= u'A' && ch <= u'Z');
+    }
+    // Latin-1补充的控制字符、不换行空格和符号中只有ª、µ、º是字母
+    if (ch < 0xC0) {
+      return ch == 0xAA || ch == 0xB5 || ch == 0xBA;
+    }
+    if (ch == 0xD7 || ch == 0xF7 || ch == 0x1680 || ch == 0xFEFF) {
+      return false;
+    }
+    // 通用标点（含各种宽度的空格、行/段分隔符）、CJK符号和标点（含全角空格）、竖排及小写变体标点
+    if ((ch >= 0x2000 && ch <= 0x206F) || (ch >= 0x3000 && ch <= 0x303F) || (ch >= 0xFE10 && ch <= 0xFE1F)
+      || (ch >= 0xFE30 && ch <= 0xFE6F)) {
+      return false;
+    }
+    // 全角ASCII只保留字母和数字，半角CJK标点
+    if (ch >= 0xFF00 && ch <= 0xFF65) {
+      return (ch >= 0xFF10 && ch <= 0xFF19) || (ch >= 0xFF21 && ch <= 0xFF3A) || (ch >= 0xFF41 && ch <= 0xFF5A) || ch == 0xFF3F;
+    }
+    return true;
+  }
+
+  void EditorDocumentListener::onTextChanged(const TextChange& change) {
+    m_editor_->onDocumentTextChanged({change});
+  }
+
+  void EditorDocumentListener::onTextChangedBatch(const Vector<TextChange>& changes) {
+    m_editor_->onDocumentTextChanged(changes);
   }
 
   EditorCore::EditorCore(const EditorConfig& config, const Ptr<TextMeasurer>& measurer): m_config_(config), m_measurer_(measurer) {
     m_decorations_ = makePtr<DecorationManager>();
     m_gesture_handler_ = makeUPtr<GestureHandler>(config.touch_config);
     m_text_layout_ = makeUPtr<TextLayout>(measurer, m_decorations_);
+    m_document_listener_ = makePtr<EditorDocumentListener>(this);
     LOGD("EditorCore::EditorCore(), config = %s", config.dump().c_str());
   }
 
   void EditorCore::loadDocument(const Ptr<Document>& document) {
+    if (m_document_ != nullptr) {
+      m_document_->removeListener(m_document_listener_);
+    }
     m_document_ = document;
+    if (m_document_ != nullptr) {
+      m_document_->addListener(m_document_listener_);
+    }
     m_text_layout_->loadDocument(document);
+    m_decorations_->clearSpans();
+    m_decorations_->clearInlays();
+    m_decorations_->setDiagnostics({});
+    m_selections_.assign(1, {});
+    m_primary_selection_ = 0;
+    ++m_text_version_;
+    m_frame_line_edit_ = {};
+    if (m_highlighter_ != nullptr) {
+      m_highlighter_->loadDocument(document);
+    }
+    if (m_highlight_worker_ != nullptr) {
+      m_highlight_worker_->loadDocument(document, m_text_version_);
+    }
     LOGD("EditorCore::loadDocument()");
   }
 
+  void EditorCore::onDocumentTextChanged(const Vector<TextChange>& changes) {
+    // 先平移高亮Span，被编辑行重新布局时使用变更后的Span
+    m_decorations_->onTextChangedBatch(changes);
+    m_text_layout_->onTextChangedBatch(changes);
+    if (!m_is_applying_edits_) {
+      for (const TextChange& change : changes) {
+        shiftSelections(change);
+      }
+    }
+    for (const TextChange& change : changes) {
+      trackFrameLineEdit(change);
+    }
+    ++m_text_version_;
+    if (m_highlighter_ != nullptr) {
+      for (const TextChange& change : changes) {
+        m_highlighter_->onTextChanged(change);
+      }
+    }
+    if (m_highlight_worker_ != nullptr) {
+      // 后台快照只同步变更涉及的行，多个变更落在同一行时该行只复制一次
+      Vector<U8String> new_lines;
+      size_t next_line = 0;
+      for (const TextChange& change : changes) {
+        for (size_t line = std::max(change.range.start.line, next_line); line <= change.new_end.line; ++line) {
+          new_lines.push_back(m_document_->getLineU8Text(line, 0, m_document_->getLineByteLength(line)));
+        }
+        next_line = std::max(next_line, change.new_end.line + 1);
+      }
+      m_highlight_worker_->postTextChanges(changes, std::move(new_lines), m_text_version_);
+    }
+  }
+
+  void EditorCore::setSelections(Vector<Selection>&& selections, size_t primary_index) {
+    if (selections.empty()) {
+      selections.push_back({});
+    }
+    const Selection primary = selections[std::min(primary_index, selections.size() - 1)];
+    auto less = [](const Selection& left, const Selection& right) {
+      const TextRange left_range = left.range();
+      const TextRange right_range = right.range();
+      return left_range.start < right_range.start || (left_range.start == right_range.start && left_range.end < right_range.end);
+    };
+    std::stable_sort(selections.begin(), selections.end(), less);
+    m_selections_ = std::move(selections);
+    auto it = std::lower_bound(m_selections_.begin(), m_selections_.end(), primary, less);
+    while (!(it->anchor == primary.anchor && it->caret == primary.caret)) {
+      ++it;
+    }
+    m_primary_selection_ = it - m_selections_.begin();
+    mergeSelections();
+  }
+
+  const Vector<Selection>& EditorCore::getSelections() const {
+    return m_selections_;
+  }
+
+  size_t EditorCore::getPrimarySelectionIndex() const {
+    return m_primary_selection_;
+  }
+
+  void EditorCore::selectAll() {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    setSelections({{{0, 0}, m_document_->clampPosition({SIZE_MAX, SIZE_MAX})}});
+  }
+
+  void EditorCore::copySelectedText(const std::function<void(const char*, size_t)>& consumer) const {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    bool is_first = true;
+    for (const Selection& selection : m_selections_) {
+      if (selection.isEmpty()) {
+        continue;
+      }
+      if (!is_first) {
+        consumer("\n", 1);
+      }
+      is_first = false;
+      m_document_->streamU8Text(selection.range(), consumer);
+    }
+  }
+
+  void EditorCore::insertText(const U8String& text) {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    Vector<TextEdit> edits;
+    edits.reserve(m_selections_.size());
+    for (const Selection& selection : m_selections_) {
+      edits.push_back({selection.range(), text});
+    }
+    applySelectionEdits(std::move(edits));
+  }
+
+  void EditorCore::deleteBackward() {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    Vector<TextEdit> edits;
+    edits.reserve(m_selections_.size());
+    for (const Selection& selection : m_selections_) {
+      if (!selection.isEmpty()) {
+        edits.push_back({selection.range(), {}});
+        continue;
+      }
+      const TextPosition& caret = selection.caret;
+      if (caret.column > 0) {
+        // 按字素簇删除，不会拆开代理对或组合序列
+        edits.push_back({{{caret.line, m_text_layout_->getPrevCaretColumn(caret.line, caret.column)}, caret}, {}});
+      } else if (caret.line > 0) {
+        edits.push_back({{{caret.line - 1, m_document_->getLineColumns(caret.line - 1)}, caret}, {}});
+      } else {
+        edits.push_back({{caret, caret}, {}});
+      }
+    }
+    applySelectionEdits(std::move(edits));
+  }
+
   GestureResult EditorCore::handleGestureEvent(const GestureEvent& event) {
     GestureResult result = m_gesture_handler_->handleGestureEvent(event);
     switch (result.type) {
     case GestureType::TAP:
       // 重新定位光标
+      if (m_document_ != nullptr) {
+        const TextPosition position = getPositionAtPoint(result.tap_point);
+        setSelections({{position, position}});
+      }
       break;
     case GestureType::DOUBLE_TAP:
       // 选中文本
+      if (m_document_ != nullptr) {
+        const TextRange range = getWordRange(getPositionAtPoint(result.tap_point));
+        setSelections({{range.start, range.end}});
+      }
       break;
-    case GestureType::SCALE:
-      // 缩放编辑器
-      m_view_state_.scale = std::max(1.0f, std::min(m_config_.max_scale, m_view_state_.scale * result.scale));
+    case GestureType::SCALE: {
+      // 缩放编辑器，滚动距离随缩放等比调整，保持视口顶部的内容不变
+      m_scroll_animation_.is_running = false;
+      const float scale = std::max(1.0f, std::min(m_config_.max_scale, m_view_state_.scale * result.scale));
+      const float factor = scale / m_view_state_.scale;
+      m_view_state_.scale = scale;
+      m_view_state_.scroll_x *= factor;
+      m_view_state_.scroll_y *= factor;
+      m_text_layout_->setScaling(true);
       break;
+    }
     case GestureType::SCROLL:
     case GestureType::FAST_SCROLL:
-      // 滚动到指定位置
+    {
+      // 滚动到指定位置，手动滚动会打断平滑滚动动画
+      m_scroll_animation_.is_running = false;
+      const float scroll_y = std::max(0.0f, m_view_state_.scroll_y + result.scroll_y);
+      updateScrollVelocity(scroll_y - m_view_state_.scroll_y);
       m_view_state_.scroll_x = std::max(0.0f, m_view_state_.scroll_x + result.scroll_x);
-      m_view_state_.scroll_y = std::max(0.0f, m_view_state_.scroll_y + result.scroll_y);
+      m_view_state_.scroll_y = scroll_y;
       break;
+    }
     default:
       break;
     }
+    // 手指抬起后缩放结束，下一帧按新的缩放系数重新断行
+    if (event.type == EventType::TOUCH_POINTER_UP || event.type == EventType::TOUCH_UP || event.type == EventType::TOUCH_CANCEL) {
+      m_text_layout_->setScaling(false);
+    }
     m_text_layout_->setViewState(m_view_state_);
     LOGD("EditorCore::handleGestureEvent, m_view_state_ = %s", m_view_state_.dump().c_str());
     return result;
   }
 
+  TextPosition EditorCore::getPositionAtPoint(const PointF& point) const {
+    return m_text_layout_->getPositionAtPoint(point);
+  }
+
+  PointF EditorCore::getPositionPoint(const TextPosition& position) const {
+    return m_text_layout_->getPositionPoint(position);
+  }
+
   void EditorCore::resetMeasurer() {
     m_text_layout_->resetMeasurer();
   }
@@ -57,11 +275,238 @@ namespace NS_SWEETEDITOR {
     return m_decorations_->getStyleRegistry();
   }
 
+  void EditorCore::setStyles(Vector<Style>&& styles) {
+    m_decorations_->getStyleRegistry()->setStyles(std::move(styles));
+  }
+
+  Ptr<DecorationManager> EditorCore::getDecorations() const {
+    return m_decorations_;
+  }
+
+  void EditorCore::setLineSpans(size_t line, Vector<StyleSpan>&& spans) {
+    m_decorations_->setLineSpans(line, std::move(spans));
+    m_text_layout_->invalidateLine(line);
+  }
+
+  void EditorCore::setPackedSpans(size_t start_line, const uint32_t* packed, size_t count) {
+    const size_t line_count = m_document_ == nullptr ? 0 : m_document_->getLineCount();
+    Vector<size_t> changed_lines;
+    m_decorations_->setPackedSpans(start_line, packed, count, line_count, changed_lines);
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+  }
+
+  bool EditorCore::applyPackedSpanEdits(const uint32_t* edits, size_t length) {
+    const size_t line_count = m_document_ == nullptr ? 0 : m_document_->getLineCount();
+    Vector<size_t> changed_lines;
+    if (!m_decorations_->applyPackedSpanEdits(edits, length, line_count, changed_lines)) {
+      return false;
+    }
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+    return true;
+  }
+
+  void EditorCore::setInlayHints(size_t start_line, Vector<Vector<InlayHint>>&& hints) {
+    Vector<size_t> changed_lines;
+    m_decorations_->replaceInlayHints(start_line, std::move(hints), changed_lines);
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+  }
+
+  void EditorCore::setPhantomTexts(size_t start_line, Vector<Vector<PhantomText>>&& texts) {
+    Vector<size_t> changed_lines;
+    m_decorations_->replacePhantomTexts(start_line, std::move(texts), changed_lines);
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+  }
+
+  void EditorCore::setDiagnostics(Vector<Diagnostic>&& diagnostics) {
+    m_decorations_->setDiagnostics(std::move(diagnostics));
+  }
+
+  void EditorCore::setGrammar(const Grammar& grammar) {
+#ifndef WASM
+    if (m_config_.async_highlight) {
+      UPtr<HighlightWorker> worker = makeUPtr<HighlightWorker>(grammar);
+      m_highlighter_.reset();
+      m_highlight_worker_ = std::move(worker);
+      m_highlight_worker_->setReadyCallback(m_highlight_callback_);
+      m_highlight_worker_->loadDocument(m_document_, m_text_version_);
+      return;
+    }
+#endif
+    m_highlighter_ = makeUPtr<SyntaxHighlighter>(grammar);
+    m_highlight_worker_.reset();
+    m_highlighter_->loadDocument(m_document_);
+  }
+
+  void EditorCore::setHighlightReadyCallback(std::function<void()> callback) {
+    m_highlight_callback_ = std::move(callback);
+    if (m_highlight_worker_ != nullptr) {
+      m_highlight_worker_->setReadyCallback(m_highlight_callback_);
+    }
+  }
+
+  bool EditorCore::isHighlightIdle() const {
+    return m_highlight_worker_ == nullptr || m_highlight_worker_->isIdle();
+  }
+
   void EditorCore::buildRenderModel(EditorRenderModel& model) {
+    highlightVisibleLines();
     m_text_layout_->composeRenderModel(model);
+    m_text_layout_->composeSelections(m_selections_, m_primary_selection_, model);
+    model.sequence = ++m_frame_sequence_;
+    snapshotFrameLines(model.lines, m_last_frame_lines_);
+    m_frame_line_edit_ = {};
   }
 
-  const U16String& EditorCore::getVisualRunText(int64_t run_text_id) const {
+  void EditorCore::buildRenderDelta(uint64_t base_sequence, EditorRenderDelta& delta) {
+    EditorRenderModel model;
+    highlightVisibleLines();
+    m_text_layout_->composeRenderModel(model);
+    m_text_layout_->composeSelections(m_selections_, m_primary_selection_, model);
+    const bool has_base = base_sequence != 0 && base_sequence == m_frame_sequence_;
+    delta.sequence = ++m_frame_sequence_;
+    delta.base_sequence = has_base ? base_sequence : 0;
+    delta.split_x = model.split_x;
+    delta.current_line = model.current_line;
+    delta.cursor = model.cursor;
+    delta.extra_cursors = std::move(model.extra_cursors);
+    delta.guide_lines = std::move(model.guide_lines);
+    delta.diagnostics = std::move(model.diagnostics);
+    delta.selection_rects = std::move(model.selection_rects);
+
+    Vector<FrameLineSnapshot> snapshots;
+    snapshotFrameLines(model.lines, snapshots);
+    const FrameLineEdit line_edit = m_frame_line_edit_;
+    m_frame_line_edit_ = {};
+    if (!has_base) {
+      delta.added_lines = std::move(model.lines);
+      m_last_frame_lines_.swap(snapshots);
+      return;
+    }
+    // 上方增删行后之后的行号整体平移，先按平移后的行号换算上一帧的快照，行号变化但内容不变的行只需位移；
+    // 变更中被删除的行直接移除
+    size_t shifted_start = SIZE_MAX;
+    if (line_edit.has_edit && line_edit.line_shift != 0) {
+      delta.line_shift_start = line_edit.last_line + 1;
+      delta.line_shift = line_edit.line_shift;
+      shifted_start = static_cast<size_t>(static_cast<int64_t>(delta.line_shift_start) + delta.line_shift);
+      size_t kept = 0;
+      for (FrameLineSnapshot prev : m_last_frame_lines_) {
+        size_t& line = prev.key.logical_line;
+        if (line > line_edit.first_line && line <= line_edit.last_line) {
+          delta.removed_lines.push_back(prev.key);
+          continue;
+        }
+        if (line > line_edit.last_line) {
+          line = static_cast<size_t>(static_cast<int64_t>(line) + line_edit.line_shift);
+        }
+        m_last_frame_lines_[kept++] = prev;
+      }
+      m_last_frame_lines_.resize(kept);
+    }
+    // removed_lines使用基准帧的行号
+    auto base_key = [&](VisualLineKey key) {
+      if (key.logical_line >= shifted_start) {
+        key.logical_line = static_cast<size_t>(static_cast<int64_t>(key.logical_line) - delta.line_shift);
+      }
+      return key;
+    };
+    // 两帧的视觉行都按Key升序，归并比较
+    size_t prev_index = 0;
+    size_t curr_index = 0;
+    const size_t prev_size = m_last_frame_lines_.size();
+    const size_t curr_size = snapshots.size();
+    while (prev_index < prev_size || curr_index < curr_size) {
+      if (curr_index >= curr_size
+        || (prev_index < prev_size && m_last_frame_lines_[prev_index].key < snapshots[curr_index].key)) {
+        delta.removed_lines.push_back(base_key(m_last_frame_lines_[prev_index].key));
+        ++prev_index;
+      } else if (prev_index >= prev_size || snapshots[curr_index].key < m_last_frame_lines_[prev_index].key) {
+        delta.added_lines.push_back(std::move(model.lines[curr_index]));
+        ++curr_index;
+      } else {
+        const FrameLineSnapshot& prev = m_last_frame_lines_[prev_index];
+        const FrameLineSnapshot& curr = snapshots[curr_index];
+        if (prev.content_hash != curr.content_hash) {
+          delta.changed_lines.push_back(std::move(model.lines[curr_index]));
+        } else if (prev.x != curr.x || prev.y != curr.y) {
+          delta.shifted_lines.push_back({curr.key, curr.x - prev.x, curr.y - prev.y});
+        }
+        ++prev_index;
+        ++curr_index;
+      }
+    }
+    m_last_frame_lines_.swap(snapshots);
+  }
+
+  size_t EditorCore::encodeRenderModel(const EditorRenderModel& model, uint8_t* buffer, size_t capacity) const {
+    return RenderModelEncoder(*m_text_layout_).encode(model, buffer, capacity);
+  }
+
+  size_t EditorCore::encodeRenderDelta(const EditorRenderDelta& delta, uint8_t* buffer, size_t capacity) const {
+    return RenderModelEncoder(*m_text_layout_).encode(delta, buffer, capacity);
+  }
+
+  void EditorCore::setFrameBuffers(uint8_t* const* buffers, const size_t* capacities, uint32_t count) {
+    m_frame_buffers_.setBuffers(buffers, capacities, count);
+  }
+
+  int32_t EditorCore::buildFrame(uint64_t base_sequence) {
+    int32_t index = m_frame_buffers_.acquire();
+    if (index < 0) {
+      return -1;
+    }
+    uint8_t* buffer = m_frame_buffers_.payload(index);
+    const size_t capacity = m_frame_buffers_.payloadCapacity(index);
+    size_t data_size;
+    if (base_sequence == 0) {
+      EditorRenderModel model;
+      buildRenderModel(model);
+      data_size = encodeRenderModel(model, buffer, capacity);
+    } else {
+      EditorRenderDelta delta;
+      buildRenderDelta(base_sequence, delta);
+      data_size = encodeRenderDelta(delta, buffer, capacity);
+    }
+    m_frame_buffers_.publish(index, data_size, m_frame_sequence_);
+    return index;
+  }
+
+  void EditorCore::releaseFrame(int32_t index) {
+    m_frame_buffers_.release(index);
+  }
+
+  size_t EditorCore::prefetchLayout(size_t max_lines) {
+    if (!m_viewport_.valid()) {
+      return 0;
+    }
+    const float scale = m_view_state_.scale;
+    const float screen_height = m_viewport_.height / scale;
+    // 预布局距离随速度增大，至少一屏，最多prefetch_screens屏（未缩放坐标）
+    const float max_distance = screen_height * std::max(1u, m_config_.prefetch_screens);
+    const float distance = std::min(max_distance, std::max(screen_height, std::abs(m_scroll_velocity_) / scale * kPrefetchLookaheadMs));
+    const float top = m_view_state_.scroll_y / scale;
+    const float bottom = (m_view_state_.scroll_y + m_viewport_.height) / scale;
+    if (m_scroll_velocity_ < 0) {
+      highlightPrefetchLines(top - distance, top, max_lines);
+      return m_text_layout_->prefetchLayout(top, top - distance, max_lines);
+    }
+    highlightPrefetchLines(bottom, bottom + distance, max_lines);
+    return m_text_layout_->prefetchLayout(bottom, bottom + distance, max_lines);
+  }
+
+  PrefetchStats EditorCore::getPrefetchStats() const {
+    return m_text_layout_->getPrefetchStats();
+  }
+
+  U16StringView EditorCore::getVisualRunText(int64_t run_text_id) const {
     return m_text_layout_->getTextById(run_text_id);
   }
 
@@ -75,6 +520,26 @@ namespace NS_SWEETEDITOR {
     m_text_layout_->setWrapMode(mode);
   }
 
+  void EditorCore::setTabSize(uint32_t tab_size) {
+    m_text_layout_->setTabSize(tab_size);
+  }
+
+  void EditorCore::setShowWhitespace(bool show) {
+    m_text_layout_->setShowWhitespace(show);
+  }
+
+  void EditorCore::setFoldRanges(const Vector<FoldRange>& ranges) {
+    m_text_layout_->setFoldRanges(ranges);
+  }
+
+  bool EditorCore::setFoldCollapsed(size_t line, bool collapsed) {
+    return m_text_layout_->setFoldCollapsed(line, collapsed);
+  }
+
+  const Vector<FoldRange>& EditorCore::getFoldRanges() const {
+    return m_text_layout_->getFoldRanges();
+  }
+
   void EditorCore::setScale(float scale) {
     m_view_state_.scale = scale;
     m_text_layout_->setViewState(m_view_state_);
@@ -82,10 +547,43 @@ namespace NS_SWEETEDITOR {
   }
 
   void EditorCore::scrollToLine(size_t line, ScrollBehavior behavior) {
+    m_scroll_animation_.is_running = false;
+    const float scroll_y = computeLineScrollY(line, behavior);
+    updateScrollVelocity(scroll_y - m_view_state_.scroll_y);
+    m_view_state_.scroll_y = scroll_y;
+    m_text_layout_->setViewState(m_view_state_);
+    LOGD("EditorCore::scrollToLine, m_view_state_ = %s", m_view_state_.dump().c_str());
+  }
 
+  void EditorCore::smoothScrollToLine(size_t line, ScrollBehavior behavior, int64_t duration_ms) {
+    if (duration_ms <= 0) {
+      scrollToLine(line, behavior);
+      return;
+    }
+    m_scroll_animation_ = {line, behavior, m_view_state_.scroll_y, TimeUtil::milliTime(), duration_ms, true};
+  }
+
+  bool EditorCore::updateScrollAnimation() {
+    if (!m_scroll_animation_.is_running) {
+      return false;
+    }
+    const int64_t elapsed = TimeUtil::milliTime() - m_scroll_animation_.start_time;
+    const float progress = std::min(1.0f, static_cast<float>(elapsed) / static_cast<float>(m_scroll_animation_.duration));
+    // 先快后慢（ease-out cubic）
+    const float eased = 1 - std::pow(1 - progress, 3.0f);
+    const float to_y = computeLineScrollY(m_scroll_animation_.line, m_scroll_animation_.behavior);
+    const float scroll_y = m_scroll_animation_.from_y + (to_y - m_scroll_animation_.from_y) * eased;
+    updateScrollVelocity(scroll_y - m_view_state_.scroll_y);
+    m_view_state_.scroll_y = scroll_y;
+    m_text_layout_->setViewState(m_view_state_);
+    m_scroll_animation_.is_running = progress < 1;
+    return m_scroll_animation_.is_running;
   }
 
   void EditorCore::setScroll(float scroll_x, float scroll_y) {
+    m_scroll_animation_.is_running = false;
+    // 平台侧的惯性滚动动画也通过这里驱动，同样参与速度估计
+    updateScrollVelocity(scroll_y - m_view_state_.scroll_y);
     m_view_state_.scroll_x = scroll_x;
     m_view_state_.scroll_y = scroll_y;
     m_text_layout_->setViewState(m_view_state_);
@@ -99,4 +597,226 @@ namespace NS_SWEETEDITOR {
   EditorParams& EditorCore::getEditorParams() const {
     return m_text_layout_->getEditorParams();
   }
+
+  void EditorCore::highlightVisibleLines() {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    const float bottom = (m_view_state_.scroll_y + m_viewport_.height) / m_view_state_.scale;
+    Vector<size_t> changed_lines;
+    if (m_highlight_worker_ != nullptr) {
+      // 只接收与当前文本版本一致的结果，并告知后台当前的可见范围
+      const float top = m_view_state_.scroll_y / m_view_state_.scale;
+      m_highlight_worker_->setVisibleRange(m_text_layout_->getLineAtY(top), m_text_layout_->getLineAtY(bottom));
+      m_highlight_worker_->collectResults(m_text_version_, *m_decorations_, changed_lines);
+    } else if (m_highlighter_ != nullptr) {
+      // 可见行的行首状态依赖之前所有行，因此从第一个失效行一直分析到视口底部
+      m_highlighter_->highlight(m_text_layout_->getLineAtY(bottom), SIZE_MAX, *m_decorations_, changed_lines);
+    }
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+  }
+
+  void EditorCore::highlightPrefetchLines(float top, float bottom, size_t max_lines) {
+    if (m_document_ == nullptr) {
+      return;
+    }
+    // 先让高亮覆盖即将预布局的行，避免这些行布局后又因Span变化重新布局
+    const size_t first_line = m_text_layout_->getLineAtY(top);
+    const size_t last_line = m_text_layout_->getLineAtY(bottom);
+    Vector<size_t> changed_lines;
+    if (m_highlight_worker_ != nullptr) {
+      m_highlight_worker_->setPrefetchRange(first_line, last_line);
+      m_highlight_worker_->collectResults(m_text_version_, *m_decorations_, changed_lines);
+    } else if (m_highlighter_ != nullptr) {
+      m_highlighter_->highlight(last_line, max_lines, *m_decorations_, changed_lines);
+    }
+    for (size_t line : changed_lines) {
+      m_text_layout_->invalidateLine(line);
+    }
+  }
+
+  TextRange EditorCore::getWordRange(const TextPosition& position) const {
+    const U16StringView line_text = m_document_->getLineU16View(position.line);
+    const size_t column = std::min(position.column, line_text.length());
+    size_t start = column;
+    size_t end = column;
+    while (start > 0 && isWordChar(line_text[start - 1])) {
+      --start;
+    }
+    while (end < line_text.length() && isWordChar(line_text[end])) {
+      ++end;
+    }
+    // 不在单词上时选中光标后的一个字符
+    if (start == end && end < line_text.length()) {
+      end = m_text_layout_->getNextCaretColumn(position.line, end);
+    }
+    return {{position.line, start}, {position.line, end}};
+  }
+
+  void EditorCore::applySelectionEdits(Vector<TextEdit>&& edits) {
+    // 选区有序且互不重叠，批量编辑返回的变更与选区一一对应，每个光标直接移动到对应变更的末尾
+    m_is_applying_edits_ = true;
+    const Vector<TextChange> changes = m_document_->applyEdits(std::move(edits));
+    m_is_applying_edits_ = false;
+    for (size_t i = 0; i < changes.size() && i < m_selections_.size(); ++i) {
+      m_selections_[i] = {changes[i].new_end, changes[i].new_end};
+    }
+    mergeSelections();
+  }
+
+  void EditorCore::mergeSelections() {
+    size_t kept = 0;
+    for (size_t i = 0; i < m_selections_.size(); ++i) {
+      const Selection selection = m_selections_[i];
+      if (kept > 0) {
+        Selection& last = m_selections_[kept - 1];
+        const TextRange last_range = last.range();
+        const TextRange range = selection.range();
+        // 重叠的选区合并，光标与选区相接时也合并
+        if (range.start < last_range.end || (range.start == last_range.end && (last.isEmpty() || selection.isEmpty()))) {
+          if (last_range.end < range.end) {
+            if (last.caret < last.anchor) {
+              last.anchor = range.end;
+            } else {
+              last.caret = range.end;
+            }
+          }
+          if (i == m_primary_selection_) {
+            m_primary_selection_ = kept - 1;
+          }
+          continue;
+        }
+      }
+      if (i == m_primary_selection_) {
+        m_primary_selection_ = kept;
+      }
+      m_selections_[kept++] = selection;
+    }
+    m_selections_.resize(kept);
+  }
+
+  void EditorCore::trackFrameLineEdit(const TextChange& change) {
+    const size_t start_line = change.range.start.line;
+    const size_t end_line = change.range.end.line;
+    const int64_t line_shift = static_cast<int64_t>(change.new_end.line) - static_cast<int64_t>(end_line);
+    FrameLineEdit& edit = m_frame_line_edit_;
+    if (!edit.has_edit) {
+      edit = {true, start_line, end_line, line_shift};
+      return;
+    }
+    // 变更基于之前的变更已经生效的文本：已涉及范围之前的行号不变，之后的行号减去已有的平移量，范围内的并入范围
+    const int64_t touched_end = static_cast<int64_t>(edit.last_line) + edit.line_shift;
+    auto to_old_line = [&](size_t line, size_t touched_line) {
+      if (line < edit.first_line) {
+        return line;
+      }
+      if (static_cast<int64_t>(line) > touched_end) {
+        return static_cast<size_t>(static_cast<int64_t>(line) - edit.line_shift);
+      }
+      return touched_line;
+    };
+    const size_t old_start = to_old_line(start_line, edit.first_line);
+    const size_t old_end = to_old_line(end_line, edit.last_line);
+    edit.first_line = std::min(edit.first_line, old_start);
+    edit.last_line = std::max(edit.last_line, old_end);
+    edit.line_shift += line_shift;
+  }
+
+  void EditorCore::shiftSelections(const TextChange& change) {
+    const TextPosition& start = change.range.start;
+    const TextPosition& end = change.range.end;
+    const TextPosition& new_end = change.new_end;
+    // 变更之前的位置不变，被删除的位置移动到新文本末尾，之后的位置整体平移
+    auto map_position = [&](TextPosition& position) {
+      if (!(start < position)) {
+        return;
+      }
+      if (position < end) {
+        position = new_end;
+      } else if (position.line == end.line) {
+        position = {new_end.line, new_end.column + position.column - end.column};
+      } else {
+        position.line = position.line - end.line + new_end.line;
+      }
+    };
+    const bool is_line_shifted = end.line != new_end.line;
+    auto it = std::lower_bound(m_selections_.begin(), m_selections_.end(), start,
+      [](const Selection& selection, const TextPosition& position) { return !(position < selection.range().end); });
+    for (; it != m_selections_.end(); ++it) {
+      // 行数不变时只有变更末尾所在行上的位置需要平移
+      if (!is_line_shifted && it->range().start.line > end.line) {
+        break;
+      }
+      map_position(it->anchor);
+      map_position(it->caret);
+    }
+    mergeSelections();
+  }
+
+  float EditorCore::computeLineScrollY(size_t line, ScrollBehavior behavior) {
+    float top;
+    float height;
+    m_text_layout_->getLineBounds(line, top, height);
+    const float viewport_height = m_viewport_.height / m_view_state_.scale;
+    float y = top;
+    if (behavior == ScrollBehavior::GOTO_CENTER) {
+      y = top + (height - viewport_height) / 2;
+    } else if (behavior == ScrollBehavior::GOTO_BOTTOM) {
+      y = top + height - viewport_height;
+    }
+    return std::max(0.0f, y * m_view_state_.scale);
+  }
+
+  void EditorCore::updateScrollVelocity(float delta_y) {
+    if (delta_y == 0) {
+      return;
+    }
+    const int64_t now = TimeUtil::milliTime();
+    const int64_t elapsed = now - m_last_scroll_time_;
+    m_last_scroll_time_ = now;
+    const float velocity = delta_y / (elapsed > 0 ? std::min(static_cast<float>(elapsed), kFrameIntervalMs * 4) : kFrameIntervalMs);
+    if (elapsed > kScrollVelocityWindowMs || (velocity > 0) != (m_scroll_velocity_ > 0)) {
+      m_scroll_velocity_ = velocity;
+    } else {
+      // 指数平滑，避免单次事件抖动
+      m_scroll_velocity_ = m_scroll_velocity_ * 0.5f + velocity * 0.5f;
+    }
+  }
+
+  uint64_t EditorCore::computeLineContentHash(const VisualLine& line) const {
+    // FNV-1a，纵坐标和横向滚动偏移不参与计算，以便区分位移和内容变化
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+      const unsigned char* bytes = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+      }
+    };
+    mix(&line.line_number_position.x, sizeof(float));
+    mix(&line.is_folded, sizeof(line.is_folded));
+    for (const VisualRun& run : line.runs) {
+      mix(&run.type, sizeof(run.type));
+      mix(&run.column, sizeof(run.column));
+      mix(&run.length, sizeof(run.length));
+      const float run_x = run.x + m_view_state_.scroll_x;
+      mix(&run_x, sizeof(run_x));
+      mix(&run.style_id, sizeof(run.style_id));
+      // 按文本内容而不是文本ID计算，上方增删行后行号变化但内容相同的行仍视为位移（文本ID随行平移，保持有效）
+      U16StringView text = m_text_layout_->getTextById(run.text_id);
+      mix(text.data(), text.length() * sizeof(U16Char));
+    }
+    return hash;
+  }
+
+  void EditorCore::snapshotFrameLines(const Vector<VisualLine>& lines, Vector<FrameLineSnapshot>& snapshots) const {
+    snapshots.clear();
+    snapshots.reserve(lines.size());
+    for (const VisualLine& line : lines) {
+      snapshots.push_back({{line.logical_line, line.wrap_index}, computeLineContentHash(line), -m_view_state_.scroll_x,
+        line.line_number_position.y});
+    }
+  }
 }
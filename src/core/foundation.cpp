@@ -32,6 +32,15 @@ namespace NS_SWEETEDITOR {
     return "TextRange {start = " + start.dump() + ", end = " + end.dump() + "}";
   }
 
+  // ===================================== Selection ============================================
+  TextRange Selection::range() const {
+    return caret < anchor ? TextRange {caret, anchor} : TextRange {anchor, caret};
+  }
+
+  bool Selection::isEmpty() const {
+    return anchor == caret;
+  }
+
   // ===================================== PointF ============================================
   float PointF::distance(const PointF& other) const {
     return sqrtf(powf(other.x - x, 2) + powf(other.y - y, 2));
@@ -0,0 +1,265 @@
+//
+// Created by Scave on 2025/12/18.
+//
+#include <algorithm>
+#include "grapheme.h"
+
+namespace NS_SWEETEDITOR {
+  struct GraphemeBreakRange {
+    uint32_t first;
+    uint32_t last;
+    GraphemeBreak property;
+  };
+
+  /// 精简的断开属性表（按码点升序，不重叠）：常用文字的组合附加符号（SpacingMark按Extend处理）、
+  /// 变体选择符、emoji肤色修饰符与标签、Extended_Pictographic；控制字符、ZWJ、国旗、韩文由规则直接判断
+  static const GraphemeBreakRange kBreakRanges[] = {
+    {0x00A9, 0x00A9, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x00AE, 0x00AE, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x0300, 0x036F, GraphemeBreak::EXTEND}, {0x0483, 0x0489, GraphemeBreak::EXTEND},
+    {0x0591, 0x05BD, GraphemeBreak::EXTEND}, {0x05BF, 0x05BF, GraphemeBreak::EXTEND},
+    {0x05C1, 0x05C2, GraphemeBreak::EXTEND}, {0x05C4, 0x05C5, GraphemeBreak::EXTEND},
+    {0x05C7, 0x05C7, GraphemeBreak::EXTEND}, {0x0610, 0x061A, GraphemeBreak::EXTEND},
+    {0x064B, 0x065F, GraphemeBreak::EXTEND}, {0x0670, 0x0670, GraphemeBreak::EXTEND},
+    {0x06D6, 0x06DC, GraphemeBreak::EXTEND}, {0x06DF, 0x06E4, GraphemeBreak::EXTEND},
+    {0x06E7, 0x06E8, GraphemeBreak::EXTEND}, {0x06EA, 0x06ED, GraphemeBreak::EXTEND},
+    {0x0711, 0x0711, GraphemeBreak::EXTEND}, {0x0730, 0x074A, GraphemeBreak::EXTEND},
+    {0x07A6, 0x07B0, GraphemeBreak::EXTEND}, {0x07EB, 0x07F3, GraphemeBreak::EXTEND},
+    {0x0816, 0x082D, GraphemeBreak::EXTEND}, {0x0859, 0x085B, GraphemeBreak::EXTEND},
+    {0x0898, 0x089F, GraphemeBreak::EXTEND}, {0x08CA, 0x08E1, GraphemeBreak::EXTEND},
+    {0x08E3, 0x0903, GraphemeBreak::EXTEND}, {0x093A, 0x093C, GraphemeBreak::EXTEND},
+    {0x093E, 0x094F, GraphemeBreak::EXTEND}, {0x0951, 0x0957, GraphemeBreak::EXTEND},
+    {0x0962, 0x0963, GraphemeBreak::EXTEND}, {0x0981, 0x0983, GraphemeBreak::EXTEND},
+    {0x09BC, 0x09BC, GraphemeBreak::EXTEND}, {0x09BE, 0x09CD, GraphemeBreak::EXTEND},
+    {0x09D7, 0x09D7, GraphemeBreak::EXTEND}, {0x09E2, 0x09E3, GraphemeBreak::EXTEND},
+    {0x0A01, 0x0A03, GraphemeBreak::EXTEND}, {0x0A3C, 0x0A51, GraphemeBreak::EXTEND},
+    {0x0A70, 0x0A71, GraphemeBreak::EXTEND}, {0x0A75, 0x0A75, GraphemeBreak::EXTEND},
+    {0x0A81, 0x0A83, GraphemeBreak::EXTEND}, {0x0ABC, 0x0ABC, GraphemeBreak::EXTEND},
+    {0x0ABE, 0x0ACD, GraphemeBreak::EXTEND}, {0x0AE2, 0x0AE3, GraphemeBreak::EXTEND},
+    {0x0B01, 0x0B03, GraphemeBreak::EXTEND}, {0x0B3C, 0x0B3C, GraphemeBreak::EXTEND},
+    {0x0B3E, 0x0B57, GraphemeBreak::EXTEND}, {0x0B62, 0x0B63, GraphemeBreak::EXTEND},
+    {0x0B82, 0x0B82, GraphemeBreak::EXTEND}, {0x0BBE, 0x0BD7, GraphemeBreak::EXTEND},
+    {0x0C00, 0x0C04, GraphemeBreak::EXTEND}, {0x0C3C, 0x0C3C, GraphemeBreak::EXTEND},
+    {0x0C3E, 0x0C56, GraphemeBreak::EXTEND}, {0x0C62, 0x0C63, GraphemeBreak::EXTEND},
+    {0x0C81, 0x0C83, GraphemeBreak::EXTEND}, {0x0CBC, 0x0CBC, GraphemeBreak::EXTEND},
+    {0x0CBE, 0x0CD6, GraphemeBreak::EXTEND}, {0x0CE2, 0x0CE3, GraphemeBreak::EXTEND},
+    {0x0D00, 0x0D03, GraphemeBreak::EXTEND}, {0x0D3B, 0x0D3C, GraphemeBreak::EXTEND},
+    {0x0D3E, 0x0D4D, GraphemeBreak::EXTEND}, {0x0D57, 0x0D57, GraphemeBreak::EXTEND},
+    {0x0D62, 0x0D63, GraphemeBreak::EXTEND}, {0x0D81, 0x0D83, GraphemeBreak::EXTEND},
+    {0x0DCA, 0x0DDF, GraphemeBreak::EXTEND}, {0x0DF2, 0x0DF3, GraphemeBreak::EXTEND},
+    {0x0E31, 0x0E31, GraphemeBreak::EXTEND}, {0x0E33, 0x0E3A, GraphemeBreak::EXTEND},
+    {0x0E47, 0x0E4E, GraphemeBreak::EXTEND}, {0x0EB1, 0x0EB1, GraphemeBreak::EXTEND},
+    {0x0EB3, 0x0EBC, GraphemeBreak::EXTEND}, {0x0EC8, 0x0ECE, GraphemeBreak::EXTEND},
+    {0x0F18, 0x0F19, GraphemeBreak::EXTEND}, {0x0F35, 0x0F35, GraphemeBreak::EXTEND},
+    {0x0F37, 0x0F37, GraphemeBreak::EXTEND}, {0x0F39, 0x0F39, GraphemeBreak::EXTEND},
+    {0x0F3E, 0x0F3F, GraphemeBreak::EXTEND}, {0x0F71, 0x0F84, GraphemeBreak::EXTEND},
+    {0x0F86, 0x0F87, GraphemeBreak::EXTEND}, {0x0F8D, 0x0FBC, GraphemeBreak::EXTEND},
+    {0x0FC6, 0x0FC6, GraphemeBreak::EXTEND}, {0x102B, 0x103E, GraphemeBreak::EXTEND},
+    {0x1AB0, 0x1AFF, GraphemeBreak::EXTEND}, {0x1DC0, 0x1DFF, GraphemeBreak::EXTEND},
+    {0x203C, 0x203C, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2049, 0x2049, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x20D0, 0x20F0, GraphemeBreak::EXTEND}, {0x2122, 0x2122, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2139, 0x2139, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2194, 0x2199, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x21A9, 0x21AA, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x231A, 0x231B, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2328, 0x2328, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2388, 0x2388, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x23CF, 0x23CF, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x23E9, 0x23F3, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x23F8, 0x23FA, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x24C2, 0x24C2, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x25AA, 0x25AB, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x25B6, 0x25B6, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x25C0, 0x25C0, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x25FB, 0x25FE, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2600, 0x27BF, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2934, 0x2935, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2B05, 0x2B07, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2B1B, 0x2B1C, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2B50, 0x2B50, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x2B55, 0x2B55, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x2CEF, 0x2CF1, GraphemeBreak::EXTEND}, {0x2D7F, 0x2D7F, GraphemeBreak::EXTEND},
+    {0x2DE0, 0x2DFF, GraphemeBreak::EXTEND}, {0x302A, 0x302F, GraphemeBreak::EXTEND},
+    {0x3030, 0x3030, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x303D, 0x303D, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x3099, 0x309A, GraphemeBreak::EXTEND}, {0x3297, 0x3297, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x3299, 0x3299, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0xA66F, 0xA672, GraphemeBreak::EXTEND},
+    {0xA674, 0xA67D, GraphemeBreak::EXTEND}, {0xA69E, 0xA69F, GraphemeBreak::EXTEND},
+    {0xA6F0, 0xA6F1, GraphemeBreak::EXTEND}, {0xA802, 0xA802, GraphemeBreak::EXTEND},
+    {0xA806, 0xA806, GraphemeBreak::EXTEND}, {0xA80B, 0xA80B, GraphemeBreak::EXTEND},
+    {0xA823, 0xA827, GraphemeBreak::EXTEND}, {0xFB1E, 0xFB1E, GraphemeBreak::EXTEND},
+    {0xFE00, 0xFE0F, GraphemeBreak::EXTEND}, {0xFE20, 0xFE2F, GraphemeBreak::EXTEND},
+    {0xFF9E, 0xFF9F, GraphemeBreak::EXTEND}, {0x101FD, 0x101FD, GraphemeBreak::EXTEND},
+    {0x10376, 0x1037A, GraphemeBreak::EXTEND}, {0x10A01, 0x10A0F, GraphemeBreak::EXTEND},
+    {0x11000, 0x11002, GraphemeBreak::EXTEND}, {0x11038, 0x11046, GraphemeBreak::EXTEND},
+    {0x1D165, 0x1D169, GraphemeBreak::EXTEND}, {0x1D16D, 0x1D172, GraphemeBreak::EXTEND},
+    {0x1D17B, 0x1D182, GraphemeBreak::EXTEND}, {0x1D185, 0x1D18B, GraphemeBreak::EXTEND},
+    {0x1D1AA, 0x1D1AD, GraphemeBreak::EXTEND}, {0x1F000, 0x1F0FF, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F10D, 0x1F10F, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F12F, 0x1F12F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F16C, 0x1F171, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F17E, 0x1F17F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F18E, 0x1F18E, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F191, 0x1F19A, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F1AD, 0x1F1E5, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F201, 0x1F20F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F21A, 0x1F21A, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F22F, 0x1F22F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F232, 0x1F23A, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F23C, 0x1F23F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F249, 0x1F3FA, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F3FB, 0x1F3FF, GraphemeBreak::EXTEND},
+    {0x1F400, 0x1F53D, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F546, 0x1F64F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F680, 0x1F6FF, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F774, 0x1F77F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F7D5, 0x1F7FF, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F80C, 0x1F80F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F848, 0x1F84F, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F85A, 0x1F85F, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F888, 0x1F88F, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F8AE, 0x1F8FF, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F90C, 0x1F93A, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1F93C, 0x1F945, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0x1F947, 0x1FAFF, GraphemeBreak::EXTENDED_PICTOGRAPHIC}, {0x1FC00, 0x1FFFD, GraphemeBreak::EXTENDED_PICTOGRAPHIC},
+    {0xE0020, 0xE007F, GraphemeBreak::EXTEND}, {0xE0100, 0xE01EF, GraphemeBreak::EXTEND},
+  };
+
+  static bool isHighSurrogate(U16Char ch) {
+    return ch >= 0xD800 && ch <= 0xDBFF;
+  }
+
+  static bool isLowSurrogate(U16Char ch) {
+    return ch >= 0xDC00 && ch <= 0xDFFF;
+  }
+
+  GraphemeBreak Grapheme::getBreakProperty(uint32_t code_point) {
+    if (code_point < 0x20 || (code_point >= 0x7F && code_point <= 0x9F)) {
+      return GraphemeBreak::CONTROL;
+    }
+    if (code_point < 0xA9) {
+      return GraphemeBreak::OTHER;
+    }
+    if (code_point == 0x200D) {
+      return GraphemeBreak::ZWJ;
+    }
+    if (code_point == 0x200C) {
+      return GraphemeBreak::EXTEND;
+    }
+    if (code_point == 0x200B || code_point == 0x2028 || code_point == 0x2029 || code_point == 0xFEFF) {
+      return GraphemeBreak::CONTROL;
+    }
+    if (code_point >= 0x1F1E6 && code_point <= 0x1F1FF) {
+      return GraphemeBreak::REGIONAL_INDICATOR;
+    }
+    if ((code_point >= 0x1100 && code_point <= 0x115F) || (code_point >= 0xA960 && code_point <= 0xA97C)) {
+      return GraphemeBreak::HANGUL_L;
+    }
+    if ((code_point >= 0x1160 && code_point <= 0x11A7) || (code_point >= 0xD7B0 && code_point <= 0xD7C6)) {
+      return GraphemeBreak::HANGUL_V;
+    }
+    if ((code_point >= 0x11A8 && code_point <= 0x11FF) || (code_point >= 0xD7CB && code_point <= 0xD7FB)) {
+      return GraphemeBreak::HANGUL_T;
+    }
+    if (code_point >= 0xAC00 && code_point <= 0xD7A3) {
+      return (code_point - 0xAC00) % 28 == 0 ? GraphemeBreak::HANGUL_LV : GraphemeBreak::HANGUL_LVT;
+    }
+    const GraphemeBreakRange* ranges_end = kBreakRanges + sizeof(kBreakRanges) / sizeof(kBreakRanges[0]);
+    const GraphemeBreakRange* it = std::upper_bound(kBreakRanges, ranges_end, code_point,
+      [](uint32_t value, const GraphemeBreakRange& range) { return value < range.first; });
+    if (it != kBreakRanges && code_point <= (it - 1)->last) {
+      return (it - 1)->property;
+    }
+    return GraphemeBreak::OTHER;
+  }
+
+  bool Grapheme::computeBoundaries(const U16String& text, Vector<uint64_t>& bits) {
+    bits.clear();
+    const size_t length = text.length();
+    // 快速路径：0x300以下没有组合字符，每个码点都是一个簇
+    bool maybe_complex = false;
+    for (size_t i = 0; i < length; ++i) {
+      if (text[i] >= 0x300) {
+        maybe_complex = true;
+        break;
+      }
+    }
+    if (!maybe_complex) {
+      return false;
+    }
+    bits.assign(length / 64 + 1, 0);
+    bool is_complex = false;
+    GraphemeBreak prev = GraphemeBreak::CONTROL;
+    // 前面是否为 ExtPict Extend* 序列，以及是否刚好是 ExtPict Extend* ZWJ
+    bool in_pictographic = false;
+    bool after_pictographic_zwj = false;
+    // 连续的国旗符号个数
+    size_t regional_count = 0;
+    size_t column = 0;
+    while (column < length) {
+      uint32_t code_point = text[column];
+      size_t units = 1;
+      if (isHighSurrogate(text[column]) && column + 1 < length && isLowSurrogate(text[column + 1])) {
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (text[column + 1] - 0xDC00);
+        units = 2;
+      }
+      const GraphemeBreak curr = getBreakProperty(code_point);
+      bool is_break;
+      if (column == 0 || prev == GraphemeBreak::CONTROL || curr == GraphemeBreak::CONTROL) {
+        is_break = true;
+      } else if (curr == GraphemeBreak::EXTEND || curr == GraphemeBreak::ZWJ) {
+        is_break = false;
+      } else if (prev == GraphemeBreak::HANGUL_L) {
+        is_break = curr != GraphemeBreak::HANGUL_L && curr != GraphemeBreak::HANGUL_V
+          && curr != GraphemeBreak::HANGUL_LV && curr != GraphemeBreak::HANGUL_LVT;
+      } else if ((prev == GraphemeBreak::HANGUL_LV || prev == GraphemeBreak::HANGUL_V)
+        && (curr == GraphemeBreak::HANGUL_V || curr == GraphemeBreak::HANGUL_T)) {
+        is_break = false;
+      } else if ((prev == GraphemeBreak::HANGUL_LVT || prev == GraphemeBreak::HANGUL_T) && curr == GraphemeBreak::HANGUL_T) {
+        is_break = false;
+      } else if (curr == GraphemeBreak::EXTENDED_PICTOGRAPHIC && after_pictographic_zwj) {
+        is_break = false;
+      } else if (curr == GraphemeBreak::REGIONAL_INDICATOR && regional_count % 2 == 1) {
+        is_break = false;
+      } else {
+        is_break = true;
+      }
+      if (is_break) {
+        bits[column >> 6] |= 1ULL << (column & 63);
+      } else {
+        is_complex = true;
+      }
+      // 更新emoji序列和国旗的状态
+      after_pictographic_zwj = curr == GraphemeBreak::ZWJ && in_pictographic;
+      if (curr == GraphemeBreak::EXTENDED_PICTOGRAPHIC) {
+        in_pictographic = true;
+      } else if (curr != GraphemeBreak::EXTEND) {
+        in_pictographic = false;
+      }
+      regional_count = curr == GraphemeBreak::REGIONAL_INDICATOR ? regional_count + 1 : 0;
+      prev = curr;
+      column += units;
+    }
+    if (!is_complex) {
+      bits.clear();
+      return false;
+    }
+    bits[length >> 6] |= 1ULL << (length & 63);
+    return true;
+  }
+
+  bool Grapheme::isBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column) {
+    if (column == 0 || column >= text.length()) {
+      return true;
+    }
+    if (bits.empty()) {
+      return !isLowSurrogate(text[column]) || !isHighSurrogate(text[column - 1]);
+    }
+    return (bits[column >> 6] >> (column & 63)) & 1;
+  }
+
+  size_t Grapheme::floorBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column) {
+    column = std::min(column, text.length());
+    while (!isBoundary(text, bits, column)) {
+      --column;
+    }
+    return column;
+  }
+
+  size_t Grapheme::ceilBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column) {
+    column = std::min(column, text.length());
+    while (!isBoundary(text, bits, column)) {
+      ++column;
+    }
+    return column;
+  }
+
+  size_t Grapheme::nextBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column) {
+    if (column >= text.length()) {
+      return text.length();
+    }
+    return ceilBoundary(text, bits, column + 1);
+  }
+
+  size_t Grapheme::prevBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column) {
+    if (column == 0) {
+      return 0;
+    }
+    return floorBoundary(text, bits, std::min(column, text.length()) - 1);
+  }
+}
@@ -0,0 +1,496 @@
+//
+// Created by Scave on 2025/12/22.
+//
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <simdutf/simdutf.h>
+#include "highlight.h"
+
+namespace NS_SWEETEDITOR {
+  // ===================================== HighlightFrontier ============================================
+  void HighlightFrontier::reset() {
+    frontier = 0;
+    resume_line = 0;
+    analyzed_end = 0;
+  }
+
+  void HighlightFrontier::onTextChanged(const TextChange& change) {
+    const size_t start_line = change.range.start.line;
+    const size_t end_line = change.range.end.line;
+    const size_t new_end_line = change.new_end.line;
+    auto shift_line = [&](size_t line) {
+      return line > end_line ? line - end_line + new_end_line : std::min(line, start_line);
+    };
+    // 合并后的末行缓存的可能是原首行或原末行的状态，因此至少再比较一行原有的行
+    const size_t min_resume_line = new_end_line + 2;
+    resume_line = frontier < resume_line ? std::max(shift_line(resume_line), min_resume_line) : min_resume_line;
+    frontier = std::min(frontier, start_line);
+    analyzed_end = shift_line(analyzed_end);
+  }
+
+  void HighlightFrontier::advance(uint32_t end_state, uint32_t old_state) {
+    ++frontier;
+    if (frontier >= resume_line && frontier < analyzed_end && end_state == old_state) {
+      frontier = analyzed_end;
+    }
+    analyzed_end = std::max(analyzed_end, frontier);
+  }
+
+  void HighlightFrontier::rewind(size_t line) {
+    if (line >= frontier) {
+      return;
+    }
+    resume_line = std::max(frontier < resume_line ? resume_line : 0, frontier);
+    frontier = line;
+  }
+
+  // ===================================== SyntaxHighlighter ============================================
+  SyntaxHighlighter::SyntaxHighlighter(const Grammar& grammar): m_grammar_(grammar) {
+    if (m_grammar_.states.empty()) {
+      throw std::invalid_argument("SyntaxHighlighter grammar has no state");
+    }
+    HashMap<U8String, int32_t> state_indices;
+    for (size_t i = 0; i < m_grammar_.states.size(); ++i) {
+      state_indices[m_grammar_.states[i].name] = static_cast<int32_t>(i);
+    }
+    m_states_.resize(m_grammar_.states.size());
+    for (size_t i = 0; i < m_grammar_.states.size(); ++i) {
+      const GrammarState& state = m_grammar_.states[i];
+      CompiledState& compiled = m_states_[i];
+      compiled.style_id = state.style_id;
+      // 每条规则包在一个捕获组中，规则自身的捕获组数量由单独编译得到，用于计算下一条规则的组号
+      U8String pattern;
+      size_t group = 1;
+      for (const GrammarRule& rule : state.rules) {
+        const std::regex rule_regex(rule.pattern, std::regex::ECMAScript);
+        if (!pattern.empty()) {
+          pattern += '|';
+        }
+        pattern += '(';
+        pattern += rule.pattern;
+        pattern += ')';
+        compiled.rule_groups.push_back(group);
+        group += rule_regex.mark_count() + 1;
+        int32_t push_state = -1;
+        if (!rule.push.empty()) {
+          auto it = state_indices.find(rule.push);
+          if (it == state_indices.end()) {
+            throw std::invalid_argument("SyntaxHighlighter unknown state: " + rule.push);
+          }
+          push_state = it->second;
+        }
+        compiled.push_states.push_back(push_state);
+      }
+      if (!pattern.empty()) {
+        compiled.regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+      }
+    }
+    // ID 0 固定为只含初始状态的栈
+    internStack({0});
+  }
+
+  void SyntaxHighlighter::loadDocument(const Ptr<Document>& document) {
+    m_document_ = document;
+    m_frontier_.reset();
+  }
+
+  void SyntaxHighlighter::onTextChanged(const TextChange& change) {
+    m_frontier_.onTextChanged(change);
+  }
+
+  size_t SyntaxHighlighter::highlight(size_t until_line, size_t max_lines, DecorationManager& decorations, Vector<size_t>& changed_lines) {
+    if (m_document_ == nullptr) {
+      return 0;
+    }
+    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
+    const size_t line_count = logical_lines.size();
+    until_line = std::min(until_line, line_count == 0 ? 0 : line_count - 1);
+    m_frontier_.analyzed_end = std::min(m_frontier_.analyzed_end, line_count);
+    size_t analyzed_lines = 0;
+    Vector<StyleSpan> spans;
+    while (m_frontier_.frontier <= until_line && m_frontier_.frontier < line_count && analyzed_lines < max_lines) {
+      const size_t line = m_frontier_.frontier;
+      const uint32_t start_state = line == 0 ? 0 : logical_lines[line - 1].lexer_state;
+      spans.clear();
+      uint32_t end_state = start_state;
+      const size_t byte_length = m_document_->getLineByteLength(line);
+      if (byte_length <= kMaxHighlightLineBytes) {
+        end_state = tokenizeLine(m_document_->getLineU8Text(line, 0, byte_length), start_state, spans);
+      }
+      if (decorations.replaceLineSpans(line, std::move(spans))) {
+        changed_lines.push_back(line);
+      }
+      const uint32_t old_state = logical_lines[line].lexer_state;
+      logical_lines[line].lexer_state = end_state;
+      ++analyzed_lines;
+      m_frontier_.advance(end_state, old_state);
+    }
+    return analyzed_lines;
+  }
+
+  size_t SyntaxHighlighter::getFrontierLine() const {
+    return m_frontier_.frontier;
+  }
+
+  uint32_t SyntaxHighlighter::tokenizeLine(const U8String& text, uint32_t start_state, Vector<StyleSpan>& spans) {
+    if (text.size() > kMaxHighlightLineBytes) {
+      return start_state;
+    }
+    Vector<uint32_t> stack = m_stacks_[start_state < m_stacks_.size() ? start_state : 0];
+    // 字节偏移到UTF16列号的换算，只向前推进
+    size_t mapped_byte = 0;
+    size_t mapped_column = 0;
+    auto to_column = [&](size_t byte) {
+      mapped_column += simdutf::utf16_length_from_utf8(text.data() + mapped_byte, byte - mapped_byte);
+      mapped_byte = byte;
+      return mapped_column;
+    };
+    auto add_span = [&](size_t start_byte, size_t end_byte, uint32_t style_id) {
+      const size_t start_column = to_column(start_byte);
+      const size_t end_column = to_column(end_byte);
+      if (style_id == 0 || end_column <= start_column) {
+        return;
+      }
+      if (!spans.empty() && spans.back().style_id == style_id && spans.back().column + spans.back().length == start_column) {
+        spans.back().length += static_cast<uint32_t>(end_column - start_column);
+        return;
+      }
+      spans.push_back({static_cast<uint32_t>(start_column), static_cast<uint32_t>(end_column - start_column), style_id});
+    };
+    size_t position = 0;
+    // 空匹配反复切换状态时的保护
+    size_t remaining_steps = text.size() * 4 + 16;
+    while (position < text.size() && remaining_steps-- > 0) {
+      const uint32_t top_state = stack.back();
+      const CompiledState& state = m_states_[top_state];
+      const Vector<GrammarRule>& rules = m_grammar_.states[top_state].rules;
+      std::smatch match;
+      std::regex_constants::match_flag_type flags = position > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+      if (rules.empty() || !std::regex_search(text.cbegin() + position, text.cend(), match, state.regex, flags)) {
+        add_span(position, text.size(), state.style_id);
+        position = text.size();
+        break;
+      }
+      const size_t match_start = position + match.position(0);
+      const size_t match_end = match_start + match.length(0);
+      size_t rule_index = 0;
+      while (rule_index + 1 < rules.size() && !match[state.rule_groups[rule_index]].matched) {
+        ++rule_index;
+      }
+      const GrammarRule& rule = rules[rule_index];
+      add_span(position, match_start, state.style_id);
+      add_span(match_start, match_end, rule.style_id != 0 ? rule.style_id : state.style_id);
+      const size_t stack_depth = stack.size();
+      if (rule.pop && stack.size() > 1) {
+        stack.pop_back();
+      }
+      if (state.push_states[rule_index] >= 0) {
+        stack.push_back(static_cast<uint32_t>(state.push_states[rule_index]));
+      }
+      position = match_end;
+      if (match_end == match_start && stack.size() == stack_depth && stack.back() == top_state) {
+        // 空匹配且状态不变，跳过一个UTF8字符避免死循环
+        do {
+          ++position;
+        } while (position < text.size() && (static_cast<uint8_t>(text[position]) & 0xC0) == 0x80);
+      }
+    }
+    if (position < text.size()) {
+      add_span(position, text.size(), m_states_[stack.back()].style_id);
+    }
+    return internStack(stack);
+  }
+
+  uint32_t SyntaxHighlighter::internStack(const Vector<uint32_t>& stack) {
+    U8String key(reinterpret_cast<const char*>(stack.data()), stack.size() * sizeof(uint32_t));
+    auto it = m_stack_ids_.find(key);
+    if (it != m_stack_ids_.end()) {
+      return it->second;
+    }
+    const uint32_t id = static_cast<uint32_t>(m_stacks_.size());
+    m_stacks_.push_back(stack);
+    m_stack_ids_.emplace(std::move(key), id);
+    return id;
+  }
+
+  // ===================================== HighlightWorker ============================================
+  /// 后台每批分析的行数，批次之间检查新的编辑和视口变化
+  static constexpr size_t kHighlightBatchLines = 512;
+  /// 分析到视口底部的批次最多分析的行数，视口远在分析进度之后时仍然分批发布
+  static constexpr size_t kMaxHighlightBatchLines = 4096;
+  /// 视口首行距离分析进度超过该行数时，先按初始状态推测分析可见的行
+  static constexpr size_t kSpeculativeDistance = 2000;
+
+  HighlightWorker::HighlightWorker(const Grammar& grammar): m_highlighter_(grammar) {
+    m_thread_ = std::thread(&HighlightWorker::run, this);
+  }
+
+  HighlightWorker::~HighlightWorker() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      m_is_running_ = false;
+    }
+    m_condition_.notify_all();
+    if (m_thread_.joinable()) {
+      m_thread_.join();
+    }
+  }
+
+  void HighlightWorker::loadDocument(const Ptr<Document>& document, uint64_t version) {
+    Vector<U8String> lines;
+    if (document != nullptr) {
+      const size_t line_count = document->getLineCount();
+      lines.reserve(line_count);
+      for (size_t line = 0; line < line_count; ++line) {
+        lines.push_back(document->getLineU8Text(line, 0, document->getLineByteLength(line)));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      m_pending_snapshot_ = std::move(lines);
+      m_snapshot_version_ = version;
+      m_has_snapshot_ = true;
+      m_pending_changes_.clear();
+      m_results_.clear();
+      m_is_idle_ = false;
+      m_latest_version_ = version;
+    }
+    m_condition_.notify_all();
+  }
+
+  void HighlightWorker::postTextChanges(const Vector<TextChange>& changes, Vector<U8String>&& new_lines, uint64_t version) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      m_pending_changes_.push_back({changes, std::move(new_lines), version});
+      m_is_idle_ = false;
+      m_latest_version_ = version;
+    }
+    m_condition_.notify_all();
+  }
+
+  void HighlightWorker::setVisibleRange(size_t first_line, size_t last_line) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      if (m_visible_first_ == first_line && m_visible_last_ == last_line) {
+        return;
+      }
+      m_visible_first_ = first_line;
+      m_visible_last_ = last_line;
+    }
+    m_condition_.notify_all();
+  }
+
+  void HighlightWorker::setPrefetchRange(size_t first_line, size_t last_line) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      if (m_prefetch_first_ == first_line && m_prefetch_last_ == last_line) {
+        return;
+      }
+      m_prefetch_first_ = first_line;
+      m_prefetch_last_ = last_line;
+    }
+    m_condition_.notify_all();
+  }
+
+  void HighlightWorker::collectResults(uint64_t version, DecorationManager& decorations, Vector<size_t>& changed_lines) {
+    Vector<HighlightResult> results;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      // 后台尚未应用的编辑会使已发布的结果过期，留给后台回退分析进度后在新版本上重新分析
+      if (m_has_snapshot_ || !m_pending_changes_.empty()) {
+        return;
+      }
+      results.swap(m_results_);
+    }
+    for (HighlightResult& result : results) {
+      // 基于旧版本文本的结果行号和列号都可能已经失效
+      if (result.version != version) {
+        continue;
+      }
+      if (decorations.replaceLineSpans(result.line, std::move(result.spans))) {
+        changed_lines.push_back(result.line);
+      }
+    }
+  }
+
+  void HighlightWorker::setReadyCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(m_mutex_);
+    m_ready_callback_ = std::move(callback);
+  }
+
+  bool HighlightWorker::isIdle() const {
+    std::lock_guard<std::mutex> lock(m_mutex_);
+    return m_is_idle_;
+  }
+
+  void HighlightWorker::run() {
+    Vector<HighlightResult> results;
+    while (true) {
+      size_t visible_first;
+      size_t visible_last;
+      Vector<PendingChange> changes;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex_);
+        m_condition_.wait(lock, [this] {
+          const std::pair<size_t, size_t> range = getPriorityRange();
+          const bool has_work = m_frontier_.frontier < m_lines_.size()
+            || ((m_speculated_first_ != range.first || m_speculated_last_ != range.second)
+              && range.first > m_frontier_.frontier + kSpeculativeDistance);
+          return !m_is_running_ || m_has_snapshot_ || !m_pending_changes_.empty() || has_work;
+        });
+        if (!m_is_running_) {
+          return;
+        }
+        if (m_has_snapshot_) {
+          m_lines_ = std::move(m_pending_snapshot_);
+          m_line_states_.assign(m_lines_.size(), 0);
+          m_version_ = m_snapshot_version_;
+          m_frontier_.reset();
+          m_has_snapshot_ = false;
+        }
+        if (!m_pending_changes_.empty()) {
+          // UI线程不会再取走这些过期的结果，退回分析进度使对应的行在应用编辑后重新分析
+          for (const HighlightResult& result : m_results_) {
+            if (result.version == m_version_) {
+              m_frontier_.rewind(result.line);
+            }
+          }
+          m_results_.clear();
+        }
+        changes.swap(m_pending_changes_);
+        std::tie(visible_first, visible_last) = getPriorityRange();
+      }
+      for (PendingChange& pending : changes) {
+        applyTextChange(pending);
+      }
+      results.clear();
+      // 视口远在分析进度之后时，先推测分析可见的行，顺序分析到达时再修正
+      if (visible_first > m_frontier_.frontier + kSpeculativeDistance
+        && (m_speculated_first_ != visible_first || m_speculated_last_ != visible_last || m_speculated_version_ != m_version_)) {
+        analyzeVisibleLines(visible_first, visible_last, results);
+        m_speculated_first_ = visible_first;
+        m_speculated_last_ = visible_last;
+        m_speculated_version_ = m_version_;
+        publish(results);
+        continue;
+      }
+      // 分析进度在视口之前时，一次分析到视口底部再发布
+      const size_t until_line = m_frontier_.frontier <= visible_last
+        ? std::min(std::max(visible_last, m_frontier_.frontier + kHighlightBatchLines - 1), m_frontier_.frontier + kMaxHighlightBatchLines - 1)
+        : m_frontier_.frontier + kHighlightBatchLines - 1;
+      analyzeBatch(until_line, results);
+      publish(results);
+    }
+  }
+
+  std::pair<size_t, size_t> HighlightWorker::getPriorityRange() const {
+    // 调用时需持有m_mutex_；预布局范围由UI线程按当时的视口计算，视口移开后不再相连的旧范围不参与
+    if (m_prefetch_first_ <= m_visible_last_ + 1 && m_prefetch_last_ + 1 >= m_visible_first_) {
+      return {std::min(m_visible_first_, m_prefetch_first_), std::max(m_visible_last_, m_prefetch_last_)};
+    }
+    return {m_visible_first_, m_visible_last_};
+  }
+
+  void HighlightWorker::applyTextChange(PendingChange& pending) {
+    const bool keeps_line_count = std::all_of(pending.changes.begin(), pending.changes.end(),
+      [](const TextChange& change) { return change.new_end.line == change.range.end.line; });
+    if (keeps_line_count) {
+      // 行号不变时原地替换变更涉及的行
+      auto new_line = pending.new_lines.begin();
+      size_t next_line = 0;
+      for (const TextChange& change : pending.changes) {
+        for (size_t line = std::max(change.range.start.line, next_line);
+             line <= change.new_end.line && line < m_lines_.size() && new_line != pending.new_lines.end(); ++line) {
+          m_lines_[line] = std::move(*new_line++);
+          m_line_states_[line] = 0;
+        }
+        next_line = std::max(next_line, change.new_end.line + 1);
+        m_frontier_.onTextChanged(change);
+      }
+      m_version_ = pending.version;
+      return;
+    }
+    // 快照中一次归并替换所有变更涉及的行，其余行原样保留（包括行尾状态）
+    Vector<U8String> lines;
+    Vector<uint32_t> line_states;
+    lines.reserve(m_lines_.size() + pending.new_lines.size());
+    line_states.reserve(lines.capacity());
+    auto new_line = pending.new_lines.begin();
+    size_t old_line = 0;
+    int64_t line_shift = 0;
+    for (const TextChange& change : pending.changes) {
+      const size_t start_line = change.range.start.line;
+      const size_t old_start = static_cast<size_t>(static_cast<int64_t>(start_line) - line_shift);
+      const size_t old_end = static_cast<size_t>(static_cast<int64_t>(change.range.end.line) - line_shift);
+      for (; old_line < old_start && old_line < m_lines_.size(); ++old_line) {
+        lines.push_back(std::move(m_lines_[old_line]));
+        line_states.push_back(m_line_states_[old_line]);
+      }
+      old_line = std::max(old_line, old_end + 1);
+      // 与前一个变更共用的首行已经写入
+      for (; lines.size() <= change.new_end.line && new_line != pending.new_lines.end(); ++new_line) {
+        lines.push_back(std::move(*new_line));
+        line_states.push_back(0);
+      }
+      line_shift += static_cast<int64_t>(change.new_end.line) - static_cast<int64_t>(change.range.end.line);
+      m_frontier_.onTextChanged(change);
+    }
+    for (; old_line < m_lines_.size(); ++old_line) {
+      lines.push_back(std::move(m_lines_[old_line]));
+      line_states.push_back(m_line_states_[old_line]);
+    }
+    m_lines_ = std::move(lines);
+    m_line_states_ = std::move(line_states);
+    m_version_ = pending.version;
+  }
+
+  void HighlightWorker::analyzeVisibleLines(size_t first_line, size_t last_line, Vector<HighlightResult>& results) {
+    uint32_t state = 0;
+    const size_t end_line = std::min(last_line + 1, m_lines_.size());
+    for (size_t line = first_line; line < end_line; ++line) {
+      HighlightResult result {m_version_, line, {}};
+      state = m_highlighter_.tokenizeLine(m_lines_[line], state, result.spans);
+      results.push_back(std::move(result));
+    }
+  }
+
+  void HighlightWorker::analyzeBatch(size_t until_line, Vector<HighlightResult>& results) {
+    m_frontier_.analyzed_end = std::min(m_frontier_.analyzed_end, m_lines_.size());
+    const size_t first_line = m_frontier_.frontier;
+    while (m_frontier_.frontier <= until_line && m_frontier_.frontier < m_lines_.size()) {
+      // 有新的编辑时放弃本批次，已经得到的结果会因版本过期被丢弃，退回批次首行在新版本上重新分析
+      if (m_latest_version_.load(std::memory_order_relaxed) != m_version_) {
+        m_frontier_.rewind(first_line);
+        results.clear();
+        return;
+      }
+      const size_t line = m_frontier_.frontier;
+      const uint32_t start_state = line == 0 ? 0 : m_line_states_[line - 1];
+      HighlightResult result {m_version_, line, {}};
+      const uint32_t end_state = m_highlighter_.tokenizeLine(m_lines_[line], start_state, result.spans);
+      const uint32_t old_state = m_line_states_[line];
+      m_line_states_[line] = end_state;
+      results.push_back(std::move(result));
+      m_frontier_.advance(end_state, old_state);
+    }
+  }
+
+  void HighlightWorker::publish(Vector<HighlightResult>& results) {
+    std::function<void()> callback;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex_);
+      for (HighlightResult& result : results) {
+        m_results_.push_back(std::move(result));
+      }
+      m_is_idle_ = m_pending_changes_.empty() && !m_has_snapshot_ && m_frontier_.frontier >= m_lines_.size();
+      if (!results.empty()) {
+        callback = m_ready_callback_;
+      }
+    }
+    results.clear();
+    if (callback) {
+      callback();
+    }
+  }
+}
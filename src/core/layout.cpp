@@ -2,19 +2,642 @@
 // Created by Scave on 2025/12/7.
 //
 #include <cmath>
+#include <algorithm>
+#include <iterator>
 #include <simdutf/simdutf.h>
-#include <utf8/utf8.h>
 #include "layout.h"
+#include "grapheme.h"
+#include "utility.h"
 #include "logging.h"
 
 namespace NS_SWEETEDITOR {
+  // ===================================== LineHeightIndex ============================================
+  bool LineHeightIndexBlock::isLineVisible(size_t offset) const {
+    return block_hidden == 0 && lines[offset].hidden == 0;
+  }
+
+  void LineHeightIndexBlock::refresh() {
+    visible_lines = 0;
+    visible_height = 0;
+    if (block_hidden > 0) {
+      return;
+    }
+    for (const Item& line : lines) {
+      if (line.hidden == 0) {
+        ++visible_lines;
+        visible_height += line.height;
+      }
+    }
+  }
+
+  void LineHeightIndex::reset(size_t line_count, float default_height) {
+    m_default_height_ = default_height;
+    resetItems(Vector<Block::Item>(line_count, {default_height, 0}));
+  }
+
+  float LineHeightIndex::getHeight(size_t line) const {
+    if (line >= size()) {
+      return 0;
+    }
+    size_t offset = 0;
+    const size_t block = locate(line, offset);
+    return m_blocks_[block].lines[offset].height;
+  }
+
+  void LineHeightIndex::setHeight(size_t line, float height) {
+    if (line >= size()) {
+      return;
+    }
+    size_t offset = 0;
+    const size_t index = locate(line, offset);
+    Block& block = m_blocks_[index];
+    float& line_height = block.lines[offset].height;
+    if (line_height == height) {
+      return;
+    }
+    if (block.isLineVisible(offset)) {
+      block.visible_height += static_cast<double>(height) - line_height;
+    }
+    line_height = height;
+    updateBlock(0, 0, m_blocks_.size(), index);
+  }
+
+  float LineHeightIndex::getLineY(size_t line) const {
+    return static_cast<float>(prefixSum(std::min(line, size())));
+  }
+
+  size_t LineHeightIndex::getLineAtY(float y) const {
+    const size_t count = size();
+    if (count == 0) {
+      return 0;
+    }
+    if (y >= m_visible_[0]) {
+      const size_t last_line = prevVisibleLine(count - 1);
+      return last_line < count ? last_line : 0;
+    }
+    // 从根节点下降：左子树可见高度超过y时进入左子树，否则扣除左子树高度进入右子树，隐藏的节点高度为0不会被选中
+    double remaining = std::max(0.0f, y);
+    size_t node = 0;
+    size_t lo = 0;
+    size_t hi = m_blocks_.size();
+    size_t base = 0;
+    while (hi - lo > 1) {
+      const size_t mid = (lo + hi) / 2;
+      const size_t left = node + 1;
+      if (m_visible_[left] > remaining) {
+        node = left;
+        hi = mid;
+      } else {
+        remaining -= m_visible_[left];
+        base += m_lines_[left];
+        node += 2 * (mid - lo);
+        lo = mid;
+      }
+    }
+    const Block& block = m_blocks_[lo];
+    for (size_t i = 0; i < block.lines.size(); ++i) {
+      if (!block.isLineVisible(i)) {
+        continue;
+      }
+      if (block.lines[i].height > remaining) {
+        return base + i;
+      }
+      remaining -= block.lines[i].height;
+    }
+    // 浮点误差导致落在块末尾之后时取块内（或之前）最后一个可见行
+    const size_t last_line = prevVisibleLine(base + block.lines.size() - 1);
+    return last_line < count ? last_line : 0;
+  }
+
+  float LineHeightIndex::getTotalHeight() const {
+    return m_visible_.empty() ? 0 : static_cast<float>(m_visible_[0]);
+  }
+
+  void LineHeightIndex::spliceLines(size_t line, size_t removed, size_t inserted) {
+    spliceItems(line, removed, inserted, {m_default_height_, 0});
+  }
+
+  void LineHeightIndex::spliceLines(const Vector<LineSplice>& splices) {
+    spliceItems(splices, {m_default_height_, 0});
+  }
+
+  void LineHeightIndex::setLinesHidden(size_t start, size_t end, bool hidden) {
+    end = std::min(end, size());
+    if (start >= end) {
+      return;
+    }
+    updateHidden(0, 0, m_blocks_.size(), 0, start, end, hidden);
+  }
+
+  bool LineHeightIndex::isHidden(size_t line) const {
+    if (line >= size()) {
+      return false;
+    }
+    size_t node = 0;
+    size_t lo = 0;
+    size_t hi = m_blocks_.size();
+    while (true) {
+      if (m_hidden_[node] > 0) {
+        return true;
+      }
+      if (hi - lo == 1) {
+        return !m_blocks_[lo].isLineVisible(line);
+      }
+      const size_t mid = (lo + hi) / 2;
+      const size_t left = node + 1;
+      if (line < m_lines_[left]) {
+        node = left;
+        hi = mid;
+      } else {
+        line -= m_lines_[left];
+        node += 2 * (mid - lo);
+        lo = mid;
+      }
+    }
+  }
+
+  size_t LineHeightIndex::nextVisibleLine(size_t line) const {
+    if (line >= size()) {
+      return size();
+    }
+    return findVisible(0, 0, m_blocks_.size(), 0, line, true);
+  }
+
+  size_t LineHeightIndex::prevVisibleLine(size_t line) const {
+    if (line >= size()) {
+      return size();
+    }
+    return findVisible(0, 0, m_blocks_.size(), 0, line, false);
+  }
+
+  void LineHeightIndex::pullNode(size_t node, size_t lo, size_t hi) {
+    if (hi - lo == 1) {
+      const Block& block = m_blocks_[lo];
+      m_visible_lines_[node] = block.visible_lines;
+      m_visible_[node] = block.visible_height;
+    } else {
+      const size_t mid = (lo + hi) / 2;
+      const size_t left = node + 1;
+      const size_t right = node + 2 * (mid - lo);
+      m_visible_lines_[node] = m_visible_lines_[left] + m_visible_lines_[right];
+      m_visible_[node] = m_visible_[left] + m_visible_[right];
+    }
+    if (m_hidden_[node] > 0) {
+      m_visible_lines_[node] = 0;
+      m_visible_[node] = 0;
+    }
+  }
+
+  void LineHeightIndex::resizeNodes(size_t node_count) {
+    m_visible_lines_.assign(node_count, 0);
+    m_visible_.assign(node_count, 0);
+    m_hidden_.assign(node_count, 0);
+  }
+
+  void LineHeightIndex::pushDown(size_t node, size_t lo, size_t hi) {
+    if (m_hidden_[node] == 0) {
+      return;
+    }
+    const size_t mid = (lo + hi) / 2;
+    const size_t left = node + 1;
+    const size_t right = node + 2 * (mid - lo);
+    m_hidden_[left] += m_hidden_[node];
+    m_hidden_[right] += m_hidden_[node];
+    m_hidden_[node] = 0;
+    pull(left, lo, mid);
+    pull(right, mid, hi);
+  }
+
+  void LineHeightIndex::pushDownPath(size_t block) {
+    size_t node = 0;
+    size_t lo = 0;
+    size_t hi = m_blocks_.size();
+    while (hi - lo > 1) {
+      pushDown(node, lo, hi);
+      const size_t mid = (lo + hi) / 2;
+      if (block < mid) {
+        node += 1;
+        hi = mid;
+      } else {
+        node += 2 * (mid - lo);
+        lo = mid;
+      }
+    }
+    if (m_hidden_[node] > 0) {
+      m_blocks_[lo].block_hidden += m_hidden_[node];
+      m_hidden_[node] = 0;
+      m_blocks_[lo].refresh();
+    }
+  }
+
+  void LineHeightIndex::pushDownAll(size_t node, size_t lo, size_t hi, uint32_t hidden) {
+    hidden += m_hidden_[node];
+    m_hidden_[node] = 0;
+    if (hi - lo == 1) {
+      if (hidden > 0) {
+        m_blocks_[lo].block_hidden += hidden;
+        m_blocks_[lo].refresh();
+      }
+      return;
+    }
+    const size_t mid = (lo + hi) / 2;
+    pushDownAll(node + 1, lo, mid, hidden);
+    pushDownAll(node + 2 * (mid - lo), mid, hi, hidden);
+  }
+
+  void LineHeightIndex::pushDownAll() {
+    pushDownAll(0, 0, m_blocks_.size(), 0);
+  }
+
+  void LineHeightIndex::flattenBlock(Block& block) {
+    // 整块的隐藏计数转为逐行计数
+    if (block.block_hidden == 0) {
+      return;
+    }
+    for (Block::Item& line : block.lines) {
+      line.hidden += block.block_hidden;
+    }
+    block.block_hidden = 0;
+  }
+
+  void LineHeightIndex::updateHidden(size_t node, size_t lo, size_t hi, size_t base, size_t start, size_t end, bool hidden) {
+    const size_t node_end = base + m_lines_[node];
+    const bool covered = start <= base && node_end <= end;
+    if (covered && (hidden || m_hidden_[node] > 0)) {
+      // 完全覆盖的节点只修改计数，不再下传
+      if (hidden) {
+        ++m_hidden_[node];
+      } else {
+        --m_hidden_[node];
+      }
+      pull(node, lo, hi);
+      return;
+    }
+    if (hi - lo == 1) {
+      // 部分覆盖的块逐行修改计数；撤销时计数可能已经下传到整块或逐行
+      Block& block = m_blocks_[lo];
+      block.block_hidden += m_hidden_[node];
+      m_hidden_[node] = 0;
+      if (covered && block.block_hidden > 0) {
+        --block.block_hidden;
+      } else {
+        for (size_t line = std::max(start, base); line < std::min(end, node_end); ++line) {
+          uint32_t& count = block.lines[line - base].hidden;
+          if (hidden) {
+            ++count;
+          } else if (count > 0) {
+            --count;
+          }
+        }
+      }
+      block.refresh();
+      pull(node, lo, hi);
+      return;
+    }
+    pushDown(node, lo, hi);
+    const size_t mid = (lo + hi) / 2;
+    const size_t left = node + 1;
+    const size_t mid_line = base + m_lines_[left];
+    if (start < mid_line) {
+      updateHidden(left, lo, mid, base, start, end, hidden);
+    }
+    if (end > mid_line) {
+      updateHidden(node + 2 * (mid - lo), mid, hi, mid_line, start, end, hidden);
+    }
+    pull(node, lo, hi);
+  }
+
+  size_t LineHeightIndex::findVisible(size_t node, size_t lo, size_t hi, size_t base, size_t line, bool forward) const {
+    // 整个区间在查找方向之外或没有可见行时直接跳过
+    const size_t node_end = base + m_lines_[node];
+    if ((forward ? node_end <= line : base > line) || m_visible_lines_[node] == 0) {
+      return size();
+    }
+    if (hi - lo == 1) {
+      const Block& block = m_blocks_[lo];
+      if (forward) {
+        for (size_t i = line > base ? line - base : 0; i < block.lines.size(); ++i) {
+          if (block.isLineVisible(i)) {
+            return base + i;
+          }
+        }
+      } else {
+        for (size_t i = std::min(line - base + 1, block.lines.size()); i-- > 0;) {
+          if (block.isLineVisible(i)) {
+            return base + i;
+          }
+        }
+      }
+      return size();
+    }
+    const size_t mid = (lo + hi) / 2;
+    const size_t left = node + 1;
+    const size_t right = node + 2 * (mid - lo);
+    const size_t mid_line = base + m_lines_[left];
+    size_t result = forward ? findVisible(left, lo, mid, base, line, true) : findVisible(right, mid, hi, mid_line, line, false);
+    if (result == size()) {
+      result = forward ? findVisible(right, mid, hi, mid_line, line, true) : findVisible(left, lo, mid, base, line, false);
+    }
+    return result;
+  }
+
+  double LineHeightIndex::prefixSum(size_t count) const {
+    // 累加[0, count)范围内的可见高度：沿一条路径下降到所在的块，再累加块内之前的行
+    if (count == 0 || m_blocks_.empty()) {
+      return 0;
+    }
+    if (count >= size()) {
+      return m_visible_[0];
+    }
+    double sum = 0;
+    size_t node = 0;
+    size_t lo = 0;
+    size_t hi = m_blocks_.size();
+    while (true) {
+      if (m_hidden_[node] > 0) {
+        return sum;
+      }
+      if (hi - lo == 1) {
+        break;
+      }
+      const size_t mid = (lo + hi) / 2;
+      const size_t left = node + 1;
+      if (count < m_lines_[left]) {
+        node = left;
+        hi = mid;
+      } else {
+        sum += m_visible_[left];
+        count -= m_lines_[left];
+        node += 2 * (mid - lo);
+        lo = mid;
+      }
+    }
+    const Block& block = m_blocks_[lo];
+    for (size_t i = 0; i < count; ++i) {
+      if (block.isLineVisible(i)) {
+        sum += block.lines[i].height;
+      }
+    }
+    return sum;
+  }
+
+  // ===================================== IndentIndex ============================================
+  void IndentIndexBlock::refresh() {
+    min_indent = UINT32_MAX;
+    for (uint32_t indent : lines) {
+      min_indent = std::min(min_indent, indent == UINT32_MAX ? 0 : indent);
+    }
+  }
+
+  IndentIndex::IndentIndex(IndentProvider provider): m_provider_(std::move(provider)) {
+  }
+
+  void IndentIndex::reset(size_t line_count) {
+    resetItems(Vector<uint32_t>(line_count, kUnknownIndent));
+  }
+
+  void IndentIndex::spliceLines(size_t line, size_t removed, size_t inserted) {
+    spliceItems(line, removed, inserted, kUnknownIndent);
+  }
+
+  void IndentIndex::spliceLines(const Vector<LineSplice>& splices) {
+    spliceItems(splices, kUnknownIndent);
+  }
+
+  void IndentIndex::invalidateLines(size_t start, size_t end) {
+    end = std::min(end, size());
+    size_t line = start;
+    while (line < end) {
+      // 逐块重置，每块只更新一次线段树
+      size_t offset = 0;
+      const size_t index = locate(line, offset);
+      Block& block = m_blocks_[index];
+      bool is_changed = false;
+      for (; offset < block.lines.size() && line < end; ++offset, ++line) {
+        if (block.lines[offset] != kUnknownIndent) {
+          block.lines[offset] = kUnknownIndent;
+          is_changed = true;
+        }
+      }
+      if (is_changed) {
+        block.refresh();
+        updateBlock(0, 0, m_blocks_.size(), index);
+      }
+    }
+  }
+
+  uint32_t IndentIndex::getIndent(size_t line) {
+    if (line >= size()) {
+      return kBlankIndent;
+    }
+    size_t offset = 0;
+    const size_t index = locate(line, offset);
+    Block& block = m_blocks_[index];
+    if (block.lines[offset] == kUnknownIndent) {
+      block.lines[offset] = std::min(m_provider_(line), kBlankIndent);
+      block.refresh();
+      updateBlock(0, 0, m_blocks_.size(), index);
+    }
+    return block.lines[offset];
+  }
+
+  size_t IndentIndex::findPrevLess(size_t line, uint32_t limit) {
+    return findLessInWindow(line, limit, false, 0, size());
+  }
+
+  size_t IndentIndex::findNextLess(size_t line, uint32_t limit) {
+    return findLessInWindow(line, limit, true, 0, size());
+  }
+
+  void IndentIndex::collectBlocks(size_t first_line, size_t last_line, const std::function<size_t(size_t)>& next_line,
+    Vector<IndentBlock>& blocks) {
+    blocks.clear();
+    const size_t count = size();
+    // 只计算视口附近的行，查找越过窗口时遇到的未计算行视为未知边界
+    const size_t window_start = first_line > kResolveWindowLines ? first_line - kResolveWindowLines : 0;
+    const size_t window_end = last_line < count ? std::min(count, last_line + 1 + kResolveWindowLines) : count;
+    size_t line = findLessInWindow(first_line, kBlankIndent, true, window_start, window_end);
+    if (line == count || !isResolved(line)) {
+      return;
+    }
+    // 外层区块：从范围内首个非空白行开始逐层向上查找缩进更浅的行，范围开头的空白行也属于这些区块
+    size_t header_line = findLessInWindow(line, getIndent(line), false, window_start, window_end);
+    while (header_line != count && isResolved(header_line)) {
+      blocks.push_back(makeBlock(header_line, window_start, window_end));
+      header_line = findLessInWindow(header_line, blocks.back().indent, false, window_start, window_end);
+    }
+    std::reverse(blocks.begin(), blocks.end());
+    // 范围内开始的区块：下一个非空白行缩进更深的行
+    while (line <= last_line) {
+      const size_t next = findLessInWindow(line + 1, kBlankIndent, true, window_start, window_end);
+      if (next == count || !isResolved(next)) {
+        break;
+      }
+      if (getIndent(next) > getIndent(line)) {
+        blocks.push_back(makeBlock(line, window_start, window_end));
+      }
+      line = next;
+      // 跳过隐藏的行，继续检查之后的首个非空白行
+      while (line <= last_line) {
+        const size_t visible_line = next_line(line);
+        if (visible_line == line || visible_line >= count) {
+          break;
+        }
+        line = findLessInWindow(visible_line, kBlankIndent, true, window_start, window_end);
+      }
+    }
+  }
+
+  void IndentIndex::pullNode(size_t node, size_t lo, size_t hi) {
+    if (hi - lo == 1) {
+      m_min_[node] = m_blocks_[lo].min_indent;
+    } else {
+      const size_t mid = (lo + hi) / 2;
+      m_min_[node] = std::min(m_min_[node + 1], m_min_[node + 2 * (mid - lo)]);
+    }
+  }
+
+  void IndentIndex::resizeNodes(size_t node_count) {
+    m_min_.assign(node_count, 0);
+  }
+
+  size_t IndentIndex::findLess(size_t node, size_t lo, size_t hi, size_t base, size_t line, uint32_t limit, bool forward) const {
+    // 整个区间在查找方向之外或最小缩进不小于limit时直接跳过
+    const size_t node_end = base + m_lines_[node];
+    if ((forward ? node_end <= line : base >= line) || m_min_[node] >= limit) {
+      return size();
+    }
+    if (hi - lo == 1) {
+      const Vector<uint32_t>& indents = m_blocks_[lo].lines;
+      auto is_less = [&](size_t i) { return (indents[i] == kUnknownIndent ? 0 : indents[i]) < limit; };
+      if (forward) {
+        for (size_t i = line > base ? line - base : 0; i < indents.size(); ++i) {
+          if (is_less(i)) {
+            return base + i;
+          }
+        }
+      } else {
+        for (size_t i = std::min(line - base, indents.size()); i-- > 0;) {
+          if (is_less(i)) {
+            return base + i;
+          }
+        }
+      }
+      return size();
+    }
+    const size_t mid = (lo + hi) / 2;
+    const size_t left = node + 1;
+    const size_t right = node + 2 * (mid - lo);
+    const size_t mid_line = base + m_lines_[left];
+    size_t result = forward ? findLess(left, lo, mid, base, line, limit, true) : findLess(right, mid, hi, mid_line, line, limit, false);
+    if (result == size()) {
+      result = forward ? findLess(right, mid, hi, mid_line, line, limit, true) : findLess(left, lo, mid, base, line, limit, false);
+    }
+    return result;
+  }
+
+  size_t IndentIndex::findLessInWindow(size_t line, uint32_t limit, bool forward, size_t window_start, size_t window_end) {
+    const size_t count = size();
+    if (count == 0) {
+      return 0;
+    }
+    line = std::min(line, count);
+    // 未计算的行在线段树中按0记录，命中窗口内的行时计算出实际缩进再重新查找，每行最多计算一次；
+    // 命中窗口外的行时直接返回，由调用方按未知边界处理
+    while (true) {
+      const size_t found = findLess(0, 0, m_blocks_.size(), 0, line, limit, forward);
+      if (found == count || isResolved(found) || found < window_start || found >= window_end) {
+        return found;
+      }
+      getIndent(found);
+    }
+  }
+
+  bool IndentIndex::isResolved(size_t line) const {
+    size_t offset = 0;
+    const size_t index = locate(line, offset);
+    return m_blocks_[index].lines[offset] != kUnknownIndent;
+  }
+
+  IndentBlock IndentIndex::makeBlock(size_t header_line, size_t window_start, size_t window_end) {
+    const size_t count = size();
+    IndentBlock block;
+    block.header_line = header_line;
+    block.indent = getIndent(header_line);
+    block.body_indent = getIndent(findLessInWindow(header_line + 1, kBlankIndent, true, window_start, window_end));
+    // 区块在之后第一个缩进不深于首行的行之前结束，该行在窗口外且未计算时结束位置未知
+    const size_t end_line = findLessInWindow(header_line + 1, block.indent + 1, true, window_start, window_end);
+    block.is_end_known = end_line == count || isResolved(end_line);
+    block.last_line = findLessInWindow(end_line, kBlankIndent, false, window_start, window_end);
+    return block;
+  }
+
+  // ===================================== RunTextRef ============================================
+  bool RunTextRef::operator==(const RunTextRef& other) const {
+    return line == other.line && column == other.column && length == other.length && inlay_index == other.inlay_index
+      && version == other.version;
+  }
+
+  size_t RunTextRefHash::operator()(const RunTextRef& ref) const {
+    size_t hash = std::hash<size_t>()(ref.line);
+    hash = hash * 31 + ref.column;
+    hash = hash * 31 + ref.length;
+    hash = hash * 31 + static_cast<size_t>(ref.inlay_index);
+    hash = hash * 31 + ref.version;
+    // 打散到低位，供按2的幂取模的开放寻址表使用
+    hash ^= hash >> 31;
+    hash *= 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 29);
+  }
+
+  // ===================================== LineEdit ============================================
+  /// 一批变更中的一个变更换算到变更前坐标后的首末行，用于把变更前的行号一次换算到全部变更之后
+  struct LineEdit {
+    size_t old_start;
+    size_t old_end;
+    size_t start;
+    size_t new_end;
+    bool is_single_line;
+  };
+
+  /// 变更的行号基于之前的变更已经生效的文本，换算出每个变更在变更前文本中的首末行
+  static void collectLineEdits(const Vector<TextChange>& changes, Vector<LineEdit>& edits) {
+    edits.reserve(changes.size());
+    int64_t line_shift = 0;
+    for (const TextChange& change : changes) {
+      const size_t start_line = change.range.start.line;
+      const size_t end_line = change.range.end.line;
+      const size_t new_end_line = change.new_end.line;
+      edits.push_back({static_cast<size_t>(static_cast<int64_t>(start_line) - line_shift),
+        static_cast<size_t>(static_cast<int64_t>(end_line) - line_shift), start_line, new_end_line,
+        start_line == end_line && start_line == new_end_line});
+      line_shift += static_cast<int64_t>(new_end_line) - static_cast<int64_t>(end_line);
+    }
+  }
+
+  /// 最后一个首行在line（变更前的行号）之前的变更，没有时返回nullptr
+  static const LineEdit* findLineEditBefore(const Vector<LineEdit>& edits, size_t line) {
+    auto it = std::lower_bound(edits.begin(), edits.end(), line,
+      [](const LineEdit& edit, size_t value) { return edit.old_start < value; });
+    return it == edits.begin() ? nullptr : &*(it - 1);
+  }
+
+  // ===================================== TextLayout ============================================
   TextLayout::TextLayout(const Ptr<TextMeasurer>& measurer, const Ptr<DecorationManager>& decoration_manager)
-    : m_measurer_(measurer), m_decoration_manager_(decoration_manager) {
+    : m_measurer_(measurer), m_decoration_manager_(decoration_manager),
+      m_indent_index_([this](size_t line) { return computeLineIndent(line); }) {
+    m_styles_ = m_decoration_manager_->getStyleRegistry()->getSnapshot();
     resetMeasurer();
   }
 
   void TextLayout::loadDocument(const Ptr<Document>& document) {
     m_document_ = document;
+    m_last_first_line_ = 1;
+    m_last_last_line_ = 0;
+    m_fold_ranges_.clear();
+    releaseTextIds();
+    resetHeightIndex();
+    m_indent_index_.reset(document == nullptr ? 0 : document->getLineCount());
   }
 
   void TextLayout::setViewport(const Viewport& viewport) {
@@ -26,75 +649,483 @@ namespace NS_SWEETEDITOR {
   }
 
   void TextLayout::setWrapMode(WrapMode mode) {
+    if (m_wrap_mode_ == mode) {
+      return;
+    }
     m_wrap_mode_ = mode;
+    invalidateLayouts();
+  }
+
+  void TextLayout::setScaling(bool scaling) {
+    m_is_scaling_ = scaling;
+  }
+
+  void TextLayout::layoutLine(size_t index, LogicalLine& logical_line) {
+    if (isLayoutValid(logical_line)) {
+      return;
+    }
+    logical_line.visual_lines.clear();
+    // 布局结果全部是未缩放的坐标，缩放只在composeRenderModel中做乘法
+    const float line_height = getDefaultLineHeight();
+    if (m_document_->getLineByteLength(index) > kLongLineBytes) {
+      layoutLongLine(index, logical_line);
+    } else {
+      Vector<LineChunk>().swap(logical_line.chunks);
+      m_document_->updateDirtyLine(index, logical_line);
+      Grapheme::computeBoundaries(logical_line.cached_text, logical_line.cluster_bits);
+      buildInlayBoxes(index, logical_line);
+      const Vector<StyleSpan>& spans = m_decoration_manager_->getLineSpans(index);
+      buildPrefixWidths(logical_line.cached_text, logical_line.cluster_bits, 0, spans.data(), spans.data() + spans.size(), 0,
+        logical_line.inlay_boxes, logical_line.prefix_widths);
+      layoutVisualLines(index, logical_line);
+    }
+    logical_line.layout_version = logical_line.version;
+    logical_line.layout_epoch = m_layout_epoch_;
+    logical_line.is_layout_dirty = false;
+    if (index < m_height_index_.size()) {
+      m_height_index_.setHeight(index, line_height * logical_line.visual_lines.size());
+    }
+  }
+
+  void TextLayout::layoutVisualLines(size_t index, LogicalLine& logical_line) {
+    const float line_height = getDefaultLineHeight();
+    const size_t length = logical_line.cached_text.length();
+    const Vector<StyleSpan>& spans = m_decoration_manager_->getLineSpans(index);
+    size_t start_column = 0;
+    do {
+      // 将span、inlay-hints、phantom-text组合起来，便于后续断行
+      const size_t end_column = m_wrap_mode_ == WrapMode::NONE || m_wrap_width_ <= 0 ? length : findWrapColumn(logical_line, start_column);
+      VisualLine visual_line = {index, logical_line.visual_lines.size(), {}, false, {}};
+      const float line_y = line_height * visual_line.wrap_index;
+      visual_line.line_number_position = {m_params_.line_number_margin, line_y};
+      const std::pair<size_t, size_t> span_range = m_decoration_manager_->findLineSpans(index, start_column, end_column);
+      splitLineRuns(logical_line.cached_text, logical_line.cluster_bits, logical_line.prefix_widths,
+        spans.data() + span_range.first, spans.data() + span_range.second, 0, logical_line.inlay_boxes,
+        start_column, end_column, -getCaretX(logical_line, start_column), line_y, visual_line.runs);
+      logical_line.visual_lines.push_back(std::move(visual_line));
+      start_column = end_column;
+    } while (start_column < length);
+  }
+
+  void TextLayout::layoutLongLine(size_t index, LogicalLine& logical_line) {
+    // 超长行只建立分块索引（不自动换行，不显示镶嵌内容），文本转换和测量推迟到块进入视口时；释放整行的缓存
+    U16String().swap(logical_line.cached_text);
+    Vector<InlayBox>().swap(logical_line.inlay_boxes);
+    Vector<float>().swap(logical_line.prefix_widths);
+    Vector<uint64_t>().swap(logical_line.cluster_bits);
+    logical_line.is_char_dirty = true;
+    Vector<LineChunk>& chunks = logical_line.chunks;
+    if (!chunks.empty() && logical_line.chunks_version == logical_line.version) {
+      // 内容未变（样式、字体等变化）时块边界不变，无需重新扫描整行；只丢弃块内的测量结果，
+      // 已有的块宽度作为估算值保留，进入视口时重新测量修正，避免视口内容跳动
+      for (LineChunk& chunk : chunks) {
+        U16String().swap(chunk.text);
+        Vector<float>().swap(chunk.prefix_widths);
+        Vector<uint64_t>().swap(chunk.cluster_bits);
+      }
+      logical_line.visual_lines.push_back({index, 0, {m_params_.line_number_margin, 0}, false, {}});
+      return;
+    }
+    chunks.clear();
+    logical_line.chunks_version = logical_line.version;
+    const size_t line_length = m_document_->getLineByteLength(index);
+    size_t offset = 0;
+    size_t column = 0;
+    float x = 0;
+    while (offset < line_length) {
+      U8String bytes = m_document_->getLineU8Text(index, offset, kLineChunkBytes);
+      size_t length = bytes.size();
+      if (offset + length < line_length) {
+        // 退回到最后一个完整UTF8字符之后，块边界不截断字符
+        size_t lead = length;
+        while (lead > 0 && (static_cast<uint8_t>(bytes[lead - 1]) & 0xC0) == 0x80) {
+          --lead;
+        }
+        if (lead > 0) {
+          const uint8_t lead_byte = static_cast<uint8_t>(bytes[lead - 1]);
+          const size_t char_bytes = lead_byte < 0x80 ? 1 : lead_byte >= 0xF0 ? 4 : lead_byte >= 0xE0 ? 3 : 2;
+          if (lead - 1 + char_bytes > length && lead > 1) {
+            length = lead - 1;
+          }
+        }
+      }
+      LineChunk chunk;
+      chunk.start_byte = offset;
+      chunk.byte_length = length;
+      chunk.start_column = column;
+      chunk.columns = simdutf::utf16_length_from_utf8(bytes.data(), length);
+      chunk.x = x;
+      // 测量前按空格宽度估算，块进入视口测量后再修正后续块的位置
+      chunk.width = m_space_width_ * chunk.columns;
+      offset += length;
+      column += chunk.columns;
+      x += chunk.width;
+      chunks.push_back(std::move(chunk));
+    }
+    logical_line.visual_lines.push_back({index, 0, {m_params_.line_number_margin, 0}, false, {}});
+  }
+
+  void TextLayout::setTabSize(uint32_t tab_size) {
+    if (m_params_.tab_size == tab_size) {
+      return;
+    }
+    m_params_.tab_size = tab_size;
+    invalidateLayouts();
+    // 缩进列数按制表位展开，需要全部重新计算
+    m_indent_index_.reset(m_indent_index_.size());
+  }
+
+  void TextLayout::setShowWhitespace(bool show) {
+    // 空白片段始终保留在布局中，只在输出时过滤，切换时无需重新布局
+    m_params_.show_whitespace = show;
+  }
+
+  void TextLayout::onTextChanged(const TextChange& change) {
+    onTextChangedBatch({change});
+  }
+
+  void TextLayout::onTextChangedBatch(const Vector<TextChange>& changes) {
+    // 先按变更前的行号展开受影响的折叠区域，其余区域的隐藏标记随行一起平移
+    if (!m_fold_ranges_.empty()) {
+      shiftFoldRanges(changes);
+    }
+    // 只调整增删的行，被编辑行的内容版本已经变化，下次可见时重新布局并更新高度
+    Vector<LineSplice> splices;
+    for (const TextChange& change : changes) {
+      const size_t removed = change.range.end.line - change.range.start.line;
+      const size_t inserted = change.new_end.line - change.range.start.line;
+      if (removed != inserted) {
+        splices.push_back({change.range.start.line + 1, removed, inserted});
+      }
+    }
+    if (!splices.empty()) {
+      m_height_index_.spliceLines(splices);
+      m_indent_index_.spliceLines(splices);
+      shiftTextIds(changes);
+    }
+    for (const TextChange& change : changes) {
+      m_indent_index_.invalidateLines(change.range.start.line, change.new_end.line + 1);
+    }
+  }
+
+  void TextLayout::setFoldRanges(const Vector<FoldRange>& ranges) {
+    for (const FoldRange& range : m_fold_ranges_) {
+      if (range.collapsed) {
+        m_height_index_.setLinesHidden(range.start_line + 1, range.end_line + 1, false);
+      }
+    }
+    m_fold_ranges_.clear();
+    syncHeightIndex();
+    const size_t line_count = m_height_index_.size();
+    for (const FoldRange& range : ranges) {
+      if (range.start_line < range.end_line && range.end_line < line_count) {
+        m_fold_ranges_.push_back(range);
+      }
+    }
+    // 首行相同时外层区域在前
+    std::sort(m_fold_ranges_.begin(), m_fold_ranges_.end(), [](const FoldRange& a, const FoldRange& b) {
+      return a.start_line != b.start_line ? a.start_line < b.start_line : a.end_line > b.end_line;
+    });
+    for (const FoldRange& range : m_fold_ranges_) {
+      if (range.collapsed) {
+        m_height_index_.setLinesHidden(range.start_line + 1, range.end_line + 1, true);
+      }
+    }
+  }
+
+  bool TextLayout::setFoldCollapsed(size_t line, bool collapsed) {
+    syncHeightIndex();
+    auto it = std::lower_bound(m_fold_ranges_.begin(), m_fold_ranges_.end(), line,
+      [](const FoldRange& range, size_t value) { return range.start_line < value; });
+    if (it == m_fold_ranges_.end() || it->start_line != line || it->collapsed == collapsed) {
+      return false;
+    }
+    // 只在高度索引上标记一个区间，不遍历被折叠的行
+    it->collapsed = collapsed;
+    m_height_index_.setLinesHidden(it->start_line + 1, it->end_line + 1, collapsed);
+    return true;
+  }
+
+  const Vector<FoldRange>& TextLayout::getFoldRanges() const {
+    return m_fold_ranges_;
+  }
+
+  void TextLayout::invalidateLine(size_t line) {
+    if (m_document_ == nullptr || line >= m_document_->getLineCount()) {
+      return;
+    }
+    m_document_->getLogicalLines()[line].is_layout_dirty = true;
+  }
+
+  bool TextLayout::isLineHidden(size_t line) const {
+    return m_height_index_.isHidden(line);
+  }
+
+  float TextLayout::getLineY(size_t line) {
+    syncHeightIndex();
+    return m_height_index_.getLineY(std::min(line, m_height_index_.size()));
+  }
+
+  void TextLayout::getLineBounds(size_t line, float& top, float& height) {
+    // 与构建渲染模型时使用相同的断行宽度，目标行的高度才准确
+    if (m_viewport_.valid()) {
+      syncStyles();
+      updateTextArea();
+    }
+    syncHeightIndex();
+    const size_t line_count = m_height_index_.size();
+    if (line_count == 0) {
+      top = 0;
+      height = 0;
+      return;
+    }
+    line = std::min(line, line_count - 1);
+    if (m_height_index_.isHidden(line)) {
+      line = m_height_index_.prevVisibleLine(line);
+    }
+    ensureLineLayout(line);
+    top = m_height_index_.getLineY(line);
+    height = m_height_index_.getHeight(line);
+  }
+
+  size_t TextLayout::getLineAtY(float y) {
+    syncHeightIndex();
+    return m_height_index_.getLineAtY(y);
+  }
+
+  float TextLayout::getContentHeight() {
+    syncHeightIndex();
+    return m_height_index_.getTotalHeight();
+  }
+
+  void TextLayout::composeRenderModel(EditorRenderModel& model) {
+    if (!m_viewport_.valid() || m_document_ == nullptr) {
+      return;
+    }
+    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
+    if (logical_lines.empty()) {
+      return;
+    }
+    syncStyles();
+    updateTextArea();
+    // 计算第一行和最后一行可见的
+    VisibleLineInfo visile_line_info = computeVisibleLineInfo();
+    ++m_text_frame_;
+    // 构建视觉行（仅扫描可见列），布局缓存中是相对行首的未缩放坐标，输出时缩放并转换为视口坐标
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    float line_top = visile_line_info.first_line_y;
+    for (size_t i = visile_line_info.first_line; i <= visile_line_info.last_line; i = m_height_index_.nextVisibleLine(i + 1)) {
+      LogicalLine& logical_line = logical_lines[i];
+      const bool is_folded = isFoldHeader(i);
+      // 对逻辑行重组的VisualLine的副本进行视口裁剪，布局缓存本身保持完整
+      for (const VisualLine& visual_line : logical_line.visual_lines) {
+        model.lines.push_back(visual_line);
+        VisualLine& frame_line = model.lines.back();
+        // 行号可能因上方增删行而变化，缓存的布局不需要因此重建
+        frame_line.logical_line = i;
+        frame_line.is_folded = is_folded;
+        if (logical_line.chunks.empty()) {
+          cropVisualLineRuns(logical_line, frame_line);
+        } else {
+          emitLongLineRuns(i, logical_line, frame_line);
+        }
+        frame_line.line_number_position.x *= scale;
+        frame_line.line_number_position.y = (line_top + frame_line.line_number_position.y) * scale;
+        for (VisualRun& run : frame_line.runs) {
+          run.x = (text_left + run.x) * scale - m_view_state_.scroll_x;
+          run.y = (line_top + run.y) * scale;
+        }
+      }
+      line_top += m_height_index_.getHeight(i);
+    }
+    recycleTextIds();
+    model.split_x = text_left * scale;
+    composeGuideLines(visile_line_info, model);
+    composeDiagnostics(visile_line_info, model);
+  }
+
+  size_t TextLayout::prefetchLayout(float from_y, float to_y, size_t max_lines) {
+    if (m_document_ == nullptr || max_lines == 0) {
+      return 0;
+    }
+    syncHeightIndex();
+    syncStyles();
+    const size_t line_count = m_height_index_.size();
+    if (line_count == 0) {
+      return 0;
+    }
+    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
+    size_t laid_lines = 0;
+    // 按滚动方向由近及远布局，预算用完时最近的区域已经就绪
+    size_t line = m_height_index_.getLineAtY(from_y);
+    if (from_y <= to_y) {
+      for (; line < line_count && laid_lines < max_lines; line = m_height_index_.nextVisibleLine(line + 1)) {
+        if (m_height_index_.getLineY(line) >= to_y) {
+          break;
+        }
+        if (!isLayoutValid(logical_lines[line])) {
+          layoutLine(line, logical_lines[line]);
+          ++laid_lines;
+        }
+      }
+    } else {
+      while (line < line_count && laid_lines < max_lines) {
+        if (m_height_index_.getLineY(line) + m_height_index_.getHeight(line) <= to_y) {
+          break;
+        }
+        if (!isLayoutValid(logical_lines[line])) {
+          layoutLine(line, logical_lines[line]);
+          ++laid_lines;
+        }
+        if (line == 0) {
+          break;
+        }
+        line = m_height_index_.prevVisibleLine(line - 1);
+      }
+    }
+    m_prefetch_stats_.prefetched_lines += laid_lines;
+    return laid_lines;
+  }
+
+  const PrefetchStats& TextLayout::getPrefetchStats() const {
+    return m_prefetch_stats_;
+  }
+
+  size_t TextLayout::getTextIdCapacity() const {
+    return m_run_text_slots_.size();
+  }
+
+  U16StringView TextLayout::getTextById(int64_t text_id) const {
+    // text_id的低32位是槽位下标，高位是槽位的回收次数
+    const size_t slot = static_cast<size_t>(text_id & 0xFFFFFFFF);
+    if (text_id < 0 || slot >= m_run_texts_.size() || m_document_ == nullptr) {
+      return {};
+    }
+    const RunTextEntry& entry = m_run_texts_[slot];
+    if (!entry.is_used || (entry.generation & 0x7FFFFFFF) != static_cast<uint32_t>(text_id >> 32)) {
+      return {};
+    }
+    const RunTextRef& text_ref = entry.ref;
+    const Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
+    // 行内容已经变化的ID不再指向任何文本
+    if (text_ref.line >= logical_lines.size() || logical_lines[text_ref.line].version != text_ref.version) {
+      return {};
+    }
+    const LogicalLine& logical_line = logical_lines[text_ref.line];
+    if (text_ref.inlay_index >= 0) {
+      const Vector<InlayBox>& inlay_boxes = logical_line.inlay_boxes;
+      return static_cast<size_t>(text_ref.inlay_index) < inlay_boxes.size() ? U16StringView(inlay_boxes[text_ref.inlay_index].text) : U16StringView();
+    }
+    size_t column = text_ref.column;
+    U16StringView line_text = logical_line.cached_text;
+    if (!logical_line.chunks.empty()) {
+      // 超长行的片段不会跨块，引用所在块的文本缓存
+      const LineChunk& chunk = logical_line.chunks[findChunkByColumn(logical_line.chunks, column)];
+      line_text = chunk.text;
+      column -= chunk.start_column;
+    }
+    if (column >= line_text.length()) {
+      return {};
+    }
+    return line_text.substr(column, text_ref.length);
+  }
+
+  float TextLayout::getColumnX(size_t line, size_t column) {
+    LogicalLine& logical_line = ensureLineLayout(line);
+    if (!logical_line.chunks.empty()) {
+      const LineChunk& chunk = ensureChunk(line, logical_line, findChunkByColumn(logical_line.chunks, column));
+      const size_t offset = std::min(column - std::min(column, chunk.start_column), chunk.prefix_widths.size() - 1);
+      return chunk.x + chunk.prefix_widths[offset];
+    }
+    return getCaretX(logical_line, std::min(column, logical_line.prefix_widths.size() - 1));
+  }
+
+  size_t TextLayout::getColumnAtX(size_t line, float x) {
+    LogicalLine& logical_line = ensureLineLayout(line);
+    if (!logical_line.chunks.empty()) {
+      Vector<LineChunk>& chunks = logical_line.chunks;
+      const size_t chunk_index = findChunkAtX(chunks, x);
+      ensureChunk(line, logical_line, chunk_index);
+      // 测量后块的位置可能被修正，重新定位一次
+      const LineChunk& chunk = ensureChunk(line, logical_line, findChunkAtX(chunks, x));
+      return chunk.start_column + findColumnAtX(chunk.text, chunk.cluster_bits, chunk.prefix_widths, {}, x - chunk.x);
+    }
+    return findColumnAtX(logical_line.cached_text, logical_line.cluster_bits, logical_line.prefix_widths, logical_line.inlay_boxes, x);
   }
 
-  void TextLayout::layoutLine(size_t index, LogicalLine& logical_line) {
-    if (!logical_line.is_layout_dirty) {
-      return;
+  TextPosition TextLayout::getPositionAtPoint(const PointF& point) {
+    syncHeightIndex();
+    if (m_height_index_.size() == 0) {
+      return {};
     }
-    // 清空文本ID
-    for (const VisualLine& line : logical_line.visual_lines) {
-      for (const VisualRun& run : line.runs) {
-        removeTextId(run.text_id);
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float y = (point.y + m_view_state_.scroll_y) / scale;
+    // 高度索引定位逻辑行，布局后行高可能变化，定位结果稳定后再继续
+    size_t line = m_height_index_.getLineAtY(y);
+    for (int attempt = 0; attempt < 3; ++attempt) {
+      ensureLineLayout(line);
+      const size_t located_line = m_height_index_.getLineAtY(y);
+      if (located_line == line) {
+        break;
       }
+      line = located_line;
     }
-    logical_line.visual_lines.clear();
-    m_document_->updateDirtyLine(index, logical_line);
-    if (index > 0) {
-      const LogicalLine& prev_line = m_document_->getLogicalLines()[index - 1];
-      logical_line.start_y = prev_line.start_y + prev_line.height;
-    } else {
-      logical_line.start_y = 0;
-    }
-    const U16String& line_text = logical_line.cached_text;
-    VisualLine visual_line = {index};
-    visual_line.line_number_position = {m_params_.line_number_margin, logical_line.start_y};
-    if (m_wrap_mode_ == WrapMode::NONE) {
-      logical_line.height = m_params_.font_height * m_params_.line_spacing_mult + m_params_.line_spacing_add;
-      // 将span、inlay-hints、phantom-text组合起来，便于后续断行
-      VisualRun text_run = {VisualRunType::TEXT, 0, logical_line.cached_text.length()};
-      text_run.y = logical_line.start_y;
-      text_run.text_id = createTextId(line_text);
-      visual_line.runs.push_back(text_run);
-    } else if (m_wrap_mode_ == WrapMode::CHAR_BREAK) {
-    } else {
+    const LogicalLine& logical_line = ensureLineLayout(line);
+    const size_t visual_count = logical_line.visual_lines.size();
+    const float offset_y = std::max(0.0f, y - m_height_index_.getLineY(line));
+    const size_t wrap_index = std::min(static_cast<size_t>(offset_y / getDefaultLineHeight()), visual_count - 1);
+    const size_t visual_start = getVisualStartColumn(logical_line, wrap_index);
+    // 横坐标相对所在视觉行的起点，前缀宽度缓存中已经包含镶嵌内容和幽灵文本的宽度
+    const float x = std::max(0.0f, (point.x + m_view_state_.scroll_x) / scale - text_left);
+    size_t column = std::max(visual_start, getColumnAtX(line, getColumnX(line, visual_start) + x));
+    if (wrap_index + 1 < visual_count) {
+      // 断行处的列显示在下一视觉行的行首，点击本视觉行末尾时停在最后一个字素簇之前
+      const size_t visual_end = getVisualStartColumn(logical_line, wrap_index + 1);
+      if (column >= visual_end) {
+        column = std::max(visual_start, getPrevCaretColumn(line, visual_end));
+      }
     }
-    logical_line.visual_lines.push_back(std::move(visual_line));
-    logical_line.is_layout_dirty = false;
+    return {line, column};
   }
 
-  void TextLayout::composeRenderModel(EditorRenderModel& model) {
-    if (!m_viewport_.valid() || m_document_ == nullptr) {
-      return;
-    }
-    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
-    if (logical_lines.empty()) {
-      return;
-    }
-    // 计算行号宽度
-    m_params_.line_number_width = computeLineNumberWidth();
-    // 计算第一行和最后一行可见的
-    VisibleLineInfo visile_line_info = computeVisibleLineInfo();
-    // 构建视觉行（仅扫描可见列）
-    for (size_t i = visile_line_info.first_line; i <= visile_line_info.last_line; ++i) {
-      LogicalLine& logical_line = logical_lines[i];
-      // 对逻辑行重组的VisualLine进行视口裁剪
-      for (VisualLine& visual_line : logical_line.visual_lines) {
-        cropVisualLineRuns(visual_line);
-        model.lines.push_back(visual_line);
+  size_t TextLayout::getPrevCaretColumn(size_t line, size_t column) {
+    LogicalLine& logical_line = ensureLineLayout(line);
+    if (!logical_line.chunks.empty()) {
+      if (column == 0) {
+        return 0;
       }
+      const LineChunk& chunk = ensureChunk(line, logical_line, findChunkByColumn(logical_line.chunks, column - 1));
+      return chunk.start_column + Grapheme::prevBoundary(chunk.text, chunk.cluster_bits, column - chunk.start_column);
     }
-    model.split_x = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    return Grapheme::prevBoundary(logical_line.cached_text, logical_line.cluster_bits, column);
   }
 
-  const U16String& TextLayout::getTextById(int64_t text_id) {
-    return m_text_mapping_[text_id];
+  size_t TextLayout::getNextCaretColumn(size_t line, size_t column) {
+    LogicalLine& logical_line = ensureLineLayout(line);
+    if (!logical_line.chunks.empty()) {
+      const LineChunk& chunk = ensureChunk(line, logical_line, findChunkByColumn(logical_line.chunks, column));
+      if (column < chunk.start_column) {
+        return chunk.start_column;
+      }
+      return chunk.start_column + Grapheme::nextBoundary(chunk.text, chunk.cluster_bits, column - chunk.start_column);
+    }
+    return Grapheme::nextBoundary(logical_line.cached_text, logical_line.cluster_bits, column);
   }
 
   void TextLayout::resetMeasurer() {
+    // 字体变化后所有宽度缓存和已有布局全部失效
+    for (size_t variant = 0; variant < kFontVariantCount; ++variant) {
+      m_text_widths_[variant].clear();
+      std::fill(std::begin(m_ascii_widths_[variant]), std::end(m_ascii_widths_[variant]), -1.0f);
+    }
     FontMetrics metrics = m_measurer_->getFontMetrics();
     m_params_.font_height = metrics.descent - metrics.ascent;
+    if (m_document_ != nullptr) {
+      invalidateLayouts();
+      resetHeightIndex();
+    }
     static const U16String test_chars = CHAR16("iIl1!.,;:W0@");
     static const U16String test_number = CHAR16("9");
     static const U16String test_space = CHAR16(" ");
@@ -129,101 +1160,972 @@ namespace NS_SWEETEDITOR {
     return m_params_;
   }
 
-  float TextLayout::measureWidth(const U16String& text, bool is_bold) {
-    const auto it = m_text_widths_.find(text);
-    if (it == m_text_widths_.end()) {
-      float width = m_measurer_->measureWidth(text, is_bold);
-      m_text_widths_.insert_or_assign(text, width);
+  float TextLayout::measureWidth(const U16String& text, uint32_t style_id, size_t variant) {
+    HashMap<U16String, float>& text_widths = m_text_widths_[variant];
+    const auto it = text_widths.find(text);
+    if (it == text_widths.end()) {
+      float width = m_measurer_->measureWidth(text, style_id);
+      text_widths.insert_or_assign(text, width);
       return width;
     }
     return it->second;
   }
 
-  int64_t TextLayout::createTextId(const U16String& text) {
-    int64_t id = m_text_id_counter_++;
-    m_text_mapping_.insert_or_assign(id, text);
-    return id;
+  float TextLayout::measureClusterWidth(const U16Char* text, size_t length, uint32_t style_id, size_t variant) {
+    // 单个ASCII字符直接查表，不构造字符串
+    if (length == 1 && text[0] < kAsciiCount) {
+      float& width = m_ascii_widths_[variant][text[0]];
+      if (width < 0) {
+        width = m_measurer_->measureWidth(U16String(text, 1), style_id);
+      }
+      return width;
+    }
+    return measureWidth(U16String(text, length), style_id, variant);
+  }
+
+  size_t TextLayout::getFontVariant(uint32_t style_id) const {
+    if (style_id == 0) {
+      return 0;
+    }
+    return m_styles_->get(style_id).width_cache_id;
+  }
+
+  void TextLayout::syncStyles() {
+    // 只有字体变体变化（快照布局版本变化）时才需要重新布局，颜色变化直接生效
+    Ptr<const StyleSnapshot> styles = m_decoration_manager_->getStyleRegistry()->getSnapshot();
+    if (styles == m_styles_) {
+      return;
+    }
+    if (m_styles_ != nullptr && styles->getLayoutVersion() != m_styles_->getLayoutVersion()) {
+      invalidateLayouts();
+    }
+    m_styles_ = std::move(styles);
+  }
+
+  int64_t TextLayout::createFrameTextId(size_t line, size_t column, size_t length, int64_t inlay_index) {
+    if (m_run_text_slots_.empty()) {
+      m_run_text_slots_.assign(kMinTextSlots, kEmptyTextSlot);
+    }
+    const RunTextRef text_ref = {line, column, length, inlay_index, m_document_->getLogicalLines()[line].version};
+    const size_t position = findTextSlot(text_ref);
+    uint32_t slot = m_run_text_slots_[position];
+    if (slot == kEmptyTextSlot) {
+      if (m_free_run_texts_.empty()) {
+        slot = static_cast<uint32_t>(m_run_texts_.size());
+        m_run_texts_.emplace_back();
+      } else {
+        slot = m_free_run_texts_.back();
+        m_free_run_texts_.pop_back();
+      }
+      m_run_texts_[slot].ref = text_ref;
+      m_run_texts_[slot].is_used = true;
+      m_run_text_slots_[position] = slot;
+      if ((m_run_texts_.size() - m_free_run_texts_.size()) * 2 > m_run_text_slots_.size()) {
+        growTextSlots();
+      }
+    }
+    RunTextEntry& entry = m_run_texts_[slot];
+    entry.frame = m_text_frame_;
+    return (static_cast<int64_t>(entry.generation & 0x7FFFFFFF) << 32) | slot;
+  }
+
+  size_t TextLayout::findTextSlot(const RunTextRef& text_ref) const {
+    // 返回text_ref所在的位置，不存在时返回探测到的空位
+    const size_t mask = m_run_text_slots_.size() - 1;
+    size_t position = RunTextRefHash()(text_ref) & mask;
+    while (m_run_text_slots_[position] != kEmptyTextSlot && !(m_run_texts_[m_run_text_slots_[position]].ref == text_ref)) {
+      position = (position + 1) & mask;
+    }
+    return position;
+  }
+
+  void TextLayout::eraseTextSlot(size_t position) {
+    // 线性探测表的删除：把之后探测链上可以前移的元素依次移入空位，不留墓碑
+    const size_t mask = m_run_text_slots_.size() - 1;
+    size_t hole = position;
+    for (size_t next = (hole + 1) & mask; m_run_text_slots_[next] != kEmptyTextSlot; next = (next + 1) & mask) {
+      const size_t home = RunTextRefHash()(m_run_texts_[m_run_text_slots_[next]].ref) & mask;
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        m_run_text_slots_[hole] = m_run_text_slots_[next];
+        hole = next;
+      }
+    }
+    m_run_text_slots_[hole] = kEmptyTextSlot;
+  }
+
+  void TextLayout::growTextSlots() {
+    m_run_text_slots_.assign(m_run_text_slots_.size() * 2, kEmptyTextSlot);
+    for (size_t slot = 0; slot < m_run_texts_.size(); ++slot) {
+      if (m_run_texts_[slot].is_used) {
+        m_run_text_slots_[findTextSlot(m_run_texts_[slot].ref)] = static_cast<uint32_t>(slot);
+      }
+    }
+  }
+
+  void TextLayout::recycleTextIds() {
+    for (size_t slot = 0; slot < m_run_texts_.size(); ++slot) {
+      RunTextEntry& entry = m_run_texts_[slot];
+      if (!entry.is_used || entry.frame == m_text_frame_) {
+        continue;
+      }
+      eraseTextSlot(findTextSlot(entry.ref));
+      entry.is_used = false;
+      ++entry.generation;
+      m_free_run_texts_.push_back(static_cast<uint32_t>(slot));
+    }
+  }
+
+  void TextLayout::shiftTextIds(const Vector<TextChange>& changes) {
+    // 平台保留的视觉行在上方增删行后只做位移，其文本ID需要随行平移，被删除的行上的ID直接回收
+    Vector<LineEdit> edits;
+    collectLineEdits(changes, edits);
+    for (size_t slot = 0; slot < m_run_texts_.size(); ++slot) {
+      RunTextEntry& entry = m_run_texts_[slot];
+      const LineEdit* edit = entry.is_used ? findLineEditBefore(edits, entry.ref.line) : nullptr;
+      if (edit == nullptr) {
+        continue;
+      }
+      if (entry.ref.line <= edit->old_end) {
+        entry.is_used = false;
+        ++entry.generation;
+        m_free_run_texts_.push_back(static_cast<uint32_t>(slot));
+        continue;
+      }
+      entry.ref.line = entry.ref.line - edit->old_end + edit->new_end;
+    }
+    // 行号变化后按原容量重建查找表
+    std::fill(m_run_text_slots_.begin(), m_run_text_slots_.end(), kEmptyTextSlot);
+    for (size_t slot = 0; slot < m_run_texts_.size(); ++slot) {
+      if (m_run_texts_[slot].is_used) {
+        m_run_text_slots_[findTextSlot(m_run_texts_[slot].ref)] = static_cast<uint32_t>(slot);
+      }
+    }
+  }
+
+  void TextLayout::releaseTextIds() {
+    // 保留槽位的回收次数，旧文档的ID不会指向新文档的文本
+    for (size_t slot = 0; slot < m_run_texts_.size(); ++slot) {
+      RunTextEntry& entry = m_run_texts_[slot];
+      if (entry.is_used) {
+        entry.is_used = false;
+        ++entry.generation;
+        m_free_run_texts_.push_back(static_cast<uint32_t>(slot));
+      }
+    }
+    std::fill(m_run_text_slots_.begin(), m_run_text_slots_.end(), kEmptyTextSlot);
+  }
+
+  void TextLayout::buildPrefixWidths(const U16String& line_text, const Vector<uint64_t>& cluster_bits, float origin_x,
+    const StyleSpan* first_span, const StyleSpan* last_span, size_t span_offset,
+    const Vector<InlayBox>& inlay_boxes, Vector<float>& prefix_widths) {
+    prefix_widths.resize(line_text.length() + 1);
+    float current_x = 0;
+    size_t column = 0;
+    const size_t length = line_text.length();
+    auto box = inlay_boxes.begin();
+    // 按所在Span的样式测量，每个Span只查询一次字体变体
+    const StyleSpan* span = first_span;
+    const StyleSpan* variant_span = nullptr;
+    size_t span_variant = 0;
+    while (true) {
+      // 镶嵌内容绘制在所在列的字符之前，其宽度计入该列的起始横坐标
+      for (; box != inlay_boxes.end() && box->column <= column; ++box) {
+        current_x += box->width;
+      }
+      prefix_widths[column] = current_x;
+      if (column >= length) {
+        break;
+      }
+      // 按字素簇测量（没有多码点簇时即按码点），簇内后续列与簇起始列共享横坐标，保证不会从中间被裁开
+      const size_t next_column = Grapheme::nextBoundary(line_text, cluster_bits, column);
+      for (size_t i = column + 1; i < next_column; ++i) {
+        prefix_widths[i] = current_x;
+      }
+      // 空白字符不调用平台测量：空格使用缓存的宽度，制表符对齐到下一个制表位
+      const U16Char ch = line_text[column];
+      if (next_column - column == 1 && ch == CHAR16('\t')) {
+        // 制表位按行首对齐（超长行分块时加上块的起始横坐标）
+        current_x = nextTabStop(origin_x + current_x) - origin_x;
+      } else if (next_column - column == 1 && ch == CHAR16(' ')) {
+        current_x += m_space_width_;
+      } else {
+        const size_t line_column = column + span_offset;
+        while (span != last_span && static_cast<size_t>(span->column) + span->length <= line_column) {
+          ++span;
+        }
+        uint32_t style_id = 0;
+        size_t variant = 0;
+        if (span != last_span && span->column <= line_column) {
+          if (variant_span != span) {
+            variant_span = span;
+            span_variant = getFontVariant(span->style_id);
+          }
+          style_id = span->style_id;
+          variant = span_variant;
+        }
+        current_x += measureClusterWidth(line_text.data() + column, next_column - column, style_id, variant);
+      }
+      column = next_column;
+    }
+  }
+
+  void TextLayout::buildInlayBoxes(size_t index, LogicalLine& logical_line) {
+    Vector<InlayBox>& inlay_boxes = logical_line.inlay_boxes;
+    inlay_boxes.clear();
+    const Vector<InlayHint>& hints = m_decoration_manager_->getLineInlayHints(index);
+    const Vector<PhantomText>& phantom_texts = m_decoration_manager_->getLinePhantomTexts(index);
+    if (hints.empty() && phantom_texts.empty()) {
+      return;
+    }
+    const U16String& line_text = logical_line.cached_text;
+    size_t hint_index = 0;
+    size_t phantom_index = 0;
+    // 同一列的镶嵌提示排在幽灵文本之前；超出行尾的按行尾处理，不会落在字素簇中间
+    while (hint_index < hints.size() || phantom_index < phantom_texts.size()) {
+      InlayBox box;
+      if (phantom_index == phantom_texts.size() || (hint_index < hints.size() && hints[hint_index].column <= phantom_texts[phantom_index].column)) {
+        const InlayHint& hint = hints[hint_index++];
+        box.column = hint.column;
+        box.type = VisualRunType::INLAY_HINT;
+        if (hint.type == InlayType::ICON) {
+          // 图标按字体高度绘制为正方形
+          box.icon_id = hint.icon_id;
+          box.width = m_params_.font_height;
+        } else {
+          StrUtil::convertUTF8ToUTF16(hint.text, box.text);
+        }
+      } else {
+        const PhantomText& phantom_text = phantom_texts[phantom_index++];
+        box.column = phantom_text.column;
+        box.type = VisualRunType::PHANTOM_TEXT;
+        StrUtil::convertUTF8ToUTF16(phantom_text.text, box.text);
+      }
+      if (!box.text.empty()) {
+        box.width = measureWidth(box.text, 0, 0);
+      }
+      box.column = Grapheme::floorBoundary(line_text, logical_line.cluster_bits, std::min(box.column, line_text.length()));
+      inlay_boxes.push_back(std::move(box));
+    }
+  }
+
+  float TextLayout::getCaretX(const LogicalLine& logical_line, size_t column) {
+    // 光标位于该列镶嵌内容之前
+    float x = logical_line.prefix_widths[column];
+    const Vector<InlayBox>& inlay_boxes = logical_line.inlay_boxes;
+    auto box = std::lower_bound(inlay_boxes.begin(), inlay_boxes.end(), column,
+      [](const InlayBox& inlay_box, size_t value) { return inlay_box.column < value; });
+    for (; box != inlay_boxes.end() && box->column == column; ++box) {
+      x -= box->width;
+    }
+    return x;
+  }
+
+  LogicalLine& TextLayout::ensureLineLayout(size_t line) {
+    syncStyles();
+    LogicalLine& logical_line = m_document_->getLogicalLines()[line];
+    layoutLine(line, logical_line);
+    return logical_line;
+  }
+
+  float TextLayout::nextTabStop(float x) const {
+    const float tab_width = m_space_width_ * m_params_.tab_size;
+    if (tab_width <= 0) {
+      return x + m_space_width_;
+    }
+    return (std::floor(x / tab_width) + 1) * tab_width;
+  }
+
+  void TextLayout::splitLineRuns(const U16String& line_text, const Vector<uint64_t>& cluster_bits, const Vector<float>& prefix_widths,
+    const StyleSpan* first_span, const StyleSpan* last_span, size_t span_offset, const Vector<InlayBox>& inlay_boxes,
+    size_t start_column, size_t end_column, float origin_x, float line_y, Vector<VisualRun>& runs) {
+    const U16Char* text = line_text.data();
+    size_t column = start_column;
+    const StyleSpan* span = first_span;
+    // 镶嵌内容在所在列的字符之前单独成片段，位于断行处的归入下一个视觉行；布局缓存中其text_id为在inlay_boxes中的下标
+    auto box = std::lower_bound(inlay_boxes.begin(), inlay_boxes.end(), start_column,
+      [](const InlayBox& inlay_box, size_t value) { return inlay_box.column < value; });
+    auto emit_boxes = [&] {
+      auto box_end = box;
+      float width = 0;
+      for (; box_end != inlay_boxes.end() && box_end->column <= column; ++box_end) {
+        width += box_end->width;
+      }
+      float x = origin_x + prefix_widths[column] - width;
+      for (; box != box_end; ++box) {
+        runs.push_back({box->type, column, 0, x, line_y, box - inlay_boxes.begin()});
+        // 图标没有文本，图标ID通过style_id传递
+        runs.back().style_id = box->text.empty() ? static_cast<uint32_t>(box->icon_id) : 0;
+        x += box->width;
+      }
+    };
+    // 当前样式区域：相邻且样式相同的Span（样式为0的Span与Span之间的空隙视为同一样式）合并为一个区域，只在区域边界切分片段
+    size_t style_end = 0;
+    uint32_t region_style = 0;
+    const size_t run_limit = runs.size() + kMaxLineRuns;
+    while (column < end_column) {
+      emit_boxes();
+      const U16Char ch = text[column];
+      VisualRunType type;
+      size_t run_end;
+      if (runs.size() + 1 >= run_limit) {
+        // 片段过多时，剩余文本（到下一个镶嵌内容为止）合并为一个片段
+        type = VisualRunType::TEXT;
+        run_end = box != inlay_boxes.end() ? box->column : end_column;
+      } else if (ch == CHAR16(' ')) {
+        type = VisualRunType::WHITESPACE;
+        run_end = StrUtil::skipChar(text, end_column, column, CHAR16(' '));
+      } else if (ch == CHAR16('\t')) {
+        // 每个制表符宽度不同，单独成片段便于绘制
+        type = VisualRunType::TAB;
+        run_end = column + 1;
+      } else {
+        type = VisualRunType::TEXT;
+        run_end = StrUtil::findWhitespace(text, end_column, column);
+      }
+      // 文本片段再按样式区域切分（Span列号相对整行，分块时需加上块的起始列）
+      uint32_t style_id = 0;
+      if (type == VisualRunType::TEXT && runs.size() + 1 < run_limit) {
+        const size_t line_column = column + span_offset;
+        if (line_column >= style_end) {
+          while (span != last_span && static_cast<size_t>(span->column) + span->length <= line_column) {
+            ++span;
+          }
+          region_style = span != last_span && span->column <= line_column ? span->style_id : 0;
+          style_end = line_column;
+          for (const StyleSpan* next = span; ; ) {
+            if (next != last_span && next->column <= style_end) {
+              if (next->style_id != region_style) {
+                break;
+              }
+              style_end = static_cast<size_t>(next->column) + next->length;
+              ++next;
+            } else if (region_style == 0) {
+              if (next == last_span) {
+                style_end = SIZE_MAX;
+                break;
+              }
+              style_end = next->column;
+            } else {
+              break;
+            }
+          }
+        }
+        style_id = region_style;
+        run_end = std::min(run_end, style_end - span_offset);
+      }
+      if (box != inlay_boxes.end() && box->column < run_end) {
+        run_end = box->column;
+      }
+      // 空白后紧跟组合字符时，片段延伸到簇边界
+      run_end = Grapheme::ceilBoundary(line_text, cluster_bits, run_end);
+      runs.push_back({type, column, run_end - column, origin_x + prefix_widths[column], line_y});
+      runs.back().style_id = style_id;
+      column = run_end;
+    }
+    if (end_column == line_text.length()) {
+      emit_boxes();
+    }
+  }
+
+  size_t TextLayout::findColumnAtX(const U16String& line_text, const Vector<uint64_t>& cluster_bits, const Vector<float>& prefix_widths,
+                                   const Vector<InlayBox>& inlay_boxes, float x) {
+    const size_t columns = prefix_widths.size() - 1;
+    if (x <= 0) {
+      return 0;
+    }
+    if (x >= prefix_widths[columns]) {
+      return columns;
+    }
+    // 最后一个起始横坐标不大于x的字素簇，再取距离更近的簇边界（不会落在代理对或组合序列中间）
+    size_t column = std::upper_bound(prefix_widths.begin(), prefix_widths.end(), x) - prefix_widths.begin() - 1;
+    column = Grapheme::floorBoundary(line_text, cluster_bits, column);
+    const size_t next_column = Grapheme::nextBoundary(line_text, cluster_bits, column);
+    // 下一列的光标位于其镶嵌内容之前，点击镶嵌内容时落到其所在的列
+    float next_x = prefix_widths[next_column];
+    auto box = std::lower_bound(inlay_boxes.begin(), inlay_boxes.end(), next_column,
+      [](const InlayBox& inlay_box, size_t value) { return inlay_box.column < value; });
+    for (; box != inlay_boxes.end() && box->column == next_column; ++box) {
+      next_x -= box->width;
+    }
+    if (x >= next_x || x - prefix_widths[column] > next_x - x) {
+      column = next_column;
+    }
+    return column;
+  }
+
+  size_t TextLayout::getVisualStartColumn(const LogicalLine& logical_line, size_t wrap_index) {
+    // 自动换行时每个视觉行的起始列即布局缓存中第一个片段的列
+    const Vector<VisualRun>& runs = logical_line.visual_lines[wrap_index].runs;
+    return wrap_index == 0 || runs.empty() ? 0 : runs.front().column;
+  }
+
+  size_t TextLayout::findWrapIndex(const LogicalLine& logical_line, size_t column) {
+    // 位于断行处的光标显示在下一视觉行的行首
+    size_t wrap_index = 0;
+    while (wrap_index + 1 < logical_line.visual_lines.size() && getVisualStartColumn(logical_line, wrap_index + 1) <= column) {
+      ++wrap_index;
+    }
+    return wrap_index;
+  }
+
+  size_t TextLayout::findChunkByColumn(const Vector<LineChunk>& chunks, size_t column) {
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), column,
+      [](size_t value, const LineChunk& chunk) { return value < chunk.start_column; });
+    return it == chunks.begin() ? 0 : it - chunks.begin() - 1;
   }
 
-  void TextLayout::removeTextId(int64_t id) {
-    m_text_mapping_.erase(id);
+  size_t TextLayout::findChunkAtX(const Vector<LineChunk>& chunks, float x) {
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), x,
+      [](float value, const LineChunk& chunk) { return value < chunk.x; });
+    return it == chunks.begin() ? 0 : it - chunks.begin() - 1;
+  }
+
+  LineChunk& TextLayout::ensureChunk(size_t line, LogicalLine& logical_line, size_t chunk_index) {
+    Vector<LineChunk>& chunks = logical_line.chunks;
+    LineChunk& chunk = chunks[chunk_index];
+    if (!chunk.prefix_widths.empty()) {
+      return chunk;
+    }
+    U8String bytes = m_document_->getLineU8Text(line, chunk.start_byte, chunk.byte_length);
+    StrUtil::convertUTF8ToUTF16(bytes, chunk.text);
+    Grapheme::computeBoundaries(chunk.text, chunk.cluster_bits);
+    const Vector<StyleSpan>& spans = m_decoration_manager_->getLineSpans(line);
+    const std::pair<size_t, size_t> span_range = m_decoration_manager_->findLineSpans(line, chunk.start_column, chunk.start_column + chunk.columns);
+    buildPrefixWidths(chunk.text, chunk.cluster_bits, chunk.x, spans.data() + span_range.first, spans.data() + span_range.second,
+      chunk.start_column, {}, chunk.prefix_widths);
+    const float width = chunk.prefix_widths.back();
+    chunk.is_measured = true;
+    if (width != chunk.width) {
+      // 实际宽度与估算不同，平移后续块
+      const float offset = width - chunk.width;
+      chunk.width = width;
+      for (size_t i = chunk_index + 1; i < chunks.size(); ++i) {
+        chunks[i].x += offset;
+      }
+    }
+    return chunk;
+  }
+
+  void TextLayout::emitLongLineRuns(size_t index, LogicalLine& logical_line, VisualLine& visual_line) {
+    Vector<LineChunk>& chunks = logical_line.chunks;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float visible_left = m_view_state_.scroll_x / m_view_state_.scale;
+    const float visible_right = (m_view_state_.scroll_x + m_viewport_.width) / m_view_state_.scale - text_left;
+    // 只转换和测量与视口相交的块；测量会修正后续块的位置，定位结果稳定后再输出
+    size_t first_chunk = 0;
+    size_t end_chunk = 0;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+      first_chunk = findChunkAtX(chunks, visible_left);
+      const float first_x = chunks[first_chunk].x;
+      for (end_chunk = first_chunk; end_chunk < chunks.size() && chunks[end_chunk].x < visible_right; ++end_chunk) {
+        ensureChunk(index, logical_line, end_chunk);
+      }
+      if (findChunkAtX(chunks, visible_left) == first_chunk && chunks[first_chunk].x == first_x) {
+        break;
+      }
+    }
+    // 释放视口外块的文本缓存，内存只与可见区域相关
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      LineChunk& chunk = chunks[i];
+      if ((i < first_chunk || i >= end_chunk) && !chunk.prefix_widths.empty()) {
+        U16String().swap(chunk.text);
+        Vector<float>().swap(chunk.prefix_widths);
+        Vector<uint64_t>().swap(chunk.cluster_bits);
+      }
+    }
+    Vector<VisualRun>& runs = visual_line.runs;
+    const Vector<StyleSpan>& spans = m_decoration_manager_->getLineSpans(index);
+    for (size_t i = first_chunk; i < end_chunk; ++i) {
+      const LineChunk& chunk = chunks[i];
+      const Vector<float>& prefix_widths = chunk.prefix_widths;
+      const size_t length = chunk.text.length();
+      if (length == 0) {
+        continue;
+      }
+      size_t start_column = std::upper_bound(prefix_widths.begin() + 1, prefix_widths.end(), visible_left - chunk.x) - prefix_widths.begin() - 1;
+      start_column = Grapheme::floorBoundary(chunk.text, chunk.cluster_bits, start_column);
+      size_t end_column = std::lower_bound(prefix_widths.begin(), prefix_widths.end(), visible_right - chunk.x) - prefix_widths.begin();
+      end_column = Grapheme::ceilBoundary(chunk.text, chunk.cluster_bits, std::min(end_column, length));
+      if (start_column >= end_column) {
+        continue;
+      }
+      const size_t run_begin = runs.size();
+      const std::pair<size_t, size_t> span_range = m_decoration_manager_->findLineSpans(index,
+        chunk.start_column + start_column, chunk.start_column + end_column);
+      splitLineRuns(chunk.text, chunk.cluster_bits, prefix_widths, spans.data() + span_range.first, spans.data() + span_range.second,
+        chunk.start_column, {}, start_column, end_column, chunk.x, 0, runs);
+      size_t run_end = run_begin;
+      for (size_t k = run_begin; k < runs.size(); ++k) {
+        VisualRun run = runs[k];
+        const bool is_whitespace = run.type == VisualRunType::WHITESPACE || run.type == VisualRunType::TAB;
+        if (is_whitespace && !m_params_.show_whitespace) {
+          continue;
+        }
+        run.column += chunk.start_column;
+        run.text_id = is_whitespace ? -1 : createFrameTextId(index, run.column, run.length);
+        runs[run_end++] = run;
+      }
+      runs.resize(run_end);
+    }
+  }
+
+  bool TextLayout::isLayoutValid(const LogicalLine& logical_line) const {
+    return !logical_line.is_layout_dirty && logical_line.layout_version == logical_line.version
+      && logical_line.layout_epoch == m_layout_epoch_;
+  }
+
+  float TextLayout::getDefaultLineHeight() const {
+    return m_params_.font_height * m_params_.line_spacing_mult + m_params_.line_spacing_add;
+  }
+
+  void TextLayout::syncHeightIndex() {
+    // Document未经EditorCore直接编辑时行数可能不同步，此时整体重建
+    if (m_document_ != nullptr && m_height_index_.size() != m_document_->getLineCount()) {
+      resetHeightIndex();
+    }
+  }
+
+  void TextLayout::resetHeightIndex() {
+    const size_t line_count = m_document_ == nullptr ? 0 : m_document_->getLineCount();
+    m_height_index_.reset(line_count, getDefaultLineHeight());
+    // 重新标记仍然有效的已折叠区域
+    m_fold_ranges_.erase(std::remove_if(m_fold_ranges_.begin(), m_fold_ranges_.end(),
+      [line_count](const FoldRange& range) { return range.end_line >= line_count; }), m_fold_ranges_.end());
+    for (const FoldRange& range : m_fold_ranges_) {
+      if (range.collapsed) {
+        m_height_index_.setLinesHidden(range.start_line + 1, range.end_line + 1, true);
+      }
+    }
+  }
+
+  uint32_t TextLayout::computeLineIndent(size_t line) const {
+    // 只读取行首的空白字符，长行也无需取出整行文本
+    constexpr size_t kReadBytes = 64;
+    const uint32_t tab_size = std::max<uint32_t>(1, m_params_.tab_size);
+    const size_t byte_length = m_document_->getLineByteLength(line);
+    uint32_t indent = 0;
+    size_t offset = 0;
+    while (offset < byte_length) {
+      const U8String bytes = m_document_->getLineU8Text(line, offset, std::min(kReadBytes, byte_length - offset));
+      if (bytes.empty()) {
+        break;
+      }
+      for (char ch : bytes) {
+        if (ch == ' ') {
+          ++indent;
+        } else if (ch == '\t') {
+          indent = (indent / tab_size + 1) * tab_size;
+        } else if (ch == '\r' || ch == '\n') {
+          return IndentIndex::kBlankIndent;
+        } else {
+          return indent;
+        }
+      }
+      offset += bytes.size();
+    }
+    return IndentIndex::kBlankIndent;
+  }
+
+  void TextLayout::syncIndentIndex() {
+    // 与高度索引相同，行数不同步时整体重建
+    if (m_document_ != nullptr && m_indent_index_.size() != m_document_->getLineCount()) {
+      m_indent_index_.reset(m_document_->getLineCount());
+    }
+  }
+
+  void TextLayout::composeGuideLines(const VisibleLineInfo& visible_line_info, EditorRenderModel& model) {
+    syncIndentIndex();
+    m_indent_index_.collectBlocks(visible_line_info.first_line, visible_line_info.last_line,
+      [this](size_t line) { return m_height_index_.nextVisibleLine(line); }, m_guide_blocks_);
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float scroll_y = m_view_state_.scroll_y / scale;
+    const float view_bottom = m_viewport_.height / scale;
+    auto indent_x = [&](uint32_t indent) {
+      return (text_left + static_cast<float>(indent) * m_space_width_) * scale - m_view_state_.scroll_x;
+    };
+    // 竖线位于区块首行的缩进处，从区块第二行顶部延伸到最后一个非空白行底部，只输出视口内的部分；
+    // 区块在视口内结束时再用横线连接到区块内容的缩进处
+    for (const IndentBlock& block : m_guide_blocks_) {
+      const float x = indent_x(block.indent);
+      if (x < text_left * scale || x > m_viewport_.width) {
+        continue;
+      }
+      const float top = std::max(0.0f, m_height_index_.getLineY(block.header_line + 1) - scroll_y);
+      const float block_bottom = m_height_index_.getLineY(block.last_line + 1) - scroll_y;
+      const float bottom = std::min(view_bottom, block_bottom);
+      if (bottom <= top) {
+        continue;
+      }
+      model.guide_lines.push_back({GuideLineDirection::VERTICAL, {x, top * scale}, {x, bottom * scale}});
+      if (block.is_end_known && block_bottom <= view_bottom) {
+        const float end_x = std::min(indent_x(block.body_indent), m_viewport_.width);
+        model.guide_lines.push_back({GuideLineDirection::HORIZONTAL, {x, block_bottom * scale}, {end_x, block_bottom * scale}});
+      }
+    }
+  }
+
+  void TextLayout::composeDiagnostics(const VisibleLineInfo& visible_line_info, EditorRenderModel& model) {
+    if (m_decoration_manager_->getDiagnosticCount() == 0) {
+      return;
+    }
+    m_decoration_manager_->queryDiagnostics(visible_line_info.first_line, visible_line_info.last_line, m_frame_diagnostics_);
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float scroll_y = m_view_state_.scroll_y / scale;
+    const float line_height = getDefaultLineHeight();
+    const float visible_left = text_left * scale;
+    const float visible_right = m_viewport_.width;
+    for (const Diagnostic& diagnostic : m_frame_diagnostics_) {
+      const TextRange& range = diagnostic.range;
+      const bool is_empty = range.start == range.end;
+      const size_t last_line = std::min(range.end.line, visible_line_info.last_line);
+      for (size_t line = m_height_index_.nextVisibleLine(std::max(range.start.line, visible_line_info.first_line));
+           line <= last_line; line = m_height_index_.nextVisibleLine(line + 1)) {
+        const LogicalLine& logical_line = ensureLineLayout(line);
+        const size_t column_count = logical_line.chunks.empty() ? logical_line.cached_text.length()
+          : logical_line.chunks.back().start_column + logical_line.chunks.back().columns;
+        size_t start_column = line == range.start.line ? std::min(range.start.column, column_count) : 0;
+        size_t end_column = line == range.end.line ? std::min(range.end.column, column_count) : column_count;
+        if (!logical_line.chunks.empty() && !is_empty) {
+          // 超长行先把列范围限制在视口内，避免转换视口外的块
+          const float left_x = m_view_state_.scroll_x / scale;
+          start_column = std::max(start_column, getColumnAtX(line, left_x));
+          end_column = std::min(end_column, getColumnAtX(line, left_x + visible_right / scale) + 1);
+        }
+        const float line_y = m_height_index_.getLineY(line) - scroll_y;
+        const size_t visual_count = logical_line.visual_lines.size();
+        for (size_t wrap_index = 0; wrap_index < visual_count; ++wrap_index) {
+          const size_t visual_start = getVisualStartColumn(logical_line, wrap_index);
+          const bool is_last_visual = wrap_index + 1 == visual_count;
+          const size_t visual_end = is_last_visual ? column_count : getVisualStartColumn(logical_line, wrap_index + 1);
+          const size_t segment_start = std::max(start_column, visual_start);
+          const size_t segment_end = std::min(end_column, visual_end);
+          // 空范围（例如缺少的分号）只在所在的视觉行输出，至少占一个空格的宽度
+          if (is_empty ? segment_start != start_column || (segment_start >= visual_end && !is_last_visual)
+                       : segment_start >= segment_end) {
+            continue;
+          }
+          const float origin_x = getColumnX(line, visual_start);
+          const float start_x = getColumnX(line, segment_start) - origin_x;
+          const float end_x = std::max(getColumnX(line, segment_end) - origin_x, start_x + (is_empty ? m_space_width_ : 0));
+          const float left = std::max(visible_left, (text_left + start_x) * scale - m_view_state_.scroll_x);
+          const float right = std::min(visible_right, (text_left + end_x) * scale - m_view_state_.scroll_x);
+          if (right <= left) {
+            continue;
+          }
+          const float y = (line_y + line_height * static_cast<float>(wrap_index + 1)) * scale;
+          model.diagnostics.push_back({diagnostic.severity, diagnostic.style, {left, y}, {right, y}});
+        }
+      }
+    }
+  }
+
+  void TextLayout::composeSelections(const Vector<Selection>& selections, size_t primary_index, EditorRenderModel& model) {
+    if (m_document_ == nullptr || selections.empty()) {
+      return;
+    }
+    primary_index = std::min(primary_index, selections.size() - 1);
+    model.cursor.position = getPositionPoint(selections[primary_index].caret);
+    if (m_last_first_line_ > m_last_last_line_) {
+      return;
+    }
+    // 选区的结束位置同样有序，二分找到第一个结束于首个可见行或之后的选区
+    auto selection = std::lower_bound(selections.begin(), selections.end(), m_last_first_line_,
+      [](const Selection& value, size_t line) { return value.range().end.line < line; });
+    for (; selection != selections.end() && selection->range().start.line <= m_last_last_line_; ++selection) {
+      if (!selection->isEmpty()) {
+        composeSelectionRects(selection->range(), model);
+      }
+    }
+    // 选区有序且互不重叠，光标位置同样有序，只转换可见行范围内的光标
+    auto it = std::lower_bound(selections.begin(), selections.end(), m_last_first_line_,
+      [](const Selection& selection, size_t line) { return selection.caret.line < line; });
+    for (; it != selections.end() && it->caret.line <= m_last_last_line_; ++it) {
+      if (static_cast<size_t>(it - selections.begin()) == primary_index || m_height_index_.isHidden(it->caret.line)) {
+        continue;
+      }
+      model.extra_cursors.push_back({getPositionPoint(it->caret)});
+    }
+  }
+
+  void TextLayout::composeSelectionRects(const TextRange& range, EditorRenderModel& model) {
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float scroll_y = m_view_state_.scroll_y / scale;
+    const float line_height = getDefaultLineHeight();
+    const float visible_left = text_left * scale;
+    const float visible_right = m_viewport_.width;
+    const size_t last_line = std::min(range.end.line, m_last_last_line_);
+    for (size_t line = m_height_index_.nextVisibleLine(std::max(range.start.line, m_last_first_line_));
+         line <= last_line; line = m_height_index_.nextVisibleLine(line + 1)) {
+      const LogicalLine& logical_line = ensureLineLayout(line);
+      const size_t column_count = logical_line.chunks.empty() ? logical_line.cached_text.length()
+        : logical_line.chunks.back().start_column + logical_line.chunks.back().columns;
+      size_t start_column = line == range.start.line ? std::min(range.start.column, column_count) : 0;
+      size_t end_column = line == range.end.line ? std::min(range.end.column, column_count) : column_count;
+      // 选区跨过行尾时在行末多画一个空格宽度表示换行符
+      const bool has_newline = line < range.end.line;
+      if (!logical_line.chunks.empty()) {
+        // 超长行先把列范围限制在视口内，避免转换视口外的块
+        const float left_x = m_view_state_.scroll_x / scale;
+        start_column = std::max(start_column, getColumnAtX(line, left_x));
+        end_column = std::min(end_column, getColumnAtX(line, left_x + visible_right / scale) + 1);
+        if (start_column > end_column) {
+          continue;
+        }
+      }
+      const float line_y = m_height_index_.getLineY(line) - scroll_y;
+      const size_t visual_count = logical_line.visual_lines.size();
+      for (size_t wrap_index = 0; wrap_index < visual_count; ++wrap_index) {
+        const size_t visual_start = getVisualStartColumn(logical_line, wrap_index);
+        const bool is_last_visual = wrap_index + 1 == visual_count;
+        const size_t visual_end = is_last_visual ? column_count : getVisualStartColumn(logical_line, wrap_index + 1);
+        const size_t segment_start = std::max(start_column, visual_start);
+        const size_t segment_end = std::min(end_column, visual_end);
+        const bool show_newline = is_last_visual && has_newline && segment_end == column_count;
+        if (segment_start > segment_end || (segment_start == segment_end && !show_newline)) {
+          continue;
+        }
+        const float origin_x = getColumnX(line, visual_start);
+        const float start_x = getColumnX(line, segment_start) - origin_x;
+        const float end_x = getColumnX(line, segment_end) - origin_x + (show_newline ? m_space_width_ : 0);
+        const float left = std::max(visible_left, (text_left + start_x) * scale - m_view_state_.scroll_x);
+        const float right = std::min(visible_right, (text_left + end_x) * scale - m_view_state_.scroll_x);
+        if (right <= left) {
+          continue;
+        }
+        const float top = (line_y + line_height * static_cast<float>(wrap_index)) * scale;
+        model.selection_rects.push_back({{left, top}, right - left, line_height * scale});
+      }
+    }
+  }
+
+  PointF TextLayout::getPositionPoint(const TextPosition& position) {
+    syncHeightIndex();
+    if (m_height_index_.size() == 0) {
+      return {};
+    }
+    const size_t line = std::min(position.line, m_height_index_.size() - 1);
+    const LogicalLine& logical_line = ensureLineLayout(line);
+    const size_t wrap_index = findWrapIndex(logical_line, position.column);
+    const float x = getColumnX(line, position.column) - getColumnX(line, getVisualStartColumn(logical_line, wrap_index));
+    const float y = m_height_index_.getLineY(line) + getDefaultLineHeight() * static_cast<float>(wrap_index);
+    const float scale = m_view_state_.scale;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    return {(text_left + x) * scale - m_view_state_.scroll_x, y * scale - m_view_state_.scroll_y};
+  }
+
+  void TextLayout::shiftFoldRanges(const Vector<TextChange>& changes) {
+    Vector<LineEdit> edits;
+    collectLineEdits(changes, edits);
+    // 每个折叠区域按变更前的行号二分查找相关的变更
+    auto find_before = [&edits](size_t line) { return findLineEditBefore(edits, line); };
+    // 被删除的行映射到变更起始行，之后的行整体平移
+    auto map_line = [&](size_t line) {
+      const LineEdit* edit = find_before(line);
+      if (edit == nullptr) {
+        return line;
+      }
+      return line <= edit->old_end ? edit->start : line - edit->old_end + edit->new_end;
+    };
+    size_t kept = 0;
+    for (FoldRange range : m_fold_ranges_) {
+      const LineEdit* header_edit = find_before(range.start_line);
+      const bool header_removed = header_edit != nullptr && range.start_line <= header_edit->old_end;
+      // 只修改首行内容时保持折叠，变更触及隐藏的行时自动展开
+      bool touched = false;
+      auto it = std::lower_bound(edits.begin(), edits.end(), range.start_line,
+        [](const LineEdit& edit, size_t value) { return edit.old_end < value; });
+      for (; it != edits.end() && it->old_start <= range.end_line; ++it) {
+        if (!(it->is_single_line && it->old_start == range.start_line)) {
+          touched = true;
+          break;
+        }
+      }
+      if (range.collapsed && (header_removed || touched)) {
+        m_height_index_.setLinesHidden(range.start_line + 1, range.end_line + 1, false);
+        range.collapsed = false;
+      }
+      range.start_line = map_line(range.start_line);
+      range.end_line = map_line(range.end_line);
+      if (header_removed || range.end_line <= range.start_line) {
+        continue;
+      }
+      m_fold_ranges_[kept++] = range;
+    }
+    m_fold_ranges_.resize(kept);
+  }
+
+  bool TextLayout::isFoldHeader(size_t line) const {
+    auto it = std::lower_bound(m_fold_ranges_.begin(), m_fold_ranges_.end(), line,
+      [](const FoldRange& range, size_t value) { return range.start_line < value; });
+    for (; it != m_fold_ranges_.end() && it->start_line == line; ++it) {
+      if (it->collapsed) {
+        return true;
+      }
+    }
+    return false;
   }
 
   VisibleLineInfo TextLayout::computeVisibleLineInfo() {
-    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
-    if (logical_lines.empty()) {
+    syncHeightIndex();
+    const size_t line_count = m_height_index_.size();
+    if (line_count == 0) {
       return {};
     }
-    size_t first_line = 0;
-    size_t last_line = logical_lines.size() - 1;
-    float first_y = 0;
-    float current_y = 0;
-    const size_t size = logical_lines.size();
-    for (size_t i = 0; i < size; ++i) {
-      LogicalLine& logical_line = logical_lines[i];
-      layoutLine(i, logical_line);
-      if (current_y + logical_line.height > m_view_state_.scroll_y) {
-        first_line = i;
-        first_y = current_y - m_view_state_.scroll_y;
-        current_y += logical_line.height;
+    Vector<LogicalLine>& logical_lines = m_document_->getLogicalLines();
+    // 新进入视口却还没有布局的行需要同步布局，记为预布局未命中
+    uint64_t miss_count = 0;
+    auto layout_visible_line = [&](size_t line) {
+      if (!isLayoutValid(logical_lines[line])) {
+        if (line < m_last_first_line_ || line > m_last_last_line_) {
+          ++miss_count;
+        }
+        layoutLine(line, logical_lines[line]);
+      }
+    };
+    // 滚动距离是缩放后的视口坐标，换算为未缩放的文档坐标再查询
+    const float scroll_y = m_view_state_.scroll_y / m_view_state_.scale;
+    // 通过高度索引定位首个可见行；布局后行高可能变化，定位结果稳定后再继续
+    size_t first_line = m_height_index_.getLineAtY(scroll_y);
+    for (int attempt = 0; attempt < 3; ++attempt) {
+      layout_visible_line(first_line);
+      const size_t located_line = m_height_index_.getLineAtY(scroll_y);
+      if (located_line == first_line) {
         break;
       }
+      first_line = located_line;
     }
-    for (size_t i = first_line + 1; i < size; ++i) {
-      LogicalLine& logical_line = logical_lines[i];
-      layoutLine(i, logical_line);
-      if (current_y + logical_line.height > m_view_state_.scroll_y + m_viewport_.height) {
-        last_line = i;
+    const float first_y = m_height_index_.getLineY(first_line);
+    const float visible_bottom = scroll_y + m_viewport_.height / m_view_state_.scale;
+    float current_y = first_y;
+    size_t last_line = first_line;
+    // 不在上一帧可见范围内的行都是新进入视口的行，折叠隐藏的行直接跳过
+    size_t new_lines = 0;
+    for (size_t i = first_line; i < line_count; i = m_height_index_.nextVisibleLine(i + 1)) {
+      layout_visible_line(i);
+      last_line = i;
+      if (i < m_last_first_line_ || i > m_last_last_line_) {
+        ++new_lines;
+      }
+      current_y += m_height_index_.getHeight(i);
+      if (current_y > visible_bottom) {
         break;
       }
-      current_y += logical_line.height;
     }
-    return {first_line, last_line, first_y};
+    miss_count = std::min<uint64_t>(miss_count, new_lines);
+    m_prefetch_stats_.miss_count += miss_count;
+    m_prefetch_stats_.hit_count += new_lines - miss_count;
+    m_last_first_line_ = first_line;
+    m_last_last_line_ = last_line;
+    return {first_line, last_line, first_y - scroll_y};
+  }
+
+  void TextLayout::invalidateLayouts() {
+    ++m_layout_epoch_;
+  }
+
+  void TextLayout::updateTextArea() {
+    // 计算行号宽度
+    m_params_.line_number_width = computeLineNumberWidth();
+    // 缩放手势结束后才按新的视口宽度重新断行，缩放过程中沿用原有断行位置
+    if (!m_is_scaling_) {
+      updateWrapWidth();
+    }
+  }
+
+  void TextLayout::updateWrapWidth() {
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    const float wrap_width = std::max(0.0f, m_viewport_.width / m_view_state_.scale - text_left);
+    if (wrap_width == m_wrap_width_) {
+      return;
+    }
+    m_wrap_width_ = wrap_width;
+    // 不换行时断行宽度不影响布局
+    if (m_wrap_mode_ != WrapMode::NONE) {
+      invalidateLayouts();
+    }
+  }
+
+  size_t TextLayout::findWrapColumn(const LogicalLine& logical_line, size_t start_column) const {
+    const Vector<float>& prefix_widths = logical_line.prefix_widths;
+    const U16String& line_text = logical_line.cached_text;
+    const size_t length = line_text.length();
+    // 最后一个右边界不超过断行宽度的列（视觉行从起始列的镶嵌内容之前开始）
+    const float limit = getCaretX(logical_line, start_column) + m_wrap_width_;
+    size_t end_column = std::upper_bound(prefix_widths.begin() + start_column + 1, prefix_widths.end(), limit) - prefix_widths.begin() - 1;
+    if (end_column >= length) {
+      return length;
+    }
+    // 每个视觉行至少容纳一个字素簇，且不会从字素簇中间断开
+    const Vector<uint64_t>& cluster_bits = logical_line.cluster_bits;
+    end_column = Grapheme::floorBoundary(line_text, cluster_bits, end_column);
+    if (end_column <= start_column) {
+      end_column = Grapheme::nextBoundary(line_text, cluster_bits, start_column);
+    }
+    if (m_wrap_mode_ == WrapMode::WORD_BREAK) {
+      // 优先在空白之后断开，整段没有空白时退化为按字符断行
+      for (size_t column = end_column; column > start_column + 1; --column) {
+        const U16Char ch = line_text[column - 1];
+        if ((ch == CHAR16(' ') || ch == CHAR16('\t')) && Grapheme::isBoundary(line_text, cluster_bits, column)) {
+          return column;
+        }
+      }
+    }
+    return end_column;
   }
 
-  void TextLayout::cropVisualLineRuns(VisualLine& visual_line) {
-    float first_x = m_params_.line_number_margin * 2 + m_params_.line_number_width;
-    float current_x = first_x;
-    bool has_crop_start = false;
+  void TextLayout::cropVisualLineRuns(const LogicalLine& logical_line, VisualLine& visual_line) {
+    const Vector<float>& prefix_widths = logical_line.prefix_widths;
+    const U16String& line_text = logical_line.cached_text;
+    const float text_left = m_params_.line_number_margin * 2 + m_params_.line_number_width;
+    // 可见范围换算为未缩放的、相对文本区域左侧的坐标
+    const float visible_left = m_view_state_.scroll_x / m_view_state_.scale;
+    const float visible_right = (m_view_state_.scroll_x + m_viewport_.width) / m_view_state_.scale - text_left;
     auto run_it = visual_line.runs.begin();
-    auto run_it_end = visual_line.runs.end();
-    while (run_it != run_it_end) {
+    while (run_it != visual_line.runs.end()) {
       VisualRun& run = *run_it;
-      run.x = current_x - first_x;
-      const U16String& run_text = getTextById(run.text_id);
-      auto text_begin = run_text.begin();
-      auto text_end = run_text.end();
-      size_t start_u16_index = 0;
-      size_t end_u16_index = run_text.length() - 1;
-      size_t current_u16_index = 0;
-      while (text_begin != text_end) {
-        auto char_start = text_begin;
-        utf8::next16(text_begin, text_end);
-        U16String u16_char_text(char_start, text_begin);
-        float char_width = measureWidth(u16_char_text, false);
-        if (!has_crop_start && current_x + char_width > m_view_state_.scroll_x) {
-          start_u16_index = current_u16_index;
-          first_x = current_x;
-          run.x = current_x;
-          current_u16_index += u16_char_text.length();
-          has_crop_start = true;
-        } else if (current_x + char_width > m_view_state_.scroll_x + m_viewport_.width) {
-          end_u16_index = current_u16_index;
-          current_x += char_width;
-          current_u16_index += u16_char_text.length();
-          break;
+      if (run.type == VisualRunType::INLAY_HINT || run.type == VisualRunType::PHANTOM_TEXT) {
+        // 镶嵌片段整体保留或丢弃，布局缓存中的text_id是镶嵌内容下标
+        const int64_t inlay_index = run.text_id;
+        const float width = logical_line.inlay_boxes[inlay_index].width;
+        if (run.x >= visible_right || run.x + width <= visible_left) {
+          run_it = visual_line.runs.erase(run_it);
+          continue;
         }
-        current_x += char_width;
-        current_u16_index += u16_char_text.length();
+        run.text_id = logical_line.inlay_boxes[inlay_index].text.empty() ? -1
+          : createFrameTextId(visual_line.logical_line, run.column, 0, inlay_index);
+        ++run_it;
+        continue;
+      }
+      const size_t run_end = run.column + run.length;
+      const bool is_whitespace = run.type == VisualRunType::WHITESPACE || run.type == VisualRunType::TAB;
+      if (is_whitespace && !m_params_.show_whitespace) {
+        run_it = visual_line.runs.erase(run_it);
+        continue;
       }
-      if (end_u16_index == 0) {
+      // 片段起点在视觉行中的横坐标与逻辑行前缀宽度之差（自动换行时不为0）
+      const float run_offset = run.x - prefix_widths[run.column];
+      const float run_left = visible_left - run_offset;
+      const float run_right = visible_right - run_offset;
+      if (run.length == 0 || prefix_widths[run_end] <= run_left || prefix_widths[run.column] >= run_right) {
         run_it = visual_line.runs.erase(run_it);
         continue;
-      } else if (start_u16_index > 0 || end_u16_index < run_text.length() - 1) {
-        removeTextId(run.text_id);
-        U16String visible_text = run_text.substr(start_u16_index, end_u16_index - start_u16_index);
-        run.text_id = createTextId(visible_text);
       }
+      auto column_begin = prefix_widths.begin() + run.column;
+      auto column_end = prefix_widths.begin() + run_end + 1;
+      // 第一个右边界越过视口左侧的列
+      size_t start_column = std::upper_bound(column_begin + 1, column_end, run_left) - prefix_widths.begin() - 1;
+      start_column = std::max(run.column, Grapheme::floorBoundary(line_text, logical_line.cluster_bits, start_column));
+      // 第一个左边界越过视口右侧的列
+      size_t end_column = std::lower_bound(column_begin, column_end, run_right) - prefix_widths.begin();
+      end_column = std::min(end_column, run_end);
+      run.x = run_offset + prefix_widths[start_column];
+      run.column = start_column;
+      run.length = end_column - start_column;
+      // 空白片段按长度绘制，不需要文本
+      run.text_id = is_whitespace ? -1 : createFrameTextId(visual_line.logical_line, run.column, run.length);
       ++run_it;
     }
   }
@@ -1,12 +1,36 @@
 //
 // Created by Scave on 2025/12/6.
 //
+#include <algorithm>
 #include <chrono>
 #include <cstdarg>
 #include <simdutf/simdutf.h>
 #include "utility.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWEETEDITOR_SSE2 1
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define SWEETEDITOR_NEON 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace NS_SWEETEDITOR {
+#ifdef SWEETEDITOR_SSE2
+  static inline uint32_t countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+#endif
+
   // ======================================== TimeUtil =================================================
   int64_t TimeUtil::milliTime() {
     auto now = std::chrono::high_resolution_clock::now();
@@ -64,14 +88,86 @@ namespace NS_SWEETEDITOR {
     simdutf::convert_utf16_to_utf8(CHAR16_PTR(utf16_str.c_str()), utf16_str.length(), result.data());
   }
 
-  U16Char* StrUtil::allocU16Chars(const U16String& utf16_str) {
+  U16Char* StrUtil::allocU16Chars(U16StringView utf16_str) {
     size_t length = utf16_str.length();
     U16Char* result = new U16Char[length + 1];
-#ifdef _MSC_VER
-    wcscpy_s(result, length + 1, utf16_str.c_str());
-#else
-    std::wcscpy(result, utf16_str.c_str());
-#endif
+    // 视图不保证以0结尾，按长度拷贝
+    std::char_traits<U16Char>::copy(result, utf16_str.data(), length);
+    result[length] = 0;
     return result;
   }
+
+  size_t StrUtil::copyU16Chars(U16StringView utf16_str, U16Char* buffer, size_t capacity) {
+    const size_t length = utf16_str.length();
+    if (buffer == nullptr) {
+      return length;
+    }
+    std::char_traits<U16Char>::copy(buffer, utf16_str.data(), std::min(length, capacity));
+    if (length < capacity) {
+      buffer[length] = 0;
+    }
+    return length;
+  }
+
+  size_t StrUtil::findWhitespace(const U16Char* text, size_t length, size_t start) {
+    size_t index = start;
+#if defined(SWEETEDITOR_SSE2)
+    const __m128i spaces = _mm_set1_epi16(0x20);
+    const __m128i tabs = _mm_set1_epi16(0x09);
+    for (; index + 8 <= length; index += 8) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index));
+      const __m128i matched = _mm_or_si128(_mm_cmpeq_epi16(chunk, spaces), _mm_cmpeq_epi16(chunk, tabs));
+      const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matched));
+      if (mask != 0) {
+        // 每个编码单元占掩码中的2位
+        return index + countTrailingZeros(mask) / 2;
+      }
+    }
+#elif defined(SWEETEDITOR_NEON)
+    const uint16x8_t spaces = vdupq_n_u16(0x20);
+    const uint16x8_t tabs = vdupq_n_u16(0x09);
+    for (; index + 8 <= length; index += 8) {
+      const uint16x8_t chunk = vld1q_u16(reinterpret_cast<const uint16_t*>(text + index));
+      const uint16x8_t matched = vorrq_u16(vceqq_u16(chunk, spaces), vceqq_u16(chunk, tabs));
+      if (vmaxvq_u16(matched) != 0) {
+        // 命中的块交给下面的逐个比较定位
+        break;
+      }
+    }
+#endif
+    for (; index < length; ++index) {
+      if (text[index] == CHAR16(' ') || text[index] == CHAR16('\t')) {
+        return index;
+      }
+    }
+    return length;
+  }
+
+  size_t StrUtil::skipChar(const U16Char* text, size_t length, size_t start, U16Char ch) {
+    size_t index = start;
+#if defined(SWEETEDITOR_SSE2)
+    const __m128i target = _mm_set1_epi16(static_cast<short>(ch));
+    for (; index + 8 <= length; index += 8) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index));
+      const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(chunk, target))) & 0xFFFF;
+      if (mask != 0) {
+        return index + countTrailingZeros(mask) / 2;
+      }
+    }
+#elif defined(SWEETEDITOR_NEON)
+    const uint16x8_t target = vdupq_n_u16(static_cast<uint16_t>(ch));
+    for (; index + 8 <= length; index += 8) {
+      const uint16x8_t chunk = vld1q_u16(reinterpret_cast<const uint16_t*>(text + index));
+      if (vminvq_u16(vceqq_u16(chunk, target)) == 0) {
+        break;
+      }
+    }
+#endif
+    for (; index < length; ++index) {
+      if (text[index] != ch) {
+        return index;
+      }
+    }
+    return length;
+  }
 }
@@ -16,6 +16,8 @@ namespace NS_SWEETEDITOR {
       return "INLAY_HINT";
     case VisualRunType::PHANTOM_TEXT:
       return "PHANTOM_TEXT";
+    case VisualRunType::TAB:
+      return "TAB";
     default:
       return "UNDEFINED";
     }
@@ -38,7 +40,8 @@ namespace NS_SWEETEDITOR {
   }
 
   U8String VisualLine::dump() const {
-    U8String result = "VisualLine {logical_line = " + std::to_string(logical_line) + ", runs = [";
+    U8String result = "VisualLine {logical_line = " + std::to_string(logical_line)
+      + ", is_folded = " + std::to_string(is_folded) + ", runs = [";
     for (const VisualRun& run : runs) {
       result += "\n  ";
       result += run.dump();
@@ -63,7 +66,29 @@ namespace NS_SWEETEDITOR {
 
   U8String EditorRenderModel::toJson() const {
     nlohmann::json root = *this;
-    return root.dump(2);
+    return root.dump();
+  }
+
+  bool VisualLineKey::operator<(const VisualLineKey& other) const {
+    if (logical_line != other.logical_line) return logical_line < other.logical_line;
+    return wrap_index < other.wrap_index;
+  }
+
+  bool VisualLineKey::operator==(const VisualLineKey& other) const {
+    return logical_line == other.logical_line && wrap_index == other.wrap_index;
+  }
+
+  U8String EditorRenderDelta::dump() const {
+    return "EditorRenderDelta {sequence = " + std::to_string(sequence) + ", base_sequence = " + std::to_string(base_sequence)
+      + ", added = " + std::to_string(added_lines.size()) + ", changed = " + std::to_string(changed_lines.size())
+      + ", shifted = " + std::to_string(shifted_lines.size()) + ", removed = " + std::to_string(removed_lines.size())
+      + ", line_shift_start = " + std::to_string(line_shift_start) + ", line_shift = " + std::to_string(line_shift)
+      + ", cursor = " + cursor.dump() + "}";
+  }
+
+  U8String EditorRenderDelta::toJson() const {
+    nlohmann::json root = *this;
+    return root.dump();
   }
 
   U8String EditorParams::toJson() const {
@@ -5,6 +5,7 @@
 #ifndef SWEETEDITOR_C_API_H
 #define SWEETEDITOR_C_API_H
 #include <cstdint>
+#include "macro.h"
 
 #if defined(WINDOWS) || defined(_WIN32) || defined(_WIN64)
   #ifdef SWEETEDITOR_EXPORT
@@ -12,14 +13,18 @@
   #else
     #define EDITOR_API __declspec(dllimport)
   #endif
+  #define EDITOR_CALLBACK __stdcall
 #else
   #define EDITOR_API __attribute__((visibility("default")))
+  #define EDITOR_CALLBACK
 #endif
 
 extern "C" {
 
-typedef float (__stdcall* MeasureTextWidth)(const U16Char* text, uint32_t style_id);
-typedef void (__stdcall* GetFontMetrics)(float* arr, size_t length);
+typedef float (EDITOR_CALLBACK* MeasureTextWidth)(const U16Char* text, uint32_t style_id);
+typedef void (EDITOR_CALLBACK* GetFontMetrics)(float* arr, size_t length);
+typedef void (EDITOR_CALLBACK* HighlightReady)(intptr_t editor_handle);
+typedef void (EDITOR_CALLBACK* TextChunkReceiver)(intptr_t editor_handle, const char* data, size_t length);
 
 /// 创建Document类并返回其句柄
 /// @param text UTF16文本内容
@@ -51,6 +56,14 @@ EDITOR_API size_t get_document_line_count(intptr_t document_handle);
 /// @return 指定行的UTF8文本内容
 EDITOR_API const U16Char* get_document_line_text(intptr_t document_handle, size_t line);
 
+/// 将指定行的UTF16文本拷贝到调用方提供的内存（不分配内存）
+/// @param document_handle Document句柄
+/// @param line 行号
+/// @param buffer 调用方提供的内存，容量足够时会在末尾写入0
+/// @param capacity 内存容量（UTF16编码单元数）
+/// @return 该行文本的UTF16长度，大于capacity时仅拷贝capacity个编码单元
+EDITOR_API size_t copy_document_line_text(intptr_t document_handle, size_t line, U16Char* buffer, size_t capacity);
+
 /// 创建EditorCore类并返回其句柄
 /// @param touch_slop 单击移动的阈值
 /// @param double_tap_timeout 手势判定双击点击的时间差
@@ -86,17 +99,194 @@ EDITOR_API const U16Char* handle_editor_gesture_event(intptr_t editor_handle, ui
 /// @param editor_handle EditorCore句柄
 EDITOR_API void reset_editor_text_measurer(intptr_t editor_handle);
 
-/// 构建editor一帧的渲染模型
+/// 构建editor一帧的渲染模型（JSON格式，仅用于调试，渲染请使用 build_editor_render_model_binary）
 /// @param editor_handle EditorCore句柄
 /// @return 渲染模型（以JSON格式呈现）
 EDITOR_API const U16Char* build_editor_render_model(intptr_t editor_handle);
 
+/// 构建editor一帧的增量渲染模型（JSON格式，仅用于调试，渲染请使用 build_editor_render_delta_binary）
+/// @param editor_handle EditorCore句柄
+/// @param base_sequence 平台侧当前持有的帧序号（首次调用或需要全量时传0）
+/// @return 增量渲染模型（以JSON格式呈现）
+EDITOR_API const U16Char* build_editor_render_delta(intptr_t editor_handle, uint64_t base_sequence);
+
+/// 构建editor一帧的渲染模型，以紧凑二进制格式写入调用方提供的内存（格式见 codec.h）
+/// @param editor_handle EditorCore句柄
+/// @param buffer 调用方提供的内存
+/// @param capacity 内存容量
+/// @return 完整数据所需字节数，大于capacity时数据无效，需扩大内存后重新调用
+EDITOR_API size_t build_editor_render_model_binary(intptr_t editor_handle, uint8_t* buffer, size_t capacity);
+
+/// 构建editor一帧的增量渲染模型，以紧凑二进制格式写入调用方提供的内存（格式见 codec.h）
+/// @param editor_handle EditorCore句柄
+/// @param base_sequence 平台侧当前持有的帧序号（首次调用或需要全量时传0）
+/// @param buffer 调用方提供的内存
+/// @param capacity 内存容量
+/// @return 完整数据所需字节数，大于capacity时数据无效，需扩大内存后以原base_sequence重新调用（将得到全量数据）
+EDITOR_API size_t build_editor_render_delta_binary(intptr_t editor_handle, uint64_t base_sequence, uint8_t* buffer, size_t capacity);
+
 /// 获取指定ID的视觉文本
 /// @param editor_handle EditorCore句柄
 /// @param run_text_id 文本ID（渲染模型中的ID）
 /// @return UTF8文本
 EDITOR_API const U16Char* get_editor_visual_run_text(intptr_t editor_handle, int64_t run_text_id);
 
+/// 将指定ID的视觉文本拷贝到调用方提供的内存（不分配内存）
+/// @param editor_handle EditorCore句柄
+/// @param run_text_id 文本ID（渲染模型中的ID）
+/// @param buffer 调用方提供的内存，容量足够时会在末尾写入0
+/// @param capacity 内存容量（UTF16编码单元数）
+/// @return 文本的UTF16长度，大于capacity时仅拷贝capacity个编码单元
+EDITOR_API size_t copy_editor_visual_run_text(intptr_t editor_handle, int64_t run_text_id, U16Char* buffer, size_t capacity);
+
+/// 注册平台侧持有的帧缓冲内存，核心按轮转顺序写入二进制渲染数据，不再分配任何内存
+/// 每块内存的布局：u32 state, u32 data_size, u64 sequence，之后是二进制渲染数据（格式见 codec.h）
+/// state：0 空闲，1 写入中，2 就绪，3 容量不足（data_size为所需字节数）；平台读取完毕后将state写回0或调用release_editor_frame
+/// @param editor_handle EditorCore句柄
+/// @param buffers 每块内存的起始地址，一般2~3块；起始地址必须4字节对齐（state按32位原子变量访问），
+///                未对齐或容量小于16字节头部的内存块会被忽略，JNI/托管内存需使用对齐的直接缓冲区或固定后的对齐地址
+/// @param capacities 每块内存的字节容量
+/// @param count 内存块数量
+EDITOR_API void set_editor_frame_buffers(intptr_t editor_handle, uint8_t** buffers, const size_t* capacities, uint32_t count);
+
+/// 构建一帧并写入下一个空闲的帧缓冲
+/// @param editor_handle EditorCore句柄
+/// @param base_sequence 为0时写入全量渲染模型，否则写入相对该帧的增量渲染模型
+/// @return 写入的帧缓冲下标，没有空闲帧缓冲时返回-1
+EDITOR_API int32_t build_editor_frame(intptr_t editor_handle, uint64_t base_sequence);
+
+/// 将帧缓冲归还为空闲状态
+/// @param editor_handle EditorCore句柄
+/// @param index 帧缓冲下标
+EDITOR_API void release_editor_frame(intptr_t editor_handle, int32_t index);
+
+/// 在平台空闲回调中沿滚动方向预布局接下来的若干屏，可以分批多次调用
+/// @param editor_handle EditorCore句柄
+/// @param max_lines 本次最多布局的行数
+/// @return 实际布局的行数，为0时表示预布局区域已经全部就绪
+EDITOR_API size_t prefetch_editor_layout(intptr_t editor_handle, size_t max_lines);
+
+/// 获取预布局的命中统计
+/// @param editor_handle EditorCore句柄
+/// @param stats 调用方提供的数组，依次写入：新进入视口时已布局的行数、需要同步布局的行数、预布局完成的行数
+/// @param length 数组长度
+EDITOR_API void get_editor_prefetch_stats(intptr_t editor_handle, uint64_t* stats, size_t length);
+
+/// 切换主题，整体替换所有高亮样式；只有加粗、斜体变化的样式会导致重新布局
+/// @param editor_handle EditorCore句柄
+/// @param styles 每个样式依次为3个uint32：样式ID、颜色值、字体标志（bit0加粗，bit1斜体）
+/// @param count 样式个数
+EDITOR_API void set_editor_styles(intptr_t editor_handle, const uint32_t* styles, size_t count);
+
+/// 按LSP semantic tokens的相对编码批量设置高亮Span，替换start_line及之后所有行的Span
+/// @param editor_handle EditorCore句柄
+/// @param start_line 起始行号，第一个Span的行差相对该行
+/// @param packed 每个Span依次为5个uint32：行差、列差（同一行内相对上一个Span的起始列，否则为绝对列）、长度（UTF16）、样式ID、修饰符（保留）
+/// @param count Span个数
+EDITOR_API void set_editor_style_spans(intptr_t editor_handle, size_t start_line, const uint32_t* packed, size_t count);
+
+/// 对上一次set_editor_style_spans的编码数据应用LSP semantic tokens delta编辑
+/// @param editor_handle EditorCore句柄
+/// @param edits 每个编辑依次为：起始下标、删除的uint32个数、插入的uint32个数，之后紧跟插入的数据；编辑按起始下标升序，下标相对编辑前的数据
+/// @param length edits的uint32个数
+/// @return 成功返回1，编辑格式无效时返回0（Span保持不变，需要重新全量设置）
+EDITOR_API int32_t apply_editor_style_span_edits(intptr_t editor_handle, const uint32_t* edits, size_t length);
+
+/// 批量替换[start_line, start_line + line_count)范围内的镶嵌内容，范围内没有镶嵌内容的行被清除，只有变化的行重新布局
+/// @param editor_handle EditorCore句柄
+/// @param start_line 起始行号
+/// @param line_count 替换的行数
+/// @param packed 每个镶嵌内容依次为5个uint32：行号、列、类型（0文本，1图标）、图标ID、文本的UTF8字节数
+/// @param count 镶嵌内容个数
+/// @param texts 所有镶嵌文本按顺序拼接的UTF8数据
+/// @param texts_length texts的字节数，文本长度之和超出时整个调用被忽略
+EDITOR_API void set_editor_inlay_hints(intptr_t editor_handle, size_t start_line, size_t line_count,
+  const uint32_t* packed, size_t count, const char* texts, size_t texts_length);
+
+/// 批量替换[start_line, start_line + line_count)范围内的幽灵文本，范围内没有幽灵文本的行被清除
+/// @param editor_handle EditorCore句柄
+/// @param start_line 起始行号
+/// @param line_count 替换的行数
+/// @param packed 每个幽灵文本依次为3个uint32：行号、列、文本的UTF8字节数
+/// @param count 幽灵文本个数
+/// @param texts 所有幽灵文本按顺序拼接的UTF8数据
+/// @param texts_length texts的字节数，文本长度之和超出时整个调用被忽略
+EDITOR_API void set_editor_phantom_texts(intptr_t editor_handle, size_t start_line, size_t line_count,
+  const uint32_t* packed, size_t count, const char* texts, size_t texts_length);
+
+/// 整体替换所有诊断信息
+/// @param editor_handle EditorCore句柄
+/// @param packed 每个诊断依次为6个uint32：起始行、起始列、结束行、结束列、严重程度（1-4，同LSP）、下划线样式（0波浪线，1直线，2虚线）
+/// @param count 诊断个数
+EDITOR_API void set_editor_diagnostics(intptr_t editor_handle, const uint32_t* packed, size_t count);
+
+/// 设置所有光标和选区
+/// @param editor_handle EditorCore句柄
+/// @param packed 每个选区依次为4个uint32：固定端行、固定端列、光标行、光标列
+/// @param count 选区个数
+/// @param primary_index 主光标的下标
+EDITOR_API void set_editor_selections(intptr_t editor_handle, const uint32_t* packed, size_t count, size_t primary_index);
+
+/// 在所有光标处输入文本（替换选中的文本），作为一次批量编辑提交
+/// @param editor_handle EditorCore句柄
+/// @param text UTF8文本
+EDITOR_API void editor_insert_text(intptr_t editor_handle, const char* text);
+
+/// 在所有光标处向前删除
+/// @param editor_handle EditorCore句柄
+EDITOR_API void editor_delete_backward(intptr_t editor_handle);
+
+/// 选中全部文本
+/// @param editor_handle EditorCore句柄
+EDITOR_API void editor_select_all(intptr_t editor_handle);
+
+/// 复制所有选区的文本，文本按块依次回调（数据仅在回调期间有效），不会一次性拼接整个选区
+/// @param editor_handle EditorCore句柄
+/// @param receiver 接收每块UTF8数据的回调
+EDITOR_API void copy_editor_selected_text(intptr_t editor_handle, TextChunkReceiver receiver);
+
+/// 滚动到指定行
+/// @param editor_handle EditorCore句柄
+/// @param line 行号
+/// @param behavior 滚动的形式（0顶部，1居中，2底部）
+EDITOR_API void editor_scroll_to_line(intptr_t editor_handle, size_t line, uint8_t behavior);
+
+/// 平滑滚动到指定行，之后每一帧调用 update_editor_scroll_animation 推进动画
+/// @param editor_handle EditorCore句柄
+/// @param line 行号
+/// @param behavior 滚动的形式（0顶部，1居中，2底部）
+/// @param duration_ms 动画时长（毫秒）
+EDITOR_API void editor_smooth_scroll_to_line(intptr_t editor_handle, size_t line, uint8_t behavior, int64_t duration_ms);
+
+/// 推进平滑滚动动画
+/// @param editor_handle EditorCore句柄
+/// @return 动画还在进行时返回1，平台需要继续请求下一帧
+EDITOR_API int32_t update_editor_scroll_animation(intptr_t editor_handle);
+
+/// 设置语法高亮规则
+/// @param editor_handle EditorCore句柄
+/// @param grammar_json 语法定义JSON：{"states": [{"name", "style_id", "rules": [{"pattern", "style_id", "pop", "push"}]}]}
+/// @return 成功返回1，JSON或正则无效时返回0
+EDITOR_API int32_t set_editor_grammar(intptr_t editor_handle, const char* grammar_json);
+
+/// 设置后台高亮有新结果时的回调，回调在后台线程中执行，平台需要切换到UI线程后重新构建渲染模型
+/// @param editor_handle EditorCore句柄
+/// @param callback 回调，传入editor_handle
+EDITOR_API void set_editor_highlight_callback(intptr_t editor_handle, HighlightReady callback);
+
+/// 设置折叠区域（替换原有的所有区域）
+/// @param editor_handle EditorCore句柄
+/// @param ranges 每个区域依次为：首行、末行（包含）、是否已折叠（0或1）
+/// @param count 区域个数
+EDITOR_API void set_editor_fold_ranges(intptr_t editor_handle, const uint32_t* ranges, size_t count);
+
+/// 折叠或展开以指定行为首行的区域
+/// @param editor_handle EditorCore句柄
+/// @param line 折叠区域首行
+/// @param collapsed 1折叠，0展开
+/// @return 折叠状态发生变化时返回1，否则返回0
+EDITOR_API int32_t set_editor_fold_collapsed(intptr_t editor_handle, size_t line, int32_t collapsed);
+
 /// 获取编辑器的渲染参数
 /// @param editor_handle EditorCore句柄
 /// @return 渲染参数JSON
@@ -0,0 +1,163 @@
+//
+// Created by Scave on 2025/12/16.
+//
+
+#ifndef SWEETEDITOR_CODEC_H
+#define SWEETEDITOR_CODEC_H
+
+#include <atomic>
+#include <cstdint>
+#include "visual.h"
+#include "layout.h"
+
+namespace NS_SWEETEDITOR {
+  /// 二进制渲染数据的魔数（小端序字节为 "SERM"）
+  constexpr uint32_t kRenderBinaryMagic = 0x4D524553;
+  /// 二进制渲染数据的格式版本
+  constexpr uint16_t kRenderBinaryVersion = 7;
+  /// 二进制渲染数据头部字节数
+  constexpr size_t kRenderBinaryHeaderSize = 16;
+
+  /// 二进制渲染数据的内容类型
+  enum struct RenderBinaryKind : uint16_t {
+    /// 全量渲染模型 EditorRenderModel
+    MODEL = 1,
+    /// 增量渲染模型 EditorRenderDelta
+    DELTA = 2,
+  };
+
+  /// 小端序紧凑二进制写入器，直接写入调用方提供的内存；空间不足时停止写入但继续统计所需字节数
+  class BinaryWriter {
+  public:
+    BinaryWriter(uint8_t* buffer, size_t capacity);
+
+    void writeU8(uint8_t value);
+    void writeU16(uint16_t value);
+    void writeU32(uint32_t value);
+    void writeU64(uint64_t value);
+    void writeF32(float value);
+    void writePoint(const PointF& point);
+    /// 写入UTF16文本（u32长度 + UTF16编码单元）
+    void writeU16Text(U16StringView text);
+    /// 回填之前写入位置的u32
+    void patchU32(size_t offset, uint32_t value);
+
+    /// 完整写入所需的字节数
+    size_t size() const;
+    /// 是否超出了缓冲区容量
+    bool isOverflow() const;
+  private:
+    uint8_t* m_buffer_;
+    size_t m_capacity_;
+    size_t m_size_ {0};
+
+    void writeBytes(const uint8_t* bytes, size_t length);
+  };
+
+  /// 渲染模型的二进制编码器
+  ///
+  /// 格式（全部小端序、无对齐填充）：
+  /// - 头部16字节：u32 magic, u16 version, u16 kind, u32 total_size, u32 reserved
+  /// - VisualRun：u8 type, u32 column, u32 length, f32 x, f32 y, u32 style_id, u32 text_length, u16[text_length] text
+  /// - VisualLine：u32 logical_line, u32 wrap_index, f32 x2 line_number_position, u8 is_folded, u32 run_count, VisualRun[run_count]
+  /// - Cursor：f32 x2 position, u8 show_dragger
+  /// - GuideLine：u8 direction, f32 x2 start, f32 x2 end
+  /// - DiagnosticSegment：u8 severity, u8 style, f32 x2 start, f32 x2 end
+  /// - SelectionRect：f32 x2 origin, f32 width, f32 height
+  /// - MODEL：u64 sequence, f32 split_x, f32 x2 current_line, Cursor, u32 extra_cursor_count, Cursor[], u32 line_count, VisualLine[],
+  ///   u32 guide_count, GuideLine[], u32 diagnostic_count, DiagnosticSegment[], u32 selection_count, SelectionRect[]
+  /// - DELTA：u64 sequence, u64 base_sequence, f32 split_x, f32 x2 current_line, Cursor, u32 extra_cursor_count, Cursor[],
+  ///   u32 count + VisualLine[] added, u32 count + VisualLine[] changed,
+  ///   u32 count + (u32 logical_line, u32 wrap_index, f32 offset_x, f32 offset_y)[] shifted,
+  ///   u32 count + (u32 logical_line, u32 wrap_index)[] removed, u32 line_shift_start, i32 line_shift, u32 guide_count, GuideLine[],
+  ///   u32 diagnostic_count, DiagnosticSegment[], u32 selection_count, SelectionRect[]
+  ///
+  /// 与JSON不同，片段文本直接内联在数据中，平台无需再按text_id逐个获取
+  class RenderModelEncoder {
+  public:
+    explicit RenderModelEncoder(const TextLayout& text_layout);
+
+    /// 编码全量渲染模型
+    /// @param model 渲染模型
+    /// @param buffer 调用方提供的内存
+    /// @param capacity 内存容量
+    /// @return 完整编码所需字节数，大于capacity时缓冲区中的数据无效
+    size_t encode(const EditorRenderModel& model, uint8_t* buffer, size_t capacity) const;
+
+    /// 编码增量渲染模型
+    /// @param delta 增量渲染模型
+    /// @param buffer 调用方提供的内存
+    /// @param capacity 内存容量
+    /// @return 完整编码所需字节数，大于capacity时缓冲区中的数据无效
+    size_t encode(const EditorRenderDelta& delta, uint8_t* buffer, size_t capacity) const;
+  private:
+    const TextLayout& m_text_layout_;
+
+    void writeHeader(BinaryWriter& writer, RenderBinaryKind kind) const;
+    void finishHeader(BinaryWriter& writer) const;
+    void writeLine(BinaryWriter& writer, const VisualLine& line) const;
+    void writeLines(BinaryWriter& writer, const Vector<VisualLine>& lines) const;
+    void writeCursor(BinaryWriter& writer, const Cursor& cursor) const;
+    void writeGuideLines(BinaryWriter& writer, const Vector<GuideLine>& guide_lines) const;
+    void writeDiagnostics(BinaryWriter& writer, const Vector<DiagnosticSegment>& diagnostics) const;
+    void writeSelectionRects(BinaryWriter& writer, const Vector<SelectionRect>& rects) const;
+  };
+
+  /// 帧缓冲槽的状态
+  enum struct FrameSlotState : uint32_t {
+    /// 空闲，核心可以写入
+    FREE = 0,
+    /// 核心正在写入
+    WRITING = 1,
+    /// 数据已就绪，平台读取完毕后需将状态写回FREE
+    READY = 2,
+    /// 容量不足，data_size为完整数据所需字节数，平台读取后需将状态写回FREE
+    TOO_LARGE = 3,
+  };
+
+  /// 帧缓冲槽头部字节数：u32 state, u32 data_size, u64 sequence，之后是二进制渲染数据
+  constexpr size_t kFrameSlotHeaderSize = 16;
+
+  /// 平台侧持有的多块帧缓冲内存（JNI DirectBuffer、WASM线性内存、固定的托管数组等）
+  ///
+  /// 核心按轮转顺序写入下一个FREE槽位，写完后以release语义发布READY状态；
+  /// 平台以acquire语义读取状态，读取完数据后直接把状态写回FREE（或调用release），无需任何内存分配和拷贝
+  class FrameBufferRing {
+  public:
+    /// 注册帧缓冲内存，之前注册的内存不再使用
+    /// @param buffers 每块内存的起始地址（需按std::atomic<uint32_t>对齐，即4字节；为空、未对齐或小于头部大小的内存块被忽略）
+    /// @param capacities 每块内存的容量
+    /// @param count 内存块数量
+    void setBuffers(uint8_t* const* buffers, const size_t* capacities, uint32_t count);
+
+    /// 获取下一个FREE槽位并标记为WRITING
+    /// @return 槽位下标，没有空闲槽位时返回-1
+    int32_t acquire();
+
+    /// 槽位中存放渲染数据的内存
+    uint8_t* payload(int32_t index) const;
+
+    /// 槽位中存放渲染数据的容量
+    size_t payloadCapacity(int32_t index) const;
+
+    /// 发布写入完成的槽位，data_size超出容量时发布为TOO_LARGE
+    void publish(int32_t index, size_t data_size, uint64_t sequence);
+
+    /// 将槽位归还为FREE
+    void release(int32_t index);
+
+    /// 注册的槽位数量
+    uint32_t size() const;
+  private:
+    struct FrameSlot {
+      uint8_t* memory {nullptr};
+      size_t capacity {0};
+    };
+    Vector<FrameSlot> m_slots_;
+    uint32_t m_next_slot_ {0};
+
+    static std::atomic<uint32_t>& stateOf(const FrameSlot& slot);
+  };
+}
+
+#endif //SWEETEDITOR_CODEC_H
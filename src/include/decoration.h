@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include "macro.h"
+#include "document.h"
+#include "line_blocks.h"
 
 namespace NS_SWEETEDITOR {
   /// 编辑器样式定义
@@ -21,19 +23,62 @@ namespace NS_SWEETEDITOR {
     bool is_italic {false};
   };
 
-  /// 编辑器样式注册表
+  /// 解析后的样式，布局和序列化直接按样式ID下标读取
+  struct ResolvedStyle {
+    /// 颜色值
+    int32_t color {0};
+    /// 是否加粗
+    bool is_bold {false};
+    /// 是否斜体
+    bool is_italic {false};
+    /// 宽度缓存ID（字体变体，bit0加粗、bit1斜体），相同ID的样式共享文本宽度
+    uint8_t width_cache_id {0};
+  };
+
+  /// 样式ID上限（不包含），样式按ID稠密存储
+  constexpr uint32_t kMaxStyleCount = 1 << 16;
+
+  /// 样式的只读快照，注册样式或切换主题时整体替换，已经持有的快照保持不变
+  class StyleSnapshot {
+  public:
+    StyleSnapshot(Vector<ResolvedStyle>&& styles, uint64_t layout_version);
+
+    /// 根据样式ID取解析后的样式，未注册时返回默认样式
+    const ResolvedStyle& get(uint32_t style_id) const;
+
+    /// 快照中的样式个数（最大样式ID + 1）
+    size_t size() const;
+
+    /// 布局版本，只有某个样式的宽度缓存ID变化（字体度量变化）时才递增，颜色变化不影响布局
+    uint64_t getLayoutVersion() const;
+  private:
+    Vector<ResolvedStyle> m_styles_;
+    uint64_t m_layout_version_ {0};
+  };
+
+  /// 编辑器样式注册表，样式按ID稠密存储
   class StyleRegistry {
   public:
-    /// 注册一个高亮样式
-    /// @param style 高亮样式信息
+    /// 注册一个高亮样式（替换相同ID的样式）
+    /// @param style 高亮样式信息，style_id需小于kMaxStyleCount
     void registerStyle(Style&& style);
 
+    /// 切换主题：整体替换所有样式，O(样式数)
+    /// @param styles 新主题的所有样式，style_id需小于kMaxStyleCount
+    void setStyles(Vector<Style>&& styles);
+
     /// 根据样式ID取样式信息
     /// @param style_id 样式ID
-    /// @return 对应的样式信息
-    Style& getStyle(uint32_t style_id);
+    /// @return 对应的样式信息，未注册时返回默认样式
+    const Style& getStyle(uint32_t style_id) const;
+
+    /// 获取当前样式的只读快照，样式变化后的第一次调用重新生成
+    Ptr<const StyleSnapshot> getSnapshot();
   private:
-    HashMap<uint32_t, Style> style_map_;
+    Vector<Style> m_styles_;
+    Ptr<const StyleSnapshot> m_snapshot_;
+    uint64_t m_layout_version_ {0};
+    Vector<uint8_t> m_width_cache_ids_;
   };
 
   /// 高亮Span定义
@@ -74,6 +119,105 @@ namespace NS_SWEETEDITOR {
     U8String text;
   };
 
+  /// 诊断信息（例如LSP publishDiagnostics）
+  struct Diagnostic {
+    /// 范围（列为UTF16编码单元）
+    TextRange range;
+    /// 严重程度
+    DiagnosticSeverity severity {DiagnosticSeverity::ERROR};
+    /// 下划线样式
+    DiagnosticStyle style {DiagnosticStyle::SQUIGGLE};
+  };
+
+  /// 诊断信息的区间索引：诊断按起始位置排序存放，线段树记录区间内的起始行范围和最大结束行
+  /// 查询与若干行相交的诊断耗时O((k + 1) * log n)；编辑后之后的诊断整体按行差懒平移，只有与变更行相交的诊断逐个调整
+  class DiagnosticIndex {
+  public:
+    /// 整体替换所有诊断信息，O(n log n)
+    /// @param diagnostics 诊断信息（无需有序），起点在终点之后的会被交换
+    void setDiagnostics(Vector<Diagnostic>&& diagnostics);
+
+    /// 诊断信息个数
+    size_t size() const;
+
+    /// 查询与[first_line, last_line]相交的诊断信息
+    /// @param first_line 起始行
+    /// @param last_line 结束行（包含）
+    /// @param result 输出（按起始位置升序）
+    void query(size_t first_line, size_t last_line, Vector<Diagnostic>& result);
+
+    /// 文档文本变更后平移诊断：变更之前的不变，变更之后的随文本平移，被删除范围内的端点收缩到变更起点
+    /// @param change 变更描述
+    void onTextChanged(const TextChange& change);
+  private:
+    // 叶子上的行号可能还有未下传的平移量，经过的节点下传后才是实际值
+    Vector<Diagnostic> m_diagnostics_;
+    // 线段树节点按先序排列（同LineHeightIndex）：区间内最小、最大起始行，最大结束行，以及尚未下传给子节点的行平移量
+    Vector<size_t> m_min_start_;
+    Vector<size_t> m_max_start_;
+    Vector<size_t> m_max_end_;
+    Vector<int64_t> m_shift_;
+
+    void build(size_t node, size_t lo, size_t hi);
+    void pull(size_t node, size_t lo, size_t hi);
+    void applyShift(size_t node, size_t lo, size_t hi, int64_t shift);
+    void pushDown(size_t node, size_t lo, size_t hi);
+    void collect(size_t node, size_t lo, size_t hi, size_t first_line, size_t last_line, Vector<size_t>& indices);
+    void shiftAfter(size_t node, size_t lo, size_t hi, size_t line, int64_t shift);
+    void updateLeaf(size_t node, size_t lo, size_t hi, size_t index, const TextRange& range);
+  };
+
+  /// LineArray的块：每行一个数组，块上没有聚合值
+  template<typename T>
+  struct LineArrayBlock {
+    using Item = Vector<T>;
+    Vector<Vector<T>> lines;
+
+    void refresh() {
+    }
+  };
+
+  /// 按行存储的数组（例如每行的Span），行按块存储：按行号访问O(log n)，
+  /// 增删行只移动所在块内的元素，不重新分配整个行数组
+  template<typename T>
+  class LineArray : public LineBlockTree<LineArray<T>, LineArrayBlock<T>> {
+  public:
+    Vector<T>& operator[](size_t line) {
+      size_t offset = 0;
+      const size_t block = this->locate(line, offset);
+      return this->m_blocks_[block].lines[offset];
+    }
+
+    const Vector<T>& operator[](size_t line) const {
+      size_t offset = 0;
+      const size_t block = this->locate(line, offset);
+      return this->m_blocks_[block].lines[offset];
+    }
+
+    bool empty() const {
+      return this->size() == 0;
+    }
+
+    /// 调整行数，新增的行为空数组
+    void resize(size_t line_count) {
+      const size_t count = this->size();
+      if (line_count > count) {
+        spliceLines(count, 0, line_count - count);
+      } else {
+        spliceLines(line_count, count - line_count, 0);
+      }
+    }
+
+    void clear() {
+      this->resetItems({});
+    }
+
+    /// 在line处删除removed行再插入inserted个空行
+    void spliceLines(size_t line, size_t removed, size_t inserted) {
+      this->spliceItems(line, removed, inserted, {});
+    }
+  };
+
   /// 所有嵌入文本和样式的操作接口
   class DecorationManager {
   public:
@@ -81,12 +225,102 @@ namespace NS_SWEETEDITOR {
 
     Ptr<StyleRegistry> getStyleRegistry();
 
-    //StyleSpan& getStyleSpan(size_t line, uint32_t column, uint32_t length);
+    /// 设置一行的高亮Span，替换该行原有的Span
+    /// @param line 逻辑行号
+    /// @param spans 互不重叠的Span（无需有序）
+    void setLineSpans(size_t line, Vector<StyleSpan>&& spans);
+
+    /// 替换一行的高亮Span，内容相同时不做修改
+    /// @param line 逻辑行号
+    /// @param spans 按列升序且互不重叠的Span
+    /// @return Span是否发生变化（需要重新布局）
+    bool replaceLineSpans(size_t line, Vector<StyleSpan>&& spans);
+
+    /// 获取一行的所有高亮Span（按列升序）
+    /// @param line 逻辑行号
+    const Vector<StyleSpan>& getLineSpans(size_t line) const;
+
+    /// 查询一行中与[start_column, end_column)相交的Span，二分定位
+    /// @param line 逻辑行号
+    /// @param start_column 起始列
+    /// @param end_column 结束列（不包含）
+    /// @return 相交Span在getLineSpans(line)中的下标范围[first, second)
+    std::pair<size_t, size_t> findLineSpans(size_t line, size_t start_column, size_t end_column) const;
+
+    /// 按LSP semantic tokens的相对编码批量设置高亮Span，替换start_line及之后所有行的Span
+    /// 每个Span依次为5个uint32：与上一个Span的行差、列差（行差不为0时为行内的绝对列）、长度、样式ID、修饰符（保留）
+    /// 第一个Span的行差相对start_line，编码数据会保留一份用于之后的增量编辑
+    /// @param start_line 起始行号
+    /// @param packed 编码数据
+    /// @param count Span个数
+    /// @param line_count 文档行数，超出的Span被忽略
+    /// @param changed_lines 输出Span发生变化的行
+    void setPackedSpans(size_t start_line, const uint32_t* packed, size_t count, size_t line_count, Vector<size_t>& changed_lines);
+
+    /// 对上一次setPackedSpans的编码数据应用LSP semantic tokens delta编辑，只重新解码第一个编辑所在行及之后的行
+    /// @param edits 每个编辑依次为：起始下标、删除的uint32个数、插入的uint32个数，之后紧跟插入的数据；
+    /// 编辑按起始下标升序且互不重叠，下标都相对编辑前的数据
+    /// @param length edits的uint32个数
+    /// @param line_count 文档行数，超出的Span被忽略
+    /// @param changed_lines 输出Span发生变化的行
+    /// @return 编辑格式无效时返回false，原有Span保持不变
+    bool applyPackedSpanEdits(const uint32_t* edits, size_t length, size_t line_count, Vector<size_t>& changed_lines);
+
+    /// 清除所有高亮Span
+    void clearSpans();
+
+    /// 批量替换从start_line开始连续若干行的镶嵌内容，hints[i]对应start_line + i行（为空时清除该行）
+    /// @param start_line 起始行号
+    /// @param hints 每行的镶嵌内容（无需有序）
+    /// @param changed_lines 输出镶嵌内容发生变化的行
+    void replaceInlayHints(size_t start_line, Vector<Vector<InlayHint>>&& hints, Vector<size_t>& changed_lines);
+
+    /// 获取一行的镶嵌内容（按列升序）
+    /// @param line 逻辑行号
+    const Vector<InlayHint>& getLineInlayHints(size_t line) const;
+
+    /// 批量替换从start_line开始连续若干行的幽灵文本，texts[i]对应start_line + i行（为空时清除该行）
+    /// @param start_line 起始行号
+    /// @param texts 每行的幽灵文本（无需有序）
+    /// @param changed_lines 输出幽灵文本发生变化的行
+    void replacePhantomTexts(size_t start_line, Vector<Vector<PhantomText>>&& texts, Vector<size_t>& changed_lines);
+
+    /// 获取一行的幽灵文本（按列升序）
+    /// @param line 逻辑行号
+    const Vector<PhantomText>& getLinePhantomTexts(size_t line) const;
+
+    /// 清除所有镶嵌内容和幽灵文本
+    void clearInlays();
+
+    /// 整体替换所有诊断信息
+    /// @param diagnostics 诊断信息（无需有序）
+    void setDiagnostics(Vector<Diagnostic>&& diagnostics);
+
+    /// 查询与[first_line, last_line]相交的诊断信息（按起始位置升序）
+    void queryDiagnostics(size_t first_line, size_t last_line, Vector<Diagnostic>& result);
+
+    /// 诊断信息个数
+    size_t getDiagnosticCount() const;
+
+    /// 文档文本变更后平移或裁剪Span、镶嵌内容、幽灵文本和诊断信息，只处理变更涉及的行；其它行的列相对行首，无需修改
+    /// @param change 变更描述
+    void onTextChanged(const TextChange& change);
+
+    /// 一次处理批量编辑的所有变更，增删的行在一次遍历中完成
+    /// @param changes 按位置从前往后排列的变更，每个变更的坐标都基于之前的变更已经生效的文本
+    void onTextChangedBatch(const Vector<TextChange>& changes);
   private:
     Ptr<StyleRegistry> m_style_reg_;
-    Vector<Vector<StyleSpan>> m_spans_;
-    Vector<Vector<InlayHint>> m_inlay_hints_;
-    Vector<Vector<PhantomText>> m_phantom_texts_;
+    LineArray<StyleSpan> m_spans_;
+    /// 最近一次setPackedSpans的编码数据（服务端视角，不随本地编辑平移）
+    Vector<uint32_t> m_packed_spans_;
+    size_t m_packed_start_line_ {0};
+    LineArray<InlayHint> m_inlay_hints_;
+    LineArray<PhantomText> m_phantom_texts_;
+    DiagnosticIndex m_diagnostics_;
+
+    /// 从first_token开始解码m_packed_spans_，直接覆写每行的Span数组；clear_line到first_token所在行之间以及最后一个Span之后的行被清空
+    void decodePackedSpans(size_t clear_line, size_t first_token, size_t token_line, size_t line_count, Vector<size_t>& changed_lines);
   };
 }
 
@@ -6,6 +6,7 @@
 #define SWEETEDITOR_DOCUMENT_H
 
 #include <cstdint>
+#include <functional>
 #include "foundation.h"
 #include "buffer.h"
 #include "visual.h"
@@ -27,24 +28,106 @@ namespace NS_SWEETEDITOR {
     size_t byte_length {0};
   };
 
+  /// 超长行的分块数据，只有与视口相交的块会转换文本并测量
+  struct LineChunk {
+    /// 块在行内的起始字节偏移
+    size_t start_byte {0};
+    /// 块的字节长度（不会截断UTF8字符）
+    size_t byte_length {0};
+    /// 块的起始列
+    size_t start_column {0};
+    /// 块的列数（UTF16编码单元数）
+    size_t columns {0};
+    /// 块的起始横坐标（相对行首）
+    float x {0};
+    /// 块的宽度，测量前按列数估算
+    float width {0};
+    /// 块宽度是否已经测量
+    bool is_measured {false};
+    /// 块的文本缓存，离开视口后释放
+    U16String text;
+    /// 块内每一列相对块起点的横坐标，离开视口后释放
+    Vector<float> prefix_widths;
+    /// 块内字素簇边界位图，离开视口后释放
+    Vector<uint64_t> cluster_bits;
+  };
+
+  /// 行内镶嵌内容（镶嵌提示、幽灵文本）的布局数据，绘制在所在列的字符之前
+  struct InlayBox {
+    /// 所在列
+    size_t column {0};
+    /// 片段类型（INLAY_HINT或PHANTOM_TEXT）
+    VisualRunType type {VisualRunType::INLAY_HINT};
+    /// 显示的文本（图标时为空）
+    U16String text;
+    /// 图标ID（文本时为0）
+    int32_t icon_id {0};
+    /// 占用的宽度（未缩放）
+    float width {0};
+  };
+
   /// 逻辑行的数据快照(标记dirty后随时刷新)
   struct LogicalLine {
     /// 当前行在全文中的起始字节偏移，文本变动时即更新
     size_t start_byte {0};
-    /// 当前行在全文中的起始字符偏移，dirty时更新
+    /// 当前行在全文中的起始字符偏移，文本变动时按字符差值平移，dirty时重新计算
     size_t start_char {0};
     /// 当前行文本的缓存（不包括换行符），dirty时更新
     U16String cached_text;
     /// 当前行文本数据是否已经被标记为dirty，需要刷新
     bool is_char_dirty {false};
-    /// 当前行起始y坐标
-    float start_y {-1};
-    /// 当前行的渲染高度
-    float height {-1};
-    /// 视觉行布局数据
+    /// 当前行内容版本，只有该行文本被编辑时才递增
+    uint32_t version {0};
+    /// 视觉行布局数据（纵坐标相对行首）
     Vector<VisualLine> visual_lines;
-    /// 当前行布局是否已经被标记为dirty，需要重建
+    /// 每一列起始处相对行首的横坐标（前缀宽度和，长度为列数+1），随布局一起重建
+    Vector<float> prefix_widths;
+    /// 字素簇边界位图（第i位为1表示第i列是簇起点），行内没有多码点字素簇时为空，随布局一起重建
+    Vector<uint64_t> cluster_bits;
+    /// 超长行模式下的分块（此时不使用cached_text、prefix_widths），普通行为空
+    Vector<LineChunk> chunks;
+    /// 分块边界对应的内容版本，与version一致时重新布局沿用已有的块边界
+    uint32_t chunks_version {0};
+    /// 行内镶嵌内容（按列升序），随布局一起重建，其宽度计入所在列之后的prefix_widths
+    Vector<InlayBox> inlay_boxes;
+    /// 当前布局所对应的内容版本，与version不一致时需要重建
+    uint32_t layout_version {0};
+    /// 当前行布局是否被强制标记为dirty（样式变化等），需要重建
     bool is_layout_dirty {true};
+    /// 布局时TextLayout的布局代数，与当前代数不一致时需要重建（断行宽度、制表符宽度等全局变化只递增代数）
+    uint32_t layout_epoch {0};
+    /// 语法高亮分析到行尾时的词法状态ID（由SyntaxHighlighter分配，0为初始状态）
+    uint32_t lexer_state {0};
+  };
+
+  /// 文本变更描述
+  struct TextChange {
+    /// 变更前被替换的范围（插入时start与end相同）
+    TextRange range;
+    /// 变更后新文本的结束位置（删除时与range.start相同）
+    TextPosition new_end;
+  };
+
+  /// 批量编辑中的一处修改
+  struct TextEdit {
+    /// 被替换的范围（插入时start与end相同）
+    TextRange range;
+    /// 替换后的文本
+    U8String text;
+  };
+
+  /// 文档文本变更监听
+  class DocumentListener {
+  public:
+    virtual ~DocumentListener() = default;
+
+    /// 文本发生变更后回调，此时行数据已经更新
+    /// @param change 变更描述
+    virtual void onTextChanged(const TextChange& change) = 0;
+
+    /// 批量编辑（applyEdits）完成后回调一次，默认按顺序逐个转发给onTextChanged
+    /// @param changes 按位置从前往后排列的变更，每个变更的坐标都基于之前的变更已经生效的文本
+    virtual void onTextChangedBatch(const Vector<TextChange>& changes);
   };
 
   /// 编辑器的文本对象
@@ -72,6 +155,21 @@ namespace NS_SWEETEDITOR {
     /// @return 指定行的文本内容
     U16String getLineU16Text(size_t line) const;
 
+    /// 获取指定行的UTF16文本缓存（必要时刷新），不拷贝文本
+    /// @param line 行号
+    /// @return 指向行缓存的文本视图，在下一次编辑之前有效
+    U16StringView getLineU16View(size_t line);
+
+    /// 获取指定行的字节长度（不包括换行符）
+    /// @param line 行号
+    size_t getLineByteLength(size_t line) const;
+
+    /// 获取指定行中一段字节范围的UTF8文本，用于超长行分块读取
+    /// @param line 行号
+    /// @param byte_offset 行内起始字节偏移
+    /// @param byte_length 字节长度
+    U8String getLineU8Text(size_t line, size_t byte_offset, size_t byte_length) const;
+
     /// 获取指定行的column数量（字符数）
     /// @param line 行号
     /// @return 指定行的字符总数
@@ -101,6 +199,24 @@ namespace NS_SWEETEDITOR {
     /// @param text 替换后的文本
     void replaceU8Text(const TextRange& range, const U8String& text);
 
+    /// 将位置限制到文档范围内，超出最后一行时限制到文档末尾（按字节扫描，不会转换整行文本）
+    /// @param position 文本位置
+    /// @return 限制后的位置
+    TextPosition clampPosition(const TextPosition& position) const;
+
+    /// 分块读取范围内的UTF8文本，数据直接引用文档内部的buffer，不会拼接为完整的字符串（例如复制超大文件的全部内容）
+    /// @param range 文本范围，超出文档时限制到文档范围内
+    /// @param consumer 依次接收每块数据（仅在回调期间有效），块边界不会截断UTF8字符
+    /// @param max_chunk_bytes 每块的最大字节数
+    void streamU8Text(const TextRange& range, const std::function<void(const char*, size_t)>& consumer,
+      size_t max_chunk_bytes = 1 << 20) const;
+
+    /// 批量应用多处修改（例如多光标输入），一次遍历完成文本片段和逻辑行的更新
+    /// 监听通过onTextChangedBatch一次收到所有修改，按位置从前往后排列，每个变更的坐标都基于之前的修改已经生效的文本
+    /// @param edits 修改（范围都基于修改前的文本），按起点排序后与前一处重叠的部分会被裁掉
+    /// @return 按起点排序后每处修改对应的变更（与监听收到的相同），没有实际修改的也会保留以便一一对应
+    Vector<TextChange> applyEdits(Vector<TextEdit>&& edits);
+
     /// 计算在文本中指定区域有多少字符
     /// @param start_byte 起始字节偏移
     /// @param byte_length 字节长度
@@ -110,6 +226,17 @@ namespace NS_SWEETEDITOR {
     /// 获取所有逻辑行数据
     Vector<LogicalLine>& getLogicalLines();
 
+    /// 获取文档版本，每次编辑递增
+    uint64_t getVersion() const;
+
+    /// 添加文本变更监听（弱引用持有，监听对象释放后自动失效）
+    /// @param listener 监听对象
+    void addListener(const Ptr<DocumentListener>& listener);
+
+    /// 移除文本变更监听
+    /// @param listener 监听对象
+    void removeListener(const Ptr<DocumentListener>& listener);
+
     /// 更新被标记为dirty的行
     /// @param index 行号
     /// @param logical_line 逻辑行数据
@@ -121,22 +248,40 @@ namespace NS_SWEETEDITOR {
     UPtr<U8StringBuffer> m_edit_buffer_;
     /// 所有的文本片段
     Vector<BufferSegment> m_buffer_segments_;
+    /// 每个文本片段结束处在全文中的字节偏移，用于二分定位片段
+    Vector<size_t> m_segment_ends_;
+    /// 上一次压缩编辑片段后的片段数
+    size_t m_compacted_segment_count_ {0};
     /// 逻辑行的数据
     Vector<LogicalLine> m_logical_lines_;
     /// 全文的字节长度
     size_t m_total_bytes_ {0};
+    /// 文档版本
+    uint64_t m_version_ {0};
+    /// 文本变更监听
+    Vector<WPtr<DocumentListener>> m_listeners_;
   private:
     void rebuildBufferSegments();
+    void rebuildSegmentEnds();
+    void updateSegmentEnds(size_t first_segment, size_t touched_end, size_t old_count, int64_t byte_delta);
+    void compactSegments();
+    size_t findSegment(size_t byte_offset) const;
+    void resolveOffsets(Vector<TextPosition>& positions, Vector<size_t>& byte_offsets, Vector<size_t>& char_offsets) const;
+    static TextPosition computeInsertEnd(const TextPosition& start, const U8String& text);
     void rebuildLogicalLines();
     U8String getU8Text(size_t start_byte, size_t byte_length) const;
     void insertU8Text(size_t start_byte, const U8String& text);
     void deleteU8Text(size_t start_byte, size_t byte_length);
     void updateLogicalLinesByInsertText(size_t start_byte, const U8String& text);
-    void updateLogicalLinesByDeleteText(size_t start_byte, size_t byte_length);
+    void updateLogicalLinesByDeleteText(size_t start_byte, size_t byte_length, size_t char_length);
+    void dispatchTextChanged(const TextChange& change);
+    void dispatchTextChangedBatch(const Vector<TextChange>& changes);
+    void forEachListener(const std::function<void(DocumentListener&)>& callback);
     size_t getByteOffsetFromPosition(const TextPosition& position) const;
     size_t getLineFromByteOffset(size_t byte_offset) const;
     size_t getLineFromCharIndex(size_t char_index) const;
     size_t getByteLengthOfLine(size_t line) const;
+    U8String getLineU8Content(size_t line) const;
     const char* getSegmentData(const BufferSegment& segment) const;
   };
 }
@@ -8,12 +8,18 @@
 #include "visual.h"
 #include "gesture.h"
 #include "layout.h"
+#include "codec.h"
+#include "highlight.h"
 
 namespace NS_SWEETEDITOR {
   /// EditorCore初始化的一些配置
   struct EditorConfig {
     TouchConfig touch_config;
     float max_scale {5};
+    /// 沿滚动方向最多预布局的屏数
+    uint32_t prefetch_screens {2};
+    /// 是否在后台线程进行语法高亮（WASM等不支持线程的平台始终同步分析）
+    bool async_highlight {true};
 
     U8String dump() const;
   };
@@ -27,6 +33,60 @@ namespace NS_SWEETEDITOR {
     GOTO_BOTTOM,
   };
 
+  /// 平滑滚动动画状态
+  struct ScrollAnimation {
+    /// 目标行
+    size_t line {0};
+    /// 滚动的形式
+    ScrollBehavior behavior {ScrollBehavior::GOTO_TOP};
+    /// 动画开始时的纵向滚动距离
+    float from_y {0};
+    /// 动画开始时间（毫秒）
+    int64_t start_time {0};
+    /// 动画时长（毫秒）
+    int64_t duration {0};
+    /// 动画是否在进行
+    bool is_running {false};
+  };
+
+  /// 上一帧中视觉行的快照，用于计算增量渲染模型
+  struct FrameLineSnapshot {
+    /// 视觉行标识
+    VisualLineKey key;
+    /// 内容哈希（片段横坐标相对文本区域左侧，不受滚动影响）
+    uint64_t content_hash {0};
+    /// 文本片段的横向滚动偏移
+    float x {0};
+    /// 行号纵坐标
+    float y {0};
+  };
+
+  /// 两帧之间的文本变更涉及的行，用于把上一帧快照的行号换算到当前帧
+  struct FrameLineEdit {
+    /// 是否有变更
+    bool has_edit {false};
+    /// 涉及的第一行（变更前的行号）
+    size_t first_line {0};
+    /// 涉及的最后一行（变更前的行号），之后的行整体平移line_shift行
+    size_t last_line {0};
+    /// 净增的行数
+    int64_t line_shift {0};
+  };
+
+  class EditorCore;
+
+  /// 将Document的文本变更转发给EditorCore，由EditorCore分发到布局等各个模块
+  class EditorDocumentListener : public DocumentListener {
+  public:
+    explicit EditorDocumentListener(EditorCore* editor);
+
+    void onTextChanged(const TextChange& change) override;
+
+    void onTextChangedBatch(const Vector<TextChange>& changes) override;
+  private:
+    EditorCore* m_editor_;
+  };
+
   /// 编辑器核心类
   class EditorCore {
   public:
@@ -36,11 +96,50 @@ namespace NS_SWEETEDITOR {
     /// @param document Document实例
     void loadDocument(const Ptr<Document>& document);
 
+    /// 文档文本变更后调用，增量更新布局缓存和行高索引；同一事务的多处变更一次分发
+    /// @param changes 按发生顺序排列的变更，每个变更的坐标基于之前的变更已经生效的文本
+    void onDocumentTextChanged(const Vector<TextChange>& changes);
+
+    /// 设置所有光标和选区，重叠的选区会合并为一个
+    /// @param selections 选区（无需有序）
+    /// @param primary_index 主光标（跟随滚动、单独输出到渲染模型的cursor）在selections中的下标
+    void setSelections(Vector<Selection>&& selections, size_t primary_index = 0);
+
+    /// 获取所有光标和选区（按位置升序、互不重叠）
+    const Vector<Selection>& getSelections() const;
+
+    /// 获取主光标在getSelections()中的下标
+    size_t getPrimarySelectionIndex() const;
+
+    /// 选中全部文本（只记录范围，渲染时只输出可见行的选区背景）
+    void selectAll();
+
+    /// 复制所有选区的文本，多个选区之间以换行分隔；文本分块通过回调输出，不会拼接为完整的字符串
+    /// @param consumer 依次接收每块UTF8数据（仅在回调期间有效）
+    void copySelectedText(const std::function<void(const char*, size_t)>& consumer) const;
+
+    /// 在所有光标处输入文本（替换选中的文本），所有光标的编辑作为一次批量事务提交，光标按变更结果移动到插入的文本之后
+    /// @param text UTF8文本
+    void insertText(const U8String& text);
+
+    /// 在所有光标处向前删除：删除选中的文本，或光标前的一个字素簇，位于行首时与上一行合并
+    void deleteBackward();
+
     /// 处理手势事件
     /// @param event 手势数据
     /// @return 手势事件处理的结果
     GestureResult handleGestureEvent(const GestureEvent& event);
 
+    /// 获取视口坐标处的文本位置（点击定位光标）
+    /// @param point 视口坐标
+    /// @return 最靠近的文本位置
+    TextPosition getPositionAtPoint(const PointF& point) const;
+
+    /// 获取文本位置在视口中的坐标（光标所在视觉行的顶部）
+    /// @param position 文本位置
+    /// @return 视口坐标
+    PointF getPositionPoint(const TextPosition& position) const;
+
     /// 重置文本测量，一般在编辑器重新设置字体的时候调用
     void resetMeasurer();
 
@@ -48,14 +147,107 @@ namespace NS_SWEETEDITOR {
     /// @return 高亮样式注册表
     Ptr<StyleRegistry> getStyleRegistry() const;
 
+    /// 切换主题，整体替换所有样式；只有加粗、斜体变化的样式会导致重新布局，颜色变化在下一帧直接生效
+    /// @param styles 新主题的所有样式
+    void setStyles(Vector<Style>&& styles);
+
+    /// 获取编辑器的装饰数据（高亮Span等）
+    /// @return 装饰数据管理器
+    Ptr<DecorationManager> getDecorations() const;
+
+    /// 设置一行的高亮Span，只有该行需要重新布局
+    /// @param line 逻辑行号
+    /// @param spans 互不重叠的Span
+    void setLineSpans(size_t line, Vector<StyleSpan>&& spans);
+
+    /// 按LSP semantic tokens的相对编码批量设置start_line及之后所有行的高亮Span（格式见 DecorationManager::setPackedSpans）
+    /// @param start_line 起始行号
+    /// @param packed 编码数据
+    /// @param count Span个数
+    void setPackedSpans(size_t start_line, const uint32_t* packed, size_t count);
+
+    /// 对上一次setPackedSpans的编码数据应用LSP semantic tokens delta编辑
+    /// @param edits 编辑数据（格式见 DecorationManager::applyPackedSpanEdits）
+    /// @param length edits的uint32个数
+    /// @return 编辑格式无效时返回false
+    bool applyPackedSpanEdits(const uint32_t* edits, size_t length);
+
+    /// 批量替换从start_line开始连续若干行的镶嵌内容，只有内容变化的行需要重新布局
+    /// @param start_line 起始行号
+    /// @param hints 每行的镶嵌内容，hints[i]对应start_line + i行（为空时清除该行）
+    void setInlayHints(size_t start_line, Vector<Vector<InlayHint>>&& hints);
+
+    /// 批量替换从start_line开始连续若干行的幽灵文本，只有内容变化的行需要重新布局
+    /// @param start_line 起始行号
+    /// @param texts 每行的幽灵文本，texts[i]对应start_line + i行（为空时清除该行）
+    void setPhantomTexts(size_t start_line, Vector<Vector<PhantomText>>&& texts);
+
+    /// 整体替换所有诊断信息，诊断只在渲染时输出为下划线，不影响布局
+    /// @param diagnostics 诊断信息（无需有序）
+    void setDiagnostics(Vector<Diagnostic>&& diagnostics);
+
+    /// 设置语法高亮规则。后台高亮时结果在之后构建渲染模型时生效，否则每次构建前同步增量分析到视口底部
+    /// @param grammar 语法定义（规则错误时抛出异常，原有规则保持不变）
+    void setGrammar(const Grammar& grammar);
+
+    /// 设置后台高亮有新结果时的回调（在后台线程中调用，平台需要切换到UI线程后重新构建渲染模型）
+    /// @param callback 回调
+    void setHighlightReadyCallback(std::function<void()> callback);
+
+    /// 后台高亮是否已经分析完当前版本的整个文档
+    bool isHighlightIdle() const;
+
     /// 构建编辑器渲染模型
     /// @param model 传入的 EditorRenderModel
     void buildRenderModel(EditorRenderModel& model);
 
+    /// 构建相对基准帧的增量渲染模型
+    /// @param base_sequence 平台侧当前持有的帧序号，与上一帧不一致时返回全量数据
+    /// @param delta 传入的 EditorRenderDelta
+    void buildRenderDelta(uint64_t base_sequence, EditorRenderDelta& delta);
+
+    /// 将渲染模型编码为紧凑二进制格式（见 RenderModelEncoder）
+    /// @param model 当前帧的渲染模型
+    /// @param buffer 调用方提供的内存
+    /// @param capacity 内存容量
+    /// @return 完整编码所需字节数，大于capacity时缓冲区中的数据无效
+    size_t encodeRenderModel(const EditorRenderModel& model, uint8_t* buffer, size_t capacity) const;
+
+    /// 将增量渲染模型编码为紧凑二进制格式（见 RenderModelEncoder）
+    /// @param delta 当前帧的增量渲染模型
+    /// @param buffer 调用方提供的内存
+    /// @param capacity 内存容量
+    /// @return 完整编码所需字节数，大于capacity时缓冲区中的数据无效
+    size_t encodeRenderDelta(const EditorRenderDelta& delta, uint8_t* buffer, size_t capacity) const;
+
+    /// 注册平台侧持有的帧缓冲内存（一般2~3块轮转使用，见 FrameBufferRing）
+    /// @param buffers 每块内存的起始地址
+    /// @param capacities 每块内存的容量
+    /// @param count 内存块数量
+    void setFrameBuffers(uint8_t* const* buffers, const size_t* capacities, uint32_t count);
+
+    /// 构建一帧并以二进制格式写入下一个空闲的帧缓冲
+    /// @param base_sequence 为0时写入全量渲染模型，否则写入相对该帧的增量渲染模型
+    /// @return 写入的帧缓冲下标，没有空闲帧缓冲时返回-1且不会构建新的一帧
+    int32_t buildFrame(uint64_t base_sequence);
+
+    /// 将帧缓冲归还为空闲状态（平台也可以直接把槽位状态写回FREE）
+    /// @param index 帧缓冲下标
+    void releaseFrame(int32_t index);
+
+    /// 在空闲时间沿最近的滚动方向预布局接下来的若干屏（距离随滚动速度增大，最多EditorConfig::prefetch_screens屏），
+    /// 布局前先让语法高亮覆盖这些行（同步高亮最多分析max_lines行，后台高亮将其与可见行一并优先分析）
+    /// @param max_lines 本次最多布局的行数，平台可以在每次空闲回调中分批调用
+    /// @return 实际布局的行数，为0时表示预布局区域已经全部就绪
+    size_t prefetchLayout(size_t max_lines);
+
+    /// 获取预布局的命中统计
+    PrefetchStats getPrefetchStats() const;
+
     /// 获取视觉文本片段id对应的文本
     /// @param run_text_id 片段id
-    /// @return UTF8文本
-    const U16String& getVisualRunText(int64_t run_text_id) const;
+    /// @return 文本视图（仅在下一次构建渲染模型之前有效）
+    U16StringView getVisualRunText(int64_t run_text_id) const;
 
     /// 设置编辑器视口大小
     /// @param viewport 视口区域
@@ -65,15 +257,46 @@ namespace NS_SWEETEDITOR {
     /// @param mode WrapMode
     void setWrapMode(WrapMode mode);
 
+    /// 设置制表位间隔
+    /// @param tab_size 空格宽度的倍数
+    void setTabSize(uint32_t tab_size);
+
+    /// 设置是否显示空白字符（输出WHITESPACE、TAB片段）
+    /// @param show 是否显示
+    void setShowWhitespace(bool show);
+
+    /// 设置折叠区域（替换原有的所有区域）
+    /// @param ranges 折叠区域
+    void setFoldRanges(const Vector<FoldRange>& ranges);
+
+    /// 折叠或展开以指定行为首行的区域
+    /// @param line 折叠区域首行
+    /// @param collapsed 是否折叠
+    /// @return 折叠状态是否发生变化
+    bool setFoldCollapsed(size_t line, bool collapsed);
+
+    /// 获取所有折叠区域（行号随编辑自动平移）
+    const Vector<FoldRange>& getFoldRanges() const;
+
     /// 手动设置编辑器缩放系数
     /// @param scale 缩放系数
     void setScale(float scale);
 
-    /// 滚动到指定行
+    /// 滚动到指定行，只布局目标行，行的纵坐标由高度索引求得
     /// @param line 行号
     /// @param behavior 滚动的形式
     void scrollToLine(size_t line, ScrollBehavior behavior);
 
+    /// 平滑滚动到指定行，之后平台在每一帧调用 updateScrollAnimation 推进动画；其它滚动、缩放操作会取消动画
+    /// @param line 行号
+    /// @param behavior 滚动的形式
+    /// @param duration_ms 动画时长（毫秒），不大于0时直接滚动到目标位置
+    void smoothScrollToLine(size_t line, ScrollBehavior behavior, int64_t duration_ms = 250);
+
+    /// 按当前时间推进平滑滚动动画，更新滚动位置（目标位置每帧重新计算，动画过程中行高修正后仍然停在目标行）
+    /// @return 动画是否还在进行，为true时平台需要继续请求下一帧
+    bool updateScrollAnimation();
+
     /// 手动设置编辑器滚动长度
     /// @param scroll_x 水平方向上滚动长度
     /// @param scroll_y 垂直方向上滚动长度
@@ -91,11 +314,46 @@ namespace NS_SWEETEDITOR {
     Ptr<DecorationManager> m_decorations_;
     UPtr<GestureHandler> m_gesture_handler_;
     UPtr<TextLayout> m_text_layout_;
-    // 每个逻辑行渲染高度的缓存
-    HashMap<size_t, float> m_line_heights_;
+    Ptr<EditorDocumentListener> m_document_listener_;
+    UPtr<SyntaxHighlighter> m_highlighter_;
+    UPtr<HighlightWorker> m_highlight_worker_;
+    std::function<void()> m_highlight_callback_;
+    // 文本版本，每次变更递增，用于丢弃过期的后台高亮结果
+    uint64_t m_text_version_ {0};
 
     Viewport m_viewport_;
     ViewState m_view_state_;
+    // 最近的纵向滚动速度（视口坐标/毫秒），正值向下
+    float m_scroll_velocity_ {0};
+    int64_t m_last_scroll_time_ {0};
+    // 所有光标和选区（按位置升序、互不重叠）
+    Vector<Selection> m_selections_;
+    // 主光标在m_selections_中的下标
+    size_t m_primary_selection_ {0};
+    // 正在提交光标的批量编辑，光标直接由编辑结果更新，不在变更回调中逐次平移
+    bool m_is_applying_edits_ {false};
+    // 平滑滚动动画
+    ScrollAnimation m_scroll_animation_;
+    // 帧序号计数
+    uint64_t m_frame_sequence_ {0};
+    // 上一帧的视觉行快照（按VisualLineKey升序）
+    Vector<FrameLineSnapshot> m_last_frame_lines_;
+    // 上一帧之后的文本变更涉及的行
+    FrameLineEdit m_frame_line_edit_;
+    // 平台侧持有的帧缓冲
+    FrameBufferRing m_frame_buffers_;
+
+    TextRange getWordRange(const TextPosition& position) const;
+    void applySelectionEdits(Vector<TextEdit>&& edits);
+    void mergeSelections();
+    void shiftSelections(const TextChange& change);
+    void trackFrameLineEdit(const TextChange& change);
+    float computeLineScrollY(size_t line, ScrollBehavior behavior);
+    void updateScrollVelocity(float delta_y);
+    void highlightVisibleLines();
+    void highlightPrefetchLines(float top, float bottom, size_t max_lines);
+    uint64_t computeLineContentHash(const VisualLine& line) const;
+    void snapshotFrameLines(const Vector<VisualLine>& lines, Vector<FrameLineSnapshot>& snapshots) const;
   };
 }
 
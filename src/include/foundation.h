@@ -29,6 +29,19 @@ namespace NS_SWEETEDITOR {
     U8String dump() const;
   };
 
+  /// 光标及其选区，anchor与caret相同时只有光标没有选中文本
+  struct Selection {
+    /// 选区固定的一端
+    TextPosition anchor;
+    /// 光标所在的一端
+    TextPosition caret;
+
+    /// 选区覆盖的范围（start不在end之后）
+    TextRange range() const;
+    /// 是否没有选中文本
+    bool isEmpty() const;
+  };
+
   /// 横纵坐标数据包装
   struct PointF {
     float x {0};
@@ -53,9 +66,9 @@ namespace NS_SWEETEDITOR {
   struct ViewState {
     /// 缩放系数
     float scale {1};
-    /// 水平滚动长度
+    /// 水平滚动长度（缩放后的视口坐标）
     float scroll_x {0};
-    /// 垂直滚动长度
+    /// 垂直滚动长度（缩放后的视口坐标）
     float scroll_y {0};
 
     U8String dump() const;
@@ -0,0 +1,64 @@
+//
+// Created by Scave on 2025/12/18.
+//
+
+#ifndef SWEETEDITOR_GRAPHEME_H
+#define SWEETEDITOR_GRAPHEME_H
+
+#include <cstdint>
+#include "macro.h"
+
+namespace NS_SWEETEDITOR {
+  /// 字素簇断开属性（UAX #29 Grapheme_Cluster_Break 的子集）
+  enum struct GraphemeBreak : uint8_t {
+    OTHER,
+    CONTROL,
+    EXTEND,
+    ZWJ,
+    REGIONAL_INDICATOR,
+    HANGUL_L,
+    HANGUL_V,
+    HANGUL_T,
+    HANGUL_LV,
+    HANGUL_LVT,
+    EXTENDED_PICTOGRAPHIC,
+  };
+
+  /// 字素簇边界计算，使用内置的精简属性表（组合附加符号、emoji修饰/ZWJ序列、国旗、韩文音节）
+  class Grapheme {
+  public:
+    Grapheme() = delete;
+    Grapheme(const Grapheme&) = delete;
+    Grapheme& operator=(const Grapheme&) = delete;
+
+    /// 获取码点的断开属性
+    /// @param code_point Unicode码点
+    static GraphemeBreak getBreakProperty(uint32_t code_point);
+
+    /// 计算一行文本的字素簇边界位图
+    /// @param text UTF16文本
+    /// @param bits 输出位图，第i位为1表示第i列是簇起点；所有簇都只有一个码点时清空（快速路径）
+    /// @return 是否存在多码点字素簇
+    static bool computeBoundaries(const U16String& text, Vector<uint64_t>& bits);
+
+    /// 判断列是否位于字素簇边界
+    /// @param text UTF16文本
+    /// @param bits computeBoundaries计算的位图，为空时按码点边界判断
+    /// @param column 列
+    static bool isBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column);
+
+    /// 获取不大于column的最近边界
+    static size_t floorBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column);
+
+    /// 获取不小于column的最近边界
+    static size_t ceilBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column);
+
+    /// 获取column之后的下一个边界（光标右移）
+    static size_t nextBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column);
+
+    /// 获取column之前的上一个边界（光标左移）
+    static size_t prevBoundary(const U16String& text, const Vector<uint64_t>& bits, size_t column);
+  };
+}
+
+#endif //SWEETEDITOR_GRAPHEME_H
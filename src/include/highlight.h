@@ -0,0 +1,225 @@
+//
+// Created by Scave on 2025/12/22.
+//
+
+#ifndef SWEETEDITOR_HIGHLIGHT_H
+#define SWEETEDITOR_HIGHLIGHT_H
+
+#include <regex>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <nlohmann/json.hpp>
+#include "document.h"
+#include "decoration.h"
+
+namespace NS_SWEETEDITOR {
+  /// 语法规则：匹配正则的文本应用样式，并可以切换词法状态
+  struct GrammarRule {
+    /// ECMAScript正则表达式（按UTF8文本匹配，不跨行）
+    U8String pattern;
+    /// 匹配文本的样式ID，0表示无样式
+    uint32_t style_id {0};
+    /// 匹配后是否弹出当前状态（先于push执行）
+    bool pop {false};
+    /// 匹配后压入的状态名，为空时不压入
+    U8String push;
+  };
+
+  /// 词法状态，同一时刻只尝试栈顶状态的规则
+  struct GrammarState {
+    /// 状态名
+    U8String name;
+    /// 没有被任何规则匹配的文本的样式ID（如块注释、字符串内部）
+    uint32_t style_id {0};
+    /// 规则，同一位置匹配时排在前面的优先
+    Vector<GrammarRule> rules;
+  };
+
+  /// 声明式语法定义，第一个状态为初始状态
+  struct Grammar {
+    Vector<GrammarState> states;
+  };
+
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(GrammarRule, pattern, style_id, pop, push)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(GrammarState, name, style_id, rules)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Grammar, states)
+
+  /// 超过该字节长度的行不做语法分析（没有Span，词法状态原样传递到下一行）
+  constexpr size_t kMaxHighlightLineBytes = 16 * 1024;
+
+  /// 增量分析进度，同步分析和后台分析共用
+  struct HighlightFrontier {
+    /// 第一个需要分析的行
+    size_t frontier {0};
+    /// 分析到该行（不含）之前不能提前结束，编辑涉及的行必须重新分析
+    size_t resume_line {0};
+    /// 该行之前的行都分析过（缓存的行尾状态在行首状态不变时有效）
+    size_t analyzed_end {0};
+
+    /// 所有行重新分析
+    void reset();
+
+    /// 文本变更后标记需要重新分析的行
+    void onTextChanged(const TextChange& change);
+
+    /// frontier行分析完成后推进，编辑涉及的行之后行尾状态与缓存一致时跳过已分析的行
+    /// @param end_state 新的行尾状态
+    /// @param old_state 缓存的行尾状态
+    void advance(uint32_t end_state, uint32_t old_state);
+
+    /// 从line行开始到当前frontier之前的分析结果没有送达，退回重新分析这些行（不会因行尾状态一致而跳过）
+    void rewind(size_t line);
+  };
+
+  /// 基于正则规则和状态栈的增量语法高亮：每行缓存行尾词法状态，编辑后从编辑行开始重新分析，
+  /// 直到某行的行尾状态与缓存一致为止，之后的行保持原有结果
+  class SyntaxHighlighter {
+  public:
+    /// 编译语法定义
+    /// @param grammar 语法定义，正则错误时抛出std::regex_error，引用不存在的状态时抛出std::invalid_argument
+    explicit SyntaxHighlighter(const Grammar& grammar);
+
+    /// 绑定文档，所有行重新分析
+    void loadDocument(const Ptr<Document>& document);
+
+    /// 文档文本变更后标记需要重新分析的行
+    /// @param change 变更描述
+    void onTextChanged(const TextChange& change);
+
+    /// 从第一个需要分析的行开始，分析到until_line（包含）为止，中途行尾状态与缓存一致时直接跳过后续已分析的行
+    /// @param until_line 需要保证分析完成的最后一行
+    /// @param max_lines 本次最多分析的行数
+    /// @param decorations 分析结果写入的Span存储
+    /// @param changed_lines 输出Span发生变化的行，需要重新布局
+    /// @return 实际分析的行数
+    size_t highlight(size_t until_line, size_t max_lines, DecorationManager& decorations, Vector<size_t>& changed_lines);
+
+    /// 第一个需要分析的行，不小于行数时整个文档已分析完成
+    size_t getFrontierLine() const;
+
+    /// 分析一行文本
+    /// @param text 行文本（UTF8，不含换行符）
+    /// @param start_state 行首词法状态ID
+    /// @param spans 输出的Span（列为UTF16列号，相邻的同样式Span会合并；超过kMaxHighlightLineBytes的行没有Span）
+    /// @return 行尾词法状态ID
+    uint32_t tokenizeLine(const U8String& text, uint32_t start_state, Vector<StyleSpan>& spans);
+  private:
+    struct CompiledState {
+      // 所有规则合并为一个多选正则，各规则在其中的捕获组下标
+      std::regex regex;
+      Vector<size_t> rule_groups;
+      Vector<int32_t> push_states;
+      uint32_t style_id {0};
+    };
+
+    Grammar m_grammar_;
+    Vector<CompiledState> m_states_;
+    Ptr<Document> m_document_;
+    // 状态栈驻留为ID，行尾状态只需比较一个整数
+    Vector<Vector<uint32_t>> m_stacks_;
+    HashMap<U8String, uint32_t> m_stack_ids_;
+    HighlightFrontier m_frontier_;
+
+    uint32_t internStack(const Vector<uint32_t>& stack);
+  };
+
+  /// 后台分析得到的一行高亮结果
+  struct HighlightResult {
+    /// 分析时的文本版本
+    uint64_t version {0};
+    /// 逻辑行号（对应该版本）
+    size_t line {0};
+    /// 该行的Span
+    Vector<StyleSpan> spans;
+  };
+
+  /// 后台高亮线程：在文档快照上增量分析，结果按文本版本发布，UI线程只接收与当前版本一致的结果；
+  /// 文本变更按顺序投递到后台并同步到快照，视口可见的行优先分析
+  class HighlightWorker {
+  public:
+    /// 编译语法定义并启动后台线程
+    /// @param grammar 语法定义（错误时在调用线程抛出异常，见SyntaxHighlighter）
+    explicit HighlightWorker(const Grammar& grammar);
+    ~HighlightWorker();
+
+    HighlightWorker(const HighlightWorker&) = delete;
+    HighlightWorker& operator=(const HighlightWorker&) = delete;
+
+    /// 复制文档所有行的文本作为快照，所有行重新分析（UI线程调用）
+    /// @param document 文档
+    /// @param version 当前文本版本
+    void loadDocument(const Ptr<Document>& document, uint64_t version);
+
+    /// 投递同一事务的一组文本变更（UI线程按发生顺序调用）
+    /// @param changes 按发生顺序排列的变更，每个变更的坐标基于之前的变更已经生效的文本
+    /// @param new_lines 全部变更生效后，各变更[range.start.line, new_end.line]行的完整文本依次拼接，
+    ///   与前一个变更共用的首行只出现一次
+    /// @param version 变更后的文本版本
+    void postTextChanges(const Vector<TextChange>& changes, Vector<U8String>&& new_lines, uint64_t version);
+
+    /// 设置视口可见的行范围，后台优先分析这些行
+    void setVisibleRange(size_t first_line, size_t last_line);
+
+    /// 设置即将预布局的行范围，与可见范围相连时一并优先分析，使预布局的行直接得到最终的Span
+    void setPrefetchRange(size_t first_line, size_t last_line);
+
+    /// 取出已发布的结果写入Span存储，版本与version不一致的结果直接丢弃（UI线程调用）；
+    /// 后台还有未应用的编辑时不取出，这些过期结果对应的行由后台在新版本上重新分析
+    /// @param version 当前文本版本
+    /// @param decorations Span存储
+    /// @param changed_lines 输出Span发生变化的行
+    void collectResults(uint64_t version, DecorationManager& decorations, Vector<size_t>& changed_lines);
+
+    /// 设置有新结果发布时的回调（在后台线程中调用，平台需要切换到UI线程刷新）
+    void setReadyCallback(std::function<void()> callback);
+
+    /// 后台是否已经分析完当前版本的整个文档（结果可能尚未取出）
+    bool isIdle() const;
+  private:
+    struct PendingChange {
+      Vector<TextChange> changes;
+      Vector<U8String> new_lines;
+      uint64_t version {0};
+    };
+
+    SyntaxHighlighter m_highlighter_;
+    std::thread m_thread_;
+    mutable std::mutex m_mutex_;
+    std::condition_variable m_condition_;
+    // 以下由m_mutex_保护
+    bool m_is_running_ {true};
+    bool m_has_snapshot_ {false};
+    Vector<U8String> m_pending_snapshot_;
+    uint64_t m_snapshot_version_ {0};
+    Vector<PendingChange> m_pending_changes_;
+    size_t m_visible_first_ {0};
+    size_t m_visible_last_ {0};
+    size_t m_prefetch_first_ {SIZE_MAX};
+    size_t m_prefetch_last_ {0};
+    Vector<HighlightResult> m_results_;
+    std::function<void()> m_ready_callback_;
+    bool m_is_idle_ {true};
+    // 最新投递的文本版本，后台分析中途发现版本变化时立即放弃当前批次
+    std::atomic<uint64_t> m_latest_version_ {0};
+    // 以下只在后台线程中访问
+    Vector<U8String> m_lines_;
+    Vector<uint32_t> m_line_states_;
+    uint64_t m_version_ {0};
+    HighlightFrontier m_frontier_;
+    size_t m_speculated_first_ {SIZE_MAX};
+    size_t m_speculated_last_ {0};
+    uint64_t m_speculated_version_ {0};
+
+    void run();
+    std::pair<size_t, size_t> getPriorityRange() const;
+    void applyTextChange(PendingChange& pending);
+    void analyzeVisibleLines(size_t first_line, size_t last_line, Vector<HighlightResult>& results);
+    void analyzeBatch(size_t until_line, Vector<HighlightResult>& results);
+    void publish(Vector<HighlightResult>& results);
+  };
+}
+
+#endif //SWEETEDITOR_HIGHLIGHT_H
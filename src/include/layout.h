@@ -5,8 +5,10 @@
 #ifndef SWEETEDITOR_LAYOUT_H
 #define SWEETEDITOR_LAYOUT_H
 
+#include <functional>
 #include "document.h"
 #include "decoration.h"
+#include "line_blocks.h"
 #include "visual.h"
 
 namespace NS_SWEETEDITOR {
@@ -32,10 +34,244 @@ namespace NS_SWEETEDITOR {
     size_t first_line {0};
     /// 可见的最后一行行号索引
     size_t last_line {0};
-    /// 可见的第一行纵坐标(只有部分可见情况下该坐标为负值)
+    /// 可见的第一行相对视口顶部的纵坐标，未缩放(只有部分可见情况下该坐标为负值)
     float first_line_y {0};
   };
 
+  /// 渲染片段文本在文档行缓存中的引用
+  struct RunTextRef {
+    /// 逻辑行号
+    size_t line {0};
+    /// 在行中的起始列
+    size_t column {0};
+    /// 字符长度
+    size_t length {0};
+    /// 镶嵌内容在行布局缓存中的下标（普通文本为-1）
+    int64_t inlay_index {-1};
+    /// 引用时该行的内容版本
+    uint32_t version {0};
+
+    bool operator==(const RunTextRef& other) const;
+  };
+
+  struct RunTextRefHash {
+    size_t operator()(const RunTextRef& ref) const;
+  };
+
+  /// 已分配的片段文本ID槽位
+  struct RunTextEntry {
+    /// 文本引用
+    RunTextRef ref;
+    /// 最近一次被引用的帧
+    uint64_t frame {0};
+    /// 槽位被回收的次数，与槽位下标一起组成text_id，回收后旧ID不会指向复用该槽位的新文本
+    uint32_t generation {0};
+    /// 槽位是否正在使用
+    bool is_used {false};
+  };
+
+  /// 超过该字节长度的行进入超长行模式，按块虚拟化布局
+  constexpr size_t kLongLineBytes = 64 * 1024;
+  /// 超长行每块的字节长度
+  constexpr size_t kLineChunkBytes = 4 * 1024;
+  /// 每次切分最多产生的片段数，超出后剩余的文本合并为一个片段（避免渲染端绘制过多片段）
+  constexpr size_t kMaxLineRuns = 1024;
+  /// 字体变体个数（是否加粗 × 是否斜体），宽度缓存按变体区分
+  constexpr size_t kFontVariantCount = 4;
+
+  /// 预布局统计
+  struct PrefetchStats {
+    /// 新进入视口时已经完成布局的行数
+    uint64_t hit_count {0};
+    /// 新进入视口时需要同步布局的行数
+    uint64_t miss_count {0};
+    /// 预布局完成的行数
+    uint64_t prefetched_lines {0};
+  };
+
+  /// 折叠区域，首行始终可见，折叠时隐藏其后直到end_line的行
+  struct FoldRange {
+    /// 折叠区域首行
+    size_t start_line {0};
+    /// 折叠区域末行（包含）
+    size_t end_line {0};
+    /// 是否已折叠
+    bool collapsed {false};
+  };
+
+  /// LineHeightIndex的块：每行的高度与单独被隐藏的次数，以及块内未隐藏的行数与高度之和
+  struct LineHeightIndexBlock {
+    struct Item {
+      float height {0};
+      uint32_t hidden {0};
+    };
+    Vector<Item> lines;
+    // 整块被隐藏的次数，线段树重建前由节点的计数下传而来
+    uint32_t block_hidden {0};
+    size_t visible_lines {0};
+    double visible_height {0};
+
+    bool isLineVisible(size_t offset) const;
+    void refresh();
+  };
+
+  /// 逻辑行高度索引，O(log n)完成行号与纵坐标的互相查询以及单行高度更新，
+  /// 某一行高度变化时后续所有行的纵坐标隐式平移，无需逐行修改；
+  /// 折叠的行按区间打隐藏标记，不计入纵坐标，折叠/展开时不需要逐行处理；
+  /// 行按块存储（LineBlockTree），增删行只修改所在的块，块数变化时才重建块上的线段树
+  class LineHeightIndex : public LineBlockTree<LineHeightIndex, LineHeightIndexBlock> {
+  public:
+    /// 重置为指定行数，所有行使用默认高度且都不隐藏
+    /// @param line_count 行数
+    /// @param default_height 默认行高（尚未布局的行按此估算）
+    void reset(size_t line_count, float default_height);
+
+    /// 获取指定行的高度（不考虑隐藏）
+    float getHeight(size_t line) const;
+
+    /// 更新指定行的高度
+    void setHeight(size_t line, float height);
+
+    /// 获取指定行的起始纵坐标（隐藏的行不占高度）
+    float getLineY(size_t line) const;
+
+    /// 获取纵坐标所在的可见行（超出范围时返回首个或最后一个可见行）
+    size_t getLineAtY(float y) const;
+
+    /// 所有可见行的总高度
+    float getTotalHeight() const;
+
+    /// 在line处删除removed行再插入inserted行，新行使用默认高度且不隐藏，其余行保留隐藏标记；
+    /// 只涉及一个块时耗时O(块大小 + log n)
+    void spliceLines(size_t line, size_t removed, size_t inserted);
+
+    /// 批量增删行（例如多光标换行），处数较多时一次遍历重新分块，只重建一次线段树
+    /// @param splices 按行号从前往后排列，每处的行号都基于之前的增删已经生效后的行
+    void spliceLines(const Vector<LineSplice>& splices);
+
+    /// 隐藏或取消隐藏[start, end)范围内的行，嵌套的区间按次数计数
+    /// @param start 起始行
+    /// @param end 结束行（不包含）
+    /// @param hidden true隐藏，false撤销一次之前的隐藏
+    void setLinesHidden(size_t start, size_t end, bool hidden);
+
+    /// 指定行是否被隐藏
+    bool isHidden(size_t line) const;
+
+    /// 从line（包含）开始向后查找第一个未隐藏的行，不存在时返回size()
+    size_t nextVisibleLine(size_t line) const;
+
+    /// 从line（包含）开始向前查找第一个未隐藏的行，不存在时返回size()
+    size_t prevVisibleLine(size_t line) const;
+  private:
+    friend class LineBlockTree<LineHeightIndex, LineHeightIndexBlock>;
+    using Block = LineHeightIndexBlock;
+
+    float m_default_height_ {0};
+    // 线段树节点排列见LineBlockTree，每个节点另外记录区间内未被隐藏的行数与高度之和，以及整个区间被隐藏的次数
+    Vector<size_t> m_visible_lines_;
+    Vector<double> m_visible_;
+    Vector<uint32_t> m_hidden_;
+
+    void pullNode(size_t node, size_t lo, size_t hi);
+    void resizeNodes(size_t node_count);
+    void pushDown(size_t node, size_t lo, size_t hi);
+    void pushDownPath(size_t block);
+    void pushDownAll();
+    void pushDownAll(size_t node, size_t lo, size_t hi, uint32_t hidden);
+    void flattenBlock(Block& block);
+    void updateHidden(size_t node, size_t lo, size_t hi, size_t base, size_t start, size_t end, bool hidden);
+    size_t findVisible(size_t node, size_t lo, size_t hi, size_t base, size_t line, bool forward) const;
+    double prefixSum(size_t count) const;
+  };
+
+  /// 缩进区块：首行之后连续的缩进更深的行（中间可以有空白行）
+  struct IndentBlock {
+    /// 区块首行（缩进较浅的行）
+    size_t header_line {0};
+    /// 首行的缩进列数
+    uint32_t indent {0};
+    /// 区块内首个非空白行的缩进列数
+    uint32_t body_indent {0};
+    /// 区块内最后一个非空白行（末尾的空白行不属于区块）
+    size_t last_line {0};
+    /// 是否找到了区块的结束位置，超出计算窗口时为false，last_line只是窗口内的最后一个非空白行
+    bool is_end_known {true};
+  };
+
+  /// IndentIndex的块：每行的缩进列数（UINT32_MAX表示尚未计算），以及块内的最小缩进
+  struct IndentIndexBlock {
+    using Item = uint32_t;
+    Vector<uint32_t> lines;
+    // 尚未计算的行按0记录，查询命中时再计算
+    uint32_t min_indent {0};
+
+    void refresh();
+  };
+
+  /// 按缩进划分代码区块的行索引
+  /// 每行的缩进列数（制表符按制表位展开）在需要时才计算并缓存，编辑后只重置变更涉及的行；
+  /// 行按块存储（LineBlockTree），块上的线段树维护区间内的最小缩进，O(log n)找到某行之前或之后第一个缩进更浅的行；
+  /// 收集区块时只计算视口附近窗口内的行，窗口外尚未计算的行视为未知，区块在此截断
+  class IndentIndex : public LineBlockTree<IndentIndex, IndentIndexBlock> {
+  public:
+    /// 计算指定行的缩进列数，空白行返回kBlankIndent
+    using IndentProvider = std::function<uint32_t(size_t line)>;
+    /// 空白行的缩进，不小于任何查询的上限，因此不会成为区块首行或区块边界
+    static constexpr uint32_t kBlankIndent = UINT32_MAX - 1;
+    /// 收集区块时在查询范围前后各计算的最大行数
+    static constexpr size_t kResolveWindowLines = 4096;
+
+    explicit IndentIndex(IndentProvider provider);
+
+    /// 重置为指定行数，所有行的缩进都需要重新计算
+    void reset(size_t line_count);
+
+    /// 在line处删除removed行再插入inserted行，新行的缩进在需要时计算，其余行保留已计算的缩进；
+    /// 只涉及一个块时耗时O(块大小 + log n)
+    void spliceLines(size_t line, size_t removed, size_t inserted);
+
+    /// 批量增删行，处数较多时一次遍历重新分块，只重建一次线段树
+    /// @param splices 按行号从前往后排列，每处的行号都基于之前的增删已经生效后的行
+    void spliceLines(const Vector<LineSplice>& splices);
+
+    /// 标记[start, end)范围内的行需要重新计算缩进
+    void invalidateLines(size_t start, size_t end);
+
+    /// 获取指定行的缩进列数，空白行返回kBlankIndent
+    uint32_t getIndent(size_t line);
+
+    /// 在line之前（不包含）查找最后一个缩进小于limit的行，不存在时返回size()
+    size_t findPrevLess(size_t line, uint32_t limit);
+
+    /// 从line（包含）开始向后查找第一个缩进小于limit的行，不存在时返回size()
+    size_t findNextLess(size_t line, uint32_t limit);
+
+    /// 收集与[first_line, last_line]相交的区块：先是包含范围首个非空白行的外层区块（由外到内），再是范围内开始的区块（按行号）
+    /// 只计算范围前后kResolveWindowLines行以内的缩进，首行在窗口之外的外层区块不输出；
+    /// 缩进已缓存时耗时O((区块数 + 1) * log n + 范围内的行数)
+    /// @param first_line 起始行
+    /// @param last_line 结束行（包含）
+    /// @param next_line 返回从指定行（包含）开始下一个需要检查的行，用于跳过折叠隐藏的行
+    /// @param blocks 输出的区块
+    void collectBlocks(size_t first_line, size_t last_line, const std::function<size_t(size_t)>& next_line, Vector<IndentBlock>& blocks);
+  private:
+    friend class LineBlockTree<IndentIndex, IndentIndexBlock>;
+    using Block = IndentIndexBlock;
+    static constexpr uint32_t kUnknownIndent = UINT32_MAX;
+
+    IndentProvider m_provider_;
+    // 线段树节点排列见LineBlockTree，每个节点另外记录区间内的最小缩进
+    Vector<uint32_t> m_min_;
+
+    void pullNode(size_t node, size_t lo, size_t hi);
+    void resizeNodes(size_t node_count);
+    size_t findLess(size_t node, size_t lo, size_t hi, size_t base, size_t line, uint32_t limit, bool forward) const;
+    size_t findLessInWindow(size_t line, uint32_t limit, bool forward, size_t window_start, size_t window_end);
+    bool isResolved(size_t line) const;
+    IndentBlock makeBlock(size_t header_line, size_t window_start, size_t window_end);
+  };
+
   /// 文本宽度测量接口，由各平台实现
   class TextMeasurer {
   public:
@@ -65,11 +301,122 @@ namespace NS_SWEETEDITOR {
 
     void setWrapMode(WrapMode mode);
 
+    /// 标记缩放手势是否进行中，进行中时保持原有断行位置，只按比例缩放坐标
+    /// @param scaling 是否正在缩放
+    void setScaling(bool scaling);
+
+    /// 设置制表位间隔（空格宽度的倍数），会使所有行的布局失效
+    void setTabSize(uint32_t tab_size);
+
+    /// 设置是否输出可见空白片段
+    void setShowWhitespace(bool show);
+
     void layoutLine(size_t index, LogicalLine& logical_line);
 
+    /// 标记指定行的布局失效（例如高亮Span变化），下次可见时重新布局
+    /// @param line 逻辑行号
+    void invalidateLine(size_t line);
+
+    /// 文档文本变更后同步行高索引（只调整变更涉及的行）
+    /// @param change 变更描述
+    void onTextChanged(const TextChange& change);
+
+    /// 一次处理批量编辑的所有变更，折叠区域和行索引的增删行各自一次完成
+    /// @param changes 按位置从前往后排列的变更，每个变更的坐标都基于之前的变更已经生效的文本
+    void onTextChangedBatch(const Vector<TextChange>& changes);
+
+    /// 设置折叠区域（会替换原有的所有区域），已折叠的区域立即生效
+    /// @param ranges 折叠区域，首行不能与末行相同
+    void setFoldRanges(const Vector<FoldRange>& ranges);
+
+    /// 折叠或展开以指定行为首行的区域（存在多个时取最外层），O(log n)
+    /// @param line 折叠区域首行
+    /// @param collapsed 是否折叠
+    /// @return 折叠状态是否发生变化
+    bool setFoldCollapsed(size_t line, bool collapsed);
+
+    /// 获取所有折叠区域（按首行排序，行号随编辑自动平移）
+    const Vector<FoldRange>& getFoldRanges() const;
+
+    /// 指定行是否因折叠而隐藏
+    bool isLineHidden(size_t line) const;
+
+    /// 获取指定行的起始纵坐标（文档坐标）
+    /// @param line 逻辑行号
+    float getLineY(size_t line);
+
+    /// 获取指定行的纵向范围（文档坐标），只布局这一行以修正估算的行高，其它行的纵坐标由高度索引O(log n)求得
+    /// @param line 逻辑行号，折叠隐藏的行返回其所在折叠区域首行的范围
+    /// @param top 输出行的起始纵坐标
+    /// @param height 输出行高
+    void getLineBounds(size_t line, float& top, float& height);
+
+    /// 获取纵坐标所在的逻辑行
+    /// @param y 文档坐标
+    size_t getLineAtY(float y);
+
+    /// 获取文档总高度
+    float getContentHeight();
+
+    /// 组装可见区域的渲染模型，包括可见行所在缩进区块的引导线和诊断信息下划线
     void composeRenderModel(EditorRenderModel& model);
 
-    const U16String& getTextById(int64_t text_id);
+    /// 输出光标和选区背景，主光标输出到model.cursor（不可见时同样计算坐标），其它可见光标输出到model.extra_cursors，
+    /// 选区只输出可见视觉行内裁剪到视口的矩形（选中整个超大文档时也不会遍历所有行）
+    /// 须在同一帧的composeRenderModel之后调用，只二分查找并转换与可见行相交的选区
+    /// @param selections 按位置升序、互不重叠的选区
+    /// @param primary_index 主光标在selections中的下标
+    /// @param model 当前帧的渲染模型
+    void composeSelections(const Vector<Selection>& selections, size_t primary_index, EditorRenderModel& model);
+
+    /// 获取文本位置在视口中的坐标（所在视觉行的顶部，缩放后的视口坐标）
+    /// @param position 文本位置，超出文档时限制到文档范围内
+    PointF getPositionPoint(const TextPosition& position);
+
+    /// 在空闲时间提前布局一段区域内的行（断行、测量宽度缓存），快速滚动到该区域时无需同步布局
+    /// @param from_y 起始纵坐标（未缩放的文档坐标），从这里开始向to_y方向布局
+    /// @param to_y 终止纵坐标（未缩放的文档坐标），小于from_y时向上布局
+    /// @param max_lines 本次最多布局的行数
+    /// @return 实际布局的行数，为0时表示该区域已经全部布局完成
+    size_t prefetchLayout(float from_y, float to_y, size_t max_lines);
+
+    /// 获取预布局的命中统计
+    const PrefetchStats& getPrefetchStats() const;
+
+    /// 获取渲染片段文本ID对应的文本
+    /// @param text_id 片段文本ID（同一行版本中相同位置的片段在各帧使用同一ID，最近一帧没有引用的ID在下一次composeRenderModel后失效）
+    /// @return 指向文档行缓存的文本视图
+    U16StringView getTextById(int64_t text_id) const;
+
+    /// 获取文本ID查找表的容量，滚动时复用已有容量，只在同时引用的片段数超过以往峰值时扩容
+    size_t getTextIdCapacity() const;
+
+    /// 获取指定行列位置（光标）相对行首的横坐标，位于该列镶嵌内容之前（二分前缀宽度缓存，无需重新测量）
+    /// @param line 逻辑行号
+    /// @param column 列
+    /// @return 相对行首的横坐标
+    float getColumnX(size_t line, size_t column);
+
+    /// 获取横坐标最靠近的列位置（二分前缀宽度缓存，无需重新测量）
+    /// @param line 逻辑行号
+    /// @param x 相对行首的横坐标
+    /// @return 最靠近的列
+    size_t getColumnAtX(size_t line, float x);
+
+    /// 获取视口坐标处的文本位置（点击定位光标），纵向通过高度索引定位行和视觉行，横向二分前缀宽度缓存，无需重新测量
+    /// @param point 缩放后的视口坐标
+    /// @return 最靠近的文本位置，点击镶嵌内容或幽灵文本时落到其所在的列
+    TextPosition getPositionAtPoint(const PointF& point);
+
+    /// 获取光标左移一个字素簇后的列（不会停在代理对或组合序列中间）
+    /// @param line 逻辑行号
+    /// @param column 当前列
+    size_t getPrevCaretColumn(size_t line, size_t column);
+
+    /// 获取光标右移一个字素簇后的列
+    /// @param line 逻辑行号
+    /// @param column 当前列
+    size_t getNextCaretColumn(size_t line, size_t column);
 
     void resetMeasurer();
 
@@ -78,24 +425,97 @@ namespace NS_SWEETEDITOR {
     Ptr<TextMeasurer> m_measurer_;
     Ptr<Document> m_document_;
     Ptr<DecorationManager> m_decoration_manager_;
+    // 当前使用的样式快照
+    Ptr<const StyleSnapshot> m_styles_;
     Viewport m_viewport_;
     ViewState m_view_state_;
     WrapMode m_wrap_mode_ {WrapMode::NONE};
+    // 当前断行使用的宽度（未缩放坐标）
+    float m_wrap_width_ {0};
+    bool m_is_scaling_ {false};
+    // 布局代数，使所有行的布局失效时只需递增，各行在下次布局时比较
+    uint32_t m_layout_epoch_ {0};
     EditorParams m_params_;
     bool m_is_monospace_ {true};
     float m_number_width_;
     float m_space_width_;
-    // text_id 到相应文本的映射
-    HashMap<int64_t, U16String> m_text_mapping_;
-    int64_t m_text_id_counter_ {0};
-    // 每个字符的测量宽度缓存
-    HashMap<U16String, float> m_text_widths_;
-
-    float measureWidth(const U16String& text, bool is_bold);
-    int64_t createTextId(const U16String& text);
-    void removeTextId(int64_t id);
+    // 逻辑行高度索引
+    LineHeightIndex m_height_index_;
+    // 折叠区域（按首行排序），已折叠区域的隐藏标记记录在高度索引中
+    Vector<FoldRange> m_fold_ranges_;
+    // 缩进区块索引，用于生成引导线
+    IndentIndex m_indent_index_;
+    // 当前帧与可见行相交的缩进区块，每帧复用内存
+    Vector<IndentBlock> m_guide_blocks_;
+    // 当前帧与可见行相交的诊断信息，每帧复用内存
+    Vector<Diagnostic> m_frame_diagnostics_;
+    PrefetchStats m_prefetch_stats_;
+    // 上一帧可见的逻辑行范围，用于统计新进入视口的行
+    size_t m_last_first_line_ {1};
+    size_t m_last_last_line_ {0};
+    // text_id到文档行缓存的引用：平台保留的上一帧视觉行（增量模型中未变化或仅位移的行）继续使用原ID，
+    // 因此ID不能按帧内下标分配；每帧结束时回收当前帧没有引用的ID。
+    // 槽位表、空闲链表和开放寻址的查找表在各帧之间保留容量，片段滚入滚出视口时不分配内存
+    static constexpr uint32_t kEmptyTextSlot = UINT32_MAX;
+    static constexpr size_t kMinTextSlots = 256;
+    Vector<RunTextEntry> m_run_texts_;
+    Vector<uint32_t> m_free_run_texts_;
+    // 线性探测的查找表，元素为m_run_texts_中的下标，容量为2的幂且至少是使用中槽位数的2倍
+    Vector<uint32_t> m_run_text_slots_;
+    uint64_t m_text_frame_ {0};
+    // 每种字体变体的字素簇宽度缓存，单个ASCII字符直接查表（小于0表示尚未测量）
+    static constexpr size_t kAsciiCount = 128;
+    HashMap<U16String, float> m_text_widths_[kFontVariantCount];
+    float m_ascii_widths_[kFontVariantCount][kAsciiCount];
+
+    float measureWidth(const U16String& text, uint32_t style_id, size_t variant);
+    float measureClusterWidth(const U16Char* text, size_t length, uint32_t style_id, size_t variant);
+    size_t getFontVariant(uint32_t style_id) const;
+    void syncStyles();
+    int64_t createFrameTextId(size_t line, size_t column, size_t length, int64_t inlay_index = -1);
+    size_t findTextSlot(const RunTextRef& text_ref) const;
+    void eraseTextSlot(size_t position);
+    void growTextSlots();
+    void recycleTextIds();
+    void shiftTextIds(const Vector<TextChange>& changes);
+    void releaseTextIds();
+    void buildPrefixWidths(const U16String& line_text, const Vector<uint64_t>& cluster_bits, float origin_x,
+      const StyleSpan* first_span, const StyleSpan* last_span, size_t span_offset,
+      const Vector<InlayBox>& inlay_boxes, Vector<float>& prefix_widths);
+    void buildInlayBoxes(size_t index, LogicalLine& logical_line);
+    static float getCaretX(const LogicalLine& logical_line, size_t column);
+    static size_t getVisualStartColumn(const LogicalLine& logical_line, size_t wrap_index);
+    static size_t findWrapIndex(const LogicalLine& logical_line, size_t column);
+    void layoutVisualLines(size_t index, LogicalLine& logical_line);
+    void layoutLongLine(size_t index, LogicalLine& logical_line);
+    LineChunk& ensureChunk(size_t line, LogicalLine& logical_line, size_t chunk_index);
+    void emitLongLineRuns(size_t index, LogicalLine& logical_line, VisualLine& visual_line);
+    static size_t findChunkByColumn(const Vector<LineChunk>& chunks, size_t column);
+    static size_t findChunkAtX(const Vector<LineChunk>& chunks, float x);
+    static size_t findColumnAtX(const U16String& line_text, const Vector<uint64_t>& cluster_bits, const Vector<float>& prefix_widths,
+      const Vector<InlayBox>& inlay_boxes, float x);
+    LogicalLine& ensureLineLayout(size_t line);
+    bool isLayoutValid(const LogicalLine& logical_line) const;
+    float nextTabStop(float x) const;
+    void splitLineRuns(const U16String& line_text, const Vector<uint64_t>& cluster_bits, const Vector<float>& prefix_widths,
+      const StyleSpan* first_span, const StyleSpan* last_span, size_t span_offset, const Vector<InlayBox>& inlay_boxes,
+      size_t start_column, size_t end_column, float origin_x, float line_y, Vector<VisualRun>& runs);
+    float getDefaultLineHeight() const;
+    void syncHeightIndex();
+    void resetHeightIndex();
+    uint32_t computeLineIndent(size_t line) const;
+    void syncIndentIndex();
+    void composeGuideLines(const VisibleLineInfo& visible_line_info, EditorRenderModel& model);
+    void composeDiagnostics(const VisibleLineInfo& visible_line_info, EditorRenderModel& model);
+    void composeSelectionRects(const TextRange& range, EditorRenderModel& model);
+    void shiftFoldRanges(const Vector<TextChange>& changes);
+    bool isFoldHeader(size_t line) const;
     VisibleLineInfo computeVisibleLineInfo();
-    void cropVisualLineRuns(VisualLine& visual_line);
+    void invalidateLayouts();
+    void updateTextArea();
+    void updateWrapWidth();
+    size_t findWrapColumn(const LogicalLine& logical_line, size_t start_column) const;
+    void cropVisualLineRuns(const LogicalLine& logical_line, VisualLine& visual_line);
     float computeLineNumberWidth() const;
   };
 }
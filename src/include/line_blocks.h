@@ -0,0 +1,284 @@
+//
+// Created by Scave on 2025/12/20.
+//
+
+#ifndef SWEETEDITOR_LINE_BLOCKS_H
+#define SWEETEDITOR_LINE_BLOCKS_H
+
+#include <algorithm>
+#include <iterator>
+#include "macro.h"
+
+namespace NS_SWEETEDITOR {
+  /// 一处行的增删：在line处删除removed行再插入inserted行
+  struct LineSplice {
+    size_t line {0};
+    size_t removed {0};
+    size_t inserted {0};
+  };
+
+  /// 按块存储的逐行数据：行分成若干块，块上的线段树记录区间内的行数，O(log n)按行号定位；
+  /// 增删行只修改所在的块，耗时O(块大小 + log n)，块数变化时才重建线段树
+  /// 使用方以CRTP继承，只需实现节点上的聚合值与查询，可以隐藏以下钩子（默认不做任何事）：
+  /// - pullNode(node, lo, hi)：由子节点（叶子为块）计算节点的聚合值，调用时m_lines_[node]已经更新
+  /// - resizeNodes(node_count)：重建线段树时重置聚合值数组
+  /// - pushDownPath(block)、pushDownAll()：把节点上尚未下传的懒标记下传到块，修改块之前调用
+  /// - flattenBlock(block)：把块级的状态合并到逐行数据，块内的行被移动或插入新行之前调用
+  /// @tparam Block 需要提供Item类型、Vector<Item> lines成员和refresh()（由逐行数据重新计算块的聚合值）
+  template<typename Derived, typename Block>
+  class LineBlockTree {
+  public:
+    using Item = typename Block::Item;
+
+    /// 行数
+    size_t size() const {
+      return m_lines_.empty() ? 0 : m_lines_[0];
+    }
+  protected:
+    // 每块的目标行数，增删行后超过上限的块拆分，低于下限的块与相邻块合并
+    static constexpr size_t kBlockLines = 64;
+    static constexpr size_t kMaxBlockLines = kBlockLines * 2;
+    static constexpr size_t kMinBlockLines = kBlockLines / 4;
+    // 批量增删的处数超过块数的1/kBatchSpliceRatio时一次遍历重新分块
+    static constexpr size_t kBatchSpliceRatio = 16;
+
+    Vector<Block> m_blocks_;
+    // 线段树建立在块上，节点按先序排列：节点[lo, hi)的左子节点为node + 1，右子节点为node + 2 * (mid - lo)，共2n - 1个节点
+    Vector<size_t> m_lines_;
+
+    /// 整体替换所有行并重新分块
+    void resetItems(Vector<Item>&& items) {
+      m_blocks_.clear();
+      appendBlocks(std::move(items), m_blocks_);
+      rebuild();
+    }
+
+    /// 在line处删除removed行再插入inserted行，新行的值为value
+    void spliceItems(size_t line, size_t removed, size_t inserted, const Item& value) {
+      const size_t count = size();
+      line = std::min(line, count);
+      removed = std::min(removed, count - line);
+      if (removed == 0 && inserted == 0) {
+        return;
+      }
+      // 定位受影响的首尾块，在末尾插入时归入最后一块
+      size_t first = 0;
+      size_t first_offset = 0;
+      if (line < count) {
+        first = locate(line, first_offset);
+      } else if (!m_blocks_.empty()) {
+        first = m_blocks_.size() - 1;
+        first_offset = m_blocks_[first].lines.size();
+      }
+      size_t last = first;
+      size_t last_end = first_offset + removed;
+      if (removed > 0) {
+        last = locate(line + removed - 1, last_end);
+        ++last_end;
+      }
+      if (!m_blocks_.empty() && first == last) {
+        // 只涉及一个块且增删后大小仍在范围内时原地修改，只更新一条路径
+        const size_t new_size = m_blocks_[first].lines.size() - removed + inserted;
+        if (new_size > 0 && new_size <= kMaxBlockLines && (new_size >= kMinBlockLines || m_blocks_.size() == 1)) {
+          derived().pushDownPath(first);
+          Block& block = m_blocks_[first];
+          if (inserted > 0) {
+            // 新行不继承块级的状态
+            derived().flattenBlock(block);
+          }
+          block.lines.erase(block.lines.begin() + first_offset, block.lines.begin() + last_end);
+          block.lines.insert(block.lines.begin() + first_offset, inserted, value);
+          block.refresh();
+          updateBlock(0, 0, m_blocks_.size(), first);
+          return;
+        }
+      }
+      // 块数会变化：节点上的懒标记先下传到块，受影响的块（不足下限时连同相邻块）合并后重新均分，再重建线段树
+      if (!m_blocks_.empty()) {
+        derived().pushDownAll();
+      }
+      size_t range_begin = first;
+      size_t range_end = m_blocks_.empty() ? first : last + 1;
+      const size_t tail_size = m_blocks_.empty() ? 0 : m_blocks_[last].lines.size() - last_end;
+      if (first_offset + inserted + tail_size < kMinBlockLines) {
+        if (range_end < m_blocks_.size()) {
+          ++range_end;
+        } else if (range_begin > 0) {
+          --range_begin;
+        }
+      }
+      Vector<Item> items;
+      auto append = [&](size_t index, size_t from, size_t to) {
+        Block& block = m_blocks_[index];
+        derived().flattenBlock(block);
+        items.insert(items.end(), std::make_move_iterator(block.lines.begin() + from),
+          std::make_move_iterator(block.lines.begin() + to));
+      };
+      if (range_begin < first) {
+        append(range_begin, 0, m_blocks_[range_begin].lines.size());
+      }
+      if (!m_blocks_.empty()) {
+        append(first, 0, first_offset);
+      }
+      items.insert(items.end(), inserted, value);
+      if (!m_blocks_.empty()) {
+        append(last, last_end, m_blocks_[last].lines.size());
+      }
+      if (range_end > last + 1) {
+        append(last + 1, 0, m_blocks_[last + 1].lines.size());
+      }
+      Vector<Block> blocks;
+      appendBlocks(std::move(items), blocks);
+      m_blocks_.erase(m_blocks_.begin() + range_begin, m_blocks_.begin() + range_end);
+      m_blocks_.insert(m_blocks_.begin() + range_begin, std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+      rebuild();
+    }
+
+    /// 批量增删行，处数较多时一次遍历重新分块，只重建一次线段树
+    /// @param splices 按行号从前往后排列，每处的行号都基于之前的增删已经生效后的行
+    /// @param value 新行的值
+    void spliceItems(const Vector<LineSplice>& splices, const Item& value) {
+      if (splices.size() * kBatchSpliceRatio <= m_blocks_.size()) {
+        for (const LineSplice& splice : splices) {
+          spliceItems(splice.line, splice.removed, splice.inserted, value);
+        }
+        return;
+      }
+      // 节点上的懒标记先下传到块，再按顺序合并原有的行与各处增删的行，最后统一分块
+      if (!m_blocks_.empty()) {
+        derived().pushDownAll();
+      }
+      Vector<Item> items;
+      items.reserve(size());
+      size_t block_index = 0;
+      size_t offset = 0;
+      auto take_lines = [&](size_t count, bool keep) {
+        while (count > 0 && block_index < m_blocks_.size()) {
+          Block& block = m_blocks_[block_index];
+          if (offset == 0) {
+            derived().flattenBlock(block);
+          }
+          const size_t taken = std::min(count, block.lines.size() - offset);
+          if (keep) {
+            items.insert(items.end(), std::make_move_iterator(block.lines.begin() + offset),
+              std::make_move_iterator(block.lines.begin() + offset + taken));
+          }
+          offset += taken;
+          count -= taken;
+          if (offset == block.lines.size()) {
+            ++block_index;
+            offset = 0;
+          }
+        }
+      };
+      for (const LineSplice& splice : splices) {
+        take_lines(splice.line - std::min(splice.line, items.size()), true);
+        take_lines(splice.removed, false);
+        items.insert(items.end(), splice.inserted, value);
+      }
+      take_lines(SIZE_MAX, true);
+      resetItems(std::move(items));
+    }
+
+    /// 重建块上的线段树
+    void rebuild() {
+      const size_t block_count = m_blocks_.size();
+      const size_t node_count = block_count == 0 ? 0 : block_count * 2 - 1;
+      m_lines_.assign(node_count, 0);
+      derived().resizeNodes(node_count);
+      if (block_count > 0) {
+        build(0, 0, block_count);
+      }
+    }
+
+    /// 由子节点重新计算节点的行数与聚合值
+    void pull(size_t node, size_t lo, size_t hi) {
+      if (hi - lo == 1) {
+        m_lines_[node] = m_blocks_[lo].lines.size();
+      } else {
+        const size_t mid = (lo + hi) / 2;
+        m_lines_[node] = m_lines_[node + 1] + m_lines_[node + 2 * (mid - lo)];
+      }
+      derived().pullNode(node, lo, hi);
+    }
+
+    /// 定位行所在的块
+    /// @param offset 返回行在块内的下标
+    /// @return 块下标
+    size_t locate(size_t line, size_t& offset) const {
+      size_t node = 0;
+      size_t lo = 0;
+      size_t hi = m_blocks_.size();
+      while (hi - lo > 1) {
+        const size_t mid = (lo + hi) / 2;
+        const size_t left = node + 1;
+        if (line < m_lines_[left]) {
+          node = left;
+          hi = mid;
+        } else {
+          line -= m_lines_[left];
+          node += 2 * (mid - lo);
+          lo = mid;
+        }
+      }
+      offset = line;
+      return lo;
+    }
+
+    /// 块内的数据变化后更新从根节点到该块的路径
+    void updateBlock(size_t node, size_t lo, size_t hi, size_t block) {
+      if (hi - lo > 1) {
+        const size_t mid = (lo + hi) / 2;
+        if (block < mid) {
+          updateBlock(node + 1, lo, mid, block);
+        } else {
+          updateBlock(node + 2 * (mid - lo), mid, hi, block);
+        }
+      }
+      pull(node, lo, hi);
+    }
+
+    void pullNode(size_t, size_t, size_t) {
+    }
+
+    void resizeNodes(size_t) {
+    }
+
+    void pushDownPath(size_t) {
+    }
+
+    void pushDownAll() {
+    }
+
+    void flattenBlock(Block&) {
+    }
+  private:
+    Derived& derived() {
+      return static_cast<Derived&>(*this);
+    }
+
+    void build(size_t node, size_t lo, size_t hi) {
+      if (hi - lo > 1) {
+        const size_t mid = (lo + hi) / 2;
+        build(node + 1, lo, mid);
+        build(node + 2 * (mid - lo), mid, hi);
+      }
+      pull(node, lo, hi);
+    }
+
+    static void appendBlocks(Vector<Item>&& items, Vector<Block>& blocks) {
+      // 均分为不超过kBlockLines行的若干块
+      const size_t total = items.size();
+      const size_t block_count = (total + kBlockLines - 1) / kBlockLines;
+      for (size_t i = 0; i < block_count; ++i) {
+        Block block;
+        block.lines.assign(std::make_move_iterator(items.begin() + total * i / block_count),
+          std::make_move_iterator(items.begin() + total * (i + 1) / block_count));
+        block.refresh();
+        blocks.push_back(std::move(block));
+      }
+    }
+  };
+}
+
+#endif //SWEETEDITOR_LINE_BLOCKS_H
@@ -7,6 +7,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -52,6 +53,7 @@ using U16Char = char16_t;
 #define CHAR16_PTR(ptr) ptr
 #endif
 using U16String = std::basic_string<U16Char>;
+using U16StringView = std::basic_string_view<U16Char>;
 
 /// lambda或函数签名检查（允许返回类型转换）
 template <typename T, typename Ret, typename... Args>
@@ -59,7 +59,29 @@ namespace NS_SWEETEDITOR {
     /// 将UTF16文本拷贝生成长生命周期的U16Char字符串
     /// @param utf16_str UTF16文本
     /// @return  U16Char*
-    static U16Char* allocU16Chars(const U16String& utf16_str);
+    static U16Char* allocU16Chars(U16StringView utf16_str);
+
+    /// 将UTF16文本拷贝到调用方提供的内存，容量足够时在末尾写入0
+    /// @param utf16_str UTF16文本
+    /// @param buffer 目标内存
+    /// @param capacity 目标内存容量（编码单元数）
+    /// @return 文本的完整长度
+    static size_t copyU16Chars(U16StringView utf16_str, U16Char* buffer, size_t capacity);
+
+    /// 查找第一个空格或制表符（SSE2/NEON一次比较8个编码单元）
+    /// @param text UTF16文本
+    /// @param length 文本长度
+    /// @param start 起始下标
+    /// @return 第一个空白字符的下标，没有时返回length
+    static size_t findWhitespace(const U16Char* text, size_t length, size_t start);
+
+    /// 跳过连续的指定字符（SSE2/NEON一次比较8个编码单元）
+    /// @param text UTF16文本
+    /// @param length 文本长度
+    /// @param start 起始下标
+    /// @param ch 要跳过的字符
+    /// @return 第一个不等于ch的下标，没有时返回length
+    static size_t skipChar(const U16Char* text, size_t length, size_t start, U16Char ch);
   };
 }
 
@@ -21,7 +21,9 @@ namespace NS_SWEETEDITOR {
     /// 镶嵌内容（文本或图标）
     INLAY_HINT,
     /// 幽灵文本（用于Copilot代码提示）
-    PHANTOM_TEXT
+    PHANTOM_TEXT,
+    /// 制表符（每个制表符单独一个片段，宽度按制表位计算）
+    TAB,
   };
 
   /// 视觉上渲染的每个文本片段结构定义
@@ -38,7 +40,7 @@ namespace NS_SWEETEDITOR {
     float y {0};
     /// 片段的文本内容ID（只有TEXT、INLAY_HINT、PHANTOM_TEXT会有）
     int64_t text_id {-1};
-    /// 样式ID
+    /// 样式ID（图标镶嵌片段为图标ID）
     uint32_t style_id {0};
 
     U8String dump() const;
@@ -48,8 +50,12 @@ namespace NS_SWEETEDITOR {
   struct VisualLine {
     /// 逻辑行行号
     size_t logical_line {0};
+    /// 在逻辑行中的第几个视觉行（自动换行时大于0）
+    size_t wrap_index {0};
     /// 行号位置
     PointF line_number_position;
+    /// 是否为已折叠区域的首行（平台在行尾绘制折叠占位符）
+    bool is_folded {false};
     /// 视觉行包含的文本片段
     Vector<VisualRun> runs;
 
@@ -84,20 +90,133 @@ namespace NS_SWEETEDITOR {
     PointF end;
   };
 
+  /// 诊断信息严重程度（取值与LSP DiagnosticSeverity一致）
+  enum struct DiagnosticSeverity {
+    /// 错误
+    ERROR = 1,
+    /// 警告
+    WARNING = 2,
+    /// 提示信息
+    INFORMATION = 3,
+    /// 弱提示
+    HINT = 4,
+  };
+
+  /// 诊断信息下划线样式
+  enum struct DiagnosticStyle {
+    /// 波浪线
+    SQUIGGLE = 0,
+    /// 直线
+    UNDERLINE = 1,
+    /// 虚线
+    DASHED = 2,
+  };
+
+  /// 诊断信息在一个视觉行内的下划线片段
+  struct DiagnosticSegment {
+    /// 严重程度
+    DiagnosticSeverity severity {DiagnosticSeverity::ERROR};
+    /// 下划线样式
+    DiagnosticStyle style {DiagnosticStyle::SQUIGGLE};
+    /// 起始点（视觉行底部）
+    PointF start;
+    /// 终止点（视觉行底部）
+    PointF end;
+  };
+
+  /// 选区在一个视觉行内的背景矩形
+  struct SelectionRect {
+    /// 左上角
+    PointF origin;
+    /// 宽度
+    float width {0};
+    /// 高度
+    float height {0};
+  };
+
   /// 编辑器渲染模型
   struct EditorRenderModel {
+    /// 帧序号
+    uint64_t sequence {0};
     /// 行号分割线位置
     float split_x {0};
     /// 当前行背景坐标
     PointF current_line;
     /// 视觉上要渲染的文字行
     Vector<VisualLine> lines;
-    /// 光标
+    /// 主光标
     Cursor cursor;
+    /// 多光标编辑时其它可见的光标
+    Vector<Cursor> extra_cursors;
     /// 代码区块划线
     Vector<GuideLine> guide_lines;
+    /// 诊断信息下划线
+    Vector<DiagnosticSegment> diagnostics;
+    /// 可见视觉行内的选区背景
+    Vector<SelectionRect> selection_rects;
 
     U8String dump() const;
+    /// 紧凑JSON，仅用于调试，渲染请使用 RenderModelEncoder 的二进制格式
+    U8String toJson() const;
+  };
+
+  /// 视觉行在帧之间的唯一标识
+  struct VisualLineKey {
+    /// 逻辑行行号
+    size_t logical_line {0};
+    /// 在逻辑行中的第几个视觉行
+    size_t wrap_index {0};
+
+    bool operator<(const VisualLineKey& other) const;
+    bool operator==(const VisualLineKey& other) const;
+  };
+
+  /// 内容不变、仅发生位移的视觉行
+  struct VisualLineShift {
+    /// 视觉行标识
+    VisualLineKey key;
+    /// 文本片段相对上一帧的横向偏移（横向滚动，行号位置不变）
+    float offset_x {0};
+    /// 相对上一帧的纵向偏移
+    float offset_y {0};
+  };
+
+  /// 增量渲染模型，只描述相对基准帧发生变化的视觉行
+  struct EditorRenderDelta {
+    /// 当前帧序号
+    uint64_t sequence {0};
+    /// 基准帧序号，为0时表示没有可用基准帧，所有行都在added_lines中
+    uint64_t base_sequence {0};
+    /// 行号分割线位置
+    float split_x {0};
+    /// 当前行背景坐标
+    PointF current_line;
+    /// 新出现的视觉行
+    Vector<VisualLine> added_lines;
+    /// 内容发生变化的视觉行
+    Vector<VisualLine> changed_lines;
+    /// 内容不变、仅发生位移的视觉行
+    Vector<VisualLineShift> shifted_lines;
+    /// 已经移出视口或被删除的视觉行（基准帧中的行号）
+    Vector<VisualLineKey> removed_lines;
+    /// 基准帧中行号不小于line_shift_start的视觉行整体平移line_shift行（上方增删行时），
+    /// 平台先移除removed_lines、再平移行号，之后按当前帧的行号应用其余变化
+    size_t line_shift_start {0};
+    /// 行号平移量，为0时不需要平移
+    int64_t line_shift {0};
+    /// 主光标
+    Cursor cursor;
+    /// 多光标编辑时其它可见的光标
+    Vector<Cursor> extra_cursors;
+    /// 代码区块划线
+    Vector<GuideLine> guide_lines;
+    /// 诊断信息下划线
+    Vector<DiagnosticSegment> diagnostics;
+    /// 可见视觉行内的选区背景
+    Vector<SelectionRect> selection_rects;
+
+    U8String dump() const;
+    /// 紧凑JSON，仅用于调试，渲染请使用 RenderModelEncoder 的二进制格式
     U8String toJson() const;
   };
 
@@ -113,6 +232,10 @@ namespace NS_SWEETEDITOR {
     float line_number_margin {10};
     /// 行号宽度
     float line_number_width {10};
+    /// 制表位间隔（空格宽度的倍数）
+    uint32_t tab_size {4};
+    /// 是否输出空白字符片段（WHITESPACE、TAB），用于绘制可见空白
+    bool show_whitespace {false};
 
     U8String toJson() const;
   };
@@ -127,17 +250,37 @@ namespace NS_SWEETEDITOR {
     {VisualRunType::NEWLINE, "NEWLINE"},
     {VisualRunType::INLAY_HINT, "INLAY_HINT"},
     {VisualRunType::PHANTOM_TEXT, "PHANTOM_TEXT"},
+    {VisualRunType::TAB, "TAB"},
   })
   NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(VisualRun, type, x, y, text_id, style_id)
-  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(VisualLine, logical_line, line_number_position, runs)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(VisualLine, logical_line, wrap_index, line_number_position, is_folded, runs)
   NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Cursor, position, show_dragger)
   NLOHMANN_JSON_SERIALIZE_ENUM(GuideLineDirection, {
     {GuideLineDirection::VERTICAL, "VERTICAL"},
     {GuideLineDirection::HORIZONTAL, "HORIZONTAL"},
   })
   NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GuideLine, direction, start, end)
-  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EditorRenderModel, split_x, current_line, lines, cursor, guide_lines)
-  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EditorParams, font_height, line_spacing_add, line_spacing_mult, line_number_margin, line_number_width)
+  NLOHMANN_JSON_SERIALIZE_ENUM(DiagnosticSeverity, {
+    {DiagnosticSeverity::ERROR, "ERROR"},
+    {DiagnosticSeverity::WARNING, "WARNING"},
+    {DiagnosticSeverity::INFORMATION, "INFORMATION"},
+    {DiagnosticSeverity::HINT, "HINT"},
+  })
+  NLOHMANN_JSON_SERIALIZE_ENUM(DiagnosticStyle, {
+    {DiagnosticStyle::SQUIGGLE, "SQUIGGLE"},
+    {DiagnosticStyle::UNDERLINE, "UNDERLINE"},
+    {DiagnosticStyle::DASHED, "DASHED"},
+  })
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(DiagnosticSegment, severity, style, start, end)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SelectionRect, origin, width, height)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EditorRenderModel, sequence, split_x, current_line, lines, cursor, extra_cursors, guide_lines,
+    diagnostics, selection_rects)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(VisualLineKey, logical_line, wrap_index)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(VisualLineShift, key, offset_x, offset_y)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EditorRenderDelta, sequence, base_sequence, split_x, current_line, added_lines,
+    changed_lines, shifted_lines, removed_lines, line_shift_start, line_shift, cursor, extra_cursors, guide_lines, diagnostics, selection_rects)
+  NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EditorParams, font_height, line_spacing_add, line_spacing_mult, line_number_margin, line_number_width,
+    tab_size, show_whitespace)
 }
 
 #endif //SWEETEDITOR_VISUAL_H
\ No newline at end of file
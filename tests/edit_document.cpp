@@ -47,3 +47,106 @@ TEST_CASE("Edit Benchmark") {
     document.replaceU8Text(range, "H");
   };
 }
+
+TEST_CASE("Batch Edits") {
+  Document document(U8String("ab\ncd\nef"));
+  // 编辑无需有序，返回的变更按位置升序，每个变更的坐标已经包含之前编辑的影响
+  Vector<TextChange> changes = document.applyEdits({
+    {{{2, 1}, {2, 1}}, "X"},
+    {{{0, 1}, {1, 1}}, "1\n2\n3"},
+    {{{0, 0}, {0, 0}}, "<"},
+  });
+  REQUIRE(document.getU8Text() == "<a1\n2\n3d\neXf");
+  REQUIRE(document.getLineCount() == 4);
+  REQUIRE(changes.size() == 3);
+  REQUIRE(changes[0].new_end == TextPosition {0, 1});
+  REQUIRE(changes[1].range.start == TextPosition {0, 2});
+  REQUIRE(changes[1].range.end == TextPosition {1, 1});
+  REQUIRE(changes[1].new_end == TextPosition {2, 1});
+  REQUIRE(changes[2].range.start == TextPosition {3, 1});
+  REQUIRE(changes[2].new_end == TextPosition {3, 2});
+  REQUIRE(document.getLineU16View(2) == U16StringView(u"3d"));
+
+  // 重叠的编辑裁剪到前一个编辑之后，超出文档的位置限制到文档末尾
+  changes = document.applyEdits({
+    {{{0, 0}, {0, 3}}, ""},
+    {{{0, 2}, {1, 1}}, "-"},
+    {{{9, 0}, {9, 0}}, "!"},
+  });
+  REQUIRE(document.getU8Text() == "-\n3d\neXf!");
+  REQUIRE(changes.size() == 3);
+  REQUIRE(changes[2].new_end == TextPosition {2, 4});
+}
+
+TEST_CASE("Stream Text") {
+  Document document(U8String("ab你好\ncd"));
+  document.insertU8Text({1, 1}, "😀x");
+  U8String streamed;
+  size_t chunk_count = 0;
+  document.streamU8Text({{0, 1}, {1, 4}}, [&](const char* data, size_t length) {
+    // 块边界不会截断UTF8字符
+    REQUIRE((static_cast<unsigned char>(data[0]) & 0xC0) != 0x80);
+    REQUIRE(length <= 4);
+    streamed.append(data, length);
+    ++chunk_count;
+  }, 4);
+  REQUIRE(streamed == "b你好\nc😀x");
+  REQUIRE(chunk_count > 3);
+  REQUIRE(document.clampPosition({9, 0}) == TextPosition {1, 5});
+  REQUIRE(document.clampPosition({0, 9}) == TextPosition {0, 4});
+}
+
+class CountingListener : public DocumentListener {
+public:
+  size_t change_count {0};
+  size_t batch_count {0};
+
+  void onTextChanged(const TextChange&) override {
+    ++change_count;
+  }
+
+  void onTextChangedBatch(const Vector<TextChange>& changes) override {
+    ++batch_count;
+    change_count += changes.size();
+  }
+};
+
+TEST_CASE("Batch Notification") {
+  Document document(U8String("ab\ncd\nef"));
+  Ptr<CountingListener> listener = makePtr<CountingListener>();
+  document.addListener(listener);
+  // 一次批量编辑只通知一次，没有实际修改的编辑不通知
+  document.applyEdits({{{{0, 0}, {0, 0}}, "\n"}, {{{1, 1}, {1, 1}}, ""}, {{{2, 2}, {2, 2}}, "\n"}});
+  REQUIRE(listener->batch_count == 1);
+  REQUIRE(listener->change_count == 2);
+  document.insertU8Text({0, 0}, "x");
+  REQUIRE(listener->batch_count == 1);
+  REQUIRE(listener->change_count == 3);
+}
+
+TEST_CASE("Incremental Segments") {
+  // 随机插入删除后片段偏移仍与逐字节模拟的结果一致
+  U8String expected = "0123456789abcdefghij";
+  Document document(expected);
+  uint32_t seed = 12345;
+  auto next_random = [&seed](size_t bound) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<size_t>((seed >> 8) % bound);
+  };
+  for (size_t i = 0; i < 3000; ++i) {
+    const size_t column = next_random(expected.size() + 1);
+    if (expected.size() > 8 && next_random(3) == 0) {
+      const size_t length = std::min(expected.size() - column, next_random(6));
+      document.deleteU8Text({{0, column}, {0, column + length}});
+      expected.erase(column, length);
+    } else {
+      const U8String inserted(1 + next_random(3), static_cast<char>('k' + i % 16));
+      document.insertU8Text({0, column}, inserted);
+      expected.insert(column, inserted);
+    }
+    if (i % 100 == 0) {
+      REQUIRE(document.getLineU8Text(0, column / 2, expected.size() - column / 2) == expected.substr(column / 2));
+    }
+  }
+  REQUIRE(document.getU8Text() == expected);
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <cstring>
+#include "editor_core.h"
+#include "test_measurer.h"
+
+using namespace NS_SWEETEDITOR;
+
+static uint32_t readU32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static float readF32(const uint8_t* data) {
+  uint32_t bits = readU32(data);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+TEST_CASE("Render Model Binary") {
+  EditorCore editor_core({}, makePtr<FixedTextMeasurer>());
+  editor_core.loadDocument(makePtr<Document>(U8String("ab\ncd")));
+  editor_core.setViewport({200, 200});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines.size() == 2);
+
+  // 缓冲区不足时只返回所需大小
+  const size_t required = editor_core.encodeRenderModel(model, nullptr, 0);
+  Vector<uint8_t> small(required - 1);
+  REQUIRE(editor_core.encodeRenderModel(model, small.data(), small.size()) == required);
+
+  Vector<uint8_t> buffer(required);
+  REQUIRE(editor_core.encodeRenderModel(model, buffer.data(), buffer.size()) == required);
+  const uint8_t* data = buffer.data();
+  REQUIRE(std::memcmp(data, "SERM", 4) == 0);
+  REQUIRE((data[4] | (data[5] << 8)) == kRenderBinaryVersion);
+  REQUIRE((data[6] | (data[7] << 8)) == static_cast<uint16_t>(RenderBinaryKind::MODEL));
+  REQUIRE(readU32(data + 8) == required);
+
+  // sequence(8) + split_x(4) + current_line(8) + cursor(9) + extra_cursor_count(4)
+  const uint8_t* body = data + kRenderBinaryHeaderSize;
+  REQUIRE(readF32(body + 8) == model.split_x);
+  REQUIRE(readU32(body + 8 + 4 + 8 + 9) == 0);
+  const uint8_t* lines = body + 8 + 4 + 8 + 9 + 4;
+  REQUIRE(readU32(lines) == 2);
+  const uint8_t* line0 = lines + 4;
+  REQUIRE(readU32(line0) == 0);
+  REQUIRE(line0[16] == 0);
+  REQUIRE(readU32(line0 + 17) == 1);
+  const uint8_t* run0 = line0 + 21;
+  REQUIRE(run0[0] == static_cast<uint8_t>(VisualRunType::TEXT));
+  REQUIRE(readU32(run0 + 1 + 4 * 5) == 2);
+  const uint8_t* text = run0 + 1 + 4 * 6;
+  REQUIRE(text[0] == 'a');
+  REQUIRE(text[2] == 'b');
+}
+
+TEST_CASE("Frame Buffer Ring") {
+  EditorCore editor_core({}, makePtr<FixedTextMeasurer>());
+  editor_core.loadDocument(makePtr<Document>(U8String("ab\ncd")));
+  editor_core.setViewport({200, 200});
+
+  alignas(8) uint8_t memory0[1024];
+  alignas(8) uint8_t memory1[1024];
+  uint8_t* buffers[] = {memory0, memory1};
+  size_t capacities[] = {sizeof(memory0), sizeof(memory1)};
+  editor_core.setFrameBuffers(buffers, capacities, 2);
+
+  int32_t first = editor_core.buildFrame(0);
+  REQUIRE(first == 0);
+  REQUIRE(readU32(memory0) == static_cast<uint32_t>(FrameSlotState::READY));
+  const uint32_t data_size = readU32(memory0 + 4);
+  REQUIRE(readU32(memory0 + kFrameSlotHeaderSize + 8) == data_size);
+
+  // 平台还未读完第一帧时写入第二块内存
+  int32_t second = editor_core.buildFrame(1);
+  REQUIRE(second == 1);
+  REQUIRE((memory1[kFrameSlotHeaderSize + 6] | (memory1[kFrameSlotHeaderSize + 7] << 8))
+    == static_cast<uint16_t>(RenderBinaryKind::DELTA));
+  // 没有空闲内存时不构建新帧
+  REQUIRE(editor_core.buildFrame(2) == -1);
+
+  // 平台直接写回FREE状态即可归还
+  std::memset(memory0, 0, 4);
+  REQUIRE(editor_core.buildFrame(2) == 0);
+  editor_core.releaseFrame(1);
+  REQUIRE(editor_core.buildFrame(3) == 1);
+
+  // 未对齐的内存块被忽略，状态字只会按对齐的原子变量访问
+  uint8_t* misaligned[] = {memory0 + 1, memory1};
+  size_t misaligned_capacities[] = {sizeof(memory0) - 1, sizeof(memory1)};
+  editor_core.setFrameBuffers(misaligned, misaligned_capacities, 2);
+  REQUIRE(editor_core.buildFrame(4) == 0);
+  REQUIRE(readU32(memory1) == static_cast<uint32_t>(FrameSlotState::READY));
+  REQUIRE(editor_core.buildFrame(5) == -1);
+}
@@ -0,0 +1,224 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <chrono>
+#include "editor_core.h"
+#include "test_measurer.h"
+
+using namespace NS_SWEETEDITOR;
+
+static Grammar makeTestGrammar() {
+  Grammar grammar;
+  grammar.states.push_back({"root", 0, {
+    {"/\\*", 1, false, "comment"},
+    {"\"", 2, false, "string"},
+    {"\\b(?:int|return)\\b", 3, false, ""},
+    {"[0-9]+", 4, false, ""},
+  }});
+  grammar.states.push_back({"comment", 1, {
+    {"\\*/", 1, true, ""},
+  }});
+  grammar.states.push_back({"string", 2, {
+    {"\\\\.", 5, false, ""},
+    {"\"", 2, true, ""},
+  }});
+  return grammar;
+}
+
+TEST_CASE("Tokenize Line") {
+  SyntaxHighlighter highlighter(makeTestGrammar());
+  Vector<StyleSpan> spans;
+  const uint32_t state = highlighter.tokenizeLine("int 你 = 42; /* open", 0, spans);
+  REQUIRE(spans.size() == 3);
+  REQUIRE(spans[0].column == 0);
+  REQUIRE(spans[0].length == 3);
+  REQUIRE(spans[1].column == 8);
+  REQUIRE(spans[1].style_id == 4);
+  REQUIRE(spans[2].column == 12);
+  REQUIRE(spans[2].length == 7);
+  REQUIRE(state != 0);
+  // 注释状态延续到下一行，结束后回到初始状态
+  spans.clear();
+  REQUIRE(highlighter.tokenizeLine("still */ return \"a\\\"b\"", state, spans) == 0);
+  REQUIRE(spans[0].length == 8);
+  REQUIRE(spans[1].style_id == 3);
+  REQUIRE(spans[2].style_id == 2);
+  REQUIRE(spans[3].style_id == 5);
+
+  Grammar invalid = makeTestGrammar();
+  invalid.states[0].rules[0].push = "missing";
+  REQUIRE_THROWS_AS(SyntaxHighlighter(invalid), std::invalid_argument);
+}
+
+TEST_CASE("Incremental Highlight") {
+  U8String text;
+  for (size_t i = 0; i < 1000; ++i) {
+    text += "int value = 1;\n";
+  }
+  Ptr<Document> document = makePtr<Document>(text);
+  DecorationManager decorations;
+  SyntaxHighlighter highlighter(makeTestGrammar());
+  highlighter.loadDocument(document);
+  auto apply_change = [&](const TextChange& change) {
+    decorations.onTextChanged(change);
+    highlighter.onTextChanged(change);
+  };
+  Vector<size_t> changed_lines;
+  REQUIRE(highlighter.highlight(SIZE_MAX, SIZE_MAX, decorations, changed_lines) == 1001);
+  REQUIRE(changed_lines.size() == 1000);
+
+  // 行内编辑不改变行尾状态，只重新分析编辑行和下一行
+  document->insertU8Text({500, 4}, "x");
+  apply_change({{{500, 4}, {500, 4}}, {500, 5}});
+  changed_lines.clear();
+  REQUIRE(highlighter.highlight(SIZE_MAX, SIZE_MAX, decorations, changed_lines) == 2);
+  REQUIRE(changed_lines.empty());
+
+  // 打开块注释后之后的行都变为注释，闭合后又恢复
+  document->insertU8Text({10, 0}, "/*");
+  apply_change({{{10, 0}, {10, 0}}, {10, 2}});
+  changed_lines.clear();
+  highlighter.highlight(20, SIZE_MAX, decorations, changed_lines);
+  REQUIRE(highlighter.getFrontierLine() == 21);
+  REQUIRE(decorations.getLineSpans(15)[0].style_id == 1);
+  document->insertU8Text({12, 0}, "*/\n");
+  apply_change({{{12, 0}, {12, 0}}, {13, 0}});
+  REQUIRE(highlighter.highlight(SIZE_MAX, SIZE_MAX, decorations, changed_lines) < 1000);
+  REQUIRE(highlighter.getFrontierLine() > 1000);
+  REQUIRE(decorations.getLineSpans(13)[0].style_id == 3);
+  REQUIRE(decorations.getLineSpans(600)[0].style_id == 3);
+}
+
+TEST_CASE("Editor Highlight") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorConfig config;
+  config.async_highlight = false;
+  EditorCore editor_core(config, measurer);
+  editor_core.loadDocument(makePtr<Document>(U8String("int a = 1;\nreturn 2;")));
+  editor_core.setViewport({1000, 200});
+  editor_core.setGrammar(makeTestGrammar());
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[0].runs[0].style_id == 3);
+  REQUIRE(model.lines[1].runs[0].style_id == 3);
+  REQUIRE(model.lines[1].runs[1].style_id == 4);
+
+  // 预布局前先分析这些行的高亮，滚动到预布局区域时不会因Span变化重新布局
+  U8String text;
+  for (size_t i = 0; i < 100; ++i) {
+    text += "int value = 1;\n";
+  }
+  editor_core.loadDocument(makePtr<Document>(text));
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({1000, line_height * 5});
+  EditorRenderModel first;
+  editor_core.buildRenderModel(first);
+  REQUIRE(editor_core.prefetchLayout(1000) > 0);
+  const PrefetchStats prefetched = editor_core.getPrefetchStats();
+  editor_core.setScroll(0, line_height * 3);
+  EditorRenderModel scrolled;
+  editor_core.buildRenderModel(scrolled);
+  REQUIRE(scrolled.lines.back().runs[0].style_id == 3);
+  REQUIRE(editor_core.getPrefetchStats().miss_count == prefetched.miss_count);
+}
+
+static void waitHighlightIdle(EditorCore& editor_core) {
+  for (int i = 0; i < 500 && !editor_core.isHighlightIdle(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(editor_core.isHighlightIdle());
+}
+
+TEST_CASE("Background Highlight") {
+  U8String text;
+  for (size_t i = 0; i < 20000; ++i) {
+    text += "int value = 1;\n";
+  }
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(text);
+  editor_core.loadDocument(document);
+  editor_core.setViewport({1000, 200});
+  std::atomic<int> ready_count {0};
+  editor_core.setHighlightReadyCallback([&ready_count] { ++ready_count; });
+  editor_core.setGrammar(makeTestGrammar());
+  waitHighlightIdle(editor_core);
+  REQUIRE(ready_count > 0);
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[0].runs[0].style_id == 3);
+
+  document->insertU8Text({0, 0}, "/*");
+  waitHighlightIdle(editor_core);
+  EditorRenderModel commented;
+  editor_core.buildRenderModel(commented);
+  REQUIRE(commented.lines[1].runs[0].style_id == 1);
+
+  // 闭合注释后，后台从编辑行开始重新分析，并只发布新版本的结果
+  document->insertU8Text({2, 0}, "*/");
+  waitHighlightIdle(editor_core);
+  EditorRenderModel closed;
+  editor_core.buildRenderModel(closed);
+  REQUIRE(closed.lines[2].runs[0].style_id == 1);
+  REQUIRE(closed.lines[2].runs[1].style_id == 3);
+  REQUIRE(closed.lines[3].runs[0].style_id == 3);
+}
+
+TEST_CASE("Highlight While Editing") {
+  U8String text;
+  for (size_t i = 0; i < 20000; ++i) {
+    text += "int value = 1;\n";
+  }
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(text);
+  editor_core.loadDocument(document);
+  editor_core.setViewport({1000, 200});
+  editor_core.setGrammar(makeTestGrammar());
+  // 不等待后台分析完成就连续编辑：后台发布后尚未取走的结果因版本过期被丢弃，对应的行仍会重新分析并送达
+  for (size_t i = 0; i < 40; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    document->insertU8Text({i * 500, 0}, i % 2 == 0 ? "/*" : "*/");
+    EditorRenderModel frame;
+    editor_core.buildRenderModel(frame);
+  }
+  // 批量编辑一次同步到后台快照：同一行上的多处修改、插入和删除行
+  document->applyEdits({{{{100, 0}, {100, 0}}, "/*\n"}, {{{100, 3}, {100, 3}}, "x"}, {{{300, 0}, {302, 0}}, "*/"}});
+  document->applyEdits({{{{5, 0}, {5, 0}}, "/*"}, {{{5, 4}, {5, 4}}, "*/"}, {{{7, 0}, {7, 0}}, "/*"}});
+  waitHighlightIdle(editor_core);
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+
+  // 与同步分析的结果逐行对照
+  DecorationManager expected;
+  SyntaxHighlighter highlighter(makeTestGrammar());
+  highlighter.loadDocument(document);
+  Vector<size_t> changed_lines;
+  highlighter.highlight(SIZE_MAX, SIZE_MAX, expected, changed_lines);
+  Ptr<DecorationManager> decorations = editor_core.getDecorations();
+  size_t mismatched_lines = 0;
+  for (size_t line = 0; line < document->getLineCount(); ++line) {
+    const Vector<StyleSpan>& actual_spans = decorations->getLineSpans(line);
+    const Vector<StyleSpan>& expected_spans = expected.getLineSpans(line);
+    const bool same = actual_spans.size() == expected_spans.size()
+      && std::equal(actual_spans.begin(), actual_spans.end(), expected_spans.begin(), [](const StyleSpan& a, const StyleSpan& b) {
+        return a.column == b.column && a.length == b.length && a.style_id == b.style_id;
+      });
+    mismatched_lines += same ? 0 : 1;
+  }
+  REQUIRE(mismatched_lines == 0);
+}
+
+TEST_CASE("Stale Highlight Results") {
+  Ptr<Document> document = makePtr<Document>(U8String("int a;\nint b;"));
+  HighlightWorker worker(makeTestGrammar());
+  worker.loadDocument(document, 1);
+  for (int i = 0; i < 500 && !worker.isIdle(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(worker.isIdle());
+  // 结果基于版本1，UI侧已经是版本2时全部丢弃
+  DecorationManager decorations;
+  Vector<size_t> changed_lines;
+  worker.collectResults(2, decorations, changed_lines);
+  REQUIRE(changed_lines.empty());
+  REQUIRE(decorations.getLineSpans(0).empty());
+}
@@ -0,0 +1,30 @@
+#ifndef SWEETEDITOR_TEST_MEASURER_H
+#define SWEETEDITOR_TEST_MEASURER_H
+
+#include "layout.h"
+
+using namespace NS_SWEETEDITOR;
+
+/// 测试用等宽测量：ASCII宽10，其他字符宽20
+class FixedTextMeasurer : public TextMeasurer {
+public:
+  float measureWidth(const U16String& text, uint32_t /*style_id*/) override {
+    ++measure_count;
+    float width = 0;
+    for (U16Char ch : text) {
+      if (ch >= 0xDC00 && ch <= 0xDFFF) {
+        continue;
+      }
+      width += ch < 0x80 ? 10 : 20;
+    }
+    return width;
+  }
+
+  FontMetrics getFontMetrics() override {
+    return {-16, 4};
+  }
+
+  size_t measure_count {0};
+};
+
+#endif //SWEETEDITOR_TEST_MEASURER_H
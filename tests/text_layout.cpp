@@ -0,0 +1,1351 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <thread>
+#include "editor_core.h"
+#include "utility.h"
+#include "grapheme.h"
+#include "test_measurer.h"
+
+using namespace NS_SWEETEDITOR;
+
+TEST_CASE("Layout Column Hit Testing") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  Ptr<Document> document = makePtr<Document>(U8String("ab你😀c\nline2"));
+  layout.loadDocument(document);
+
+  REQUIRE(layout.getColumnX(0, 0) == 0);
+  REQUIRE(layout.getColumnX(0, 2) == 20);
+  REQUIRE(layout.getColumnX(0, 3) == 40);
+  // 代理对中间的列与字符起点共享横坐标
+  REQUIRE(layout.getColumnX(0, 4) == 40);
+  REQUIRE(layout.getColumnX(0, 5) == 60);
+  REQUIRE(layout.getColumnX(0, 6) == 70);
+
+  REQUIRE(layout.getColumnAtX(0, -5) == 0);
+  REQUIRE(layout.getColumnAtX(0, 14) == 1);
+  REQUIRE(layout.getColumnAtX(0, 26) == 2);
+  REQUIRE(layout.getColumnAtX(0, 45) == 3);
+  REQUIRE(layout.getColumnAtX(0, 55) == 5);
+  REQUIRE(layout.getColumnAtX(0, 1000) == 6);
+}
+
+TEST_CASE("Layout Horizontal Crop") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  Ptr<Document> document = makePtr<Document>(U8String("0123456789abcdefghij\nxyz"));
+  layout.loadDocument(document);
+  layout.setViewport({100, 100});
+  const EditorParams& params = layout.getEditorParams();
+  const float text_left = params.line_number_margin * 2 + params.line_number_width;
+
+  layout.setViewState({1, 35, 0});
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  REQUIRE(model.lines.size() == 2);
+  const VisualRun& run = model.lines[0].runs[0];
+  REQUIRE(run.column == 3);
+  REQUIRE(run.x == text_left + 30 - 35);
+  REQUIRE(layout.getTextById(run.text_id) == U16StringView(CHAR16("3456789a")).substr(0, run.length));
+
+  // 再次构建时布局缓存不受上一帧裁剪影响，且不会重新测量
+  const size_t measure_count = measurer->measure_count;
+  EditorRenderModel next_model;
+  layout.composeRenderModel(next_model);
+  REQUIRE(next_model.lines[0].runs[0].column == 3);
+  REQUIRE(next_model.lines[0].runs[0].length == run.length);
+  // 文本ID按帧复用，不会持续增长
+  REQUIRE(next_model.lines[0].runs[0].text_id == run.text_id);
+  REQUIRE(measurer->measure_count == measure_count);
+}
+
+TEST_CASE("Text Id Reuse") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  U8String text;
+  for (size_t i = 0; i < 5000; ++i) {
+    text += "let value = 1; // comment\n";
+  }
+  layout.loadDocument(makePtr<Document>(std::move(text)));
+  const float line_height = layout.getEditorParams().font_height;
+  layout.setViewport({400, line_height * 40});
+  auto scroll_through = [&]() {
+    for (size_t line = 0; line < 4000; line += 7) {
+      layout.setViewState({1, 0, line_height * line});
+      EditorRenderModel frame;
+      layout.composeRenderModel(frame);
+    }
+  };
+  // 首次滚动后查找表达到峰值，之后反复滚动复用槽位，不再扩容
+  scroll_through();
+  const size_t capacity = layout.getTextIdCapacity();
+  REQUIRE(capacity > 0);
+  scroll_through();
+  scroll_through();
+  REQUIRE(layout.getTextIdCapacity() == capacity);
+
+  // 滚出视口后回收的ID不再指向文本，复用该槽位的新ID与旧ID不同
+  layout.setViewState({1, 0, 0});
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  const int64_t old_id = model.lines[0].runs[0].text_id;
+  REQUIRE(layout.getTextById(old_id) == U16StringView(CHAR16("let")));
+  layout.setViewState({1, 0, line_height * 1000});
+  EditorRenderModel scrolled;
+  layout.composeRenderModel(scrolled);
+  REQUIRE(layout.getTextById(old_id).empty());
+  for (const VisualLine& line : scrolled.lines) {
+    for (const VisualRun& run : line.runs) {
+      REQUIRE(run.text_id != old_id);
+    }
+  }
+}
+
+TEST_CASE("Render Delta") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("line0\nline1\nline2\nline3\nline4\nline5"));
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({200, line_height * 3});
+
+  EditorRenderDelta full;
+  editor_core.buildRenderDelta(0, full);
+  REQUIRE(full.base_sequence == 0);
+  REQUIRE(full.added_lines.size() == 4);
+
+  // 无变化时增量为空
+  EditorRenderDelta same;
+  editor_core.buildRenderDelta(full.sequence, same);
+  REQUIRE(same.base_sequence == full.sequence);
+  REQUIRE(same.added_lines.empty());
+  REQUIRE(same.changed_lines.empty());
+  REQUIRE(same.shifted_lines.empty());
+  REQUIRE(same.removed_lines.empty());
+
+  // 滚动一行：移出一行、新增一行，其余行只有纵向位移
+  editor_core.setScroll(0, line_height);
+  EditorRenderDelta scrolled;
+  editor_core.buildRenderDelta(same.sequence, scrolled);
+  REQUIRE(scrolled.removed_lines.size() == 1);
+  REQUIRE(scrolled.removed_lines[0].logical_line == 0);
+  REQUIRE(scrolled.added_lines.size() == 1);
+  REQUIRE(scrolled.added_lines[0].logical_line == 4);
+  REQUIRE(scrolled.changed_lines.empty());
+  REQUIRE(scrolled.shifted_lines.size() == 3);
+  REQUIRE(scrolled.shifted_lines[0].offset_y == -line_height);
+  // 平台保留的行继续使用上一帧的文本ID，不会指向其它片段
+  const int64_t line1_text_id = full.added_lines[1].runs[0].text_id;
+  REQUIRE(editor_core.getVisualRunText(line1_text_id) == U16StringView(CHAR16("line1")));
+
+  // 横向滚动不足一列时裁剪结果不变，只有横向位移
+  editor_core.setScroll(5, line_height);
+  EditorRenderDelta horizontal;
+  editor_core.buildRenderDelta(scrolled.sequence, horizontal);
+  REQUIRE(horizontal.changed_lines.empty());
+  REQUIRE(horizontal.shifted_lines.size() == 4);
+  REQUIRE(horizontal.shifted_lines[0].offset_x == -5);
+  REQUIRE(horizontal.shifted_lines[0].offset_y == 0);
+
+  // 上方插入一行：之后的行号整体平移，内容不变的行只有纵向位移，文本ID随行平移仍然有效
+  document->insertU8Text({0, 0}, "new\n");
+  EditorRenderDelta inserted;
+  editor_core.buildRenderDelta(horizontal.sequence, inserted);
+  REQUIRE(inserted.line_shift_start == 1);
+  REQUIRE(inserted.line_shift == 1);
+  REQUIRE(inserted.changed_lines.empty());
+  REQUIRE(inserted.added_lines.size() == 1);
+  REQUIRE(inserted.added_lines[0].logical_line == 1);
+  REQUIRE(inserted.shifted_lines.size() == 3);
+  REQUIRE(inserted.shifted_lines[0].key.logical_line == 2);
+  REQUIRE(inserted.shifted_lines[0].offset_y == line_height);
+  REQUIRE(inserted.removed_lines.size() == 1);
+  REQUIRE(inserted.removed_lines[0].logical_line == 4);
+  REQUIRE(editor_core.getVisualRunText(line1_text_id) == U16StringView(CHAR16("line1")));
+
+  // 删除上方的行后平移回来
+  document->deleteU8Text({{0, 0}, {1, 0}});
+  EditorRenderDelta deleted;
+  editor_core.buildRenderDelta(inserted.sequence, deleted);
+  REQUIRE(deleted.line_shift_start == 2);
+  REQUIRE(deleted.line_shift == -1);
+  REQUIRE(deleted.changed_lines.empty());
+  REQUIRE(deleted.shifted_lines.size() == 3);
+  REQUIRE(deleted.shifted_lines[0].key.logical_line == 1);
+  REQUIRE(deleted.shifted_lines[0].offset_y == -line_height);
+  REQUIRE(deleted.added_lines.size() == 1);
+  REQUIRE(deleted.removed_lines.size() == 1);
+  REQUIRE(deleted.removed_lines[0].logical_line == 1);
+  REQUIRE(editor_core.getVisualRunText(line1_text_id) == U16StringView(CHAR16("line1")));
+
+  // 基准帧不匹配时返回全量
+  EditorRenderDelta stale;
+  editor_core.buildRenderDelta(full.sequence, stale);
+  REQUIRE(stale.base_sequence == 0);
+  REQUIRE(stale.added_lines.size() == 4);
+}
+
+TEST_CASE("Incremental Layout") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("line0\nline1\nline2\nline3\nline4\nline5"));
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({200, line_height * 10});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+
+  // 编辑单行只会使该行的布局失效，后续行的布局直接复用
+  Vector<LogicalLine>& logical_lines = document->getLogicalLines();
+  document->insertU8Text({1, 5}, "x");
+  REQUIRE(logical_lines[1].version != logical_lines[1].layout_version);
+  REQUIRE(logical_lines[2].version == logical_lines[2].layout_version);
+  REQUIRE(logical_lines[2].start_char == 13);
+  const size_t measure_count = measurer->measure_count;
+  EditorRenderModel edited;
+  editor_core.buildRenderModel(edited);
+  REQUIRE(measurer->measure_count - measure_count <= 1);
+
+  // 插入换行后行高索引平移，行号与纵坐标保持一致
+  document->insertU8Text({0, 5}, "\nnew");
+  REQUIRE(logical_lines[3].start_char == 17);
+  EditorRenderModel inserted;
+  editor_core.buildRenderModel(inserted);
+  REQUIRE(inserted.lines.size() == 7);
+  for (size_t i = 0; i < inserted.lines.size(); ++i) {
+    REQUIRE(inserted.lines[i].logical_line == i);
+    REQUIRE(inserted.lines[i].line_number_position.y == line_height * i);
+  }
+
+  document->deleteU8Text({{0, 5}, {2, 0}});
+  EditorRenderModel deleted;
+  editor_core.buildRenderModel(deleted);
+  REQUIRE(deleted.lines.size() == 5);
+  REQUIRE(deleted.lines[4].line_number_position.y == line_height * 4);
+
+  // 修改制表符宽度只递增布局代数，不逐行标记，各行在下次布局时比较代数后重建
+  const uint32_t layout_epoch = logical_lines[4].layout_epoch;
+  editor_core.setTabSize(8);
+  REQUIRE_FALSE(logical_lines[4].is_layout_dirty);
+  EditorRenderModel retabbed;
+  editor_core.buildRenderModel(retabbed);
+  REQUIRE(logical_lines[4].layout_epoch == layout_epoch + 1);
+}
+
+TEST_CASE("Line Height Index") {
+  LineHeightIndex index;
+  index.reset(5, 10);
+  REQUIRE(index.getTotalHeight() == 50);
+  index.setHeight(2, 30);
+  REQUIRE(index.getLineY(3) == 50);
+  REQUIRE(index.getLineAtY(0) == 0);
+  REQUIRE(index.getLineAtY(19.5f) == 1);
+  REQUIRE(index.getLineAtY(20) == 2);
+  REQUIRE(index.getLineAtY(49) == 2);
+  REQUIRE(index.getLineAtY(50) == 3);
+  REQUIRE(index.getLineAtY(1000) == 4);
+  index.spliceLines(1, 2, 1);
+  REQUIRE(index.size() == 4);
+  REQUIRE(index.getTotalHeight() == 40);
+
+  // 嵌套隐藏按次数计数，隐藏的行不占高度
+  index.reset(6, 10);
+  index.setLinesHidden(1, 5, true);
+  index.setLinesHidden(2, 4, true);
+  REQUIRE(index.getTotalHeight() == 20);
+  REQUIRE(index.getLineY(5) == 10);
+  REQUIRE(index.getLineAtY(15) == 5);
+  REQUIRE(index.nextVisibleLine(1) == 5);
+  REQUIRE(index.prevVisibleLine(4) == 0);
+  index.setLinesHidden(1, 5, false);
+  REQUIRE(index.isHidden(2));
+  REQUIRE_FALSE(index.isHidden(1));
+  REQUIRE(index.getTotalHeight() == 40);
+
+  // 增删行跨越多个块时重新分块，其余行保留隐藏标记和高度
+  index.reset(1000, 10);
+  index.setLinesHidden(100, 600, true);
+  index.setHeight(700, 30);
+  REQUIRE(index.getTotalHeight() == 5020);
+  index.spliceLines(50, 0, 100);
+  REQUIRE(index.size() == 1100);
+  REQUIRE(index.getTotalHeight() == 6020);
+  REQUIRE_FALSE(index.isHidden(199));
+  REQUIRE(index.isHidden(200));
+  REQUIRE(index.isHidden(699));
+  REQUIRE(index.getHeight(800) == 30);
+  REQUIRE(index.getLineY(700) == 2000);
+  REQUIRE(index.getLineAtY(2000) == 700);
+  REQUIRE(index.nextVisibleLine(200) == 700);
+  index.spliceLines(20, 2, 0);
+  REQUIRE(index.isHidden(198));
+  REQUIRE_FALSE(index.isHidden(698));
+  index.setLinesHidden(198, 698, false);
+  REQUIRE(index.getTotalHeight() == 11000);
+  REQUIRE(index.nextVisibleLine(198) == 198);
+  index.spliceLines(10, 1000, 0);
+  REQUIRE(index.size() == 98);
+  REQUIRE(index.getTotalHeight() == 980);
+}
+
+TEST_CASE("Scaled Layout") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  editor_core.loadDocument(makePtr<Document>(U8String("aaaa bbbb cccc")));
+  const EditorParams& params = editor_core.getEditorParams();
+  const float text_left = params.line_number_margin * 2 + 10;
+  editor_core.setWrapMode(WrapMode::WORD_BREAK);
+  editor_core.setViewport({text_left + 100, 400});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines.size() == 2);
+  REQUIRE(model.lines[0].runs.size() == 2);
+  REQUIRE(model.lines[0].runs[1].column == 5);
+  REQUIRE(model.lines[1].runs[0].column == 10);
+
+  // 缩放过程中只按比例换算坐标，不重新测量也不重新断行
+  const size_t measure_count = measurer->measure_count;
+  float down_points[] = {0, 0, 100, 0};
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::TOUCH_DOWN, 1, down_points));
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::TOUCH_POINTER_DOWN, 2, down_points));
+  float move_points[] = {-50, 0, 150, 0};
+  GestureResult result = editor_core.handleGestureEvent(GestureEvent::create(EventType::TOUCH_MOVE, 2, move_points));
+  REQUIRE(result.type == GestureType::SCALE);
+  REQUIRE(editor_core.getViewState().scale == 2);
+  EditorRenderModel scaled;
+  editor_core.buildRenderModel(scaled);
+  REQUIRE(scaled.lines.size() == 2);
+  REQUIRE(scaled.split_x == text_left * 2);
+  REQUIRE(scaled.lines[0].runs[0].x == text_left * 2);
+  REQUIRE(scaled.lines[1].runs[0].y == params.font_height * 2);
+  REQUIRE(measurer->measure_count == measure_count);
+
+  // 手势结束后按缩放后的宽度重新断行
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::TOUCH_POINTER_UP, 1, move_points));
+  EditorRenderModel settled;
+  editor_core.buildRenderModel(settled);
+  REQUIRE(settled.lines.size() > 2);
+  REQUIRE(measurer->measure_count == measure_count);
+}
+
+TEST_CASE("Prefetch Layout") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  U8String text;
+  for (int i = 0; i < 100; ++i) {
+    text += "line" + std::to_string(i) + "\n";
+  }
+  editor_core.loadDocument(makePtr<Document>(text));
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({200, line_height * 5});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  const PrefetchStats cold_stats = editor_core.getPrefetchStats();
+  REQUIRE(cold_stats.hit_count == 0);
+  REQUIRE(cold_stats.miss_count == model.lines.size());
+
+  // 向下滚动后，沿滚动方向预布局接下来的区域
+  editor_core.setScroll(0, line_height);
+  editor_core.setScroll(0, line_height * 2);
+  REQUIRE(editor_core.prefetchLayout(3) == 3);
+  REQUIRE(editor_core.prefetchLayout(1000) > 0);
+  REQUIRE(editor_core.prefetchLayout(1000) == 0);
+
+  // 滚动到预布局区域时不需要同步布局
+  editor_core.setScroll(0, line_height * 8);
+  EditorRenderModel scrolled;
+  editor_core.buildRenderModel(scrolled);
+  const PrefetchStats stats = editor_core.getPrefetchStats();
+  REQUIRE(stats.miss_count == cold_stats.miss_count);
+  REQUIRE(stats.hit_count == scrolled.lines.size());
+  REQUIRE(stats.prefetched_lines > 3);
+}
+
+TEST_CASE("Whitespace Runs") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  layout.loadDocument(makePtr<Document>(U8String("a\tbc  d\t\tefghijklmnop qr")));
+  layout.setViewport({1000, 100});
+  const size_t measure_count = measurer->measure_count;
+
+  // 制表符对齐到4个空格宽度的制表位，空白字符不调用测量
+  REQUIRE(layout.getColumnX(0, 1) == 10);
+  REQUIRE(layout.getColumnX(0, 2) == 40);
+  REQUIRE(layout.getColumnX(0, 4) == 60);
+  REQUIRE(layout.getColumnX(0, 6) == 80);
+  REQUIRE(layout.getColumnX(0, 8) == 120);
+  REQUIRE(layout.getColumnX(0, 9) == 160);
+  // 18个不同的非空白字符各测量一次
+  REQUIRE(measurer->measure_count - measure_count == 18);
+
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  REQUIRE(model.lines[0].runs.size() == 5);
+  REQUIRE(model.lines[0].runs[3].column == 9);
+  REQUIRE(model.lines[0].runs[3].length == 12);
+
+  // 显示空白字符时输出空白片段，每个制表符单独一个片段
+  layout.setShowWhitespace(true);
+  EditorRenderModel visible;
+  layout.composeRenderModel(visible);
+  const Vector<VisualRun>& runs = visible.lines[0].runs;
+  REQUIRE(runs.size() == 10);
+  REQUIRE(runs[1].type == VisualRunType::TAB);
+  REQUIRE(runs[3].type == VisualRunType::WHITESPACE);
+  REQUIRE(runs[3].length == 2);
+  REQUIRE(runs[3].text_id == -1);
+  REQUIRE(runs[5].type == VisualRunType::TAB);
+  REQUIRE(runs[6].type == VisualRunType::TAB);
+  REQUIRE(runs[6].x - runs[5].x == 30);
+
+  REQUIRE(StrUtil::findWhitespace(CHAR16("abcdefghijklmnopq\trs"), 20, 0) == 17);
+  REQUIRE(StrUtil::skipChar(CHAR16("                   x"), 20, 3, CHAR16(' ')) == 19);
+}
+
+TEST_CASE("Grapheme Clusters") {
+  // e + 组合重音、家庭emoji（ZWJ序列）、国旗（两个区域指示符）
+  const U16String text = CHAR16("e\u0301x\U0001F468\u200D\U0001F469\u200D\U0001F467\U0001F1E8\U0001F1F3");
+  Vector<uint64_t> bits;
+  REQUIRE(Grapheme::computeBoundaries(text, bits));
+  REQUIRE(Grapheme::nextBoundary(text, bits, 0) == 2);
+  REQUIRE(Grapheme::nextBoundary(text, bits, 3) == 11);
+  REQUIRE(Grapheme::prevBoundary(text, bits, 15) == 11);
+  REQUIRE(Grapheme::floorBoundary(text, bits, 8) == 3);
+  REQUIRE(Grapheme::ceilBoundary(text, bits, 12) == 15);
+  // 只有代理对和普通字符时走快速路径
+  REQUIRE_FALSE(Grapheme::computeBoundaries(CHAR16("ab你😀c"), bits));
+  REQUIRE(bits.empty());
+  REQUIRE_FALSE(Grapheme::isBoundary(CHAR16("ab你😀c"), bits, 4));
+  // 韩文字母组合成音节
+  REQUIRE(Grapheme::computeBoundaries(CHAR16("\u1100\u1161\u11A8\uAC00"), bits));
+  REQUIRE(Grapheme::nextBoundary(CHAR16("\u1100\u1161\u11A8\uAC00"), bits, 0) == 3);
+
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  U8String u8_text;
+  StrUtil::convertUTF16ToUTF8(text, u8_text);
+  layout.loadDocument(makePtr<Document>(u8_text));
+  // 每个簇整体测量一次，簇内的列与簇起点共享横坐标
+  REQUIRE(layout.getColumnX(0, 1) == 0);
+  REQUIRE(layout.getColumnX(0, 2) == 30);
+  REQUIRE(layout.getColumnX(0, 3) == 40);
+  REQUIRE(layout.getColumnX(0, 10) == 40);
+  REQUIRE(layout.getColumnX(0, 11) == 140);
+  REQUIRE(layout.getColumnX(0, 15) == 180);
+  REQUIRE(layout.getColumnAtX(0, 80) == 3);
+  REQUIRE(layout.getColumnAtX(0, 100) == 11);
+  REQUIRE(layout.getNextCaretColumn(0, 3) == 11);
+  REQUIRE(layout.getPrevCaretColumn(0, 11) == 3);
+
+  // 视口左边界落在emoji序列中间时，从簇起点开始裁剪
+  layout.setViewport({1000, 100});
+  layout.setViewState({1, 60, 0});
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  REQUIRE(model.lines[0].runs[0].column == 3);
+  REQUIRE(model.lines[0].runs[0].length == 12);
+}
+
+TEST_CASE("Long Line Chunks") {
+  U8String u8_text;
+  for (size_t i = 0; i < 20000; ++i) {
+    u8_text += "ab你";
+  }
+  u8_text += "\nshort";
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  Ptr<Document> document = makePtr<Document>(u8_text);
+  layout.loadDocument(document);
+  layout.setViewport({400, 100});
+  layout.setViewState({1, 0, 0});
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  LogicalLine& long_line = document->getLogicalLines()[0];
+  REQUIRE(long_line.chunks.size() >= 100000 / kLineChunkBytes);
+  REQUIRE(long_line.cached_text.empty());
+  REQUIRE(long_line.visual_lines.size() == 1);
+  REQUIRE(model.lines[0].runs[0].column == 0);
+  REQUIRE(layout.getTextById(model.lines[0].runs[0].text_id).substr(0, 3) == CHAR16("ab你"));
+  REQUIRE(document->getLogicalLines()[1].chunks.empty());
+
+  // 块内列坐标与整行等宽测量结果一致
+  const float x = layout.getColumnX(0, 30000);
+  REQUIRE(layout.getColumnX(0, 30003) - x == 40);
+  REQUIRE(layout.getColumnAtX(0, x + 21) == 30002);
+  REQUIRE(layout.getNextCaretColumn(0, 30002) == 30003);
+
+  // 横向滚动到行中间，只转换视口附近的块
+  layout.setViewState({1, x, 0});
+  EditorRenderModel scrolled;
+  layout.composeRenderModel(scrolled);
+  const EditorParams& params = layout.getEditorParams();
+  const float text_left = params.line_number_margin * 2 + params.line_number_width;
+  const VisualRun& run = scrolled.lines[0].runs[0];
+  REQUIRE(run.column == 30000);
+  REQUIRE(run.x == text_left);
+  REQUIRE(layout.getTextById(run.text_id).substr(0, 6) == CHAR16("ab你ab你"));
+  size_t loaded_chunks = 0;
+  for (const LineChunk& chunk : long_line.chunks) {
+    loaded_chunks += chunk.text.empty() ? 0 : 1;
+  }
+  REQUIRE(loaded_chunks <= 2);
+
+  // 内容未变时重新布局沿用块边界和已测量的宽度，视口内容不跳动
+  const size_t chunk_count = long_line.chunks.size();
+  layout.setTabSize(8);
+  EditorRenderModel relaid;
+  layout.composeRenderModel(relaid);
+  REQUIRE(long_line.chunks_version == long_line.version);
+  REQUIRE(long_line.chunks.size() == chunk_count);
+  REQUIRE(relaid.lines[0].runs[0].column == 30000);
+  REQUIRE(layout.getColumnX(0, 30003) - layout.getColumnX(0, 30000) == 40);
+}
+
+TEST_CASE("Code Folding") {
+  U8String u8_text;
+  for (size_t i = 0; i < 60000; ++i) {
+    u8_text += "line\n";
+  }
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(u8_text);
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({200, line_height * 5});
+  editor_core.setFoldRanges({{10, 50010, false}, {2, 4, false}});
+  REQUIRE(editor_core.getFoldRanges()[0].start_line == 2);
+
+  // 折叠5万行只在高度索引上标记一个区间
+  REQUIRE(editor_core.setFoldCollapsed(10, true));
+  REQUIRE_FALSE(editor_core.setFoldCollapsed(10, true));
+  editor_core.setScroll(0, line_height * 8);
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[2].logical_line == 10);
+  REQUIRE(model.lines[2].is_folded);
+  REQUIRE(model.lines[3].logical_line == 50011);
+  REQUIRE(model.lines[3].line_number_position.y == line_height * 3);
+  REQUIRE(document->getLogicalLines()[30000].layout_version == 0);
+
+  // 折叠区域之前插入行，区域整体下移并保持折叠
+  document->insertU8Text({0, 0}, "new\n");
+  REQUIRE(editor_core.getFoldRanges()[1].start_line == 11);
+  REQUIRE(editor_core.getFoldRanges()[1].end_line == 50011);
+  REQUIRE(editor_core.getFoldRanges()[1].collapsed);
+  EditorRenderModel inserted;
+  editor_core.buildRenderModel(inserted);
+  REQUIRE(inserted.lines[3].logical_line == 11);
+  REQUIRE(inserted.lines[4].logical_line == 50012);
+
+  // 编辑被隐藏的行时自动展开
+  document->insertU8Text({20, 0}, "x\n");
+  REQUIRE_FALSE(editor_core.getFoldRanges()[1].collapsed);
+  REQUIRE(editor_core.getFoldRanges()[1].end_line == 50012);
+  EditorRenderModel expanded;
+  editor_core.buildRenderModel(expanded);
+  REQUIRE(expanded.lines[4].logical_line == 12);
+  REQUIRE_FALSE(expanded.lines[3].is_folded);
+
+  // 一次批量编辑：之前插入行、只改首行、之后删除行，区域一次平移到位并保持折叠
+  REQUIRE(editor_core.setFoldCollapsed(11, true));
+  document->applyEdits({{{{0, 0}, {0, 0}}, "a\nb\n"}, {{{11, 4}, {11, 4}}, "x"}, {{{50020, 0}, {50021, 0}}, ""}});
+  REQUIRE(editor_core.getFoldRanges()[0].start_line == 5);
+  REQUIRE(editor_core.getFoldRanges()[1].start_line == 13);
+  REQUIRE(editor_core.getFoldRanges()[1].end_line == 50014);
+  REQUIRE(editor_core.getFoldRanges()[1].collapsed);
+  editor_core.setScroll(0, line_height * 11);
+  EditorRenderModel batched;
+  editor_core.buildRenderModel(batched);
+  REQUIRE(batched.lines[2].logical_line == 13);
+  REQUIRE(batched.lines[2].is_folded);
+  REQUIRE(batched.lines[3].logical_line == 50015);
+}
+
+TEST_CASE("Style Spans") {
+  DecorationManager decorations;
+  decorations.setLineSpans(0, {{6, 4, 2}, {0, 3, 1}});
+  decorations.setLineSpans(1, {{0, 5, 3}});
+  REQUIRE(decorations.getLineSpans(0)[0].style_id == 1);
+  REQUIRE(decorations.findLineSpans(0, 3, 6) == std::pair<size_t, size_t>(1, 1));
+  REQUIRE(decorations.findLineSpans(0, 2, 7) == std::pair<size_t, size_t>(0, 2));
+
+  // 在Span内插入文本时Span变长，之后的Span平移
+  decorations.onTextChanged({{{0, 1}, {0, 1}}, {0, 3}});
+  REQUIRE(decorations.getLineSpans(0)[0].length == 5);
+  REQUIRE(decorations.getLineSpans(0)[1].column == 8);
+  // 跨行删除：首行裁剪到删除起点，末行剩余部分接到首行
+  decorations.onTextChanged({{{0, 9}, {1, 2}}, {0, 9}});
+  const Vector<StyleSpan>& merged = decorations.getLineSpans(0);
+  REQUIRE(merged.size() == 3);
+  REQUIRE(merged[1].column == 8);
+  REQUIRE(merged[1].length == 1);
+  REQUIRE(merged[2].column == 9);
+  REQUIRE(merged[2].length == 3);
+  REQUIRE(merged[2].style_id == 3);
+  // 插入换行：变更点之后的Span移到新行
+  decorations.onTextChanged({{{0, 4}, {0, 4}}, {1, 0}});
+  REQUIRE(decorations.getLineSpans(0).size() == 1);
+  REQUIRE(decorations.getLineSpans(0)[0].length == 4);
+  REQUIRE(decorations.getLineSpans(1)[0].column == 0);
+  REQUIRE(decorations.getLineSpans(1)[0].length == 1);
+  REQUIRE(decorations.getLineSpans(1)[1].column == 4);
+
+  // 批量换行与删除跨越多个块：每10行插入3个空行后再删除，各行的Span随之移动并复原
+  DecorationManager block_decorations;
+  for (uint32_t line = 0; line < 1000; ++line) {
+    block_decorations.setLineSpans(line, {{0, 5, line}});
+  }
+  Vector<TextChange> insertions;
+  Vector<TextChange> deletions;
+  for (size_t group = 0; group < 100; ++group) {
+    insertions.push_back({{{group * 13, 5}, {group * 13, 5}}, {group * 13 + 3, 0}});
+    deletions.push_back({{{group * 10, 5}, {group * 10 + 3, 0}}, {group * 10, 5}});
+  }
+  block_decorations.onTextChangedBatch(insertions);
+  for (uint32_t line = 0; line < 1000; ++line) {
+    const size_t shifted_line = line + (line / 10 + (line % 10 == 0 ? 0 : 1)) * 3;
+    REQUIRE(block_decorations.getLineSpans(shifted_line)[0].style_id == line);
+  }
+  REQUIRE(block_decorations.getLineSpans(1).empty());
+  REQUIRE(block_decorations.getLineSpans(3).empty());
+  block_decorations.onTextChangedBatch(deletions);
+  for (uint32_t line = 0; line < 1000; ++line) {
+    REQUIRE(block_decorations.getLineSpans(line).size() == 1);
+    REQUIRE(block_decorations.getLineSpans(line)[0].style_id == line);
+  }
+  REQUIRE(block_decorations.getLineSpans(1000).empty());
+
+  // 布局按Span边界切分文本片段
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("int value = 10;\nnext"));
+  editor_core.loadDocument(document);
+  editor_core.setViewport({1000, 200});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[0].runs[0].length == 3);
+  editor_core.setLineSpans(0, {{0, 3, 1}, {12, 2, 2}});
+  REQUIRE_FALSE(document->getLogicalLines()[1].is_layout_dirty);
+  EditorRenderModel styled;
+  editor_core.buildRenderModel(styled);
+  const Vector<VisualRun>& runs = styled.lines[0].runs;
+  REQUIRE(runs.size() == 5);
+  REQUIRE(runs[0].style_id == 1);
+  REQUIRE(runs[3].column == 12);
+  REQUIRE(runs[3].length == 2);
+  REQUIRE(runs[3].style_id == 2);
+  REQUIRE(runs[3].x == runs[0].x + 120);
+  REQUIRE(runs[4].column == 14);
+  REQUIRE(runs[4].style_id == 0);
+
+  // 编辑后Span随文本平移
+  document->insertU8Text({0, 0}, "  ");
+  EditorRenderModel edited;
+  editor_core.buildRenderModel(edited);
+  REQUIRE(edited.lines[0].runs[0].column == 2);
+  REQUIRE(edited.lines[0].runs[0].style_id == 1);
+}
+
+TEST_CASE("Packed Style Spans") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("int a = 1;\nint b = 2;\n\nreturn a;"));
+  editor_core.loadDocument(document);
+  Ptr<DecorationManager> decorations = editor_core.getDecorations();
+
+  // 行差、列差、长度、样式ID、修饰符
+  const uint32_t packed[] = {
+    0, 0, 3, 1, 0,
+    0, 4, 1, 2, 0,
+    1, 0, 3, 1, 0,
+    2, 0, 6, 3, 0,
+  };
+  editor_core.setPackedSpans(0, packed, 4);
+  REQUIRE(decorations->getLineSpans(0).size() == 2);
+  REQUIRE(decorations->getLineSpans(0)[1].column == 4);
+  REQUIRE(decorations->getLineSpans(0)[1].style_id == 2);
+  REQUIRE(decorations->getLineSpans(1)[0].length == 3);
+  REQUIRE(decorations->getLineSpans(2).empty());
+  REQUIRE(decorations->getLineSpans(3)[0].style_id == 3);
+
+  // delta编辑：给第二行的b加上样式，之前的行保持不变
+  EditorRenderModel model;
+  editor_core.setViewport({1000, 200});
+  editor_core.buildRenderModel(model);
+  const uint32_t edits[] = {15, 0, 5, 0, 4, 1, 2, 0};
+  REQUIRE(editor_core.applyPackedSpanEdits(edits, 8));
+  REQUIRE_FALSE(document->getLogicalLines()[0].is_layout_dirty);
+  REQUIRE(document->getLogicalLines()[1].is_layout_dirty);
+  REQUIRE_FALSE(document->getLogicalLines()[3].is_layout_dirty);
+  REQUIRE(decorations->getLineSpans(1).size() == 2);
+  REQUIRE(decorations->getLineSpans(1)[1].column == 4);
+  REQUIRE(decorations->getLineSpans(3)[0].column == 0);
+
+  // 删除最后一个Span后末行不再有Span；格式无效的编辑被拒绝
+  const uint32_t remove_last[] = {20, 5, 0};
+  REQUIRE(editor_core.applyPackedSpanEdits(remove_last, 3));
+  REQUIRE(decorations->getLineSpans(3).empty());
+  const uint32_t invalid[] = {100, 5, 0};
+  REQUIRE_FALSE(editor_core.applyPackedSpanEdits(invalid, 3));
+  REQUIRE(decorations->getLineSpans(1).size() == 2);
+
+  // 从中间行开始设置时只替换该行及之后的Span
+  const uint32_t tail[] = {1, 0, 6, 4, 0};
+  editor_core.setPackedSpans(2, tail, 1);
+  REQUIRE(decorations->getLineSpans(0).size() == 2);
+  REQUIRE(decorations->getLineSpans(1).size() == 2);
+  REQUIRE(decorations->getLineSpans(3)[0].style_id == 4);
+
+  // 删除中间行的Span后，原来有Span的行被清空
+  const uint32_t three_lines[] = {
+    0, 0, 3, 1, 0,
+    1, 0, 3, 1, 0,
+    1, 0, 3, 1, 0,
+  };
+  editor_core.setPackedSpans(0, three_lines, 3);
+  const uint32_t skip_line[] = {5, 10, 5, 2, 0, 3, 1, 0};
+  REQUIRE(editor_core.applyPackedSpanEdits(skip_line, 8));
+  REQUIRE(decorations->getLineSpans(0).size() == 1);
+  REQUIRE(decorations->getLineSpans(1).empty());
+  REQUIRE(decorations->getLineSpans(2).size() == 1);
+
+  // 10万行，每行10个Span
+  Vector<uint32_t> tokens;
+  for (size_t i = 0; i < 1000000; ++i) {
+    const bool is_line_start = i % 10 == 0;
+    tokens.insert(tokens.end(), {is_line_start ? 1u : 0u, is_line_start ? 0u : 4u, 3, static_cast<uint32_t>(i % 7), 0});
+  }
+  BENCHMARK("Decode 1M Packed Spans") {
+    DecorationManager manager;
+    Vector<size_t> changed_lines;
+    manager.setPackedSpans(0, tokens.data(), 1000000, 200000, changed_lines);
+    return changed_lines.size();
+  };
+}
+
+TEST_CASE("Inlay Hints") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("let x = 1;\nfoo()\nend"));
+  editor_core.loadDocument(document);
+  editor_core.setViewport({1000, 200});
+  Vector<Vector<InlayHint>> hints(1);
+  hints[0].push_back({InlayType::TEXT, 5, ": int"});
+  editor_core.setInlayHints(0, std::move(hints));
+  Vector<Vector<PhantomText>> phantom_texts(2);
+  phantom_texts[1].push_back({5, "bar"});
+  editor_core.setPhantomTexts(0, std::move(phantom_texts));
+
+  // 镶嵌内容单独成片段，之后的文本按其宽度右移；光标位于镶嵌内容之前
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  const Vector<VisualRun>& runs = model.lines[0].runs;
+  REQUIRE(runs.size() == 5);
+  const float left = runs[0].x;
+  REQUIRE(runs[2].type == VisualRunType::INLAY_HINT);
+  REQUIRE(runs[2].column == 5);
+  REQUIRE(runs[2].x == left + 50);
+  REQUIRE(editor_core.getVisualRunText(runs[2].text_id) == CHAR16(": int"));
+  REQUIRE(runs[3].column == 6);
+  REQUIRE(runs[3].x == left + 110);
+  const VisualRun& phantom_run = model.lines[1].runs.back();
+  REQUIRE(phantom_run.type == VisualRunType::PHANTOM_TEXT);
+  REQUIRE(phantom_run.x == left + 50);
+  REQUIRE(editor_core.getVisualRunText(phantom_run.text_id) == CHAR16("bar"));
+
+  // 内容相同的批量替换不需要重新布局，只有变化的行失效
+  Vector<Vector<InlayHint>> same_hints(3);
+  same_hints[0].push_back({InlayType::TEXT, 5, ": int"});
+  editor_core.setInlayHints(0, std::move(same_hints));
+  REQUIRE_FALSE(document->getLogicalLines()[0].is_layout_dirty);
+  Vector<Vector<InlayHint>> new_hints(3);
+  new_hints[0].push_back({InlayType::TEXT, 5, ": int"});
+  new_hints[2].push_back({InlayType::ICON, 0, "", 7});
+  editor_core.setInlayHints(0, std::move(new_hints));
+  REQUIRE_FALSE(document->getLogicalLines()[0].is_layout_dirty);
+  REQUIRE_FALSE(document->getLogicalLines()[1].is_layout_dirty);
+  REQUIRE(document->getLogicalLines()[2].is_layout_dirty);
+  EditorRenderModel icon_model;
+  editor_core.buildRenderModel(icon_model);
+  const VisualRun& icon_run = icon_model.lines[2].runs[0];
+  REQUIRE(icon_run.type == VisualRunType::INLAY_HINT);
+  REQUIRE(icon_run.style_id == 7);
+  REQUIRE(icon_run.text_id == -1);
+  REQUIRE(icon_model.lines[2].runs[1].x == icon_run.x + 20);
+
+  // 编辑后镶嵌内容随文本平移，插入位置处的镶嵌内容移到新文本之后
+  document->insertU8Text({0, 0}, "  ");
+  document->insertU8Text({0, 7}, "y");
+  REQUIRE(editor_core.getDecorations()->getLineInlayHints(0)[0].column == 8);
+  document->insertU8Text({1, 0}, "\n");
+  REQUIRE(editor_core.getDecorations()->getLinePhantomTexts(2)[0].column == 5);
+  document->deleteU8Text({{2, 2}, {2, 5}});
+  const Vector<PhantomText>& shifted = editor_core.getDecorations()->getLinePhantomTexts(2);
+  REQUIRE(shifted.size() == 1);
+  REQUIRE(shifted[0].column == 2);
+  REQUIRE(shifted[0].text == "bar");
+}
+
+/// 加粗样式（style_id为2或3）宽度为1.5倍
+class StyledTextMeasurer : public FixedTextMeasurer {
+public:
+  float measureWidth(const U16String& text, uint32_t style_id) override {
+    const float width = FixedTextMeasurer::measureWidth(text, style_id);
+    return style_id == 2 || style_id == 3 ? width * 1.5f : width;
+  }
+};
+
+TEST_CASE("Style Runs") {
+  Ptr<StyledTextMeasurer> measurer = makePtr<StyledTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  editor_core.getStyleRegistry()->registerStyle({2, 0, true});
+  editor_core.getStyleRegistry()->registerStyle({3, 0, true});
+  Ptr<Document> document = makePtr<Document>(U8String("foo.bar baz\nab cd"));
+  editor_core.loadDocument(document);
+  editor_core.setViewport({1000, 200});
+
+  // 相邻且样式相同的Span合并为一个片段，样式为0的Span与空隙合并
+  editor_core.setLineSpans(0, {{0, 3, 1}, {3, 1, 1}, {4, 3, 1}, {8, 1, 0}});
+  editor_core.setLineSpans(1, {{0, 2, 2}});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[0].runs.size() == 2);
+  REQUIRE(model.lines[0].runs[0].length == 7);
+  REQUIRE(model.lines[0].runs[0].style_id == 1);
+  REQUIRE(model.lines[0].runs[1].length == 3);
+
+  // 加粗文本按加粗字体测量，之后的片段随之右移
+  const Vector<VisualRun>& runs = model.lines[1].runs;
+  REQUIRE(runs[1].x == runs[0].x + 40);
+  // 同一字体变体的不同样式共享宽度缓存
+  const size_t measure_count = measurer->measure_count;
+  editor_core.setLineSpans(1, {{0, 2, 3}});
+  EditorRenderModel restyled;
+  editor_core.buildRenderModel(restyled);
+  REQUIRE(measurer->measure_count == measure_count);
+  REQUIRE(restyled.lines[1].runs[1].x == runs[1].x);
+
+  // 片段数超过上限时剩余文本合并为一个片段
+  U8String long_text;
+  for (size_t i = 0; i < kMaxLineRuns; ++i) {
+    long_text += "a ";
+  }
+  document->insertU8Text({1, 5}, long_text);
+  editor_core.buildRenderModel(model);
+  const Vector<VisualRun>& capped_runs = document->getLogicalLines()[1].visual_lines[0].runs;
+  REQUIRE(capped_runs.size() == kMaxLineRuns);
+  REQUIRE(capped_runs.back().column + capped_runs.back().length == document->getLogicalLines()[1].cached_text.length());
+}
+
+TEST_CASE("Style Run Benchmark") {
+  // 高亮密集的代码：每个标识符、运算符、标点都有各自的Span，相邻的标点使用相同样式
+  U8String text;
+  Vector<Vector<StyleSpan>> line_spans;
+  for (size_t i = 0; i < 2000; ++i) {
+    text += "    auto value" + std::to_string(i % 10) + " = compute(first, second)->field[index] + other(1, 2, 3);\n";
+    line_spans.push_back({{4, 4, 1}, {9, 6, 2}, {16, 1, 3}, {18, 7, 4}, {25, 1, 5}, {26, 5, 2}, {31, 1, 5},
+      {33, 6, 2}, {39, 1, 5}, {40, 2, 3}, {42, 5, 6}, {47, 1, 5}, {48, 5, 2}, {53, 1, 5}, {55, 1, 3},
+      {57, 5, 4}, {62, 1, 5}, {63, 1, 7}, {64, 1, 5}, {66, 1, 7}, {67, 1, 5}, {69, 1, 7}, {70, 2, 5}});
+  }
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  Ptr<DecorationManager> decorations = makePtr<DecorationManager>();
+  decorations->getStyleRegistry()->registerStyle({1, 0, true});
+  decorations->getStyleRegistry()->registerStyle({4, 0, false, true});
+  for (size_t i = 0; i < line_spans.size(); ++i) {
+    decorations->setLineSpans(i, std::move(line_spans[i]));
+  }
+  Ptr<Document> document = makePtr<Document>(std::move(text));
+  TextLayout layout(measurer, decorations);
+  layout.loadDocument(document);
+  BENCHMARK("Layout Tokenized Lines") {
+    for (size_t i = 0; i < document->getLineCount(); ++i) {
+      layout.invalidateLine(i);
+    }
+    return layout.prefetchLayout(0, layout.getContentHeight(), SIZE_MAX);
+  };
+}
+
+TEST_CASE("Style Snapshot") {
+  Ptr<StyledTextMeasurer> measurer = makePtr<StyledTextMeasurer>();
+  Ptr<DecorationManager> decorations = makePtr<DecorationManager>();
+  Ptr<StyleRegistry> registry = decorations->getStyleRegistry();
+  registry->registerStyle({1, 0xFF0000});
+  registry->registerStyle({2, 0x00FF00, true});
+  Ptr<const StyleSnapshot> snapshot = registry->getSnapshot();
+  REQUIRE(snapshot->size() == 3);
+  REQUIRE(snapshot->get(1).color == 0xFF0000);
+  REQUIRE(snapshot->get(2).width_cache_id == 1);
+  REQUIRE(snapshot->get(100).color == 0);
+  REQUIRE(registry->getSnapshot() == snapshot);
+
+  decorations->setLineSpans(0, {{0, 2, 2}});
+  Ptr<Document> document = makePtr<Document>(U8String("ab cd\nef"));
+  TextLayout layout(measurer, decorations);
+  layout.loadDocument(document);
+  REQUIRE(layout.prefetchLayout(0, 100, 10) == 2);
+  REQUIRE(layout.getColumnX(0, 3) == 40);
+
+  // 只修改颜色的主题切换不需要重新布局，旧快照保持不变
+  registry->setStyles({{1, 0x0000FF}, {2, 0x00FFFF, true}});
+  REQUIRE(layout.prefetchLayout(0, 100, 10) == 0);
+  REQUIRE(registry->getSnapshot()->get(1).color == 0x0000FF);
+  REQUIRE(snapshot->get(1).color == 0xFF0000);
+  REQUIRE(registry->getSnapshot()->getLayoutVersion() == snapshot->getLayoutVersion());
+
+  // 字体变体变化时重新布局
+  registry->setStyles({{1, 0x0000FF}, {2, 0x00FFFF}});
+  REQUIRE(layout.prefetchLayout(0, 100, 10) == 2);
+  REQUIRE(registry->getSnapshot()->getLayoutVersion() != snapshot->getLayoutVersion());
+}
+
+TEST_CASE("Indent Guides") {
+  constexpr uint32_t kBlank = IndentIndex::kBlankIndent;
+  Vector<uint32_t> indents = {0, 4, 8, kBlank, 4, 0};
+  size_t compute_count = 0;
+  IndentIndex index([&](size_t line) { ++compute_count; return indents[line]; });
+  index.reset(indents.size());
+  auto next_line = [](size_t line) { return line; };
+  Vector<IndentBlock> blocks;
+
+  // 空白行属于包含其后首个非空白行的区块
+  index.collectBlocks(3, 3, next_line, blocks);
+  REQUIRE(blocks.size() == 1);
+  REQUIRE(blocks[0].header_line == 0);
+  REQUIRE(blocks[0].body_indent == 4);
+  REQUIRE(blocks[0].last_line == 4);
+
+  index.collectBlocks(0, 5, next_line, blocks);
+  REQUIRE(blocks.size() == 2);
+  REQUIRE(blocks[1].header_line == 1);
+  REQUIRE(blocks[1].indent == 4);
+  REQUIRE(blocks[1].last_line == 2);
+
+  // 缩进在需要时计算并缓存，编辑后只重新计算变更的行
+  indents.assign(100000, 4);
+  indents[0] = 0;
+  indents[88000] = 0;
+  indents[92000] = 0;
+  index.reset(indents.size());
+  compute_count = 0;
+  index.collectBlocks(90000, 90010, next_line, blocks);
+  REQUIRE(blocks.size() == 1);
+  REQUIRE(blocks[0].header_line == 88000);
+  REQUIRE(blocks[0].last_line == 91999);
+  REQUIRE(blocks[0].is_end_known);
+  const size_t first_count = compute_count;
+  indents.insert(indents.begin() + 90005, 2, 8);
+  index.spliceLines(90005, 0, 2);
+  index.invalidateLines(90004, 90005);
+  compute_count = 0;
+  index.collectBlocks(90000, 90010, next_line, blocks);
+  REQUIRE(blocks.size() == 2);
+  REQUIRE(blocks[1].header_line == 90004);
+  REQUIRE(blocks[1].last_line == 90006);
+  REQUIRE(compute_count <= 3);
+  REQUIRE(compute_count < first_count);
+
+  // 超大区块内只计算视口附近的行：首行在窗口外的外层区块不输出，窗口内开始的区块在窗口边界截断
+  indents.assign(1000000, 4);
+  indents[0] = 0;
+  indents[500005] = 0;
+  index.reset(indents.size());
+  compute_count = 0;
+  index.collectBlocks(500000, 500010, next_line, blocks);
+  REQUIRE(compute_count <= IndentIndex::kResolveWindowLines * 2 + 20);
+  REQUIRE(blocks.size() == 1);
+  REQUIRE(blocks[0].header_line == 500005);
+  REQUIRE_FALSE(blocks[0].is_end_known);
+  REQUIRE(blocks[0].last_line == 500010 + IndentIndex::kResolveWindowLines);
+  REQUIRE(index.findPrevLess(500000, 4) == 0);
+
+  // 只输出视口内的引导线，竖线位于区块首行缩进处，区块结束处有横线
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  TextLayout layout(measurer, makePtr<DecorationManager>());
+  Ptr<Document> document = makePtr<Document>(U8String("fn a\n    if b\n\t    c\n\n    d\ne\n"));
+  layout.loadDocument(document);
+  const EditorParams& params = layout.getEditorParams();
+  const float line_height = params.font_height;
+  layout.setViewport({400, line_height * 4});
+  layout.setViewState({1, 0, 0});
+  EditorRenderModel model;
+  layout.composeRenderModel(model);
+  const float text_left = model.split_x;
+  REQUIRE(model.guide_lines.size() == 3);
+  const GuideLine& outer = model.guide_lines[0];
+  REQUIRE(outer.direction == GuideLineDirection::VERTICAL);
+  REQUIRE(outer.start.x == text_left);
+  REQUIRE(outer.start.y == line_height);
+  REQUIRE(outer.end.y == line_height * 4);
+  const GuideLine& inner = model.guide_lines[1];
+  REQUIRE(inner.start.x == text_left + 40);
+  REQUIRE(inner.start.y == line_height * 2);
+  REQUIRE(inner.end.y == line_height * 3);
+  const GuideLine& corner = model.guide_lines[2];
+  REQUIRE(corner.direction == GuideLineDirection::HORIZONTAL);
+  REQUIRE(corner.start.x == text_left + 40);
+  REQUIRE(corner.end.x == text_left + 80);
+
+  // 滚动后外层区块在视口内结束
+  layout.setViewState({1, 0, line_height * 2});
+  EditorRenderModel scrolled;
+  layout.composeRenderModel(scrolled);
+  REQUIRE(scrolled.guide_lines.size() == 4);
+  REQUIRE(scrolled.guide_lines[0].start.y == 0);
+  REQUIRE(scrolled.guide_lines[0].end.y == line_height * 3);
+  REQUIRE(scrolled.guide_lines[1].direction == GuideLineDirection::HORIZONTAL);
+  REQUIRE(scrolled.guide_lines[1].end.x == text_left + 40);
+}
+
+TEST_CASE("Diagnostics") {
+  DiagnosticIndex index;
+  Vector<Diagnostic> diagnostics;
+  for (size_t line = 50000; line-- > 0;) {
+    diagnostics.push_back({{{line, 2}, {line, 5}}, DiagnosticSeverity::WARNING, DiagnosticStyle::SQUIGGLE});
+  }
+  index.setDiagnostics(std::move(diagnostics));
+  Vector<Diagnostic> result;
+  index.query(100, 102, result);
+  REQUIRE(result.size() == 3);
+  REQUIRE(result[0].range.start.line == 100);
+
+  // 插入换行后之后的诊断整体下移
+  index.onTextChanged({{{10, 0}, {10, 0}}, {11, 0}});
+  index.query(9, 11, result);
+  REQUIRE(result.size() == 2);
+  REQUIRE(result[0].range.start.line == 9);
+  REQUIRE(result[1].range.start.line == 11);
+  index.query(20001, 20001, result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(result[0].range.end.line == 20001);
+
+  // 删除多行时被删除范围内的诊断收缩到变更起点
+  index.onTextChanged({{{5, 0}, {7, 0}}, {5, 0}});
+  index.query(5, 5, result);
+  REQUIRE(result.size() == 3);
+  REQUIRE(result[0].range.start == TextPosition {5, 0});
+  REQUIRE(result[0].range.end == TextPosition {5, 0});
+  REQUIRE(result[2].range.start == TextPosition {5, 2});
+  index.query(19999, 19999, result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(index.size() == 50000);
+
+  // 诊断内部插入时变长，末尾插入不扩展诊断
+  index.onTextChanged({{{100, 3}, {100, 3}}, {100, 5}});
+  index.onTextChanged({{{100, 7}, {100, 7}}, {100, 8}});
+  index.query(100, 100, result);
+  REQUIRE(result[0].range.start == TextPosition {100, 2});
+  REQUIRE(result[0].range.end == TextPosition {100, 7});
+
+  // 只输出视口内的下划线片段，跨行诊断每行一段，空范围至少一个空格宽
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("let x = 1\nfoo()\n"));
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({400, line_height * 4});
+  editor_core.setDiagnostics({
+    {{{1, 5}, {1, 5}}, DiagnosticSeverity::ERROR, DiagnosticStyle::UNDERLINE},
+    {{{0, 4}, {0, 5}}, DiagnosticSeverity::ERROR, DiagnosticStyle::SQUIGGLE},
+    {{{0, 8}, {1, 3}}, DiagnosticSeverity::HINT, DiagnosticStyle::DASHED},
+  });
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  const float text_left = model.split_x;
+  REQUIRE(model.diagnostics.size() == 4);
+  REQUIRE(model.diagnostics[0].start.x == text_left + 40);
+  REQUIRE(model.diagnostics[0].end.x == text_left + 50);
+  REQUIRE(model.diagnostics[0].start.y == line_height);
+  REQUIRE(model.diagnostics[1].severity == DiagnosticSeverity::HINT);
+  REQUIRE(model.diagnostics[1].end.x == text_left + 90);
+  REQUIRE(model.diagnostics[2].start.x == text_left);
+  REQUIRE(model.diagnostics[2].end.x == text_left + 30);
+  REQUIRE(model.diagnostics[2].start.y == line_height * 2);
+  REQUIRE(model.diagnostics[3].style == DiagnosticStyle::UNDERLINE);
+  REQUIRE(model.diagnostics[3].start.x == text_left + 50);
+  REQUIRE(model.diagnostics[3].end.x == text_left + 60);
+
+  // 诊断随编辑平移
+  document->insertU8Text({0, 0}, "\n");
+  EditorRenderModel shifted;
+  editor_core.buildRenderModel(shifted);
+  REQUIRE(shifted.diagnostics.size() == 4);
+  REQUIRE(shifted.diagnostics[0].start.y == line_height * 2);
+}
+
+TEST_CASE("Multi Cursor") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  Ptr<Document> document = makePtr<Document>(U8String("foo\nfoo\nfoo"));
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({400, line_height * 8});
+
+  // 选区按位置排序，主光标随之移动
+  editor_core.setSelections({{{2, 0}, {2, 3}}, {{0, 0}, {0, 3}}, {{1, 3}, {1, 0}}}, 2);
+  REQUIRE(editor_core.getSelections()[0].anchor == TextPosition {0, 0});
+  REQUIRE(editor_core.getPrimarySelectionIndex() == 1);
+
+  // 所有光标一次输入，光标移动到插入的文本之后
+  editor_core.insertText("bar\n");
+  REQUIRE(document->getU8Text() == "bar\n\nbar\n\nbar\n");
+  const Vector<Selection>& selections = editor_core.getSelections();
+  REQUIRE(selections.size() == 3);
+  REQUIRE(selections[0].caret == TextPosition {1, 0});
+  REQUIRE(selections[1].caret == TextPosition {3, 0});
+  REQUIRE(selections[2].caret == TextPosition {5, 0});
+
+  // 行首向前删除与上一行合并，之后按字素簇删除
+  editor_core.deleteBackward();
+  REQUIRE(document->getU8Text() == "bar\nbar\nbar");
+  REQUIRE(selections[2].caret == TextPosition {2, 3});
+  editor_core.deleteBackward();
+  REQUIRE(document->getU8Text() == "ba\nba\nba");
+
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.cursor.position.x == model.split_x + 20);
+  REQUIRE(model.cursor.position.y == line_height);
+  REQUIRE(model.extra_cursors.size() == 2);
+  REQUIRE(model.extra_cursors[0].position.y == 0);
+  REQUIRE(model.extra_cursors[1].position.y == line_height * 2);
+
+  // 外部编辑平移光标
+  document->insertU8Text({0, 0}, "\n");
+  REQUIRE(selections[0].caret == TextPosition {1, 2});
+  REQUIRE(selections[2].caret == TextPosition {3, 2});
+  document->deleteU8Text({{1, 1}, {2, 2}});
+  REQUIRE(selections.size() == 2);
+  REQUIRE(selections[0].caret == TextPosition {1, 1});
+  REQUIRE(selections[1].caret == TextPosition {2, 2});
+
+  // 重叠或相接的光标合并
+  editor_core.setSelections({{{0, 0}, {1, 1}}, {{1, 0}, {1, 2}}, {{1, 2}, {1, 2}}});
+  REQUIRE(selections.size() == 1);
+  REQUIRE(selections[0].range().end == TextPosition {1, 2});
+}
+
+TEST_CASE("Point Hit Testing") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  editor_core.loadDocument(makePtr<Document>(U8String("aaaa bbbb cccc\nx=1")));
+  const EditorParams& params = editor_core.getEditorParams();
+  const float line_height = params.font_height;
+  const float text_left = params.line_number_margin * 2 + 10;
+  editor_core.setWrapMode(WrapMode::WORD_BREAK);
+  editor_core.setViewport({text_left + 100, 400});
+  editor_core.setInlayHints(1, {{{InlayType::TEXT, 1, ": int"}}});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[1].runs[0].column == 10);
+
+  // 自动换行的第二个视觉行，横坐标相对视觉行起点
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 12, line_height + 5}) == TextPosition {0, 11});
+  // 点击第一个视觉行末尾时停在断行处之前
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 99, 5}) == TextPosition {0, 9});
+  // 点击镶嵌提示落到其所在列，之后的字符按中点取最近的列
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 30, line_height * 2 + 5}) == TextPosition {1, 1});
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 62, line_height * 2 + 5}) == TextPosition {1, 1});
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 67, line_height * 2 + 5}) == TextPosition {1, 2});
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 500, line_height * 10}) == TextPosition {1, 3});
+
+  // 光标坐标与点击定位互逆
+  const PointF point = editor_core.getPositionPoint({1, 2});
+  REQUIRE(point.x == text_left + 70);
+  REQUIRE(point.y == line_height * 2);
+  REQUIRE(editor_core.getPositionAtPoint(point) == TextPosition {1, 2});
+  REQUIRE(editor_core.getPositionPoint({0, 10}).y == line_height);
+
+  // 滚动后同样换算
+  editor_core.setScroll(0, line_height);
+  REQUIRE(editor_core.getPositionAtPoint({text_left + 12, 5}) == TextPosition {0, 11});
+
+  // 单击定位光标，双击选中单词
+  float points[] = {text_left + 12, 5};
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, points));
+  REQUIRE(editor_core.getSelections().size() == 1);
+  REQUIRE(editor_core.getSelections()[0].caret == TextPosition {0, 11});
+  GestureResult result = editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, points));
+  REQUIRE(result.type == GestureType::DOUBLE_TAP);
+  REQUIRE(editor_core.getSelections()[0].range() == TextRange {{0, 10}, {0, 14}});
+
+  // 中文标点和全角空格不属于单词，全角字母数字属于单词
+  editor_core.loadDocument(makePtr<Document>(U8String("变量，名字\u3000值 ａ１\u00A0b")));
+  editor_core.setScroll(0, 0);
+  const PointF word_point = editor_core.getPositionPoint({0, 4});
+  float word_points[] = {word_point.x + 5, word_point.y + 5};
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, word_points));
+  result = editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, word_points));
+  REQUIRE(result.type == GestureType::DOUBLE_TAP);
+  REQUIRE(editor_core.getSelections()[0].range() == TextRange {{0, 3}, {0, 5}});
+  const PointF fullwidth_point = editor_core.getPositionPoint({0, 8});
+  float fullwidth_points[] = {fullwidth_point.x + 5, fullwidth_point.y + 5};
+  editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, fullwidth_points));
+  result = editor_core.handleGestureEvent(GestureEvent::create(EventType::MOUSE_DOWN, 1, fullwidth_points));
+  REQUIRE(result.type == GestureType::DOUBLE_TAP);
+  REQUIRE(editor_core.getSelections()[0].range() == TextRange {{0, 8}, {0, 10}});
+}
+
+TEST_CASE("Selection Rects") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  U8String text;
+  for (size_t i = 0; i < 10000; ++i) {
+    text += "line text\n";
+  }
+  Ptr<Document> document = makePtr<Document>(std::move(text));
+  editor_core.loadDocument(document);
+  const float line_height = editor_core.getEditorParams().font_height;
+  editor_core.setViewport({400, line_height * 4});
+
+  // 全选时只输出可见行的矩形，跨过行尾的部分多一个空格宽度
+  editor_core.selectAll();
+  REQUIRE(editor_core.getSelections()[0].range().end == TextPosition {10000, 0});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.selection_rects.size() == model.lines.size());
+  REQUIRE(model.selection_rects[0].origin.x == model.split_x);
+  REQUIRE(model.selection_rects[0].width == 100);
+  REQUIRE(model.selection_rects[1].origin.y == line_height);
+  REQUIRE(model.selection_rects[1].height == line_height);
+
+  // 横向滚动时裁剪到文本区域内
+  editor_core.setSelections({{{1, 2}, {1, 6}}, {{3, 5}, {3, 9}}});
+  editor_core.setScroll(40, 0);
+  EditorRenderModel scrolled;
+  editor_core.buildRenderModel(scrolled);
+  REQUIRE(scrolled.selection_rects.size() == 2);
+  REQUIRE(scrolled.selection_rects[0].origin.x == model.split_x);
+  REQUIRE(scrolled.selection_rects[0].width == 20);
+  REQUIRE(scrolled.selection_rects[1].origin.x == model.split_x + 10);
+  REQUIRE(scrolled.selection_rects[1].origin.y == line_height * 3);
+
+  // 复制时多个选区以换行分隔，分块输出
+  U8String copied;
+  editor_core.copySelectedText([&](const char* data, size_t length) { copied.append(data, length); });
+  REQUIRE(copied == "ne t\ntext");
+
+  // 自动换行的选区每个视觉行一个矩形
+  editor_core.loadDocument(makePtr<Document>(U8String("aaaa bbbb cccc")));
+  const float text_left = editor_core.getEditorParams().line_number_margin * 2 + 10;
+  editor_core.setWrapMode(WrapMode::WORD_BREAK);
+  editor_core.setScroll(0, 0);
+  editor_core.setViewport({text_left + 100, 400});
+  editor_core.setSelections({{{0, 2}, {0, 12}}});
+  EditorRenderModel wrapped;
+  editor_core.buildRenderModel(wrapped);
+  REQUIRE(wrapped.selection_rects.size() == 2);
+  REQUIRE(wrapped.selection_rects[0].origin.x == text_left + 20);
+  REQUIRE(wrapped.selection_rects[0].width == 80);
+  REQUIRE(wrapped.selection_rects[1].origin.x == text_left);
+  REQUIRE(wrapped.selection_rects[1].width == 20);
+  REQUIRE(wrapped.selection_rects[1].origin.y == line_height);
+}
+
+TEST_CASE("Scroll To Line") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  U8String text;
+  for (size_t i = 0; i < 100000; ++i) {
+    text += i == 50000 ? "aaaa bbbb cccc dddd eeee\n" : "line\n";
+  }
+  Ptr<Document> document = makePtr<Document>(std::move(text));
+  editor_core.loadDocument(document);
+  const EditorParams& params = editor_core.getEditorParams();
+  const float line_height = params.font_height;
+  const float viewport_height = line_height * 10;
+  editor_core.setWrapMode(WrapMode::WORD_BREAK);
+  editor_core.setViewport({params.line_number_margin * 2 + 60 + 100, viewport_height});
+
+  // 只布局目标行，之前的行按估算高度由高度索引求得纵坐标
+  editor_core.scrollToLine(50000, ScrollBehavior::GOTO_TOP);
+  REQUIRE(editor_core.getViewState().scroll_y == line_height * 50000);
+  Vector<LogicalLine>& logical_lines = document->getLogicalLines();
+  REQUIRE(logical_lines[49999].visual_lines.empty());
+  REQUIRE(logical_lines[50000].visual_lines.size() == 3);
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  REQUIRE(model.lines[0].logical_line == 50000);
+  REQUIRE(logical_lines[10000].visual_lines.empty());
+
+  // 居中、底部按目标行换行后的实际高度计算
+  editor_core.scrollToLine(50000, ScrollBehavior::GOTO_CENTER);
+  REQUIRE(editor_core.getViewState().scroll_y == line_height * 50000 + (line_height * 3 - viewport_height) / 2);
+  editor_core.scrollToLine(50000, ScrollBehavior::GOTO_BOTTOM);
+  REQUIRE(editor_core.getViewState().scroll_y == line_height * 50003 - viewport_height);
+  editor_core.scrollToLine(2, ScrollBehavior::GOTO_BOTTOM);
+  REQUIRE(editor_core.getViewState().scroll_y == 0);
+
+  // 平滑滚动按时间推进，结束时停在目标位置
+  editor_core.smoothScrollToLine(100, ScrollBehavior::GOTO_TOP, 200);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  REQUIRE(editor_core.updateScrollAnimation());
+  const float scroll_y = editor_core.getViewState().scroll_y;
+  REQUIRE(scroll_y > 0);
+  REQUIRE(scroll_y < line_height * 100);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  REQUIRE_FALSE(editor_core.updateScrollAnimation());
+  REQUIRE(editor_core.getViewState().scroll_y == line_height * 100);
+
+  // 手动滚动打断动画
+  editor_core.smoothScrollToLine(5000, ScrollBehavior::GOTO_TOP, 200);
+  editor_core.setScroll(0, 10);
+  REQUIRE_FALSE(editor_core.updateScrollAnimation());
+  REQUIRE(editor_core.getViewState().scroll_y == 10);
+}
+
+TEST_CASE("Multi Cursor Benchmark") {
+  Ptr<FixedTextMeasurer> measurer = makePtr<FixedTextMeasurer>();
+  EditorCore editor_core({}, measurer);
+  U8String text;
+  for (size_t i = 0; i < 10000; ++i) {
+    text += "let value = 1;\n";
+  }
+  Ptr<Document> document = makePtr<Document>(std::move(text));
+  editor_core.loadDocument(document);
+  editor_core.setViewport({800, 600});
+  EditorRenderModel model;
+  editor_core.buildRenderModel(model);
+  Vector<Selection> selections;
+  for (size_t line = 0; line < 10000; ++line) {
+    selections.push_back({{line, 4}, {line, 9}});
+  }
+  editor_core.setSelections(std::move(selections));
+  editor_core.insertText("v");
+  REQUIRE(editor_core.getSelections().size() == 10000);
+  REQUIRE(editor_core.getSelections()[9999].caret == TextPosition {9999, 5});
+
+  BENCHMARK("Type With 10k Cursors") {
+    editor_core.insertText("x");
+    EditorRenderModel frame;
+    editor_core.buildRenderModel(frame);
+    return frame.extra_cursors.size();
+  };
+
+  // 20万行中每20行一个光标换行，同一事务的行数变化一次应用到各个索引
+  EditorCore enter_core({}, measurer);
+  text.clear();
+  for (size_t i = 0; i < 200000; ++i) {
+    text += "let value = 1;\n";
+  }
+  Ptr<Document> enter_document = makePtr<Document>(std::move(text));
+  enter_core.loadDocument(enter_document);
+  enter_core.setViewport({800, 600});
+  enter_core.buildRenderModel(model);
+  selections.clear();
+  for (size_t line = 0; line < 200000; line += 20) {
+    selections.push_back({{line, 4}, {line, 4}});
+  }
+  enter_core.setSelections(std::move(selections));
+  enter_core.insertText("\n");
+  REQUIRE(enter_document->getLineCount() == 210001);
+  REQUIRE(enter_core.getSelections()[9999].caret == TextPosition {209980, 0});
+  const float line_height = enter_core.getEditorParams().font_height;
+  enter_core.scrollToLine(209980, ScrollBehavior::GOTO_TOP);
+  REQUIRE(enter_core.getViewState().scroll_y == line_height * 209980);
+
+  BENCHMARK("Enter With 10k Cursors") {
+    enter_core.insertText("\n");
+    EditorRenderModel frame;
+    enter_core.buildRenderModel(frame);
+    return frame.extra_cursors.size();
+  };
+}